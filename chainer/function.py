@@ -130,9 +130,19 @@ class Function(object):
     Attributes:
         inputs: A tuple or list of input variables.
         outputs: A tuple or list of output variables.
+        accept_inplace_grad (bool): Class attribute. A function that can
+            write its input gradients over its output gradients sets it to
+            ``True``, the default is ``False``.
+        inplace_grad (bool): Set by :meth:`Variable.backward` right before
+            :meth:`backward` of a function accepting it. ``True`` when every
+            output gradient is an array the backward pass allocated itself
+            and drops after this call, so :meth:`backward` may overwrite it.
 
     """
 
+    accept_inplace_grad = False
+    inplace_grad = False
+
     def __call__(self, *inputs):
         """Applies forward propagation with chaining backward references.
 
@@ -163,7 +173,8 @@ class Function(object):
                   else chainer.Variable(x, volatile=flag.AUTO)
                   for x in inputs]
         self.mkldnn_opt = False
-        in_data = tuple([x.data for x in inputs])
+        # _data, reading data would count as a write of tracked variables
+        in_data = tuple([x._data for x in inputs])
         if chainer.is_debug():
             self._stack = traceback.extract_stack()
 
@@ -60,6 +60,10 @@ class PrintHook(function.FunctionHook):
         self._print('function\t{}'.format(function.label))
         self._print('input data')
         for d in in_data:
+            if d is None:
+                # see Variable.release_data
+                self._print('(released)')
+                continue
             self._print(chainer.Variable(d).debug_print())
         if out_grad is not None:
             self._print('output gradient')
@@ -3,6 +3,8 @@ from chainer import function
 from chainer import utils
 from chainer.utils import type_check
 import numpy
+from mkldnn import mkldnn as mkl
+from mkldnn import switch
 
 
 class ClippedReLU(function.Function):
@@ -28,11 +30,22 @@ class ClippedReLU(function.Function):
         type_check.expect(x_type.dtype.kind == 'f')
 
     def forward_cpu(self, x):
+        if switch.enable_eltwiseF(x):
+            y = numpy.empty(x[0].shape, dtype=numpy.float32)
+            mkl.Eltwise_F32.do_forward(
+                x[0].ravel(), y.ravel(), mkl.ELTWISE_CLIPPED_RELU, self.cap)
+            return y,
         x = x[0]
         return utils.force_array(numpy.minimum(numpy.maximum(0, x), self.cap),
                                  x.dtype),
 
     def backward_cpu(self, x, gy):
+        if switch.enable_eltwiseF((x[0], gy[0])):
+            gx = numpy.empty(x[0].shape, dtype=numpy.float32)
+            mkl.Eltwise_F32.do_backward(
+                x[0].ravel(), gy[0].ravel(), gx.ravel(),
+                mkl.ELTWISE_CLIPPED_RELU, self.cap)
+            return gx,
         x = x[0]
         return utils.force_array(gy[0] * (0 < x) * (x < self.cap), x.dtype),
 
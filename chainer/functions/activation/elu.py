@@ -3,6 +3,8 @@ import numpy
 from chainer import cuda
 from chainer import function
 from chainer.utils import type_check
+from mkldnn import mkldnn as mkl
+from mkldnn import switch
 
 
 class ELU(function.Function):
@@ -19,6 +21,11 @@ class ELU(function.Function):
         type_check.expect(x_type.dtype.kind == 'f')
 
     def forward_cpu(self, x):
+        if switch.enable_eltwiseF(x):
+            y = numpy.empty(x[0].shape, dtype=numpy.float32)
+            mkl.Eltwise_F32.do_forward(
+                x[0].ravel(), y.ravel(), mkl.ELTWISE_ELU, self.alpha)
+            return y,
         y = x[0].copy()
         neg_indices = x[0] < 0
         y[neg_indices] = self.alpha * (numpy.exp(y[neg_indices]) - 1)
@@ -33,6 +40,12 @@ class ELU(function.Function):
         return y,
 
     def backward_cpu(self, x, gy):
+        if switch.enable_eltwiseF((x[0], gy[0])):
+            gx = numpy.empty(x[0].shape, dtype=numpy.float32)
+            mkl.Eltwise_F32.do_backward(
+                x[0].ravel(), gy[0].ravel(), gx.ravel(),
+                mkl.ELTWISE_ELU, self.alpha)
+            return gx,
         gx = gy[0].copy()
         neg_indices = x[0] < 0
         gx[neg_indices] *= self.alpha * numpy.exp(x[0][neg_indices])
@@ -1,6 +1,10 @@
+import numpy
+
 from chainer import cuda
 from chainer import function
 from chainer.utils import type_check
+from mkldnn import mkldnn as mkl
+from mkldnn import switch
 
 
 def _kern():
@@ -22,6 +26,11 @@ class LeakyReLU(function.Function):
         type_check.expect(x_type.dtype.kind == 'f')
 
     def forward_cpu(self, x):
+        if switch.enable_eltwiseF(x):
+            # relu primitive with a negative slope
+            y = numpy.empty(x[0].shape, dtype=numpy.float32)
+            mkl.Relu_F32.do_forward(x[0].ravel(), y.ravel(), self.slope)
+            return y,
         y = x[0].copy()
         y[x[0] < 0] *= self.slope
         return y,
@@ -31,6 +40,11 @@ class LeakyReLU(function.Function):
         return y,
 
     def backward_cpu(self, x, gy):
+        if switch.enable_eltwiseF((x[0], gy[0])):
+            gx = numpy.empty(x[0].shape, dtype=numpy.float32)
+            mkl.Relu_F32.do_backward(
+                x[0].ravel(), gy[0].ravel(), gx.ravel(), self.slope)
+            return gx,
         gx = gy[0].copy()
         gx[x[0] < 0] *= self.slope
         return gx,
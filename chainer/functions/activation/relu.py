@@ -3,9 +3,11 @@ import numpy
 from chainer import cuda
 from chainer import function
 from chainer import utils
+from chainer.utils import array
 from chainer.utils import type_check
 from mkldnn import mkldnn as mkl
 from mkldnn import switch
+from mkldnn.mdarray import mdarray
 import chainer
 
 if cuda.cudnn_enabled:
@@ -17,11 +19,30 @@ if cuda.cudnn_enabled:
 
 class ReLU(function.Function):
 
-    """Rectified Linear Unit."""
-    # TODO(beam2d): Implement in-place version.
+    """Rectified Linear Unit.
 
-    def __init__(self, use_cudnn=True):
+    With ``inplace=True`` the output overwrites the input array on CPU. The
+    backward only needs the sign of the input, which the output keeps.
+    It accepts in-place gradients, see :class:`~chainer.Function`, then the
+    input gradient overwrites the output gradient.
+
+    With ``use_mask=True`` training on CPU keeps a bit mask of the sign of
+    the input for backward instead of reading the input again, so
+    :func:`relu` can release the data of an intermediate input when
+    ``mkldnn.switch.enable_release_inputs`` is on.
+    """
+
+    accept_inplace_grad = True
+    mask = None
+
+    def __init__(self, use_cudnn=True, inplace=False, use_mask=False):
         self.use_cudnn = use_cudnn
+        self.inplace = inplace
+        self.use_mask = use_mask
+
+    def _can_overwrite(self, a):
+        return (isinstance(a, numpy.ndarray) and
+                a.dtype == numpy.float32 and a.flags.c_contiguous)
 
     def check_type_forward(self, in_types):
         type_check.expect(
@@ -30,8 +51,29 @@ class ReLU(function.Function):
         )
 
     def forward_cpu(self, x):
+        if (self.use_mask and chainer.config.train and
+                self._can_overwrite(x[0]) and switch.enable_reluF((x,))):
+            if self.inplace:
+                y = x[0]
+            else:
+                y = numpy.empty(x[0].shape, dtype=numpy.float32)
+            self.mask = numpy.empty((x[0].size + 7) // 8, dtype=numpy.uint8)
+            mkl.ReluMask_F32.do_forward(x[0].ravel(), y.ravel(), self.mask)
+            return y,
+        if self.inplace and self._can_overwrite(x[0]):
+            y = x[0]
+            if switch.enable_reluF((x,)):
+                if y.ndim == 4:
+                    mkl.Relu4D_F32.do_forward_inplace(y)
+                else:
+                    mkl.Relu_F32.do_forward_inplace(y.ravel())
+            else:
+                numpy.maximum(y, 0, out=y)
+            return y,
         # if switch.enable_relu:
         if switch.enable_reluF((x,)):
+            if isinstance(x[0], mdarray):
+                return mdarray(mkl.Relu4D_F32.do_forward_md(x[0].md)),
             y = numpy.empty(x[0].shape, dtype=numpy.float32)
             if x[0].ndim == 4:
                 mkl.Relu4D_F32.do_forward(x[0], y)
@@ -57,6 +99,24 @@ class ReLU(function.Function):
         return y,
 
     def backward_cpu(self, x, gy):
+        if self.mask is not None:
+            if self.inplace_grad and self._can_overwrite(gy[0]):
+                gx = gy[0]
+            else:
+                gx = numpy.empty(gy[0].shape, dtype=numpy.float32)
+            mkl.ReluMask_F32.do_backward(gy[0].ravel(), self.mask, gx.ravel())
+            return gx,
+        if (self.inplace_grad and self._can_overwrite(gy[0]) and
+                isinstance(x[0], numpy.ndarray)):
+            gx = gy[0]
+            if switch.enable_reluF((x, gy)) and x[0].flags.c_contiguous:
+                if x[0].ndim == 4:
+                    mkl.Relu4D_F32.do_backward_inplace(x[0], gx)
+                else:
+                    mkl.Relu_F32.do_backward_inplace(x[0].ravel(), gx.ravel())
+            else:
+                gx *= x[0] > 0
+            return gx,
         # if switch.enable_relu:
         if switch.enable_reluF((x, gy)):
             gx = numpy.empty(x[0].shape, dtype=numpy.float32)
@@ -115,4 +175,12 @@ def relu(x, use_cudnn=True):
         (3, 4, 5)
 
     """
-    return ReLU(use_cudnn)(x)
+    intermediate = array.is_intermediate(x)
+    func = ReLU(use_cudnn, intermediate and switch.enable_relu_inplace,
+                switch.enable_relu_mask)
+    y = func(x)
+    if (intermediate and func.mask is not None and
+            switch.enable_release_inputs):
+        # backward reads the mask only, nothing else uses x
+        x.release_data()
+    return y
@@ -3,6 +3,8 @@ import numpy
 from chainer import cuda
 from chainer import function
 from chainer.utils import type_check
+from mkldnn import mkldnn
+from mkldnn import switch
 
 if cuda.cudnn_enabled:
     cudnn = cuda.cudnn
@@ -16,8 +18,9 @@ class Softmax(function.Function):
 
     """Softmax activation function."""
 
-    def __init__(self, use_cudnn=True):
+    def __init__(self, use_cudnn=True, axis=1):
         self.use_cudnn = use_cudnn
+        self.axis = axis
 
     def check_type_forward(self, in_types):
         type_check.expect(in_types.size() == 1)
@@ -26,11 +29,22 @@ class Softmax(function.Function):
         type_check.expect(
             x_type.dtype.kind == 'f',
             x_type.ndim > 1,
+            -x_type.ndim <= self.axis,
+            self.axis < x_type.ndim,
         )
 
+    def _mkldnn_acceptable(self, arrays):
+        return (switch.enable_softmaxF(arrays) and
+                all(a.flags.c_contiguous for a in arrays))
+
     def forward(self, x):
         xp = cuda.get_array_module(*x)
-        if (xp != numpy and cuda.cudnn_enabled and self.use_cudnn and
+        if xp is numpy and self._mkldnn_acceptable(x):
+            self.y = numpy.empty_like(x[0])
+            mkldnn.Softmax_F32.do_forward(
+                x[0].ravel(), self.y.ravel(), x[0].shape, self.axis)
+        elif (xp != numpy and cuda.cudnn_enabled and self.use_cudnn and
+                self.axis == 1 and
                 (_cudnn_version >= 3000 or x[0].dtype != numpy.float16)):
             oz_dtype = 'd' if x[0].dtype == 'd' else 'f'
             one = numpy.array(1, dtype=oz_dtype).ctypes
@@ -44,15 +58,21 @@ class Softmax(function.Function):
                 x_cube.data.ptr, zero.data, desc.value,
                 self.y.data.ptr)
         else:
-            self.y = x[0] - x[0].max(axis=1, keepdims=True)
+            self.y = x[0] - x[0].max(axis=self.axis, keepdims=True)
             xp.exp(self.y, out=self.y)
-            self.y /= self.y.sum(axis=1, keepdims=True)
+            self.y /= self.y.sum(axis=self.axis, keepdims=True)
 
         return self.y,
 
     def backward(self, x, gy):
         xp = cuda.get_array_module(*x)
-        if (xp != numpy and cuda.cudnn_enabled and self.use_cudnn and
+        if xp is numpy and self._mkldnn_acceptable((self.y, gy[0])):
+            gx = numpy.empty_like(self.y)
+            mkldnn.Softmax_F32.do_backward(
+                self.y.ravel(), gy[0].ravel(), gx.ravel(),
+                self.y.shape, self.axis)
+        elif (xp != numpy and cuda.cudnn_enabled and self.use_cudnn and
+                self.axis == 1 and
                 (_cudnn_version >= 3000 or x[0].dtype != numpy.float16)):
             oz_dtype = 'd' if x[0].dtype == 'd' else 'f'
             one = numpy.array(1, dtype=oz_dtype).ctypes
@@ -67,16 +87,17 @@ class Softmax(function.Function):
                 desc.value, gx.data.ptr)
         else:
             gx = self.y * gy[0]
-            sumdx = gx.sum(axis=1, keepdims=True)
+            sumdx = gx.sum(axis=self.axis, keepdims=True)
             gx -= self.y * sumdx
 
         return gx,
 
 
-def softmax(x, use_cudnn=True):
+def softmax(x, use_cudnn=True, axis=1):
     """Channelwise softmax function.
 
-    This function computes its softmax along the second axis. Let
+    This function computes its softmax along an axis, the second one by
+    default. Let
     :math:`x = (x_1, x_2, \\dots, x_d)^{\\top}` be the d dimensional index
     array and :math:`f(x)` be the d dimensional input array. For each index
     :math:`x` of the input array :math:`f(x)`, it computes the probability
@@ -86,10 +107,12 @@ def softmax(x, use_cudnn=True):
     Args:
         x (~chainer.Variable): Input variable.
         use_cudnn (bool): If ``True`` and cuDNN is enabled, then this function
-            uses cuDNN as the core implementation.
+            uses cuDNN as the core implementation. cuDNN is only used along
+            the second axis.
+        axis (int): The axis along which the softmax is taken.
 
     Returns:
         ~chainer.Variable: Output variable.
 
     """
-    return Softmax(use_cudnn)(x)
+    return Softmax(use_cudnn, axis)(x)
@@ -4,6 +4,8 @@ from chainer import cuda
 from chainer import function
 from chainer import utils
 from chainer.utils import type_check
+from mkldnn import mkldnn as mkl
+from mkldnn import switch
 
 
 class Softplus(function.Function):
@@ -22,6 +24,11 @@ class Softplus(function.Function):
 
     def forward_cpu(self, inputs):
         x, = inputs
+        if switch.enable_eltwiseF(inputs):
+            y = numpy.empty(x.shape, dtype=numpy.float32)
+            mkl.Eltwise_F32.do_forward(
+                x.ravel(), y.ravel(), mkl.ELTWISE_SOFTPLUS, self.beta)
+            return y,
         # y = log(1 + exp(beta * x)) / beta
         bx = self.beta * x
         y = (numpy.fmax(bx, 0) +
@@ -43,6 +50,12 @@ class Softplus(function.Function):
     def backward_cpu(self, inputs, grads):
         x, = inputs
         g, = grads
+        if switch.enable_eltwiseF((x, g)):
+            gx = numpy.empty(x.shape, dtype=numpy.float32)
+            mkl.Eltwise_F32.do_backward(
+                x.ravel(), g.ravel(), gx.ravel(),
+                mkl.ELTWISE_SOFTPLUS, self.beta)
+            return gx,
         gx = (1 - 1 / (1 + numpy.exp(self.beta * x))) * g
         return utils.force_array(gx, x.dtype),
 
@@ -4,6 +4,8 @@ from chainer import cuda
 from chainer import function
 from chainer import utils
 from chainer.utils import type_check
+from mkldnn import mkldnn as mkl
+from mkldnn import switch
 
 if cuda.cudnn_enabled:
     cudnn = cuda.cudnn
@@ -24,6 +26,11 @@ class Tanh(function.Function):
         type_check.expect(in_types[0].dtype.kind == 'f')
 
     def forward_cpu(self, x):
+        if switch.enable_eltwiseF(x):
+            self.y = numpy.empty(x[0].shape, dtype=numpy.float32)
+            mkl.Eltwise_F32.do_forward(
+                x[0].ravel(), self.y.ravel(), mkl.ELTWISE_TANH)
+            return self.y,
         self.y = utils.force_array(numpy.tanh(x[0]))
         return self.y,
 
@@ -38,6 +45,11 @@ class Tanh(function.Function):
         return self.y,
 
     def backward_cpu(self, x, gy):
+        if switch.enable_eltwiseF((self.y, gy[0])):
+            gx = numpy.empty(self.y.shape, dtype=numpy.float32)
+            mkl.Eltwise_F32.do_backward(
+                self.y.ravel(), gy[0].ravel(), gx.ravel(), mkl.ELTWISE_TANH)
+            return gx,
         one = x[0].dtype.type(1)
         return utils.force_array(gy[0] * (one - self.y * self.y)),
 
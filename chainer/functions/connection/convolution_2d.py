@@ -1,11 +1,14 @@
 import numpy
 
+import chainer
 from chainer import cuda
 from chainer import function
+from chainer.utils import array
 from chainer.utils import conv
 from chainer.utils import type_check
 from mkldnn import mkldnn
 from mkldnn import switch
+from mkldnn.mdarray import mdarray
 
 
 if cuda.cudnn_enabled:
@@ -33,8 +36,12 @@ def _pair(x):
 
 class Convolution2DFunction(function.Function):
 
+    # version of W, see chainer.utils.array.weights_version
+    W_version = -1
+
     def __init__(self, stride=1, pad=0, use_cudnn=True, cover_all=False,
-                 deterministic=False, in_chain=False):
+                 deterministic=False, in_chain=False, with_relu=False,
+                 groups=1):
         self.sy, self.sx = _pair(stride)
         self.ph, self.pw = _pair(pad)
         self.pd, self.pr = _pair(pad)
@@ -42,6 +49,8 @@ class Convolution2DFunction(function.Function):
         self.cover_all = cover_all
         self.deterministic = deterministic
         self.in_chain = in_chain
+        self.with_relu = with_relu
+        self.groups = groups
 
     def check_type_forward(self, in_types):
         n_in = in_types.size()
@@ -54,7 +63,8 @@ class Convolution2DFunction(function.Function):
             w_type.dtype.kind == 'f',
             x_type.ndim == 4,
             w_type.ndim == 4,
-            x_type.shape[1] == w_type.shape[1],
+            x_type.shape[1] == w_type.shape[1] * self.groups,
+            w_type.shape[0] % self.groups == 0,
         )
 
         if n_in.eval() == 3:
@@ -79,28 +89,67 @@ class Convolution2DFunction(function.Function):
             assert out_h > 0, 'Height in the output should be positive.'
             out_w = conv.get_conv_outsize(w, kw, self.sx, self.pw, cover_all=self.cover_all)
             assert out_w > 0, 'Width in the output should be positive.'
-            self.pd = self.sy*(out_h-1) + kh - h - self.ph
-            self.pr = self.sx*(out_w-1) + kw - w - self.pw
+            self.pd = conv.get_conv_pad_r(h, kh, self.sy, self.ph, out_h)
+            self.pr = conv.get_conv_pad_r(w, kw, self.sx, self.pw, out_w)
+            # inference uses forward_inference primitives and reuses the
+            # reordered W while weights are frozen
+            inference = not chainer.config.train
+            W_version = self.W_version if inference else -1
+
+            if switch.enable_mdarray or isinstance(x, mdarray):
+                # keep y in the layout picked by mkldnn for the next layer
+                if not isinstance(x, mdarray):
+                    x = mdarray.from_numpy(x)
+                if b is not None:
+                    y = mkldnn.Convolution2D_F32.do_forward_md(
+                        x.md, W, b, n, out_c, out_h, out_w, kh, kw,
+                        self.sy, self.sx, self.ph, self.pw, self.pd, self.pr,
+                        W_version, inference, self.with_relu, self.groups)
+                else:
+                    y = mkldnn.Convolution2D_F32.do_forward_md(
+                        x.md, W, n, out_c, out_h, out_w, kh, kw,
+                        self.sy, self.sx, self.ph, self.pw, self.pd, self.pr,
+                        W_version, inference, self.with_relu, self.groups)
+                if self.with_relu:
+                    self.y = mdarray(y)
+                    return self.y,
+                return mdarray(y),
 
             y = numpy.empty(shape=(n, out_c, out_h, out_w), dtype=x.dtype)
             if b is not None:
-                mkldnn.Convolution2D_F32.do_forward(x, W, b, y, kh, kw, self.sx, self.sy, self.ph, self.pw, self.pd, self.pr)
+                mkldnn.Convolution2D_F32.do_forward(x, W, b, y, kh, kw, self.sx, self.sy, self.ph, self.pw, self.pd, self.pr, W_version, inference, self.with_relu, self.groups)
             else:
-                mkldnn.Convolution2D_F32.do_forward(x, W, y, kh, kw, self.sx, self.sy, self.ph, self.pw, self.pd, self.pr)
+                mkldnn.Convolution2D_F32.do_forward(x, W, y, kh, kw, self.sx, self.sy, self.ph, self.pw, self.pd, self.pr, W_version, inference, self.with_relu, self.groups)
+            if self.with_relu:
+                self.y = y
             return y,
         else:
             self.col = conv.im2col_cpu(
                 x, kh, kw, self.sy, self.sx, self.ph, self.pw,
                 cover_all=self.cover_all)
             # print "%f, %f" %(cos_module.cos_func(0.5), sin_module.sin_func(0.5))
-            y = numpy.tensordot(
-                self.col, W, ((1, 2, 3), (1, 2, 3))).astype(x.dtype, copy=False)
+            if self.groups == 1:
+                y = numpy.tensordot(
+                    self.col, W, ((1, 2, 3), (1, 2, 3))).astype(x.dtype, copy=False)
+            else:
+                y = numpy.concatenate([
+                    numpy.tensordot(col_g, W_g, ((1, 2, 3), (1, 2, 3)))
+                    for col_g, W_g in zip(
+                        numpy.split(self.col, self.groups, axis=1),
+                        numpy.split(W, self.groups))],
+                    axis=3).astype(x.dtype, copy=False)
             if b is not None:
                 y += b
             y = numpy.rollaxis(y, 3, 1)
+            if self.with_relu:
+                y = numpy.maximum(y, 0, out=y)
+                self.y = y
             return y,
 
     def forward_gpu(self, inputs):
+        if self.groups > 1:
+            raise NotImplementedError(
+                'grouped convolution is only supported on CPU')
         x, W = inputs[:2]
         b = inputs[2] if len(inputs) == 3 else None
 
@@ -167,12 +216,17 @@ class Convolution2DFunction(function.Function):
                 y += b
             y = cuda.cupy.rollaxis(y, 3, 1)
 
+        if self.with_relu:
+            y = cuda.cupy.maximum(y, 0, out=y)
+            self.y = y
         return y,
 
     def backward_cpu(self, inputs, grad_outputs):
         x, W = inputs[:2]
         b = inputs[2] if len(inputs) == 3 else None
         gy = grad_outputs[0]
+        if self.with_relu:
+            gy = gy * (numpy.asarray(self.y) > 0)
         n, c, h, w = x.shape
         out_c, input_c, kh, kw = W.shape
         gn, gout_c, gout_h, gout_w = gy.shape
@@ -184,16 +238,27 @@ class Convolution2DFunction(function.Function):
             gW = numpy.empty(shape=(out_c, input_c, kh, kw), dtype=W.dtype)
             gx = numpy.empty(shape=(n, c, h, w), dtype=W.dtype)
             if b is None:
-                mkldnn.Convolution2D_F32.do_backward(x, W, gy, gW, gx, kh, kw, self.sy, self.sx, self.ph, self.pw, self.pd, self.pr, self.mkldnn_opt)
+                mkldnn.Convolution2D_F32.do_backward(x, W, gy, gW, gx, kh, kw, self.sy, self.sx, self.ph, self.pw, self.pd, self.pr, self.mkldnn_opt, self.groups)
                 return gx, gW
             else:
                 gb = numpy.empty(shape=b.shape, dtype=W.dtype)
-                mkldnn.Convolution2D_F32.do_backward(x, W, b, gy, gW, gx, gb, kh, kw, self.sy, self.sx, self.ph, self.pw, self.pd, self.pr, self.mkldnn_opt)
+                mkldnn.Convolution2D_F32.do_backward(x, W, b, gy, gW, gx, gb, kh, kw, self.sy, self.sx, self.ph, self.pw, self.pd, self.pr, self.mkldnn_opt, self.groups)
                 return gx, gW, gb
         else:
-            gW = numpy.tensordot(
-                    gy, self.col, ((0, 2, 3), (0, 4, 5))).astype(W.dtype, copy=False)
-            gcol = numpy.tensordot(W, gy, (0, 1)).astype(x.dtype, copy=False)
+            if self.groups == 1:
+                gW = numpy.tensordot(
+                        gy, self.col, ((0, 2, 3), (0, 4, 5))).astype(W.dtype, copy=False)
+                gcol = numpy.tensordot(W, gy, (0, 1)).astype(x.dtype, copy=False)
+            else:
+                gys = numpy.split(gy, self.groups, axis=1)
+                cols = numpy.split(self.col, self.groups, axis=1)
+                Ws = numpy.split(W, self.groups)
+                gW = numpy.concatenate([
+                    numpy.tensordot(gy_g, col_g, ((0, 2, 3), (0, 4, 5)))
+                    for gy_g, col_g in zip(gys, cols)]).astype(W.dtype, copy=False)
+                gcol = numpy.concatenate([
+                    numpy.tensordot(W_g, gy_g, (0, 1))
+                    for W_g, gy_g in zip(Ws, gys)]).astype(x.dtype, copy=False)
             gcol = numpy.rollaxis(gcol, 3)
             gx = conv.col2im_cpu(gcol, self.sy, self.sx, self.ph, self.pw, h, w)
             if b is None:
@@ -206,6 +271,8 @@ class Convolution2DFunction(function.Function):
         x, W = inputs[:2]
         b = inputs[2] if len(inputs) == 3 else None
         gy = grad_outputs[0]
+        if self.with_relu:
+            gy = gy * (self.y > 0)
         _, out_c, out_h, out_w = gy.shape
         n, c, h, w = x.shape
         kh, kw = W.shape[2:]
@@ -295,7 +362,8 @@ class Convolution2DFunction(function.Function):
 
 
 def convolution_2d(x, W, b=None, stride=1, pad=0, use_cudnn=True,
-                   cover_all=False, deterministic=False, in_chain=False):
+                   cover_all=False, deterministic=False, in_chain=False,
+                   groups=1):
     """Two-dimensional convolution function.
 
     This is an implementation of two-dimensional convolution in ConvNets.
@@ -315,7 +383,7 @@ def convolution_2d(x, W, b=None, stride=1, pad=0, use_cudnn=True,
     Args:
         x (~chainer.Variable): Input variable of shape :math:`(n, c_I, h, w)`.
         W (~chainer.Variable): Weight variable of shape
-            :math:`(c_O, c_I, k_H, k_W)`.
+            :math:`(c_O, c_I / g, k_H, k_W)`, where :math:`g` is ``groups``.
         b (~chainer.Variable): Bias variable of length :math:`c_O` (optional).
         stride (int or pair of ints): Stride of filter applications.
             ``stride=s`` and ``stride=(s, s)`` are equivalent.
@@ -330,7 +398,10 @@ def convolution_2d(x, W, b=None, stride=1, pad=0, use_cudnn=True,
             If this option is ``True``, then it forces cuDNN to use
             a deterministic algorithm. This option is only available for
             cuDNN version >= v4.
-
+        groups (int): Number of groups. Input and output channels are split
+            into ``groups`` groups convolved separately, ``groups`` equal to
+            the number of input channels is the depthwise convolution.
+            Grouped convolution is only supported on CPU.
 
     Returns:
         ~chainer.Variable: Output variable.
@@ -361,7 +432,34 @@ def convolution_2d(x, W, b=None, stride=1, pad=0, use_cudnn=True,
 
     """
     func = Convolution2DFunction(
-        stride, pad, use_cudnn, cover_all, deterministic, in_chain)
+        stride, pad, use_cudnn, cover_all, deterministic, in_chain,
+        groups=groups)
+    func.W_version = array.weights_version(W)
+    if b is None:
+        return func(x, W)
+    else:
+        return func(x, W, b)
+
+
+def convolution_2d_relu(x, W, b=None, stride=1, pad=0, use_cudnn=True,
+                        cover_all=False, deterministic=False, in_chain=False,
+                        groups=1):
+    """Two-dimensional convolution followed by ReLU.
+
+    Computes ``relu(convolution_2d(x, W, b, stride, pad))``. On MKL-DNN the
+    ReLU is fused into the convolution primitive, so the output is written
+    once instead of being re-read by a separate ReLU layer.
+
+    See :func:`~chainer.functions.convolution_2d` for the arguments.
+
+    Returns:
+        ~chainer.Variable: Output variable.
+
+    """
+    func = Convolution2DFunction(
+        stride, pad, use_cudnn, cover_all, deterministic, in_chain,
+        with_relu=True, groups=groups)
+    func.W_version = array.weights_version(W)
     if b is None:
         return func(x, W)
     else:
@@ -1,10 +1,15 @@
 import numpy
 
+import chainer
 from chainer import cuda
 from chainer import function
 from chainer.functions.connection import convolution_2d
+from chainer.utils import array
 from chainer.utils import conv
 from chainer.utils import type_check
+from mkldnn import mkldnn
+from mkldnn import switch
+from mkldnn.mdarray import mdarray
 
 if cuda.cudnn_enabled:
     cudnn = cuda.cudnn
@@ -29,6 +34,9 @@ def _pair(x):
 
 class Deconvolution2DFunction(function.Function):
 
+    # version of W, see chainer.utils.array.weights_version
+    W_version = -1
+
     def __init__(self, stride=1, pad=0, outsize=None, use_cudnn=True,
                  deterministic=False):
         self.sy, self.sx = _pair(stride)
@@ -36,6 +44,7 @@ class Deconvolution2DFunction(function.Function):
         self.use_cudnn = use_cudnn
         self.outh, self.outw = (None, None) if outsize is None else outsize
         self.deterministic = deterministic
+        self.mkldnn_forward = False
 
     def check_type_forward(self, in_types):
         n_in = in_types.size()
@@ -75,19 +84,41 @@ class Deconvolution2DFunction(function.Function):
         x, W = inputs[:2]
         b = inputs[2] if len(inputs) == 3 else None
         kh, kw = W.shape[2:]
-        _, _, h, w = x.shape
-        gcol = numpy.tensordot(W, x, (0, 1)).astype(x.dtype, copy=False)
-        # - k, m, n: shape of out_channel
-        # - b: number of inputs
-        # - h, w: height and width of kernels
-        # k, m, n, b, h, w -> b, k, m, n, h, w
-        gcol = numpy.rollaxis(gcol, 3)
+        n, _, h, w = x.shape
         if self.outh is None:
             self.outh = conv.get_deconv_outsize(h, kh, self.sy, self.ph)
             assert self.outh > 0, 'Height in the output should be positive.'
         if self.outw is None:
             self.outw = conv.get_deconv_outsize(w, kw, self.sx, self.pw)
             assert self.outw > 0, 'Width in the output should be positive.'
+
+        # deconvolution is the data backward of the convolution from y to
+        # x, pd and pr are its bottom and right paddings
+        self.pd = self.sy * (h - 1) + kh - self.outh - self.ph
+        self.pr = self.sx * (w - 1) + kw - self.outw - self.pw
+        self.mkldnn_forward = (
+            switch.enable_deconvF(inputs) and
+            not isinstance(x, mdarray) and self.pd >= 0 and self.pr >= 0)
+        if self.mkldnn_forward:
+            W_version = -1 if chainer.config.train else self.W_version
+            y = numpy.empty((n, W.shape[1], self.outh, self.outw),
+                            dtype=x.dtype)
+            if b is not None:
+                mkldnn.Deconvolution2D_F32.do_forward(
+                    x, W, b, y, self.sy, self.sx, self.ph, self.pw,
+                    self.pd, self.pr, W_version)
+            else:
+                mkldnn.Deconvolution2D_F32.do_forward(
+                    x, W, y, self.sy, self.sx, self.ph, self.pw,
+                    self.pd, self.pr, W_version)
+            return y,
+
+        gcol = numpy.tensordot(W, x, (0, 1)).astype(x.dtype, copy=False)
+        # - k, m, n: shape of out_channel
+        # - b: number of inputs
+        # - h, w: height and width of kernels
+        # k, m, n, b, h, w -> b, k, m, n, h, w
+        gcol = numpy.rollaxis(gcol, 3)
         y = conv.col2im_cpu(
             gcol, self.sy, self.sx, self.ph, self.pw, self.outh, self.outw)
         # b, k, h, w
@@ -176,6 +207,20 @@ class Deconvolution2DFunction(function.Function):
         b = inputs[2] if len(inputs) == 3 else None
         gy = grad_outputs[0]
         kh, kw = W.shape[2:]
+        if self.mkldnn_forward:
+            gx = numpy.empty(x.shape, dtype=x.dtype)
+            gW = numpy.empty(W.shape, dtype=W.dtype)
+            if b is None:
+                mkldnn.Deconvolution2D_F32.do_backward(
+                    x, W, gy, gW, gx, self.sy, self.sx, self.ph, self.pw,
+                    self.pd, self.pr, self.mkldnn_opt)
+                return gx, gW
+            gb = numpy.empty(b.shape, dtype=b.dtype)
+            mkldnn.Deconvolution2D_F32.do_backward(
+                x, W, gy, gW, gx, gb, self.sy, self.sx, self.ph, self.pw,
+                self.pd, self.pr, self.mkldnn_opt)
+            return gx, gW, gb
+
         col = conv.im2col_cpu(
             gy, kh, kw, self.sy, self.sx, self.ph, self.pw)
         gW = numpy.tensordot(
@@ -326,6 +371,7 @@ def deconvolution_2d(x, W, b=None, stride=1, pad=0,
     """
     func = Deconvolution2DFunction(
         stride, pad, outsize, use_cudnn, deterministic)
+    func.W_version = array.weights_version(W)
     if b is None:
         return func(x, W)
     else:
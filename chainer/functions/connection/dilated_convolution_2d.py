@@ -1,10 +1,14 @@
 import numpy
 from six import moves
 
+import chainer
 from chainer import cuda
 from chainer import function
+from chainer.utils import array
 from chainer.utils import conv
 from chainer.utils import type_check
+from mkldnn import mkldnn
+from mkldnn import switch
 
 if cuda.cudnn_enabled:
     cudnn = cuda.cudnn
@@ -31,6 +35,9 @@ def _pair(x):
 
 class DilatedConvolution2DFunction(function.Function):
 
+    # version of W, see chainer.utils.array.weights_version
+    W_version = -1
+
     def __init__(self, stride=1, pad=0, dilate=1,
                  use_cudnn=True, cover_all=False):
         self.sy, self.sx = _pair(stride)
@@ -38,6 +45,7 @@ class DilatedConvolution2DFunction(function.Function):
         self.dy, self.dx = _pair(dilate)
         self.use_cudnn = use_cudnn
         self.cover_all = cover_all
+        self.mkldnn_forward = False
 
     def check_type_forward(self, in_types):
         n_in = in_types.size()
@@ -61,10 +69,87 @@ class DilatedConvolution2DFunction(function.Function):
                 b_type.shape[0] == w_type.shape[0],
             )
 
+    def _to_batch(self, x):
+        # Pads x and moves its dy x dx phases, x[:, :, i::dy, j::dx], into
+        # the batch axis. Each phase is convolved with W undilated.
+        n, c, h, w = x.shape
+        hp = -(-(h + 2 * self.ph) // self.dy) * self.dy
+        wp = -(-(w + 2 * self.pw) // self.dx) * self.dx
+        xp = numpy.zeros((n, c, hp, wp), dtype=x.dtype)
+        xp[:, :, self.ph:self.ph + h, self.pw:self.pw + w] = x
+        xp = xp.reshape(n, c, hp // self.dy, self.dy, wp // self.dx, self.dx)
+        return xp.transpose(3, 5, 0, 1, 2, 4).reshape(
+            self.dy * self.dx * n, c, hp // self.dy, wp // self.dx)
+
+    def _from_batch(self, xb, n):
+        # Inverse of _to_batch without the crop
+        _, c, h, w = xb.shape
+        xb = xb.reshape(self.dy, self.dx, n, c, h, w)
+        return xb.transpose(2, 3, 4, 0, 5, 1).reshape(
+            n, c, h * self.dy, w * self.dx)
+
+    def _forward_mkldnn(self, x, W, b):
+        # Stride 1 dilated convolution runs as a plain convolution of the
+        # phases of x (space to batch), the bundled MKL-DNN has no dilation
+        n, _, h, w = x.shape
+        out_c, _, kh, kw = W.shape
+        out_h = conv.get_conv_outsize(h, kh, 1, self.ph, d=self.dy)
+        out_w = conv.get_conv_outsize(w, kw, 1, self.pw, d=self.dx)
+        assert out_h > 0 and out_w > 0, 'Output size should be positive.'
+        self.xb = self._to_batch(x)
+        nb, _, hb, wb = self.xb.shape
+        inference = not chainer.config.train
+        W_version = self.W_version if inference else -1
+        yb = numpy.empty((nb, out_c, hb - kh + 1, wb - kw + 1), dtype=x.dtype)
+        if b is not None:
+            mkldnn.Convolution2D_F32.do_forward(
+                self.xb, W, b, yb, kh, kw, 1, 1, 0, 0, 0, 0,
+                W_version, inference)
+        else:
+            mkldnn.Convolution2D_F32.do_forward(
+                self.xb, W, yb, kh, kw, 1, 1, 0, 0, 0, 0,
+                W_version, inference)
+        y = self._from_batch(yb, n)[:, :, :out_h, :out_w]
+        return numpy.ascontiguousarray(y),
+
+    def _backward_mkldnn(self, x, W, b, gy):
+        n, c, h, w = x.shape
+        kh, kw = W.shape[2:]
+        nb, _, hb, wb = self.xb.shape
+        out_hb, out_wb = hb - kh + 1, wb - kw + 1
+        # outputs cropped in forward get zero gradient
+        gyp = numpy.zeros((n, gy.shape[1], out_hb * self.dy,
+                           out_wb * self.dx), dtype=gy.dtype)
+        gyp[:, :, :gy.shape[2], :gy.shape[3]] = gy
+        gyp = gyp.reshape(n, gy.shape[1], out_hb, self.dy, out_wb, self.dx)
+        gyb = gyp.transpose(3, 5, 0, 1, 2, 4).reshape(
+            nb, gy.shape[1], out_hb, out_wb)
+        gW = numpy.empty(W.shape, dtype=W.dtype)
+        gxb = numpy.empty(self.xb.shape, dtype=x.dtype)
+        if b is None:
+            mkldnn.Convolution2D_F32.do_backward(
+                self.xb, W, gyb, gW, gxb, kh, kw, 1, 1, 0, 0, 0, 0, False)
+        else:
+            gb = numpy.empty(b.shape, dtype=b.dtype)
+            mkldnn.Convolution2D_F32.do_backward(
+                self.xb, W, b, gyb, gW, gxb, gb, kh, kw, 1, 1, 0, 0, 0, 0,
+                False)
+        gx = self._from_batch(gxb, n)[
+            :, :, self.ph:self.ph + h, self.pw:self.pw + w]
+        gx = numpy.ascontiguousarray(gx)
+        if b is None:
+            return gx, gW
+        return gx, gW, gb
+
     def forward_cpu(self, inputs):
         x, W = inputs[:2]
         b = inputs[2] if len(inputs) == 3 else None
         kh, kw = W.shape[2:]
+        self.mkldnn_forward = (
+            switch.enable_convF(inputs) and isinstance(x, numpy.ndarray) and
+            self.sy == 1 and self.sx == 1 and not self.cover_all)
+        if self.mkldnn_forward:
+            return self._forward_mkldnn(x, W, b)
         self.col = conv.im2col_cpu(
             x, kh, kw, self.sy, self.sx, self.ph, self.pw,
             cover_all=self.cover_all, dy=self.dy, dx=self.dx)
@@ -159,6 +244,8 @@ class DilatedConvolution2DFunction(function.Function):
         b = inputs[2] if len(inputs) == 3 else None
         gy = grad_outputs[0]
         h, w = x.shape[2:]
+        if self.mkldnn_forward:
+            return self._backward_mkldnn(x, W, b, gy)
 
         gW = numpy.tensordot(
             gy, self.col, ((0, 2, 3), (0, 4, 5))).astype(W.dtype, copy=False)
@@ -369,6 +456,7 @@ def dilated_convolution_2d(x, W, b=None, stride=1, pad=0, dilate=1,
     """
     func = DilatedConvolution2DFunction(
         stride, pad, dilate, use_cudnn, cover_all)
+    func.W_version = array.weights_version(W)
     if b is None:
         return func(x, W)
     else:
@@ -1,6 +1,8 @@
 import numpy
 
+import chainer
 from chainer import function
+from chainer.utils import array
 from chainer.utils import type_check
 from mkldnn import mkldnn
 from mkldnn import switch
@@ -13,6 +15,9 @@ def _as_mat(x):
 
 
 class LinearFunction(function.Function):
+    # version of W, see chainer.utils.array.weights_version
+    W_version = -1
+
     def __init__(self, linear_link=None):
         if switch.enable_linear and linear_link is None:
             assert "linear_link can not be None in mkldnn enabled mode"
@@ -44,10 +49,12 @@ class LinearFunction(function.Function):
         b = inputs[2] if len(inputs) == 3 else None
         if switch.enable_linearF(inputs) and isinstance(x, numpy.ndarray):
             y = numpy.empty(shape=(x.shape[0], W.shape[0]), dtype=W.dtype)
+            # the reordered W is reused while weights are frozen
+            W_version = -1 if chainer.config.train else self.W_version
             if b is not None:
-                mkldnn.Linear_F32.do_forward(x, W, b, y)
+                mkldnn.Linear_F32.do_forward(x, W, b, y, W_version)
             else:
-                mkldnn.Linear_F32.do_forward(x, W, y)
+                mkldnn.Linear_F32.do_forward(x, W, y, W_version)
             return y,
         else:
             y = x.dot(W.T).astype(x.dtype, copy=False)
@@ -120,7 +127,9 @@ def linear(x, W, b=None, linear_link=None):
         (3, 5)
 
     """
+    func = LinearFunction(linear_link)
+    func.W_version = array.weights_version(W)
     if b is None:
-        return LinearFunction(linear_link)(x, W)
+        return func(x, W)
     else:
-        return LinearFunction(linear_link)(x, W, b)
+        return func(x, W, b)
@@ -54,21 +54,46 @@ class SoftmaxCrossEntropy(function.Function):
                    '`0 <= t < x.shape[1] or t == %d`' % self.ignore_label)
             raise ValueError(msg)
 
+    def _mkldnn_acceptable(self, inputs):
+        # class weights are applied by the numpy path only. The switch
+        # checks the dtype of x alone, labels are int32 by type check.
+        x, t = inputs
+        return (switch.enable_softmax_cross_entropyF(((x,),)) and
+                t.dtype == numpy.int32 and
+                self.class_weight is None and x.ndim in (2, 4) and
+                x.flags.c_contiguous)
+
     def forward_cpu(self, inputs):
         x, t = inputs
         if chainer.is_debug():
             self._check_input_values(x, t)
 
-        # Improve me
-        # It is disabled by default
-        if switch.enable_softmax_cross_entropyF(inputs):
-            y_out = numpy.empty(x.shape, dtype=numpy.float32)
+        if self._mkldnn_acceptable(inputs):
+            if self.normalize:
+                count = (t != self.ignore_label).sum()
+            else:
+                count = len(x)
+            self._coeff = 1.0 / max(count, 1)
             mkldnn_sce_fwd = mkldnn.SoftmaxCrossEntropy_F32_softmax_cross_entropy_create_forward(x.shape)
-            mkldnn_sce_fwd.forward(x.ravel(), y_out.ravel(), x.shape)
-            log_y = y_out
-        else:
-            log_y = log_softmax._log_softmax(x, self.use_cudnn)
+            if x.ndim == 2:
+                # fused log_softmax + label gather + reduction, the
+                # softmax output is only written when it is cached
+                y = numpy.empty(x.shape if self.cache_score else (0,),
+                                dtype=numpy.float32)
+                log_p = mkldnn_sce_fwd.forward_loss(
+                    x.ravel(), y.ravel(), t.ravel(), x.shape)
+                if self.cache_score:
+                    self.y = y
+            else:
+                log_y = numpy.empty(x.shape, dtype=numpy.float32)
+                mkldnn_sce_fwd.forward(x.ravel(), log_y.ravel(), x.shape)
+                if self.cache_score:
+                    self.y = numpy.exp(log_y)
+                log_p = mkldnn.SoftmaxCrossEntropy_F32.loss(
+                    log_y.ravel(), t.ravel(), x.shape)
+            return numpy.array(-log_p * self._coeff, dtype=x.dtype),
 
+        log_y = log_softmax._log_softmax(x, self.use_cudnn)
         if self.cache_score:
             self.y = numpy.exp(log_y)
         if self.class_weight is not None:
@@ -121,22 +146,32 @@ class SoftmaxCrossEntropy(function.Function):
     def backward_cpu(self, inputs, grad_outputs):
         x, t = inputs
         gloss = grad_outputs[0]
+        if (not hasattr(self, 'y') and x.ndim == 2 and
+                self._mkldnn_acceptable(inputs)):
+            gx = numpy.empty(x.shape, dtype=numpy.float32)
+            mkldnn_sce_bwd = mkldnn.SoftmaxCrossEntropy_F32_softmax_cross_entropy_create_backward(x.shape)
+            mkldnn_sce_bwd.backward_x(x.ravel(), gx.ravel(), t.ravel(),
+                                      x.shape, float(gloss * self._coeff))
+            return gx, None
         if hasattr(self, 'y'):
             y = self.y.copy()
+        elif self._mkldnn_acceptable(inputs):
+            y = numpy.empty(x.shape, dtype=numpy.float32)
+            mkldnn_sce_fwd = mkldnn.SoftmaxCrossEntropy_F32_softmax_cross_entropy_create_forward(x.shape)
+            mkldnn_sce_fwd.forward(x.ravel(), y.ravel(), x.shape)
+            numpy.exp(y, out=y)
         else:
             y = log_softmax._log_softmax(x, self.use_cudnn)
             numpy.exp(y, out=y)
+        if self._mkldnn_acceptable(inputs):
+            gx = y
+            mkldnn_sce_bwd = mkldnn.SoftmaxCrossEntropy_F32_softmax_cross_entropy_create_backward(gx.shape)
+            mkldnn_sce_bwd.backward(gx.ravel(), t.ravel(), gx.shape,
+                                    float(gloss * self._coeff))
+            return gx, None
         if y.ndim == 2:
             gx = y
-
-            # Improve me
-            # It is disabled by default
-            if switch.enable_softmax_cross_entropyF(inputs):
-                mkldnn_sce_bwd = mkldnn.SoftmaxCrossEntropy_F32_softmax_cross_entropy_create_backward(gx.shape)
-                mkldnn_sce_bwd.backward(gx.ravel(), t.ravel(), gx.shape)
-            else:
-                gx[numpy.arange(len(t)), numpy.maximum(t, 0)] -= 1
-
+            gx[numpy.arange(len(t)), numpy.maximum(t, 0)] -= 1
             if self.class_weight is not None:
                 shape = [1 if d != 1 else -1 for d in six.moves.range(x.ndim)]
                 c = numpy.broadcast_to(
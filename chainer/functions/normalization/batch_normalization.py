@@ -4,6 +4,9 @@ from chainer import configuration
 from chainer import cuda
 from chainer import function
 from chainer.utils import type_check
+from mkldnn import mkldnn
+from mkldnn import switch
+from mkldnn.mdarray import mdarray
 
 if cuda.cudnn_enabled:
     cudnn = cuda.cudnn
@@ -45,6 +48,7 @@ class BatchNormalizationFunction(function.Function):
         self.use_cudnn = use_cudnn
         self.mean_cache = None
         self.decay = decay
+        self.mkldnn_forward = False
 
     def check_type_forward(self, in_types):
         n_in = in_types.size().eval()
@@ -104,8 +108,43 @@ class BatchNormalizationFunction(function.Function):
         # dimension.
         self.cudnn_dim_ok = x.ndim == 2 or x.ndim == 4
 
+        # mkldnn normalizes (n, c, h, w), 2d input is taken as (n, c, 1, 1)
+        self.mkldnn_forward = (
+            xp is numpy and switch.enable_batch_normalizationF(inputs) and
+            head_ndim == 2 and self.cudnn_dim_ok and
+            (configuration.config.train or len(inputs) == 5))
+
         cudnn_updated_running_stats = False
-        if xp is not numpy and cuda.cudnn_enabled and self.use_cudnn and \
+        if self.mkldnn_forward:
+            c = x.shape[1]
+            self.w = numpy.concatenate(
+                (gamma.ravel(), beta.ravel())).astype(numpy.float32)
+            if configuration.config.train:
+                self.mkl_mean = numpy.empty(c, dtype=numpy.float32)
+                self.mkl_var = numpy.empty(c, dtype=numpy.float32)
+                global_stats = False
+            else:
+                self.mkl_mean = numpy.ascontiguousarray(self.fixed_mean)
+                self.mkl_var = numpy.ascontiguousarray(self.fixed_var)
+                global_stats = True
+            if isinstance(x, mdarray) and x.ndim == 4:
+                y = mdarray(mkldnn.BatchNormalization_F32.do_forward_md(
+                    x.md, self.w, self.mkl_mean, self.mkl_var, self.eps,
+                    global_stats))
+            else:
+                x4 = numpy.ascontiguousarray(x)
+                if x4.ndim == 2:
+                    x4 = x4.reshape(x4.shape[0], c, 1, 1)
+                y = numpy.empty(x4.shape, dtype=x.dtype)
+                mkldnn.BatchNormalization_F32.do_forward(
+                    x4, y, self.w, self.mkl_mean, self.mkl_var, self.eps,
+                    global_stats)
+                y = y.reshape(x.shape)
+            if configuration.config.train:
+                # running stats are updated as in the numpy path below
+                mean = self.mkl_mean
+                var = self.mkl_var + self.eps
+        elif xp is not numpy and cuda.cudnn_enabled and self.use_cudnn and \
                 self.cudnn_dim_ok and _cudnn_version >= 5000:
             if x.ndim == 4:
                 # for convolutional layer
@@ -221,7 +260,21 @@ class BatchNormalizationFunction(function.Function):
 
         # Note: If length of inputs is not 5, we must be in train mode.
         assert configuration.config.train
-        if xp is not numpy and cuda.cudnn_enabled and self.use_cudnn and \
+        if self.mkldnn_forward:
+            c = x.shape[1]
+            x4 = numpy.ascontiguousarray(numpy.asarray(x))
+            if x4.ndim == 2:
+                x4 = x4.reshape(x4.shape[0], c, 1, 1)
+            gy4 = numpy.ascontiguousarray(numpy.asarray(gy)).reshape(x4.shape)
+            gx = numpy.empty(x4.shape, dtype=x4.dtype)
+            gw = numpy.empty(2 * c, dtype=numpy.float32)
+            mkldnn.BatchNormalization_F32.do_backward(
+                x4, gy4, gx, self.w, self.mkl_mean, self.mkl_var, gw,
+                self.eps)
+            gx = gx.reshape(x.shape)
+            ggamma = gw[:c].copy()
+            gbeta = gw[c:].copy()
+        elif xp is not numpy and cuda.cudnn_enabled and self.use_cudnn and \
                 self.cudnn_dim_ok and _cudnn_version >= 5000:
             # Note: cuDNN batch normalization backward only works in
             # "training mode." That is, it does not support
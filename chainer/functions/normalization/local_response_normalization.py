@@ -1,11 +1,13 @@
 import numpy
 import six
 
+import chainer
 from chainer import cuda
 from chainer import function
 from chainer.utils import type_check
 from mkldnn import mkldnn
 from mkldnn import switch
+from mkldnn.mdarray import mdarray
 
 
 def _cu_conv_sum(y, x, n):
@@ -56,8 +58,21 @@ class LocalResponseNormalization(function.Function):
 
     def forward_cpu(self, x):
         if switch.enable_lrnF((x,)):
+            if isinstance(x[0], mdarray) and not chainer.config.train:
+                # scoring mode keeps no workspace, so only for inference
+                self.y = mdarray(
+                    mkldnn.LocalResponseNormalization_F32.do_forward_md(
+                        x[0].md, self.n, self.k, self.n*self.alpha, self.beta))
+                return self.y,
             self.y = numpy.empty(x[0].shape, dtype=x[0].dtype)
             in_alpha = self.n*self.alpha
+            if not chainer.config.train:
+                # forward_inference keeps no workspace, backward_cpu
+                # rebuilds it if gradients are still needed
+                self.ws = None
+                mkldnn.LocalResponseNormalization_F32.do_forward(
+                    x[0], self.y, self.n, self.k, in_alpha, self.beta)
+                return self.y,
             ws_size = mkldnn.LocalResponseNormalization_F32.get_workspace_size(
                 x[0], self.y, self.n, self.k, in_alpha, self.beta)
             self.ws = numpy.empty(ws_size, dtype=x[0].dtype)
@@ -78,6 +93,9 @@ class LocalResponseNormalization(function.Function):
 
     def backward_cpu(self, x, gy):
         if switch.enable_lrnF((x, gy)):
+            if self.ws is None:
+                with chainer.using_config('train', True):
+                    self.forward_cpu(x)
             gx = numpy.empty(x[0].shape, dtype=x[0].dtype)
             in_alpha = self.n*self.alpha
             mkldnn.LocalResponseNormalization_F32.do_backward(
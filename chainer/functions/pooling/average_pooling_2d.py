@@ -1,10 +1,13 @@
 import numpy
 
+import chainer
 from chainer import cuda
 from chainer.functions.pooling import pooling_2d
 from chainer.utils import conv
 from mkldnn import mkldnn as mkl
 from mkldnn import switch
+from mkldnn.mdarray import asarray as mdarray_asarray
+from mkldnn.mdarray import mdarray
 
 if cuda.cudnn_enabled:
     cudnn = cuda.cudnn
@@ -14,32 +17,65 @@ if cuda.cudnn_enabled:
 class AveragePooling2D(pooling_2d.Pooling2D):
 
     """Average pooling over a set of 2d planes."""
-    # TODO(beam2d): Support cover_all mode.
+
+    def _edge_scale(self, h, w, y_h, y_w):
+        # In cover_all mode the last window may run past the padded input.
+        # It is averaged over its part inside ``[-p, size + p)`` as Caffe
+        # does, i.e. the extra padding does not count in the divisor.
+        # MKL-DNN and im2col divide by kh * kw, so the last output row and
+        # column are rescaled. Only the last window can overlap the extra
+        # padding since it is narrower than the stride.
+        in_h = min(h + self.ph * 2 - (y_h - 1) * self.sy, self.kh)
+        in_w = min(w + self.pw * 2 - (y_w - 1) * self.sx, self.kw)
+        return (float(self.kh) / max(in_h, 1),
+                float(self.kw) / max(in_w, 1))
+
+    def _rescale_edges(self, y, scale):
+        scale_h, scale_w = scale
+        if scale_h != 1:
+            y[:, :, -1, :] *= scale_h
+        if scale_w != 1:
+            y[:, :, :, -1] *= scale_w
+        return y
 
     def forward_cpu(self, x):
+        n, c, h, w = x[0].shape
+        y_h = conv.get_conv_outsize(
+            h, self.kh, self.sy, self.ph, self.cover_all)
+        y_w = conv.get_conv_outsize(
+            w, self.kw, self.sx, self.pw, self.cover_all)
+        self.scale = self._edge_scale(h, w, y_h, y_w)
         if switch.enable_avg_poolingF((x,)):
-            n, c, h, w = x[0].shape
-            y_h = conv.get_conv_outsize(
-                h, self.kh, self.sy, self.ph, self.cover_all)
-            y_w = conv.get_conv_outsize(
-                w, self.kw, self.sx, self.pw, self.cover_all)
             # here we calculate asymmetry padding
-            self.pd = self.sy*(y_h-1)+self.kh - h - self.ph
-            self.pr = self.sx*(y_w-1)+self.kw - w - self.pw
+            self.pd = conv.get_conv_pad_r(h, self.kh, self.sy, self.ph, y_h)
+            self.pr = conv.get_conv_pad_r(w, self.kw, self.sx, self.pw, y_w)
+            if isinstance(x[0], mdarray) and self.scale == (1, 1):
+                y = mkl.AvgPooling_F32.do_forward_md(
+                                    x[0].md,
+                                    self.sy, self.sx,
+                                    self.ph, self.pd, self.pw, self.pr,
+                                    self.kh, self.kw,
+                                    not chainer.config.train)
+                return mdarray(y),
             y = numpy.empty((n, c, y_h, y_w), dtype=x[0].dtype)
 
             mkl.AvgPooling_F32.do_forward(
-                                    x[0], y,
+                                    mdarray_asarray(x[0]), y,
                                     self.sy, self.sx,
                                     self.ph, self.pd, self.pw, self.pr,
-                                    self.kh, self.kw)
-            return y,
+                                    self.kh, self.kw,
+                                    not chainer.config.train)
+            return self._rescale_edges(y, self.scale),
         else:
-            col = conv.im2col_cpu(x[0], self.kh, self.kw, self.sy, self.sx, self.ph, self.pw)
+            col = conv.im2col_cpu(x[0], self.kh, self.kw, self.sy, self.sx,
+                                  self.ph, self.pw, cover_all=self.cover_all)
             y = col.mean(axis=(2, 3))
-            return y,
+            return self._rescale_edges(y, self.scale),
 
     def forward_gpu(self, x):
+        if self.cover_all:
+            raise NotImplementedError(
+                'cover_all average pooling is only supported on CPU')
         if (cuda.cudnn_enabled and self.use_cudnn and
                 pooling_2d._check_cudnn_acceptable_type(x[0].dtype)):
             return super(AveragePooling2D, self).forward_gpu(x)
@@ -76,19 +112,22 @@ class AveragePooling2D(pooling_2d.Pooling2D):
         return y,
 
     def backward_cpu(self, x, gy):
-        if switch.enable_avg_poolingF((x, gy)):
+        gy = gy[0]
+        if self.scale != (1, 1):
+            gy = self._rescale_edges(numpy.array(gy), self.scale)
+        if switch.enable_avg_poolingF((x, (gy,))):
             n, c, h, w = x[0].shape
             gx = numpy.empty((n, c, h, w), dtype=x[0].dtype)
 
             mkl.AvgPooling_F32.do_backward(
-                                    gy[0], x[0], gx,
+                                    gy, x[0], gx,
                                     self.sy, self.sx,
                                     self.ph, self.pd, self.pw, self.pr,
                                     self.kh, self.kw)
             return gx,
         else:
             h, w = x[0].shape[2:]
-            gcol = numpy.tile(gy[0][:, :, None, None],
+            gcol = numpy.tile(gy[:, :, None, None],
                               (1, 1, self.kh, self.kw, 1, 1))
             gx = conv.col2im_cpu(gcol, self.sy, self.sx, self.ph, self.pw, h, w)
             gx /= self.kh * self.kw
@@ -137,7 +176,8 @@ class AveragePooling2D(pooling_2d.Pooling2D):
             libcudnn.CUDNN_POOLING_AVERAGE_COUNT_INCLUDE_PADDING)
 
 
-def average_pooling_2d(x, ksize, stride=None, pad=0, use_cudnn=True):
+def average_pooling_2d(x, ksize, stride=None, pad=0, use_cudnn=True,
+                       cover_all=False):
     """Spatial average pooling function.
 
     This function acts similarly to :class:`~functions.Convolution2D`, but
@@ -155,14 +195,13 @@ def average_pooling_2d(x, ksize, stride=None, pad=0, use_cudnn=True):
             ``pad=p`` and ``pad=(p, p)`` are equivalent.
         use_cudnn (bool): If ``True`` and cuDNN is enabled, then this function
             uses cuDNN as the core implementation.
+        cover_all (bool): If ``True``, all spatial locations are pooled into
+            some output pixels as in :func:`max_pooling_2d`. Windows running
+            past the padded input are averaged over their part inside it.
+            It is only supported on CPU.
 
     Returns:
         ~chainer.Variable: Output variable.
 
-    .. note::
-
-       This function currently does not support ``cover_all`` mode as
-       :func:`max_pooling_2d`. Average pooling runs in non-cover-all mode.
-
     """
-    return AveragePooling2D(ksize, stride, pad, False, use_cudnn)(x)
+    return AveragePooling2D(ksize, stride, pad, cover_all, use_cudnn)(x)
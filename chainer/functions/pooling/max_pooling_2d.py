@@ -1,10 +1,13 @@
 import numpy
 
+import chainer
 from chainer import cuda
 from chainer.functions.pooling import pooling_2d
+from chainer.utils import array
 from chainer.utils import conv
 from mkldnn import mkldnn as mkl
 from mkldnn import switch
+from mkldnn.mdarray import mdarray
 
 if cuda.cudnn_enabled:
     cudnn = cuda.cudnn
@@ -15,18 +18,51 @@ class MaxPooling2D(pooling_2d.Pooling2D):
 
     """Max pooling over a set of 2d planes."""
 
+    # argmax within each window as uint8, set by forward_cpu in training
+    mask = None
+
     def forward_cpu(self, x):
-        # if switch.enable_max_pooling:
-        # we can only handle none cover_all situation
         if switch.enable_max_poolingF((x,)):
             n, c, h, w = x[0].shape
             y_h = conv.get_conv_outsize(
                 h, self.kh, self.sy, self.ph, self.cover_all)
             y_w = conv.get_conv_outsize(
                 w, self.kw, self.sx, self.pw, self.cover_all)
-            self.pd = self.sy*(y_h-1)+self.kh - h - self.ph
-            self.pr = self.sx*(y_w-1)+self.kw - w - self.pw
+            # cover_all is handled by padding the bottom/right edges
+            self.pd = conv.get_conv_pad_r(h, self.kh, self.sy, self.ph, y_h)
+            self.pr = conv.get_conv_pad_r(w, self.kw, self.sx, self.pw, y_w)
+            if not chainer.config.train:
+                # forward_inference keeps no indexes, backward_cpu
+                # rebuilds them if gradients are still needed
+                self.indexes = None
+                if isinstance(x[0], mdarray):
+                    y = mkl.MaxPooling_F32.do_forward_md(
+                                        x[0].md,
+                                        self.sy, self.sx,
+                                        self.ph, self.pd, self.pw, self.pr,
+                                        self.kh, self.kw, True)
+                    return mdarray(y),
+                y = numpy.empty((n, c, y_h, y_w), dtype=x[0].dtype)
+                mkl.MaxPooling_F32.do_forward(
+                                    x[0], y,
+                                    self.sy, self.sx,
+                                    self.ph, self.pd, self.pw, self.pr,
+                                    self.kh, self.kw)
+                return y,
             y = numpy.empty((n, c, y_h, y_w), dtype=x[0].dtype)
+            if (switch.enable_max_pooling_mask and
+                    self.kh * self.kw <= 255 and
+                    isinstance(x[0], numpy.ndarray)):
+                # a byte per output instead of MKL-DNN's int32 workspace,
+                # and backward does not read x
+                self.mask = numpy.empty((n, c, y_h, y_w), dtype=numpy.uint8)
+                self._in_shape = x[0].shape
+                mkl.MaxPoolingMask_F32.do_forward(
+                                    x[0], y, self.mask,
+                                    self.sy, self.sx,
+                                    self.ph, self.pd, self.pw, self.pr,
+                                    self.kh, self.kw)
+                return y,
             self.indexes = numpy.empty((n, c, y_h, y_w), dtype=numpy.int32)
 
             mkl.MaxPooling_F32.do_forward(
@@ -100,6 +136,20 @@ class MaxPooling2D(pooling_2d.Pooling2D):
         return y,
 
     def backward_cpu(self, x, gy):
+        if (self.mask is None and self.indexes is None and
+                switch.enable_max_poolingF((x, gy))):
+            # forward_inference keeps no indexes, rebuild them
+            with chainer.using_config('train', True):
+                self.forward_cpu(x)
+        if self.mask is not None:
+            # x may have been released, see max_pooling_2d
+            gx = numpy.empty(self._in_shape, dtype=gy[0].dtype)
+            mkl.MaxPoolingMask_F32.do_backward(
+                                    gy[0], self.mask, gx,
+                                    self.sy, self.sx,
+                                    self.ph, self.pd, self.pw, self.pr,
+                                    self.kh, self.kw)
+            return gx,
         if switch.enable_max_poolingF((x, gy)):
             n, c, h, w = x[0].shape
             gx = numpy.empty((n, c, h, w), dtype=x[0].dtype)
@@ -203,4 +253,11 @@ def max_pooling_2d(x, ksize, stride=None, pad=0, cover_all=True,
         ~chainer.Variable: Output variable.
 
     """
-    return MaxPooling2D(ksize, stride, pad, cover_all, use_cudnn)(x)
+    intermediate = array.is_intermediate(x)
+    func = MaxPooling2D(ksize, stride, pad, cover_all, use_cudnn)
+    y = func(x)
+    if (intermediate and func.mask is not None and
+            switch.enable_release_inputs):
+        # backward reads the mask only, nothing else uses x
+        x.release_data()
+    return y
@@ -192,6 +192,7 @@ class Link(object):
                 grad = self.xp.full_like(data, numpy.nan)
         var = variable.Variable(data, volatile='auto', name=name)
         var.grad = grad
+        var.track_version()
         self._params.append(name)
         d[name] = var
         if name in self._uninitialized_params:
@@ -481,6 +482,8 @@ class Link(object):
         d = self.__dict__
         for name in self._params:
             serializer(name, d[name].data)
+            if isinstance(serializer, chainer.serializer.Deserializer):
+                d[name].mark_updated()
         for name in self._persistent:
             d[name] = serializer(name, d[name])
         if (self.has_uninitialized_params and
@@ -1,7 +1,9 @@
+from chainer import configuration
 from chainer import cuda
 from chainer.functions.connection import convolution_2d
 from chainer import initializers
 from chainer import link
+from chainer import variable
 
 
 class Convolution2D(link.Link):
@@ -39,6 +41,10 @@ class Convolution2D(link.Link):
             If this option is ``True``, then it forces cuDNN to use
             a deterministic algorithm. This option is only available for
             cuDNN version >= v4.
+        fuse_relu (bool): If ``True``, then ReLU is applied to the output,
+            fused into the convolution primitive on MKL-DNN.
+        groups (int): Number of groups of channels convolved separately.
+            ``in_channels`` and ``out_channels`` must be divisible by it.
 
     .. seealso::
        See :func:`chainer.functions.convolution_2d` for the definition of
@@ -52,7 +58,8 @@ class Convolution2D(link.Link):
 
     def __init__(self, in_channels, out_channels, ksize, stride=1, pad=0,
                  bias=0, nobias=False, use_cudnn=True,
-                 initialW=None, initial_bias=None, deterministic=False):
+                 initialW=None, initial_bias=None, deterministic=False,
+                 fuse_relu=False, groups=1):
         super(Convolution2D, self).__init__()
         self.ksize = ksize
         self.stride = _pair(stride)
@@ -60,6 +67,10 @@ class Convolution2D(link.Link):
         self.use_cudnn = use_cudnn
         self.out_channels = out_channels
         self.deterministic = deterministic
+        self.fuse_relu = fuse_relu
+        self.groups = groups
+        self._folded_bn = None
+        self._folded_version = None
 
         # For backward compatibility
         self.initialW = initialW
@@ -81,7 +92,7 @@ class Convolution2D(link.Link):
 
     def _initialize_params(self, in_channels):
         kh, kw = _pair(self.ksize)
-        W_shape = (self.out_channels, in_channels, kh, kw)
+        W_shape = (self.out_channels, in_channels // self.groups, kh, kw)
         self.add_param('W', W_shape, initializer=self._W_initializer)
 
     def __call__(self, x):
@@ -97,9 +108,74 @@ class Convolution2D(link.Link):
         if self.has_uninitialized_params:
             with cuda.get_device(self._device_id):
                 self._initialize_params(x.shape[1])
+        W, b = self.W, self.b
+        if self._folded_bn is not None and not configuration.config.train:
+            W, b = self._folded_params()
+        if self.fuse_relu:
+            return convolution_2d.convolution_2d_relu(
+                x, W, b, self.stride, self.pad, self.use_cudnn,
+                deterministic=self.deterministic, in_chain=self.in_chain,
+                groups=self.groups)
         return convolution_2d.convolution_2d(
-            x, self.W, self.b, self.stride, self.pad, self.use_cudnn,
-            deterministic=self.deterministic, in_chain=self.in_chain)
+            x, W, b, self.stride, self.pad, self.use_cudnn,
+            deterministic=self.deterministic, in_chain=self.in_chain,
+            groups=self.groups)
+
+    def fold_batch_normalization(self, bn):
+        """Folds a following batch normalization into this layer.
+
+        In testing mode, ``bn`` applies a fixed per-channel affine transform
+        to the output of this layer, so it is applied to the filter weight and
+        bias instead and ``bn`` passes its input through. Training mode is not
+        affected. Folded weights are recomputed when the parameters of
+        either link or the running statistics of ``bn`` have changed since
+        the last forward pass. Running statistics edited in place by hand
+        are not seen, assign new arrays instead.
+
+        Args:
+            bn (~chainer.links.BatchNormalization): Batch normalization link
+                applied directly to the output of this layer.
+
+        .. seealso::
+           :func:`~chainer.links.fold_batch_normalization`
+
+        """
+        self._folded_bn = bn
+        self._folded_version = None
+        bn.folded = True
+
+    def _folded_key(self):
+        bn = self._folded_bn
+        versions = tuple(p.version for p in self.params()) + \
+            tuple(p.version for p in bn.params()) + (bn.stats_updates,)
+        return versions, bn.avg_mean, bn.avg_var
+
+    def _folded_params(self):
+        key = self._folded_key()
+        old = self._folded_version
+        # running statistics are compared by identity, the key keeps them
+        # alive so that new arrays can not take their ids
+        if old is not None and old[0] == key[0] and \
+                old[1] is key[1] and old[2] is key[2]:
+            return self._folded_W, self._folded_b
+        bn = self._folded_bn
+        xp = self.xp
+        dtype = self.W.dtype
+        scale = 1 / xp.sqrt(bn.avg_var + bn.eps)
+        if hasattr(bn, 'gamma'):
+            scale *= bn.gamma.data
+        b = -bn.avg_mean * scale
+        if self.b is not None:
+            b += self.b.data * scale
+        if hasattr(bn, 'beta'):
+            b += bn.beta.data
+        W = self.W.data * scale[:, None, None, None]
+        self._folded_W = variable.Variable(W.astype(dtype), volatile='auto')
+        self._folded_b = variable.Variable(b.astype(dtype), volatile='auto')
+        # folded weights stay prepacked until they are folded again
+        self._folded_W.track_version()
+        self._folded_version = key
+        return self._folded_W, self._folded_b
 
 
 def _pair(x):
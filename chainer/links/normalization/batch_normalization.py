@@ -1,10 +1,14 @@
+import collections
+
 import numpy
 
 from chainer import configuration
 from chainer import cuda
+from chainer.functions.connection import convolution_2d
 from chainer.functions.normalization import batch_normalization
 from chainer import initializers
 from chainer import link
+from chainer.links.connection import convolution_2d as convolution_2d_link
 from chainer import variable
 
 
@@ -60,6 +64,11 @@ class BatchNormalization(link.Link):
         eps (float): Epsilon value for numerical stability. This value is added
             to the batch variances.
         use_cudnn (bool): If ``True``, then this link uses cuDNN if available.
+        folded (bool): If ``True``, this link has been folded into the
+            preceding convolution and passes its input through in testing
+            mode.
+        stats_updates (int): Count of updates of ``avg_mean`` and
+            ``avg_var`` in place, by training or deserialization.
 
     """
 
@@ -83,6 +92,8 @@ class BatchNormalization(link.Link):
         self.decay = decay
         self.eps = eps
         self.use_cudnn = use_cudnn
+        self.folded = False
+        self.stats_updates = 0
 
     def __call__(self, x, finetune=False):
         """Invokes the forward propagation of BatchNormalization.
@@ -100,6 +111,9 @@ class BatchNormalization(link.Link):
                 statistics.
 
         """
+        if self.folded and not configuration.config.train:
+            return x
+
         if hasattr(self, 'gamma'):
             gamma = self.gamma
         else:
@@ -126,6 +140,7 @@ class BatchNormalization(link.Link):
 
             self.avg_mean[:] = func.running_mean
             self.avg_var[:] = func.running_var
+            self.stats_updates += 1
         else:
             # Use running average statistics or fine-tuned statistics.
             mean = variable.Variable(self.avg_mean, volatile='auto')
@@ -143,3 +158,91 @@ class BatchNormalization(link.Link):
 
         """
         self.N = 0
+
+    def serialize(self, serializer):
+        super(BatchNormalization, self).serialize(serializer)
+        # running statistics are loaded in place
+        self.stats_updates += 1
+
+
+def fold_batch_normalization(model, *args, **kwargs):
+    """Folds batch normalization layers into preceding convolutions.
+
+    In testing mode, :class:`BatchNormalization` is a per-channel affine
+    transform, so when it directly follows a
+    :class:`~chainer.links.Convolution2D` it can be applied to the filter
+    weight and bias once instead of to every output activation. This function
+    runs ``model`` once in testing mode to trace the computational graph, and
+    folds each batch normalization whose input is the output of a convolution
+    used nowhere else. Both links must be called only once per forward pass.
+
+    Training mode is not affected, and folded weights follow parameter
+    updates. See :meth:`Convolution2D.fold_batch_normalization
+    <chainer.links.Convolution2D.fold_batch_normalization>`.
+
+    Args:
+        model (~chainer.Link): Model to rewrite.
+        args: Sample inputs given to ``model``. They must not be volatile so
+            that the graph is traced.
+        kwargs: Keyword arguments given to ``model``.
+
+    Returns:
+        list: Pairs of folded convolution and batch normalization links.
+
+    """
+    convs = {}
+    bns = {}
+    for l in model.links():
+        if isinstance(l, convolution_2d_link.Convolution2D) and \
+                not l.fuse_relu and l._folded_bn is None:
+            convs[id(l.W)] = l
+        elif isinstance(l, BatchNormalization) and not l.folded:
+            bns[id(l.avg_mean)] = l
+
+    with configuration.using_config('train', False), \
+            configuration.using_config('enable_backprop', True):
+        outputs = model(*args, **kwargs)
+    if not isinstance(outputs, (tuple, list)):
+        outputs = (outputs,)
+
+    # Count the consumers of each variable and the calls of each link.
+    consumers = collections.Counter(id(y) for y in outputs)
+    calls = collections.Counter()
+    funcs = []
+    seen = set()
+    cand = [y.creator for y in outputs
+            if isinstance(y, variable.Variable) and y.creator is not None]
+    while cand:
+        f = cand.pop()
+        if id(f) in seen:
+            continue
+        seen.add(id(f))
+        funcs.append(f)
+        for x in f.inputs:
+            consumers[id(x)] += 1
+            if x.creator is not None:
+                cand.append(x.creator)
+        if isinstance(f, convolution_2d.Convolution2DFunction):
+            calls[id(f.inputs[1])] += 1
+        elif isinstance(f, batch_normalization.BatchNormalizationFunction) \
+                and len(f.inputs) == 5:
+            calls[id(f.inputs[3].data)] += 1
+
+    pairs = []
+    for f in funcs:
+        if not isinstance(f, batch_normalization.BatchNormalizationFunction) \
+                or len(f.inputs) != 5:
+            continue
+        bn = bns.get(id(f.inputs[3].data))
+        h = f.inputs[0]
+        conv_f = h.creator
+        if bn is None or calls[id(bn.avg_mean)] != 1 or \
+                consumers[id(h)] != 1 or \
+                not isinstance(conv_f, convolution_2d.Convolution2DFunction):
+            continue
+        conv = convs.get(id(conv_f.inputs[1]))
+        if conv is None or calls[id(conv.W)] != 1:
+            continue
+        conv.fold_batch_normalization(bn)
+        pairs.append((conv, bn))
+    return pairs
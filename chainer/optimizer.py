@@ -427,6 +427,8 @@ class GradientMethod(Optimizer):
             self.update_one_cpu(param, state)
         else:
             self.update_one_gpu(param, state)
+        # GPU kernels write to the array in place
+        param.mark_updated()
 
     def update_one_cpu(self, param, state):
         """Updates a parameter on CPU.
@@ -1,5 +1,6 @@
 import numpy
 
+import chainer
 from chainer import cuda
 
 
@@ -16,3 +17,33 @@ def empty_like(x):
         return cuda.cupy.empty_like(x)
     else:
         return numpy.empty_like(x)
+
+
+def weights_version(W):
+    """Returns the version MKL-DNN layers keep reordered weights W under.
+
+    Only tracked variables, like the parameters of links, have a version.
+    Any other W gets -1, so it is reordered on every call.
+    """
+    version = getattr(W, 'version', None)
+    return -1 if version is None else version
+
+
+def is_intermediate(x):
+    """Tells whether x is an intermediate variable owning its data.
+
+    That is a variable output by another function, as in
+    ``F.relu(self.conv(x))``, whose data is neither a view nor an array of
+    that function's inputs. Whether user code keeps x and reads it later
+    can not be told from the graph, so the functions overwriting or
+    releasing such inputs only do it when the user opts in through
+    ``mkldnn.switch``.
+    """
+    if not (isinstance(x, chainer.Variable) and x.creator is not None and
+            isinstance(x.data, numpy.ndarray)):
+        return False
+    if x.data.base is not None:
+        # views, as made by F.reshape, share memory with their base
+        return False
+    # F.identity and the like output their input arrays
+    return all(x.data is not i._data for i in x.creator.inputs)
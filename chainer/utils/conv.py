@@ -12,6 +12,17 @@ def get_conv_outsize(size, k, s, p, cover_all=False, d=1):
         return (size + p * 2 - dk) // s + 1
 
 
+def get_conv_pad_r(size, k, s, p, out_size, d=1):
+    """Returns the bottom/right padding giving ``out_size`` outputs.
+
+    In cover_all mode this is the extra padding covering the last window.
+    It is clamped to zero otherwise, since MKL-DNN computes output sizes
+    with floor division and rejects negative padding.
+    """
+    dk = k + (k - 1) * (d - 1)
+    return max(s * (out_size - 1) + dk - size - p, 0)
+
+
 def get_deconv_outsize(size, k, s, p, cover_all=False):
     if cover_all:
         return s * (size - 1) + k - s + 1 - 2 * p
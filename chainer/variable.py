@@ -1,5 +1,6 @@
 import collections
 import heapq
+import itertools
 import traceback
 import warnings
 
@@ -13,6 +14,10 @@ from chainer import utils
 
 from mkldnn import mkldnn
 from mkldnn import switch
+from mkldnn.mdarray import mdarray
+
+# stamps of tracked variables, unique within the process
+_versions = itertools.count(1)
 
 
 def _check_grad_type(func, x, gx):
@@ -39,20 +44,48 @@ https://github.com/pfnet/chainer/issues/new.
         detail += message
         return detail
 
-    if not isinstance(gx, type(x.data)):
+    # gradients of an mdarray are plain numpy arrays, only numpy arrays
+    # are released
+    data_type = numpy.ndarray if isinstance(x._data, (mdarray, type(None))) \
+        else type(x._data)
+    if not isinstance(gx, data_type):
         msg = ('Type of data and grad mismatch\n%s != %s' %
-               (type(x.data), type(gx)))
+               (data_type, type(gx)))
         raise TypeError(make_message(msg))
-    if gx.dtype != x.data.dtype:
+    if gx.dtype != x.dtype:
         msg = ('Dtype of data and grad mismatch\n%s != %s' %
-               (x.data.dtype, gx.dtype))
+               (x.dtype, gx.dtype))
         raise TypeError(make_message(msg))
-    if gx.shape != x.data.shape:
+    if gx.shape != x.shape:
         msg = ('Shape of data and grad mismatch\n%s != %s' %
-               (x.data.shape, gx.shape))
+               (x.shape, gx.shape))
         raise ValueError(make_message(msg))
 
 
+def _accumulate_grads(grad, acc_grad, owned):
+    """Sums ``grad`` and the deferred gradients ``acc_grad``.
+
+    The result is written into ``grad`` when it is ``owned`` (made by the
+    backward pass and held by one variable), otherwise into a new array. float32 arrays of
+    any rank are summed natively, others fall back to numpy.
+    """
+    grads = acc_grad + (grad,)
+    if (owned and grad.base is None and grad.flags.c_contiguous and
+            grad.flags.writeable):
+        y = grad
+    else:
+        y = numpy.empty(grad.shape, dtype=grad.dtype)
+    if all(g.dtype == numpy.float32 and g.flags.c_contiguous and
+           g.shape == grad.shape for g in grads):
+        mkldnn.Sum_F32.do_sum_nd(grads, y)
+    else:
+        acc = grads[0] + grads[1]
+        for g in grads[2:]:
+            acc += g
+        y[...] = acc
+    return y
+
+
 class Variable(object):
 
     """Array with a structure to keep track of computation.
@@ -83,6 +116,8 @@ class Variable(object):
     Attributes:
         data: Data array of type either :class:`numpy.ndarray` or
             :class:`cupy.ndarray`.
+        version: Version of the data of a tracked variable, ``None``
+            otherwise. See :meth:`track_version`.
         grad: Gradient array.
         creator: The function who creates this variable. It is ``None`` if the
             variable is not created by any function.
@@ -93,12 +128,14 @@ class Variable(object):
     """
 
     def __init__(self, data, volatile=flag.OFF, name=None, grad=None):
-        if not isinstance(data, (numpy.ndarray, cuda.ndarray)):
+        if not isinstance(data, (numpy.ndarray, cuda.ndarray, mdarray)):
             msg = '''numpy.ndarray or cuda.ndarray are expected.
 Actual: {0}'''.format(type(data))
             raise TypeError(msg)
 
-        self.data = data
+        self._version = None
+        self._released = None
+        self._data = data
         self.rank = 0
         self._volatile = flag.Flag(volatile)
 
@@ -111,7 +148,17 @@ Actual: {0}'''.format(type(data))
         self.acc_grad = ()
 
     def __reduce__(self):
-        return Variable, (self.data, self.volatile, self.name, self._grad)
+        # a restored variable gets a new stamp, stamps are per process
+        state = {'_version': [next(_versions)]} \
+            if self._version is not None else None
+        return Variable, (self._data, self.volatile, self.name, self._grad), \
+            state
+
+    def __copy__(self):
+        ret = Variable(self._data, self.volatile, self.name, self._grad)
+        # the copy shares the data array, so it shares its version too
+        ret._version = self._version
+        return ret
 
     def __repr__(self):
         if self.name:
@@ -171,7 +218,9 @@ Actual: {0}'''.format(type(data))
             int: Number of the first dimension of the data array.
 
         """
-        return len(self.data)
+        if self._released is not None:
+            return self._released[0][0]
+        return len(self._data)
 
     @property
     def volatile(self):
@@ -184,10 +233,56 @@ Actual: {0}'''.format(type(data))
     @property
     def label(self):
         """Short text that represents the variable."""
-        if self.data.shape == ():
-            return str(self.data.dtype)
-        return '(%s), %s' % (', '.join(map(str, self.data.shape)),
-                             str(self.data.dtype))
+        if self.shape == ():
+            return str(self.dtype)
+        return '(%s), %s' % (', '.join(map(str, self.shape)),
+                             str(self.dtype))
+
+    @property
+    def data(self):
+        if self._released is not None:
+            raise RuntimeError(
+                'data of %s (%s) was released after the forward pass, the '
+                'backward pass does not need it' % (self, self.label))
+        return self._data
+
+    @data.setter
+    def data(self, d):
+        self._data = d
+        self._released = None
+        if self._version is not None:
+            self._version[0] = next(_versions)
+
+    @property
+    def version(self):
+        if self._version is None:
+            return None
+        return self._version[0]
+
+    def track_version(self):
+        """Starts tracking the version of the data array.
+
+        The version changes whenever :attr:`data` is assigned through this
+        variable or a copy of it, including augmented assignments like
+        ``v.data -= g``, and when optimizers, :meth:`copydata` or
+        deserialization write to it. MKL-DNN layers reuse weights reordered
+        for a version, link parameters are tracked. Other writes to the array
+        in place, like ``v.data[...] = 0``, are not seen, call
+        :meth:`mark_updated` after them.
+
+        """
+        if self._version is None:
+            self._version = [next(_versions)]
+
+    def mark_updated(self):
+        """Tells that the data array was written in place.
+
+        It gives a tracked variable a new version, see :meth:`track_version`,
+        and does nothing otherwise.
+
+        """
+        if self._version is not None:
+            self._version[0] = next(_versions)
 
     @property
     def grad(self):
@@ -201,19 +296,42 @@ Actual: {0}'''.format(type(data))
 
     @property
     def shape(self):
-        return self.data.shape
+        if self._released is not None:
+            return self._released[0]
+        return self._data.shape
 
     @property
     def ndim(self):
-        return self.data.ndim
+        if self._released is not None:
+            return len(self._released[0])
+        return self._data.ndim
 
     @property
     def size(self):
-        return self.data.size
+        if self._released is not None:
+            return int(numpy.prod(self._released[0]))
+        return self._data.size
 
     @property
     def dtype(self):
-        return self.data.dtype
+        if self._released is not None:
+            return self._released[1]
+        return self._data.dtype
+
+    def release_data(self):
+        """Frees the data array once nothing needs it anymore.
+
+        Functions call it on intermediate inputs, see
+        :func:`~chainer.utils.array.is_intermediate`, when their backward pass
+        keeps its own state, like the mask of :func:`~chainer.functions.relu`,
+        and ``mkldnn.switch.enable_release_inputs`` is on.
+        Shape and dtype are kept for gradient checks. Reading :attr:`data`
+        raises an error until a new array is assigned, and functions and
+        hooks get ``None`` for it in the backward pass.
+
+        """
+        self._released = (self._data.shape, self._data.dtype)
+        self._data = None
 
     def to_cpu(self):
         """Copies the data and gradient arrays to CPU."""
@@ -266,7 +384,7 @@ Actual: {0}'''.format(type(data))
             var (Variable): Source variable.
 
         """
-        src = var.data
+        src = var._data
         dst = self.data
         src_xp = cuda.get_array_module(src)
         dst_xp = cuda.get_array_module(dst)
@@ -276,6 +394,7 @@ Actual: {0}'''.format(type(data))
             dst_xp.copyto(dst, src.get())
         else:
             dst.set(src)
+        self.mark_updated()
 
     def addgrad(self, var):
         """Accumulates the gradient array from given source variable.
@@ -371,6 +490,26 @@ Actual: {0}'''.format(type(data))
         seen_set = set()
         seen_vars = set()
         need_copy = set()
+        # Gradient arrays made during this backward pass and held by a
+        # single variable, by id. Only these are written in place, never an
+        # array given by the caller or passed through by a function. They
+        # are referenced here so that their ids can not be reused.
+        owned = {}
+        # arrays made during this pass and handed to several variables
+        shared = {}
+
+        def hand_over(gx, out_grad):
+            # gx is now referenced by one more variable
+            key = id(gx)
+            if key in owned:
+                shared[key] = owned.pop(key)
+            elif (key not in shared and getattr(gx, 'base', 0) is None and
+                  not any(gx is g for g in out_grad)):
+                owned[key] = gx
+
+        def disown(g):
+            if g is not None and owned.get(id(g)) is g:
+                del owned[id(g)]
 
         # Initialize error by 1, if this is a loss variable
         if self.data.size == 1 and self.grad is None:
@@ -392,28 +531,29 @@ Actual: {0}'''.format(type(data))
             _, _, func = heapq.heappop(cand_funcs)
             outputs = [y() for y in func.outputs]  # access via weak ref
 
-            in_data = tuple([x.data for x in func.inputs])
+            # None for released inputs, see release_data
+            in_data = tuple([x._data for x in func.inputs])
             out_grad = ()
-            # if enable grad accumulate
-            if switch.enable_acc_gradF((in_data,)) and in_data[0].ndim == 4 and all(isinstance(xi, numpy.ndarray) for xi in in_data):
-                out_grad_tmp = tuple([None if y is None else y.grad for y in outputs])
-                acc_grad_tuple = tuple([None if y is None else y.acc_grad for y in outputs])
-                for grad_tmp, acc_grad in zip(out_grad_tmp, acc_grad_tuple):
-                    if len(acc_grad) == 0:
-                        # no need accumulate, just return grad
-                        out_grad += (grad_tmp,)
-                    else:
-                        """
-                        acc_grad's length is not 0, means need to do grad accumulate
-                        call native MKLDNN sum primitive
-                        """
-                        y = numpy.empty((grad_tmp.shape), dtype=grad_tmp.dtype)
-                        acc_grad += (grad_tmp,)
-                        mkldnn_sum = mkldnn.Sum_F32()
-                        mkldnn_sum.sum(acc_grad, y)
-                        out_grad += (y,)
-            else:
-                out_grad = tuple([None if y is None else y.grad for y in outputs])
+            for y in outputs:
+                if y is None or len(y.acc_grad) == 0:
+                    # no need accumulate, just return grad
+                    out_grad += (None if y is None else y.grad,)
+                else:
+                    """
+                    acc_grad's length is not 0, means need to do grad accumulate
+                    call native MKLDNN sum primitive
+                    """
+                    grad = y._grad
+                    acc = _accumulate_grads(
+                        grad, y.acc_grad, owned.get(id(grad)) is grad)
+                    for g in y.acc_grad:
+                        disown(g)
+                    y.acc_grad = ()
+                    if acc is not grad:
+                        disown(grad)
+                        owned[id(acc)] = acc
+                        y._grad = acc
+                    out_grad += (acc,)
             hooks = chainer.get_function_hooks()
             if func._n_local_function_hooks != 0:
                 hooks = collections.OrderedDict(hooks)
@@ -428,6 +568,15 @@ Actual: {0}'''.format(type(data))
                 if _x.creator is None and func.in_chain is True:
                     func.mkldnn_opt = True
 
+            if func.accept_inplace_grad:
+                # output gradients no other variable holds (nor views) are
+                # released right after this backward, so it may overwrite
+                # them
+                func.inplace_grad = not retain_grad and all(
+                    y is not None and y is not self and gy is not None and
+                    owned.get(id(gy)) is gy
+                    for y, gy in zip(outputs, out_grad))
+
             gxs = func.backward(in_data, out_grad)
             assert len(gxs) == len(in_data)
             for hook in six.itervalues(hooks):
@@ -445,6 +594,7 @@ Actual: {0}'''.format(type(data))
             if not retain_grad:
                 for y in outputs:
                     if y is not None and y is not self:
+                        disown(y._grad)
                         y.grad = None
             for x, gx in zip(func.inputs, gxs):
                 if gx is None:
@@ -458,44 +608,51 @@ Actual: {0}'''.format(type(data))
                 if x.creator is None:  # leaf
                     if x._grad is None:  # 1st visit
                         x.grad = gx
+                        hand_over(gx, out_grad)
                         need_copy.add(id_x)
                     else:
                         cuda.get_device(gx).use()
+                        # nothing consumes the gradient of a leaf later,
+                        # so it is accumulated right away
                         if id_x in need_copy:  # 2nd visit
-                            if switch.enable_acc_gradF((in_data,)) and in_data[0].ndim == 4 and all(isinstance(xi, numpy.ndarray) for xi in in_data):
-                                # if enable_acc_grad,will deply to do grad accumulate,only record grad 
-                                x.acc_grad += (gx,)
+                            disown(x._grad)
+                            if all(isinstance(xi, numpy.ndarray) for xi in in_data) and switch.enable_acc_gradF((in_data,)):
+                                x.grad = _accumulate_grads(x.grad, (gx,), False)  # copy
                             else:
                                 x.grad = utils.force_array(x.grad + gx)  # copy
+                            owned[id(x._grad)] = x._grad
                             need_copy.remove(id_x)  # remove from list in 2nd visit
                         else:
-                            if switch.enable_acc_gradF((in_data,)) and in_data[0].ndim == 4 and all(isinstance(xi, numpy.ndarray) for xi in in_data):
-                                # if enable_acc_grad, will deply to do grad accumulate, only record grad
-                                if len(x.acc_grad) > 0: # means 3rd or later visit for variable x
-                                    x.acc_grad += (gx,)
-                                else: # means this variable is W or b
-                                    x._grad += gx
+                            # the copy of the 2nd visit, or a gradient the
+                            # variable held before, which accumulates
+                            if all(isinstance(xi, numpy.ndarray) for xi in in_data) and switch.enable_acc_gradF((in_data,)):
+                                x._grad = _accumulate_grads(x._grad, (gx,), True)
                             else:
                                 x._grad += gx  # 3rd or later visit
                 else:  # not a leaf
                     add_cand(x.creator)
                     if id_x not in seen_vars:  # 1st visit
                         x.grad = gx
+                        hand_over(gx, out_grad)
                         seen_vars.add(id_x)
                         need_copy.add(id_x)
                     else:
                         cuda.get_device(gx).use()
                         if id_x in need_copy:  # 2nd visit
-                            if switch.enable_acc_gradF((in_data,)) and in_data[0].ndim == 4 and all(isinstance(xi, numpy.ndarray) for xi in in_data):
+                            if all(isinstance(xi, numpy.ndarray) for xi in in_data) and switch.enable_acc_gradF((in_data,)):
                                 # if enable_acc_grad, will deply to do grad accumulate, only record grad
                                 x.acc_grad += (gx,)
+                                hand_over(gx, out_grad)
                             else:
+                                disown(x._grad)
                                 x._grad = utils.force_array(gx + x._grad)  # copied
+                                owned[id(x._grad)] = x._grad
                             need_copy.remove(id_x)
                         else:  # 3rd or later visit
-                            if switch.enable_acc_gradF((in_data,)) and in_data[0].ndim == 4 and all(isinstance(xi, numpy.ndarray) for xi in in_data):
+                            if all(isinstance(xi, numpy.ndarray) for xi in in_data) and switch.enable_acc_gradF((in_data,)):
                                 # if enable_acc_grad, will deply to do grad accumulate, only record grad
                                 x.acc_grad += (gx,)
+                                hand_over(gx, out_grad)
                             else:
                                 x._grad += gx
             del gxs  # to reduce memory usage
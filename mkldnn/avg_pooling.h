@@ -100,11 +100,23 @@ public:
                 T* y, int y_d1, int y_d2, int y_d3, int y_d4,
                 int s_y, int s_x,
                 int p_u, int p_d, int p_l, int p_r,
-                int ker_h, int ker_w) {
+                int ker_h, int ker_w,
+                bool inference = false) {
         Pooling<T>::do_forward(x, x_d1, x_d2, x_d3, x_d4,
                                y, y_d1, y_d2, y_d3, y_d4,
                                s_y, s_x, p_u, p_d, p_l, p_r, ker_h, ker_w,
-                               mkldnn::pooling_avg_include_padding);
+                               mkldnn::pooling_avg_include_padding, inference);
+    }
+
+    static MdArray<T>* do_forward_md(
+                MdArray<T>* x,
+                int s_y, int s_x,
+                int p_u, int p_d, int p_l, int p_r,
+                int ker_h, int ker_w,
+                bool inference = false) {
+        return Pooling<T>::do_forward_md(x,
+                               s_y, s_x, p_u, p_d, p_l, p_r, ker_h, ker_w,
+                               mkldnn::pooling_avg_include_padding, inference);
     }
 
     static void do_backward(
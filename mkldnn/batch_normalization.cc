@@ -0,0 +1,300 @@
+/*
+ *COPYRIGHT
+ *All modification made by Intel Corporation: © 2017 Intel Corporation.
+ *Copyright (c) 2015 Preferred Infrastructure, Inc.
+ *Copyright (c) 2015 Preferred Networks, Inc.
+ *
+ *Permission is hereby granted, free of charge, to any person obtaining a copy
+ *of this software and associated documentation files (the "Software"), to deal
+ *in the Software without restriction, including without limitation the rights
+ *to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ *copies of the Software, and to permit persons to whom the Software is
+ *furnished to do so, subject to the following conditions:
+ *
+ *The above copyright notice and this permission notice shall be included in
+ *all copies or substantial portions of the Software.
+ *
+ *THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ *AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ *OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ *THE SOFTWARE.
+ *
+ *
+ *######################################################################
+ *# The CuPy is designed based on NumPy's API.
+ *# CuPy's source code and documents contain the original NumPy ones.
+ *######################################################################
+ *Copyright (c) 2005-2016, NumPy Developers.
+ *All rights reserved.
+ *
+ *Redistribution and use in source and binary forms, with or without
+ *modification, are permitted provided that the following conditions are
+ *met:
+ *
+ *    * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *
+ *    * Redistributions in binary form must reproduce the above
+ *       copyright notice, this list of conditions and the following
+ *       disclaimer in the documentation and/or other materials provided
+ *       with the distribution.
+ *
+ *    * Neither the name of the NumPy Developers nor the names of any
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ *THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *"AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ *A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ *OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ *SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ *LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ *DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ *THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ *(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ *OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *######################################################################
+ */
+
+
+#include <glog/logging.h>
+#include <iostream>
+#include "common.h"
+#include "mkldnn.hpp"
+#include "batch_normalization.h"
+#include "utils.h"
+
+using namespace mkldnn;
+
+extern engine cpu_engine;
+
+template<typename T>
+BatchNormalization<T>::BatchNormalization(double eps, bool global_stats)
+    : eps_(eps), global_stats_(global_stats)
+{
+    fwd_stream_.reset(new stream(stream::kind::eager));
+    bwd_stream_.reset(new stream(stream::kind::eager));
+}
+
+template<typename T>
+BatchNormalization<T>::~BatchNormalization()
+{
+}
+
+template<typename T>
+size_t BatchNormalization<T>::get_memory_size()
+{
+    return this->memory_size(x_mem_, user_x_mem_)
+        + this->memory_size(y_mem_, user_y_mem_)
+        + this->memory_size(bwd_x_mem_, user_bwd_x_mem_)
+        + this->memory_size(gy_mem_, user_gy_mem_)
+        + this->memory_size(gx_mem_, user_gx_mem_);
+}
+
+template<typename T>
+void BatchNormalization<T>::forward_setup(int x_d1, int x_d2, int x_d3, int x_d4)
+{
+    LOG(INFO) << "BatchNormalization forward_setup";
+    memory::dims data_tz = {x_d1, x_d2, x_d3, x_d4};
+    memory::dims stats_tz = {x_d2};
+    memory::dims w_tz = {2, x_d2};
+
+    memory::format user_format;
+    if (x_format_ >= 0) {
+        // MdArray input, normalize in its own format
+        data_format_ = user_format = (memory::format)x_format_;
+    } else {
+        user_format = memory::format::nchw;
+        data_format_ = cpu_blocked_format(x_d2);
+    }
+
+    user_x_mem_.reset(new memory({{{data_tz}, memory_data_type<T>(),
+                                   user_format}, cpu_engine}, dummy));
+    user_y_mem_.reset(new memory({{{data_tz}, memory_data_type<T>(),
+                                   user_format}, cpu_engine}, dummy));
+
+    memory::desc data_md({data_tz}, memory_data_type<T>(), data_format_);
+    unsigned flags = use_scale_shift;
+    if (global_stats_)
+        flags |= use_global_stats;
+    prop_kind aprop_kind = global_stats_ ? prop_kind::forward_inference
+                                         : prop_kind::forward_training;
+    batch_normalization_forward::desc fwd_desc(aprop_kind, data_md, eps_, flags);
+    fwd_pd_.reset(new batch_normalization_forward::primitive_desc(fwd_desc, cpu_engine));
+
+    w_mem_.reset(new memory({{{w_tz}, memory_data_type<T>(),
+                              memory::format::nc}, cpu_engine}, dummy));
+    mean_mem_.reset(new memory({{{stats_tz}, memory_data_type<T>(),
+                                 memory::format::x}, cpu_engine}, dummy));
+    var_mem_.reset(new memory({{{stats_tz}, memory_data_type<T>(),
+                                memory::format::x}, cpu_engine}, dummy));
+
+    x_mem_ = user_x_mem_;
+    bool reorder_x_p = false;
+    if (data_format_ != user_format) {
+        x_mem_.reset(new memory({{{data_tz}, memory_data_type<T>(),
+                                  data_format_}, cpu_engine}));
+        reorder_x_ = reorder(*user_x_mem_, *x_mem_);
+        reorder_x_p = true;
+    }
+
+    y_mem_ = user_y_mem_;
+    bool reorder_y_p = false;
+    if (memory::primitive_desc(fwd_pd_->dst_primitive_desc())
+            != user_y_mem_->get_primitive_desc()) {
+        y_mem_.reset(new_local_memory(fwd_pd_->dst_primitive_desc()));
+        reorder_y_ = reorder(*y_mem_, *user_y_mem_);
+        reorder_y_p = true;
+    }
+
+    if (global_stats_)
+        bn_fwd_.reset(new batch_normalization_forward(*fwd_pd_, *x_mem_,
+                        (const primitive::at)*mean_mem_,
+                        (const primitive::at)*var_mem_, *w_mem_, *y_mem_));
+    else
+        bn_fwd_.reset(new batch_normalization_forward(*fwd_pd_, *x_mem_,
+                        *w_mem_, *y_mem_, *mean_mem_, *var_mem_));
+
+    if (reorder_x_p) fwd_primitives_.push_back(reorder_x_);
+    fwd_primitives_.push_back(*bn_fwd_);
+    if (reorder_y_p) fwd_primitives_.push_back(reorder_y_);
+}
+
+template<typename T>
+void BatchNormalization<T>::forward(T* x, int x_d1, int x_d2, int x_d3, int x_d4,
+        T* y, T* w, T* mean, T* var)
+{
+    if (bn_fwd_ == NULL) {
+        forward_setup(x_d1, x_d2, x_d3, x_d4);
+    }
+
+    user_x_mem_->set_data_handle(x);
+    user_y_mem_->set_data_handle(y);
+    w_mem_->set_data_handle(w);
+    mean_mem_->set_data_handle(mean);
+    var_mem_->set_data_handle(var);
+
+    if (fwd_first_run_) {
+        fwd_stream_->submit(fwd_primitives_).wait();
+        fwd_first_run_ = false;
+    } else {
+        fwd_stream_->rerun().wait();
+    }
+}
+
+template<typename T>
+void BatchNormalization<T>::backward_setup(int x_d1, int x_d2, int x_d3, int x_d4)
+{
+    LOG(INFO) << "BatchNormalization backward_setup";
+    memory::dims data_tz = {x_d1, x_d2, x_d3, x_d4};
+    memory::dims stats_tz = {x_d2};
+    memory::dims w_tz = {2, x_d2};
+
+    user_bwd_x_mem_.reset(new memory({{{data_tz}, memory_data_type<T>(),
+                                       memory::format::nchw}, cpu_engine}, dummy));
+    user_gy_mem_.reset(new memory({{{data_tz}, memory_data_type<T>(),
+                                    memory::format::nchw}, cpu_engine}, dummy));
+    user_gx_mem_.reset(new memory({{{data_tz}, memory_data_type<T>(),
+                                    memory::format::nchw}, cpu_engine}, dummy));
+
+    memory::desc data_md({data_tz}, memory_data_type<T>(), data_format_);
+    batch_normalization_backward::desc bwd_desc(prop_kind::backward,
+                                                data_md, data_md, eps_,
+                                                use_scale_shift);
+    bwd_pd_.reset(new batch_normalization_backward::primitive_desc(
+                    bwd_desc, cpu_engine, *fwd_pd_));
+
+    bwd_w_mem_.reset(new memory({{{w_tz}, memory_data_type<T>(),
+                                  memory::format::nc}, cpu_engine}, dummy));
+    gw_mem_.reset(new memory({{{w_tz}, memory_data_type<T>(),
+                               memory::format::nc}, cpu_engine}, dummy));
+    bwd_mean_mem_.reset(new memory({{{stats_tz}, memory_data_type<T>(),
+                                     memory::format::x}, cpu_engine}, dummy));
+    bwd_var_mem_.reset(new memory({{{stats_tz}, memory_data_type<T>(),
+                                    memory::format::x}, cpu_engine}, dummy));
+
+    bwd_x_mem_ = user_bwd_x_mem_;
+    gy_mem_ = user_gy_mem_;
+    bool reorder_p = data_format_ != memory::format::nchw;
+    if (reorder_p) {
+        bwd_x_mem_.reset(new memory({{{data_tz}, memory_data_type<T>(),
+                                      data_format_}, cpu_engine}));
+        reorder_bwd_x_ = reorder(*user_bwd_x_mem_, *bwd_x_mem_);
+        gy_mem_.reset(new memory({{{data_tz}, memory_data_type<T>(),
+                                   data_format_}, cpu_engine}));
+        reorder_gy_ = reorder(*user_gy_mem_, *gy_mem_);
+    }
+
+    /* diff desc is given in data_format_, gx comes out in it too */
+    gx_mem_ = user_gx_mem_;
+    if (reorder_p) {
+        gx_mem_.reset(new memory({{{data_tz}, memory_data_type<T>(),
+                                   data_format_}, cpu_engine}));
+        reorder_gx_ = reorder(*gx_mem_, *user_gx_mem_);
+    }
+
+    bn_bwd_.reset(new batch_normalization_backward(*bwd_pd_, *bwd_x_mem_,
+                    *bwd_mean_mem_, *bwd_var_mem_, *gy_mem_, *bwd_w_mem_,
+                    *gx_mem_, *gw_mem_));
+
+    if (reorder_p) {
+        bwd_primitives_.push_back(reorder_bwd_x_);
+        bwd_primitives_.push_back(reorder_gy_);
+    }
+    bwd_primitives_.push_back(*bn_bwd_);
+    if (reorder_p) bwd_primitives_.push_back(reorder_gx_);
+}
+
+template<typename T>
+void BatchNormalization<T>::backward(T* x, int x_d1, int x_d2, int x_d3, int x_d4,
+        T* gy, T* gx, T* w, T* mean, T* var, T* gw)
+{
+    if (fwd_pd_ == NULL) {
+        // rebuilt after eviction, backward needs forward primitive desc
+        forward_setup(x_d1, x_d2, x_d3, x_d4);
+    }
+    if (bn_bwd_ == NULL) {
+        backward_setup(x_d1, x_d2, x_d3, x_d4);
+    }
+
+    user_bwd_x_mem_->set_data_handle(x);
+    user_gy_mem_->set_data_handle(gy);
+    user_gx_mem_->set_data_handle(gx);
+    bwd_w_mem_->set_data_handle(w);
+    bwd_mean_mem_->set_data_handle(mean);
+    bwd_var_mem_->set_data_handle(var);
+    gw_mem_->set_data_handle(gw);
+
+    if (bwd_first_run_) {
+        bwd_stream_->submit(bwd_primitives_).wait();
+        bwd_first_run_ = false;
+    } else {
+        bwd_stream_->rerun().wait();
+    }
+}
+
+template<typename T>
+BatchNormalization<T>* BatchNormalization<T>::get_forward_object(
+        int x_d1, int x_d2, int x_d3, int x_d4,
+        double eps, bool global_stats, int x_format)
+{
+    auto bn = dynamic_cast<BatchNormalization<T>*>(
+        LayerFactory<T>::get_instance().get_batch_norm_layer(
+            x_d1, x_d2, x_d3, x_d4, eps, global_stats, x_format));
+    if (bn == NULL) {
+        bn = new BatchNormalization<T>(eps, global_stats);
+        bn->x_format_ = x_format;
+        LayerFactory<T>::get_instance().set_batch_norm_layer(
+            x_d1, x_d2, x_d3, x_d4, eps, global_stats, bn, x_format);
+    }
+    return bn;
+}
+
+template class BatchNormalization<float>;
+
+
+// vim: et ts=4 sw=4 cindent cino^=l0,\:0,N-s
@@ -0,0 +1,215 @@
+/*
+ *COPYRIGHT
+ *All modification made by Intel Corporation: © 2017 Intel Corporation.
+ *Copyright (c) 2015 Preferred Infrastructure, Inc.
+ *Copyright (c) 2015 Preferred Networks, Inc.
+ *
+ *Permission is hereby granted, free of charge, to any person obtaining a copy
+ *of this software and associated documentation files (the "Software"), to deal
+ *in the Software without restriction, including without limitation the rights
+ *to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ *copies of the Software, and to permit persons to whom the Software is
+ *furnished to do so, subject to the following conditions:
+ *
+ *The above copyright notice and this permission notice shall be included in
+ *all copies or substantial portions of the Software.
+ *
+ *THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ *AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ *OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ *THE SOFTWARE.
+ *
+ *
+ *######################################################################
+ *# The CuPy is designed based on NumPy's API.
+ *# CuPy's source code and documents contain the original NumPy ones.
+ *######################################################################
+ *Copyright (c) 2005-2016, NumPy Developers.
+ *All rights reserved.
+ *
+ *Redistribution and use in source and binary forms, with or without
+ *modification, are permitted provided that the following conditions are
+ *met:
+ *
+ *    * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *
+ *    * Redistributions in binary form must reproduce the above
+ *       copyright notice, this list of conditions and the following
+ *       disclaimer in the documentation and/or other materials provided
+ *       with the distribution.
+ *
+ *    * Neither the name of the NumPy Developers nor the names of any
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ *THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *"AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ *A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ *OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ *SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ *LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ *DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ *THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ *(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ *OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *######################################################################
+ */
+
+
+#ifndef _BATCH_NORMALIZATION_H_
+#define _BATCH_NORMALIZATION_H_
+
+#include <mkldnn.hpp>
+#include <vector>
+#include <memory>
+#include "layer.h"
+#include "layer_factory.h"
+#include "mdarray.h"
+
+template <typename T>
+class BatchNormalization : public Layer<T>
+{
+public:
+    BatchNormalization(double eps, bool global_stats);
+    ~BatchNormalization();
+
+    size_t get_memory_size();
+
+    /*
+     * Batch normalization forward with scale and shift
+     * Params:
+     * x: input, (n, c, h, w)
+     * y: output, (n, c, h, w)
+     * w: scale and shift, (2, c) flattened to 2 * c
+     * mean, var: per channel statistics, (c)
+     * global_stats: false for training, mean and var of the batch are
+     *     written out (var is biased). true for inference, the given
+     *     mean and var are used.
+     */
+    static void do_forward(
+        T* x,  int x_d1, int x_d2, int x_d3, int x_d4,
+        T* y,  int y_d1, int y_d2, int y_d3, int y_d4,
+        T* w,  int w_d1,
+        T* mean, int mean_d1,
+        T* var,  int var_d1,
+        double eps, bool global_stats)
+    {
+        BatchNormalization<T>* forward_object = get_forward_object(
+            x_d1, x_d2, x_d3, x_d4, eps, global_stats);
+        forward_object->forward(x, x_d1, x_d2, x_d3, x_d4,
+                                y, w, mean, var);
+        LayerFactory<T>::get_instance().put_layer(forward_object);
+    }
+
+    /*
+     * Batch normalization on an MdArray, the output keeps the input format
+     */
+    static MdArray<T>* do_forward_md(
+        MdArray<T>* x,
+        T* w,  int w_d1,
+        T* mean, int mean_d1,
+        T* var,  int var_d1,
+        double eps, bool global_stats)
+    {
+        T* x_data = (T*)x->get_data_handle();
+        int x_d1 = x->dim(0), x_d2 = x->dim(1), x_d3 = x->dim(2), x_d4 = x->dim(3);
+        BatchNormalization<T>* forward_object = get_forward_object(
+            x_d1, x_d2, x_d3, x_d4, eps, global_stats, x->format());
+        MdArray<T>* y = new MdArray<T>(x->get_primitive_desc());
+        forward_object->forward(x_data, x_d1, x_d2, x_d3, x_d4,
+                                (T*)y->get_data_handle(), w, mean, var);
+        LayerFactory<T>::get_instance().put_layer(forward_object);
+        return y;
+    }
+
+    /*
+     * Batch normalization backward, mean and var are the batch
+     * statistics written by the training forward
+     * gw: gradient of scale and shift, (2, c) flattened to 2 * c
+     */
+    static void do_backward(
+        T* x,  int x_d1,  int x_d2,  int x_d3,  int x_d4,
+        T* gy, int gy_d1, int gy_d2, int gy_d3, int gy_d4,
+        T* gx, int gx_d1, int gx_d2, int gx_d3, int gx_d4,
+        T* w,  int w_d1,
+        T* mean, int mean_d1,
+        T* var,  int var_d1,
+        T* gw, int gw_d1,
+        double eps)
+    {
+        BatchNormalization<T>* backward_object = get_forward_object(
+            x_d1, x_d2, x_d3, x_d4, eps, false);
+        backward_object->backward(x, x_d1, x_d2, x_d3, x_d4,
+                                  gy, gx, w, mean, var, gw);
+        LayerFactory<T>::get_instance().put_layer(backward_object);
+    }
+
+private:
+    static BatchNormalization<T>* get_forward_object(
+        int x_d1, int x_d2, int x_d3, int x_d4,
+        double eps, bool global_stats, int x_format = -1);
+
+    void forward_setup(int x_d1, int x_d2, int x_d3, int x_d4);
+    void forward(T* x, int x_d1, int x_d2, int x_d3, int x_d4,
+                 T* y, T* w, T* mean, T* var);
+    void backward_setup(int x_d1, int x_d2, int x_d3, int x_d4);
+    void backward(T* x, int x_d1, int x_d2, int x_d3, int x_d4,
+                  T* gy, T* gx, T* w, T* mean, T* var, T* gw);
+
+    double eps_;
+    // inference with the given mean and var
+    bool global_stats_;
+    // format of the MdArray input, -1 for numpy input and output
+    int x_format_ = -1;
+    // format used by the primitives
+    mkldnn::memory::format data_format_;
+
+    bool fwd_first_run_ = true;
+    bool bwd_first_run_ = true;
+
+    //forward
+    std::shared_ptr<mkldnn::memory> user_x_mem_;
+    std::shared_ptr<mkldnn::memory> user_y_mem_;
+    std::shared_ptr<mkldnn::memory> x_mem_;
+    std::shared_ptr<mkldnn::memory> y_mem_;
+    std::shared_ptr<mkldnn::memory> w_mem_;
+    std::shared_ptr<mkldnn::memory> mean_mem_;
+    std::shared_ptr<mkldnn::memory> var_mem_;
+    mkldnn::primitive reorder_x_;
+    mkldnn::primitive reorder_y_;
+
+    std::shared_ptr<mkldnn::batch_normalization_forward::primitive_desc> fwd_pd_;
+    std::shared_ptr<mkldnn::batch_normalization_forward> bn_fwd_;
+    std::shared_ptr<mkldnn::stream> fwd_stream_;
+    std::vector<mkldnn::primitive> fwd_primitives_;
+
+    //backward
+    std::shared_ptr<mkldnn::memory> user_bwd_x_mem_;
+    std::shared_ptr<mkldnn::memory> user_gy_mem_;
+    std::shared_ptr<mkldnn::memory> user_gx_mem_;
+    std::shared_ptr<mkldnn::memory> bwd_x_mem_;
+    std::shared_ptr<mkldnn::memory> gy_mem_;
+    std::shared_ptr<mkldnn::memory> gx_mem_;
+    std::shared_ptr<mkldnn::memory> bwd_w_mem_;
+    std::shared_ptr<mkldnn::memory> bwd_mean_mem_;
+    std::shared_ptr<mkldnn::memory> bwd_var_mem_;
+    std::shared_ptr<mkldnn::memory> gw_mem_;
+    mkldnn::primitive reorder_bwd_x_;
+    mkldnn::primitive reorder_gy_;
+    mkldnn::primitive reorder_gx_;
+
+    std::shared_ptr<mkldnn::batch_normalization_backward::primitive_desc> bwd_pd_;
+    std::shared_ptr<mkldnn::batch_normalization_backward> bn_bwd_;
+    std::shared_ptr<mkldnn::stream> bwd_stream_;
+    std::vector<mkldnn::primitive> bwd_primitives_;
+};
+
+#endif // _BATCH_NORMALIZATION_H_
+
+
+// vim: et ts=4 sw=4 cindent cino^=l0,\:0,N-s
@@ -61,9 +61,12 @@
  */
 
 
+#include <atomic>
 #include <cstddef>
+#include <cstdlib>
 #include <glog/logging.h>
 #include <iostream>
+#include <omp.h>
 #include "mkldnn.hpp"
 #include "common.h"
 #include "cpu_info.h"
@@ -72,15 +75,30 @@ using namespace mkldnn;
 
 engine cpu_engine(engine::cpu, 0);
 static bool s_enable_mkldnn = true;
+static std::atomic<bool> s_conv_bwd_concurrent(
+        getenv("MKLDNN_CONV_BWD_CONCURRENT") != NULL
+        && atoi(getenv("MKLDNN_CONV_BWD_CONCURRENT")) != 0);
 unsigned char dummy[PAGE_SIZE] __attribute__((aligned(PAGE_SIZE)));
 #define DUMMY_VAL 0xcc
 
+/*
+ * Concurrent convolution backward runs its two halves in nested parallel
+ * regions. The nesting level is process wide, so it is raised here once
+ * and never lowered, instead of around each call, where threads running
+ * backward without the GIL would race on it.
+ */
+static void enable_nested_parallelism()
+{
+    if (omp_get_max_active_levels() < 2)
+        omp_set_max_active_levels(2);
+}
+
 int global_init()
 {
     google::SetStderrLogging(1);
     google::InitGoogleLogging("mkldnnpy");
 
-    LOG(INFO) << "Global Init";
+    LOG(INFO) << "Global Init, CPU ISA " << cpu_isa_name();
 
     if (enabled()) {
     /*
@@ -91,6 +109,9 @@ int global_init()
         OpenMpManager::printVerboseInformation();
     }
 
+    if (conv_bwd_concurrent())
+        enable_nested_parallelism();
+
     for (int i=0; i<PAGE_SIZE; i++) {
         dummy[i]=DUMMY_VAL;
     }
@@ -123,4 +144,16 @@ void enable_google_logging()
    google::SetStderrLogging(0);
 }
 
+bool conv_bwd_concurrent()
+{
+    return s_conv_bwd_concurrent.load();
+}
+
+void set_conv_bwd_concurrent(bool concurrent)
+{
+    if (concurrent)
+        enable_nested_parallelism();
+    s_conv_bwd_concurrent = concurrent;
+}
+
 // vim: et ts=4 sw=4 cindent cino^=l0,\:0,N-s
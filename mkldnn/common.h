@@ -71,6 +71,23 @@ int global_init();
 bool enabled();
 void set_mkldnn_enable(bool is_enabled);
 void enable_google_logging();
+/*
+ * Run convolution backward weights and backward data at the same time,
+ * each on half of the OpenMP threads, instead of one after the other.
+ * Taken into account when backward primitives are created, call
+ * layer_cache_clear() after changing it. Default from env
+ * MKLDNN_CONV_BWD_CONCURRENT. Turning it on allows two levels of nested
+ * OpenMP parallelism for the whole process; where nesting is lowered
+ * again later, backward falls back to the serial order.
+ */
+bool conv_bwd_concurrent();
+void set_conv_bwd_concurrent(bool concurrent);
+/*
+ * Widest ISA the layouts are chosen for: avx512_core_vnni, avx512_core,
+ * avx512_mic, avx512_common, avx2 or sse42. Env MKLDNN_MAX_CPU_ISA set to
+ * one of these names limits it.
+ */
+const char* cpu_isa_name();
 extern unsigned char dummy[PAGE_SIZE];
 #endif // _COMMON_H_
 
@@ -124,7 +124,7 @@ void Concat<T>::forward_setup(int num_concats, Concat<T>::concat_data* concat_in
             != user_dst_mem_.get()->get_primitive_desc()) {
         LOG(INFO) << "concat fwd reorder dst memory";
         dst_mem_.reset(
-                new memory(fwd_concat_pd_.get()->dst_primitive_desc()));
+                new_local_memory(fwd_concat_pd_.get()->dst_primitive_desc()));
         concat_reorder_dst_ = reorder(*dst_mem_, *user_dst_mem_);
         fwd_reorder_concat_dst = true;
     }
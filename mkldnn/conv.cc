@@ -63,6 +63,7 @@
 
 #include <glog/logging.h>
 #include <iostream>
+#include <omp.h>
 #include "common.h"
 #include "mkldnn.hpp"
 #include "conv.h"
@@ -72,6 +73,17 @@ using namespace mkldnn;
 
 extern engine cpu_engine;
 
+LayerKey conv_geometry_key(std::initializer_list<memory::dims> dims)
+{
+    LayerKey key(LayerKey::KIND_CONV2D);
+    for (auto& d : dims) {
+        key.add((int)d.size());
+        for (auto v : d)
+            key.add(v);
+    }
+    return key;
+}
+
 template<typename T>
 Convolution2D<T>::Convolution2D()
 {
@@ -85,6 +97,20 @@ Convolution2D<T>::~Convolution2D()
 {
 }
 
+template<typename T>
+size_t Convolution2D<T>::get_memory_size()
+{
+    return this->memory_size(src_mem_, user_src_mem_)
+        + this->memory_size(weights_mem_, user_weights_mem_)
+        + this->memory_size(dst_mem_, user_dst_mem_)
+        + this->memory_size(bwd_src_mem_, user_bwd_src_mem_)
+        + this->memory_size(bwd_weights_mem_, user_bwd_weights_mem_)
+        + this->memory_size(bwd_diff_weights_mem_, user_bwd_diff_weights_mem_)
+        + this->memory_size(bwd_diff_src_mem_, user_bwd_diff_src_mem_)
+        + this->memory_size(bwd_diff_dst_weights_mem_, user_bwd_diff_dst_mem_)
+        + this->memory_size(bwd_diff_dst_data_mem_, user_bwd_diff_dst_mem_);
+}
+
 template<typename T>
 void Convolution2D<T>::forward_setup(T* x, int x_d1, int x_d2, int x_d3, int x_d4,
         T* W, int W_d1, int W_d2, int W_d3, int W_d4,
@@ -102,18 +128,27 @@ void Convolution2D<T>::forward_setup(T* x, int x_d1, int x_d2, int x_d3, int x_d
     //LOG(INFO) << "y =(" << y_d1 << "," << y_d2 << "," << y_d3 << "," << y_d4 << ")";
 
     src_tz_ = {x_d1, x_d2, x_d3, x_d4};
-    weights_tz_ = {W_d1, W_d2, W_d3, W_d4};
+    if (groups_ > 1) {
+        /* grouped weights, (g, out_c / g, in_c / g, kh, kw) */
+        weights_tz_ = {groups_, W_d1 / groups_, W_d2, W_d3, W_d4};
+        weights_format_ = memory::format::goihw;
+    } else {
+        weights_tz_ = {W_d1, W_d2, W_d3, W_d4};
+        weights_format_ = memory::format::oihw;
+    }
     dst_tz_ = {y_d1, y_d2, y_d3, y_d4};
     strides_ = {s1, s2};
     bias_tz_ = {b_d1};
     padding_l_ = {pl1, pl2};
     padding_r_ = {pr1, pr2};
 
-    /* create memory for user data */
+    /* create memory for user data, an MdArray input keeps its own format */
+    memory::format src_format = x_format_ < 0 ? memory::format::nchw
+                                              : (memory::format)x_format_;
     user_src_mem_.reset(new memory({{{src_tz_}, memory_data_type<T>(),
-                                      memory::format::nchw}, cpu_engine}, dummy));
+                                      src_format}, cpu_engine}, dummy));
     user_weights_mem_.reset(new memory({{{weights_tz_},
-                                          memory_data_type<T>(), memory::format::oihw}, cpu_engine}, dummy));
+                                          memory_data_type<T>(), weights_format_}, cpu_engine}, dummy));
     /* in current design, output is also allocated in python part */
     user_dst_mem_.reset(new memory({{{dst_tz_}, memory_data_type<T>(),
                                       memory::format::nchw}, cpu_engine}, dummy));
@@ -132,19 +167,25 @@ void Convolution2D<T>::forward_setup(T* x, int x_d1, int x_d2, int x_d3, int x_d
         bias_md_.reset(new memory::desc({bias_tz_}, memory_data_type<T>(),
                                    memory::format::any));
     /* create a convolution */
+    prop_kind aprop_kind = inference_ ? prop_kind::forward_inference
+                                      : prop_kind::forward;
     if (b != NULL) {
-        fwd_desc_.reset(new convolution_forward::desc(prop_kind::forward,
+        fwd_desc_.reset(new convolution_forward::desc(aprop_kind,
                                                  convolution_direct, *src_md_, *weights_md_, *bias_md_,
                                                  *dst_md_, strides_, padding_l_, padding_r_,
                                                  padding_kind::zero));
     } else {
-        fwd_desc_.reset(new convolution_forward::desc(prop_kind::forward,
+        fwd_desc_.reset(new convolution_forward::desc(aprop_kind,
                                                  convolution_direct, *src_md_, *weights_md_,
                                                  *dst_md_, strides_, padding_l_, padding_r_,
                                                  padding_kind::zero));
     }
 
-    fwd_pd_.reset(new convolution_forward::primitive_desc(*fwd_desc_, cpu_engine));
+    geometry_key_ = conv_geometry_key({src_tz_, weights_tz_, bias_tz_, dst_tz_,
+                                  strides_, padding_l_, padding_r_,
+                                  {inference_ ? 1 : 0}});
+    fwd_pd_ = PrimitiveDescCache<convolution_forward::primitive_desc>::get_instance().get(
+                geometry_key_, *fwd_desc_, cpu_engine);
 
     /* create reorders between user and data if it is needed and
      *  add it to net before convolution */
@@ -152,7 +193,7 @@ void Convolution2D<T>::forward_setup(T* x, int x_d1, int x_d2, int x_d3, int x_d
     if (memory::primitive_desc(fwd_pd_.get()->src_primitive_desc())
             != user_src_mem_.get()->get_primitive_desc()) {
         //LOG(INFO) << "fwd reorder src dim";
-        src_mem_.reset(new memory(fwd_pd_.get()->src_primitive_desc()));
+        src_mem_.reset(new_local_memory(fwd_pd_.get()->src_primitive_desc()));
         conv_reorder_src_ = reorder(*user_src_mem_,*src_mem_);
         fwd_reorder_conv_src_ = true;
     }
@@ -161,35 +202,66 @@ void Convolution2D<T>::forward_setup(T* x, int x_d1, int x_d2, int x_d3, int x_d
     if (memory::primitive_desc((*fwd_pd_).weights_primitive_desc())
             != (*user_weights_mem_).get_primitive_desc()) {
         //LOG(INFO) << "fwd reorder weight dim";
-        weights_mem_.reset(new memory(fwd_pd_.get()->weights_primitive_desc()));
+        weights_mem_.reset(new_local_memory(fwd_pd_.get()->weights_primitive_desc()));
         conv_reorder_weights_ = reorder(*user_weights_mem_, *weights_mem_);
         fwd_reorder_conv_weights_ = true;
     }
 
     dst_mem_ = user_dst_mem_;
-    if (memory::primitive_desc(fwd_pd_.get()->dst_primitive_desc())
+    if (x_format_ >= 0) {
+        /* MdArray output, keep the format chosen by convolution */
+        user_dst_mem_.reset(new memory(fwd_pd_.get()->dst_primitive_desc(), dummy));
+        dst_mem_ = user_dst_mem_;
+    } else if (memory::primitive_desc(fwd_pd_.get()->dst_primitive_desc())
             != user_dst_mem_.get()->get_primitive_desc()) {
         //LOG(INFO) << "fwd reorder output dim";
-        dst_mem_.reset(new memory(fwd_pd_.get()->dst_primitive_desc()));
+        dst_mem_.reset(new_local_memory(fwd_pd_.get()->dst_primitive_desc()));
         conv_reorder_dst_ = reorder(*dst_mem_, *user_dst_mem_);
         fwd_reorder_conv_dst_ = true;
     }
 
     /* create convolution primitive and add it to net */
-    if (b != NULL)
+    if (with_relu_) {
+        /*
+         * fused convolution + relu, built on the formats picked above so
+         * the reorders and the prepacked W still match
+         */
+        memory::desc src_d = src_mem_->get_primitive_desc().desc();
+        memory::desc weights_d = weights_mem_->get_primitive_desc().desc();
+        memory::desc dst_d = dst_mem_->get_primitive_desc().desc();
+        std::shared_ptr<convolution_forward::desc> conv_d;
+        if (b != NULL)
+            conv_d.reset(new convolution_forward::desc(aprop_kind,
+                            convolution_direct, src_d, weights_d, *bias_md_,
+                            dst_d, strides_, padding_l_, padding_r_,
+                            padding_kind::zero));
+        else
+            conv_d.reset(new convolution_forward::desc(aprop_kind,
+                            convolution_direct, src_d, weights_d,
+                            dst_d, strides_, padding_l_, padding_r_,
+                            padding_kind::zero));
+        fwd_relu_pd_.reset(new convolution_relu_forward::primitive_desc(
+                            convolution_relu_forward::desc(*conv_d, 0.0),
+                            cpu_engine));
+        if (b != NULL)
+            conv_fwd_.reset(new convolution_relu_forward(*fwd_relu_pd_,
+                            *src_mem_, *weights_mem_, *user_bias_mem_, *dst_mem_));
+        else
+            conv_fwd_.reset(new convolution_relu_forward(*fwd_relu_pd_,
+                            *src_mem_, *weights_mem_, *dst_mem_));
+    } else if (b != NULL) {
         conv_fwd_.reset(new convolution_forward(*fwd_pd_, *src_mem_,
                                       *weights_mem_, *user_bias_mem_, *dst_mem_));
-    else
+    } else {
         conv_fwd_.reset(new convolution_forward(*fwd_pd_, *src_mem_,
                                       *weights_mem_, *dst_mem_));
+    }
 
     //put all primitives into fwd_stream_
     if (fwd_reorder_conv_src_){
         fwd_primitives_.push_back(conv_reorder_src_);
     }
-    if (fwd_reorder_conv_weights_){
-        fwd_primitives_.push_back(conv_reorder_weights_);
-    }
+    /* conv_reorder_weights_ runs on its own, see prepack_weights */
     fwd_primitives_.push_back(*conv_fwd_);
     if (fwd_reorder_conv_dst_){
         fwd_primitives_.push_back(conv_reorder_dst_);
@@ -204,7 +276,8 @@ int Convolution2D<T>::forward(T* x, int x_d1, int x_d2, int x_d3, int x_d4,
         T* y, int y_d1, int y_d2, int y_d3, int y_d4,
         int s1, int s2,
         int pl1, int pl2,
-        int pr1, int pr2)
+        int pr1, int pr2,
+        long W_version)
 {
 //    LOG(INFO) << "Convolution forward";
     if (conv_fwd_ == NULL) {
@@ -225,6 +298,9 @@ int Convolution2D<T>::forward(T* x, int x_d1, int x_d2, int x_d3, int x_d4,
         user_bias_mem_->set_data_handle(b);
     }
     user_dst_mem_->set_data_handle(y);
+    if (fwd_reorder_conv_weights_) {
+        this->prepack_weights(conv_reorder_weights_, W, W_version);
+    }
     if (fwd_first_run_) {
         fwd_stream_->submit(fwd_primitives_).wait();
         fwd_first_run_ = false;
@@ -241,7 +317,8 @@ int Convolution2D<T>::forward(T* x, int x_d1, int x_d2, int x_d3, int x_d4,
         T* y, int y_d1, int y_d2, int y_d3, int y_d4,
         int s1, int s2,
         int pl1, int pl2,
-        int pr1, int pr2)
+        int pr1, int pr2,
+        long W_version)
 {
 //    LOG(INFO) << "Convolution forward without bias";
 //    LOG(INFO) << conv_fwd_;
@@ -252,7 +329,8 @@ int Convolution2D<T>::forward(T* x, int x_d1, int x_d2, int x_d3, int x_d4,
             y, y_d1, y_d2, y_d3, y_d4,
             s1, s2,
             pl1, pl2,
-            pr1, pr2);
+            pr1, pr2,
+            W_version);
     return 0;
 }
 
@@ -270,11 +348,11 @@ void Convolution2D<T>::backward_setup( T* x, int x_d1, int x_d2, int x_d3, int x
     user_bwd_src_mem_.reset(new memory({{{ src_tz_ }, memory_data_type<T>(),
                 memory::format::nchw }, cpu_engine }, dummy)); //x
     user_bwd_weights_mem_.reset(new memory({{{ weights_tz_ }, memory_data_type<T>(),
-                memory::format::oihw }, cpu_engine }, dummy)); //W
+                weights_format_ }, cpu_engine }, dummy)); //W
     user_bwd_diff_dst_mem_.reset(new memory({{{ dst_tz_ }, memory_data_type<T>(),
                 memory::format::nchw }, cpu_engine }, dummy)); //gy
     user_bwd_diff_weights_mem_.reset(new memory({{{ weights_tz_ }, memory_data_type<T>(),
-                memory::format::oihw }, cpu_engine }, dummy)); //gW
+                weights_format_ }, cpu_engine }, dummy)); //gW
     user_bwd_diff_src_mem_.reset(new memory({{{ src_tz_ }, memory_data_type<T>(),
                 memory::format::nchw }, cpu_engine }, dummy)); //gx
     if ( b != NULL ) {
@@ -320,11 +398,28 @@ void Convolution2D<T>::backward_setup( T* x, int x_d1, int x_d2, int x_d3, int x
                 convolution_direct, *src_md_, *weights_md_,
                 *dst_md_, strides_, padding_l_, padding_r_, padding_kind::zero));
 
+    /*
+     * concurrent backward splits the threads between weights and data,
+     * kernels size their work on the thread count seen at creation, so
+     * both primitive descs and primitives are created under that split
+     */
+    int nthr = omp_get_max_threads();
+    bwd_concurrent_ = conv_bwd_concurrent() && nthr > 1;
+    bwd_weights_nthr_ = bwd_concurrent_ ? (nthr + 1) / 2 : nthr;
+    bwd_data_nthr_ = bwd_concurrent_ ? nthr - bwd_weights_nthr_ : nthr;
+    LayerKey weights_key = geometry_key_;
+    weights_key.add(bwd_weights_nthr_);
+    LayerKey data_key = geometry_key_;
+    data_key.add(bwd_data_nthr_);
+
     /* create backward conv prim desc*/
-    bwd_weights_pd_.reset(new convolution_backward_weights::primitive_desc(
-                *bwd_weights_desc_, cpu_engine, *fwd_pd_));
-    bwd_data_pd_.reset(new convolution_backward_data::primitive_desc(
-                *bwd_data_desc_, cpu_engine, *fwd_pd_));
+    omp_set_num_threads(bwd_weights_nthr_);
+    bwd_weights_pd_ = PrimitiveDescCache<convolution_backward_weights::primitive_desc>::get_instance().get(
+                weights_key, *bwd_weights_desc_, cpu_engine, *fwd_pd_);
+    omp_set_num_threads(bwd_data_nthr_);
+    bwd_data_pd_ = PrimitiveDescCache<convolution_backward_data::primitive_desc>::get_instance().get(
+                data_key, *bwd_data_desc_, cpu_engine, *fwd_pd_);
+    omp_set_num_threads(nthr);
 
     /*
      * for best performance convolution backward might choose different memory format for src and diffsrc
@@ -336,7 +431,7 @@ void Convolution2D<T>::backward_setup( T* x, int x_d1, int x_d2, int x_d3, int x
     if (memory::primitive_desc(bwd_weights_pd_.get()->src_primitive_desc())
             != user_bwd_src_mem_.get()->get_primitive_desc()) {
       //  LOG(INFO) << "bwd reorder x";
-        bwd_src_mem_.reset(new memory(bwd_weights_pd_.get()->src_primitive_desc()));
+        bwd_src_mem_.reset(new_local_memory(bwd_weights_pd_.get()->src_primitive_desc()));
         conv_bwd_reorder_src_ = reorder(*user_bwd_src_mem_, *bwd_src_mem_);
         bwd_reorder_src_ = true;
     }
@@ -346,7 +441,7 @@ void Convolution2D<T>::backward_setup( T* x, int x_d1, int x_d2, int x_d3, int x
     if (memory::primitive_desc(bwd_weights_pd_.get()->diff_dst_primitive_desc())
             != user_bwd_diff_dst_mem_.get()->get_primitive_desc()) {
       //  LOG(INFO) << "bwd reorder gy";
-        bwd_diff_dst_weights_mem_.reset(new memory(bwd_weights_pd_.get()->diff_dst_primitive_desc()));
+        bwd_diff_dst_weights_mem_.reset(new_local_memory(bwd_weights_pd_.get()->diff_dst_primitive_desc()));
         conv_bwd_reorder_dst_weights_ = reorder(*user_bwd_diff_dst_mem_, *bwd_diff_dst_weights_mem_);
         bwd_reorder_diff_dst_weights_ = true;
     }
@@ -356,7 +451,7 @@ void Convolution2D<T>::backward_setup( T* x, int x_d1, int x_d2, int x_d3, int x
     if (memory::primitive_desc(bwd_weights_pd_.get()->diff_weights_primitive_desc())
             != user_bwd_diff_weights_mem_.get()->get_primitive_desc()) {
        // LOG(INFO) << "bwd reorder gW";
-        bwd_diff_weights_mem_.reset(new memory(bwd_weights_pd_.get()->diff_weights_primitive_desc()));
+        bwd_diff_weights_mem_.reset(new_local_memory(bwd_weights_pd_.get()->diff_weights_primitive_desc()));
         conv_bwd_reorder_diff_weights_ = reorder(*bwd_diff_weights_mem_, *user_bwd_diff_weights_mem_);
         bwd_reorder_diff_weights_ = true;
     }
@@ -366,7 +461,7 @@ void Convolution2D<T>::backward_setup( T* x, int x_d1, int x_d2, int x_d3, int x
     if (memory::primitive_desc(bwd_data_pd_.get()->weights_primitive_desc())
             != user_bwd_weights_mem_.get()->get_primitive_desc()) {
         // LOG(INFO) << "bwd reorder W";
-        bwd_weights_mem_.reset(new memory(bwd_data_pd_.get()->weights_primitive_desc()));
+        bwd_weights_mem_.reset(new_local_memory(bwd_data_pd_.get()->weights_primitive_desc()));
         conv_bwd_reorder_weights_ = reorder(*user_bwd_weights_mem_, *bwd_weights_mem_);
         bwd_reorder_weights_ = true;
     }
@@ -376,7 +471,7 @@ void Convolution2D<T>::backward_setup( T* x, int x_d1, int x_d2, int x_d3, int x
     if (memory::primitive_desc(bwd_data_pd_.get()->diff_dst_primitive_desc())
             != user_bwd_diff_dst_mem_.get()->get_primitive_desc()) {
       //  LOG(INFO) << "bwd reorder gy";
-        bwd_diff_dst_data_mem_.reset(new memory(bwd_data_pd_.get()->diff_dst_primitive_desc()));
+        bwd_diff_dst_data_mem_.reset(new_local_memory(bwd_data_pd_.get()->diff_dst_primitive_desc()));
         conv_bwd_reorder_dst_data_ = reorder(*user_bwd_diff_dst_mem_, *bwd_diff_dst_data_mem_);
         bwd_reorder_diff_dst_data_ = true;
     }
@@ -386,12 +481,13 @@ void Convolution2D<T>::backward_setup( T* x, int x_d1, int x_d2, int x_d3, int x
     if (memory::primitive_desc(bwd_data_pd_.get()->diff_src_primitive_desc())
             != user_bwd_diff_src_mem_.get()->get_primitive_desc()) {
         // LOG(INFO) << "bwd reorder gX";
-        bwd_diff_src_mem_.reset(new memory(bwd_data_pd_.get()->diff_src_primitive_desc()));
+        bwd_diff_src_mem_.reset(new_local_memory(bwd_data_pd_.get()->diff_src_primitive_desc()));
         conv_bwd_reorder_diff_src_ = reorder(*bwd_diff_src_mem_, *user_bwd_diff_src_mem_);
         bwd_reorder_diff_src_ = true;
     }
 
     /* create weight conv bwd prim */
+    omp_set_num_threads(bwd_weights_nthr_);
     if (b != NULL) {
         /*
          * create convolution backward primitive (gW = gy * X)
@@ -418,8 +514,10 @@ void Convolution2D<T>::backward_setup( T* x, int x_d1, int x_d2, int x_d3, int x
     /*
      * create data conv bwd prim (gX = gy * W)
      * */
+    omp_set_num_threads(bwd_data_nthr_);
     conv_bwd_data_.reset(new convolution_backward_data(
                 *bwd_data_pd_, *bwd_diff_dst_data_mem_, *bwd_weights_mem_, *bwd_diff_src_mem_));
+    omp_set_num_threads(nthr);
 
     /*
      * create weight conv bwd stream (gW = gy * X)
@@ -490,7 +588,33 @@ int Convolution2D<T>::backward( T* x, int x_d1, int x_d2, int x_d3, int x_d4,
         user_bwd_diff_bias_mem_->set_data_handle(gb); //gb
     }
 
-    if (bwd_first_run_) {
+    /*
+     * nesting is enabled along with concurrent backward (see
+     * set_conv_bwd_concurrent), it is only read here
+     */
+    if (bwd_concurrent_ && !first_layer && omp_get_max_active_levels() >= 2) {
+        /* gW = gy * x and gX = gy * W are independent, run them side by side */
+        #pragma omp parallel sections num_threads(2)
+        {
+            #pragma omp section
+            {
+                omp_set_num_threads(bwd_weights_nthr_);
+                if (bwd_first_run_)
+                    bwd_weights_stream_->submit(bwd_weights_primitives_).wait();
+                else
+                    bwd_weights_stream_->rerun().wait();
+            }
+            #pragma omp section
+            {
+                omp_set_num_threads(bwd_data_nthr_);
+                if (bwd_first_run_)
+                    bwd_data_stream_->submit(bwd_data_primitives_).wait();
+                else
+                    bwd_data_stream_->rerun().wait();
+            }
+        }
+        bwd_first_run_ = false;
+    } else if (bwd_first_run_) {
         bwd_weights_stream_->submit(bwd_weights_primitives_).wait();
     if (!first_layer)//first layer will no need to do backward data
            bwd_data_stream_->submit(bwd_data_primitives_).wait();
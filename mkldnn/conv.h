@@ -69,6 +69,12 @@
 #include <memory>
 #include "layer.h"
 #include "layer_factory.h"
+#include "mdarray.h"
+
+#ifndef SWIG
+// Key of the convolution geometry, primitive descs are shared on it
+LayerKey conv_geometry_key(std::initializer_list<mkldnn::memory::dims> dims);
+#endif
 
 template <typename T>
 class Convolution2D : public Layer<T>
@@ -82,7 +88,11 @@ static Convolution2D<T>* get_forward_object(
                     int ksize_h, int ksize_w,
                     int stride_y, int stride_x,
                     int pad_l_h, int pad_l_w,
-                    int pad_r_h, int pad_r_w)
+                    int pad_r_h, int pad_r_w,
+                    int x_format = -1,
+                    bool inference = false,
+                    bool with_relu = false,
+                    int groups = 1)
 {
     Convolution2D<T>* conv2d_forward = NULL;
     conv2d_forward = dynamic_cast<Convolution2D<T>*> (
@@ -93,10 +103,15 @@ static Convolution2D<T>* get_forward_object(
                             ksize_h, ksize_w,
                             stride_y, stride_x,
                             pad_l_h, pad_l_w,
-                            pad_r_h, pad_r_w));
+                            pad_r_h, pad_r_w,
+                            x_format, (long)W, inference, with_relu, groups));
 
     if (conv2d_forward == NULL) {
         conv2d_forward = new Convolution2D();
+        conv2d_forward->x_format_ = x_format;
+        conv2d_forward->inference_ = inference;
+        conv2d_forward->with_relu_ = with_relu;
+        conv2d_forward->groups_ = groups;
         LayerFactory<T>::get_instance().set_conv2d_layer(
                             x_d1, x_d2, x_d3, x_d4,
                             W_d1, W_d2, W_d3, W_d4,
@@ -105,7 +120,8 @@ static Convolution2D<T>* get_forward_object(
                             stride_y, stride_x,
                             pad_l_h, pad_l_w,
                             pad_r_h, pad_r_w,
-                            conv2d_forward);
+                            conv2d_forward,
+                            x_format, (long)W, inference, with_relu, groups);
     }
 
     return conv2d_forward;
@@ -115,10 +131,12 @@ static Convolution2D<T>* get_backward_object(
                     T* x,  int x_d1, int x_d2, int x_d3, int x_d4,
                     T* W,  int W_d1, int W_d2, int W_d3, int W_d4,
                     T* b,  int b_d1,
+                    T* gy, int gy_d1, int gy_d2, int gy_d3, int gy_d4,
                     int ksize_h, int ksize_w,
                     int stride_y, int stride_x,
                     int pad_l_h, int pad_l_w,
-                    int pad_r_h, int pad_r_w)
+                    int pad_r_h, int pad_r_w,
+                    int groups = 1)
 {
     Convolution2D<T>* conv2d_backward;
     conv2d_backward = dynamic_cast<Convolution2D<T>*>(
@@ -129,9 +147,31 @@ static Convolution2D<T>* get_backward_object(
                          ksize_h, ksize_w,
                          stride_y, stride_x,
                          pad_l_h, pad_l_w,
-                         pad_r_h, pad_r_w));
-
-    assert(conv2d_backward != NULL); // we must have already done forward before
+                         pad_r_h, pad_r_w,
+                         -1, (long)W, false, false, groups));
+
+    if (conv2d_backward == NULL) {
+        // no idle forward object in the cache (evicted or in use),
+        // rebuild it since backward primitives are created from forward ones
+        conv2d_backward = get_forward_object(
+                            x, x_d1, x_d2, x_d3, x_d4,
+                            W, W_d1, W_d2, W_d3, W_d4,
+                            b, b_d1,
+                            gy, gy_d1, gy_d2, gy_d3, gy_d4,
+                            ksize_h, ksize_w,
+                            stride_y, stride_x,
+                            pad_l_h, pad_l_w,
+                            pad_r_h, pad_r_w,
+                            -1, false, false, groups);
+        conv2d_backward->forward_setup(
+                            x, x_d1, x_d2, x_d3, x_d4,
+                            W, W_d1, W_d2, W_d3, W_d4,
+                            b, b_d1,
+                            gy, gy_d1, gy_d2, gy_d3, gy_d4,
+                            stride_y, stride_x,
+                            pad_l_h, pad_l_w,
+                            pad_r_h, pad_r_w);
+    }
 
     return conv2d_backward;
 
@@ -146,7 +186,11 @@ static void do_forward(
                     int ksize_h, int ksize_w,
                     int stride_y, int stride_x,
                     int pad_l_h, int pad_l_w,
-                    int pad_r_h, int pad_r_w)
+                    int pad_r_h, int pad_r_w,
+                    long W_version = -1,
+                    bool inference = false,
+                    bool with_relu = false,
+                    int groups = 1)
 {
     Convolution2D<T> *fwd_object = get_forward_object(
                                         x, x_d1, x_d2, x_d3, x_d4,
@@ -156,7 +200,8 @@ static void do_forward(
                                         ksize_h, ksize_w,
                                         stride_y, stride_x,
                                         pad_l_h, pad_l_w,
-                                        pad_r_h, pad_r_w);
+                                        pad_r_h, pad_r_w,
+                                        -1, inference, with_relu, groups);
     fwd_object->forward(
                     x, x_d1, x_d2, x_d3, x_d4,
                     W, W_d1, W_d2, W_d3, W_d4,
@@ -164,7 +209,9 @@ static void do_forward(
                     y, y_d1, y_d2, y_d3, y_d4,
                     stride_y, stride_x,
                     pad_l_h, pad_l_w,
-                    pad_r_h, pad_r_w);
+                    pad_r_h, pad_r_w,
+                    W_version);
+    LayerFactory<T>::get_instance().put_layer(fwd_object);
 }
 
 static void do_forward(
@@ -174,7 +221,11 @@ static void do_forward(
                     int ksize_h, int ksize_w,
                     int stride_y, int stride_x,
                     int pad_l_h, int pad_l_w,
-                    int pad_r_h, int pad_r_w)
+                    int pad_r_h, int pad_r_w,
+                    long W_version = -1,
+                    bool inference = false,
+                    bool with_relu = false,
+                    int groups = 1)
 {
     do_forward(
             x, x_d1, x_d2, x_d3, x_d4,
@@ -184,7 +235,88 @@ static void do_forward(
             ksize_h, ksize_w,
             stride_y, stride_x,
             pad_l_h, pad_l_w,
-            pad_r_h, pad_r_w);
+            pad_r_h, pad_r_w,
+            W_version, inference, with_relu, groups);
+}
+
+/*
+ * Convolution forward on an MdArray
+ * The output is a new MdArray in the format chosen by convolution, so
+ * the next layer can consume it without a reorder to nchw.
+ */
+static MdArray<T>* do_forward_md(
+                    MdArray<T>* x,
+                    T* W, int W_d1, int W_d2, int W_d3, int W_d4,
+                    T* b, int b_d1,
+                    int y_d1, int y_d2, int y_d3, int y_d4,
+                    int ksize_h, int ksize_w,
+                    int stride_y, int stride_x,
+                    int pad_l_h, int pad_l_w,
+                    int pad_r_h, int pad_r_w,
+                    long W_version = -1,
+                    bool inference = false,
+                    bool with_relu = false,
+                    int groups = 1)
+{
+    T* x_data = (T*)x->get_data_handle();
+    int x_d1 = x->dim(0), x_d2 = x->dim(1), x_d3 = x->dim(2), x_d4 = x->dim(3);
+    Convolution2D<T> *fwd_object = get_forward_object(
+                                        x_data, x_d1, x_d2, x_d3, x_d4,
+                                        W, W_d1, W_d2, W_d3, W_d4,
+                                        b, b_d1,
+                                        NULL, y_d1, y_d2, y_d3, y_d4,
+                                        ksize_h, ksize_w,
+                                        stride_y, stride_x,
+                                        pad_l_h, pad_l_w,
+                                        pad_r_h, pad_r_w,
+                                        x->format(), inference, with_relu, groups);
+    if (fwd_object->conv_fwd_ == NULL) {
+        fwd_object->forward_setup(
+                    x_data, x_d1, x_d2, x_d3, x_d4,
+                    W, W_d1, W_d2, W_d3, W_d4,
+                    b, b_d1,
+                    NULL, y_d1, y_d2, y_d3, y_d4,
+                    stride_y, stride_x,
+                    pad_l_h, pad_l_w,
+                    pad_r_h, pad_r_w);
+    }
+    MdArray<T>* y = new MdArray<T>(fwd_object->dst_mem_->get_primitive_desc());
+    fwd_object->forward(
+                    x_data, x_d1, x_d2, x_d3, x_d4,
+                    W, W_d1, W_d2, W_d3, W_d4,
+                    b, b_d1,
+                    (T*)y->get_data_handle(), y_d1, y_d2, y_d3, y_d4,
+                    stride_y, stride_x,
+                    pad_l_h, pad_l_w,
+                    pad_r_h, pad_r_w,
+                    W_version);
+    LayerFactory<T>::get_instance().put_layer(fwd_object);
+    return y;
+}
+
+static MdArray<T>* do_forward_md(
+                    MdArray<T>* x,
+                    T* W, int W_d1, int W_d2, int W_d3, int W_d4,
+                    int y_d1, int y_d2, int y_d3, int y_d4,
+                    int ksize_h, int ksize_w,
+                    int stride_y, int stride_x,
+                    int pad_l_h, int pad_l_w,
+                    int pad_r_h, int pad_r_w,
+                    long W_version = -1,
+                    bool inference = false,
+                    bool with_relu = false,
+                    int groups = 1)
+{
+    return do_forward_md(
+            x,
+            W, W_d1, W_d2, W_d3, W_d4,
+            NULL, -1,
+            y_d1, y_d2, y_d3, y_d4,
+            ksize_h, ksize_w,
+            stride_y, stride_x,
+            pad_l_h, pad_l_w,
+            pad_r_h, pad_r_w,
+            W_version, inference, with_relu, groups);
 }
 
 static void do_backward(
@@ -199,16 +331,19 @@ static void do_backward(
                     int stride_y, int stride_x,
                     int pad_l_h, int pad_l_w,
                     int pad_r_h, int pad_r_w,
-                    bool first_layer)
+                    bool first_layer,
+                    int groups = 1)
 {
     Convolution2D<T> *bwd_object = get_backward_object(
                                     x, x_d1, x_d2, x_d3, x_d4,
                                     W, W_d1, W_d2, W_d3, W_d4,
                                     b, b_d1,
+                                    gy, gy_d1, gy_d2, gy_d3, gy_d4,
                                     ksize_h, ksize_w,
                                     stride_y, stride_x,
                                     pad_l_h, pad_l_w,
-                                    pad_r_h, pad_r_w);
+                                    pad_r_h, pad_r_w,
+                                    groups);
     bwd_object->backward(
                     x, x_d1, x_d2, x_d3, x_d4,
                     W, W_d1, W_d2, W_d3, W_d4,
@@ -218,6 +353,7 @@ static void do_backward(
                     gx, gx_d1, gx_d2, gx_d3, gx_d4,
                     gb, gb_d1,
                     first_layer);
+    LayerFactory<T>::get_instance().put_layer(bwd_object);
 }
 
 static void do_backward(
@@ -230,7 +366,8 @@ static void do_backward(
                     int stride_y, int stride_x,
                     int pad_l_h, int pad_l_w,
                     int pad_r_h, int pad_r_w,
-                    bool first_layer)
+                    bool first_layer,
+                    int groups = 1)
 {
     do_backward(
             x, x_d1, x_d2, x_d3, x_d4,
@@ -244,13 +381,15 @@ static void do_backward(
             stride_y, stride_x,
             pad_l_h, pad_l_w,
             pad_r_h, pad_r_w,
-            first_layer);
+            first_layer, groups);
 }
 
 public:
     Convolution2D();
     ~Convolution2D();
 
+    size_t get_memory_size();
+
     /*
      * Convolution forward primitive setup
      * Params:
@@ -281,7 +420,8 @@ public:
             T* y, int y_d1, int y_d2, int y_d3, int y_d4,
             int s1, int s2,
             int pl1, int pl2,
-            int pr1, int pr2);
+            int pr1, int pr2,
+            long W_version = -1);
 
     /*
      * Convolution forward without bias
@@ -295,7 +435,8 @@ public:
             T* y, int y_d1, int y_d2, int y_d3, int y_d4,
             int s1, int s2,
             int pl1, int pl2,
-            int pr1, int pr2);
+            int pr1, int pr2,
+            long W_version = -1);
 
     /*
      * Covolution backward primitive setup
@@ -357,10 +498,29 @@ private:
     bool fwd_first_run_ = true;
     bool bwd_first_run_ = true;
 
+    // backward weights and data run concurrently on split thread teams
+    bool bwd_concurrent_ = false;
+    int bwd_weights_nthr_ = 1;
+    int bwd_data_nthr_ = 1;
+
+    // format of the MdArray input, -1 for numpy input and output
+    int x_format_ = -1;
+    // forward_inference variant, can not be used for backward
+    bool inference_ = false;
+    // ReLU fused into the forward primitive, y = max(conv(x), 0)
+    bool with_relu_ = false;
+    // W is (out_c, in_c / groups, kh, kw), goihw for groups > 1
+    int groups_ = 1;
+    mkldnn::memory::format weights_format_ = mkldnn::memory::format::oihw;
+
     //desc & prmitive desc
     //forward
     std::shared_ptr<mkldnn::convolution_forward::desc> fwd_desc_;
     std::shared_ptr<mkldnn::convolution_forward::primitive_desc> fwd_pd_;
+    std::shared_ptr<mkldnn::convolution_relu_forward::primitive_desc> fwd_relu_pd_;
+#ifndef SWIG
+    LayerKey geometry_key_;
+#endif
     //backward
     std::shared_ptr<mkldnn::convolution_backward_weights::desc> bwd_weights_desc_;
     std::shared_ptr<mkldnn::convolution_backward_weights::primitive_desc> bwd_weights_pd_;
@@ -62,10 +62,14 @@
 
 
 #include <glog/logging.h>
+#include <dirent.h>
 
+#include <algorithm>
 #include <fstream>
 #include <set>
+#include <sstream>
 #include <string>
+#include <utility>
 #include <vector>
 
 #include "cpu_info.h"
@@ -77,6 +81,7 @@ Processor::Processor() {
   coreId = 0;
   cpuCores = 0;
   speedMHz = 0;
+  nodeId = 0;
 }
 
 CpuInfo::CpuInfo() {
@@ -144,11 +149,14 @@ const char *CpuInfo::getNextLine() {
 Collection::Collection(CpuInfoInterface *cpuInfo) : cpuInfo(*cpuInfo) {
   totalNumberOfSockets = 0;
   totalNumberOfCpuCores = 0;
+  totalNumberOfNodes = 0;
   currentProcessor = NULL;
 
   processors.reserve(96);
 
   parseCpuInfo();
+  readSysfsTopology();
+  readSysfsNodes();
   collectBasicCpuInformation();
 }
 
@@ -168,10 +176,23 @@ unsigned Collection::getNumberOfProcessors() {
   return processors.size();
 }
 
+unsigned Collection::getTotalNumberOfNodes() {
+  return totalNumberOfNodes;
+}
+
 const Processor &Collection::getProcessor(unsigned processorId) {
   return processors[processorId];
 }
 
+const Processor *Collection::findProcessor(unsigned cpu) const {
+  for (size_t i = 0; i < processors.size(); i++) {
+    if (processors[i].processor == cpu) {
+      return &processors[i];
+    }
+  }
+  return NULL;
+}
+
 void Collection::parseCpuInfo() {
   const char *cpuInfoLine = cpuInfo.getFirstLine();
   for (; cpuInfoLine; cpuInfoLine = cpuInfo.getNextLine()) {
@@ -264,23 +285,96 @@ unsigned Collection::extractSpeedFromModelName(const char *text) const {
   }
 }
 
-void Collection::collectBasicCpuInformation() {
-  std::set<unsigned> uniquePhysicalId;
+static bool readSysfsValue(const std::string &fileName, unsigned *value) {
+  std::ifstream file(fileName.c_str());
+  return static_cast<bool>(file >> *value);
+}
+
+/* /proc/cpuinfo lacks "physical id" and "core id" on some kernels and
+   virtual machines, sysfs has them for every online cpu. */
+void Collection::readSysfsTopology() {
   std::vector<Processor>::iterator processor = processors.begin();
   for (; processor != processors.end(); processor++) {
-    uniquePhysicalId.insert(processor->physicalId);
-    updateCpuInformation(*processor, uniquePhysicalId.size());
+    std::ostringstream path;
+    path << "/sys/devices/system/cpu/cpu" << processor->processor
+         << "/topology/";
+    readSysfsValue(path.str() + "physical_package_id",
+                   &processor->physicalId);
+    readSysfsValue(path.str() + "core_id", &processor->coreId);
+  }
+}
+
+/* Parses a cpu list such as "0-13,28-41" */
+static std::vector<unsigned> parseCpuList(const std::string &list) {
+  std::vector<unsigned> cpus;
+  std::istringstream stream(list);
+  std::string range;
+  while (std::getline(stream, range, ',')) {
+    unsigned first, last;
+    int fields = sscanf(range.c_str(), "%u-%u", &first, &last);
+    if (fields < 1) {
+      continue;
+    }
+    if (fields == 1) {
+      last = first;
+    }
+    for (unsigned cpu = first; cpu <= last; cpu++) {
+      cpus.push_back(cpu);
+    }
   }
+  return cpus;
 }
 
-void Collection::updateCpuInformation(const Processor &processor,
-    unsigned numberOfUniquePhysicalId) {
-  if (totalNumberOfSockets == numberOfUniquePhysicalId) {
+/* Without /sys/devices/system/node every cpu is on node 0 */
+void Collection::readSysfsNodes() {
+  DIR *dir = opendir("/sys/devices/system/node");
+  if (!dir) {
     return;
   }
 
-  totalNumberOfSockets = numberOfUniquePhysicalId;
-  totalNumberOfCpuCores += processor.cpuCores;
+  struct dirent *entry;
+  while ((entry = readdir(dir)) != NULL) {
+    unsigned nodeId;
+    char tail;
+    if (sscanf(entry->d_name, "node%u%c", &nodeId, &tail) != 1) {
+      continue;
+    }
+
+    std::ostringstream path;
+    path << "/sys/devices/system/node/" << entry->d_name << "/cpulist";
+    std::ifstream file(path.str().c_str());
+    std::string list;
+    std::getline(file, list);
+
+    std::vector<unsigned> cpus = parseCpuList(list);
+    std::vector<Processor>::iterator processor = processors.begin();
+    for (; processor != processors.end(); processor++) {
+      if (std::find(cpus.begin(), cpus.end(), processor->processor)
+          != cpus.end()) {
+        processor->nodeId = nodeId;
+      }
+    }
+  }
+  closedir(dir);
+}
+
+/* Sockets, cores and nodes are counted from the ids of the processors,
+   a core is a (physical id, core id) pair. */
+void Collection::collectBasicCpuInformation() {
+  std::set<unsigned> uniquePhysicalId;
+  std::set<std::pair<unsigned, unsigned> > uniqueCore;
+  std::set<unsigned> uniqueNodeId;
+  std::vector<Processor>::iterator processor = processors.begin();
+  for (; processor != processors.end(); processor++) {
+    uniquePhysicalId.insert(processor->physicalId);
+    uniqueCore.insert(std::make_pair(processor->physicalId,
+                                     processor->coreId));
+    uniqueNodeId.insert(processor->nodeId);
+  }
+
+  totalNumberOfSockets = uniquePhysicalId.size();
+  totalNumberOfCpuCores = uniqueCore.size();
+  totalNumberOfNodes = uniqueNodeId.size();
 }
 
 /* The OpenMpManager class is responsible for determining a set of all of
@@ -289,7 +383,11 @@ void Collection::updateCpuInformation(const Processor &processor,
    remaining cores are dedicated for OpenMP threads. Each OpenMP thread owns
    one core for exclusive use. The number of OpenMP threads is then limited
    to the number of available cores minus one. The amount of CPU cores may
-   be limited by system eg. when numactl was used. */
+   be limited by system eg. when numactl was used.
+
+   Cores are ordered NUMA node by node, so consecutive OpenMP threads, which
+   get consecutive chunks of the data with a static schedule, share a node.
+   MKLDNN_NUMA_NODE=<node> keeps the team on the cores of one node. */
 
 #include <omp.h>
 #include <sched.h>
@@ -311,8 +409,10 @@ static const unsigned numberOfOpenMpEnvVars =
 
 OpenMpManager::OpenMpManager(Collection *collection) :
                              mainThreadId(boost::this_thread::get_id()),
-                             collection(*collection) {
+                             collection(*collection),
+                             isGpuEnabled(false) {
   getOpenMpEnvVars();
+  getSelectedNode();
   getCurrentCpuSet();
   getCurrentCoreSet();
 }
@@ -373,6 +473,11 @@ void OpenMpManager::getOpenMpEnvVars() {
   }
 }
 
+void OpenMpManager::getSelectedNode() {
+  const char *value = getenv("MKLDNN_NUMA_NODE");
+  selectedNodeId = value ? atoi(value) : -1;
+}
+
 void OpenMpManager::getCurrentCpuSet() {
   if (sched_getaffinity(0, sizeof(currentCpuSet), &currentCpuSet)) {
     getDefaultCpuSet(&currentCpuSet);
@@ -383,57 +488,81 @@ void OpenMpManager::getDefaultCpuSet(cpu_set_t *defaultCpuSet) {
   CPU_ZERO(defaultCpuSet);
   unsigned numberOfProcessors = collection.getNumberOfProcessors();
   for (unsigned processorId = 0; processorId < numberOfProcessors; processorId++) {
-    CPU_SET(processorId, defaultCpuSet);
+    CPU_SET(collection.getProcessor(processorId).processor, defaultCpuSet);
   }
 }
 
+bool OpenMpManager::isSameCore(unsigned cpu, unsigned otherCpu) {
+  const Processor *processor = collection.findProcessor(cpu);
+  const Processor *other = collection.findProcessor(otherCpu);
+  return processor && other &&
+         processor->physicalId == other->physicalId &&
+         processor->coreId == other->coreId;
+}
+
 /* Function getCurrentCoreSet() fills currentCoreSet variable with a set of
    available CPUs, where only one CPU per core is chosen. When multiple CPUs
    of single core are used, function is selecting only first one of all
-   available. */
+   available. coreOrder lists the chosen CPUs node by node. */
 
 void OpenMpManager::getCurrentCoreSet() {
   unsigned numberOfProcessors = collection.getNumberOfProcessors();
-  unsigned totalNumberOfCpuCores = collection.getTotalNumberOfCpuCores();
 
-  cpu_set_t usedCoreSet;
-  CPU_ZERO(&usedCoreSet);
+  // (node, cpu) of the first available cpu of every core
+  std::vector<std::pair<unsigned, unsigned> > cores;
   CPU_ZERO(&currentCoreSet);
 
   for (unsigned processorId = 0; processorId < numberOfProcessors; processorId++) {
-    if (CPU_ISSET(processorId, &currentCpuSet)) {
-      unsigned coreId = processorId % totalNumberOfCpuCores;
-      if (!CPU_ISSET(coreId, &usedCoreSet)) {
-        CPU_SET(coreId, &usedCoreSet);
-        CPU_SET(processorId, &currentCoreSet);
+    const Processor &processor = collection.getProcessor(processorId);
+    if (!CPU_ISSET(processor.processor, &currentCpuSet)) {
+      continue;
+    }
+    if (selectedNodeId >= 0 && processor.nodeId != (unsigned)selectedNodeId) {
+      continue;
+    }
+
+    bool isCoreUsed = false;
+    for (size_t i = 0; i < cores.size(); i++) {
+      if (isSameCore(cores[i].second, processor.processor)) {
+        isCoreUsed = true;
+        break;
       }
     }
+    if (!isCoreUsed) {
+      cores.push_back(std::make_pair(processor.nodeId, processor.processor));
+      CPU_SET(processor.processor, &currentCoreSet);
+    }
+  }
+
+  if (cores.empty() && selectedNodeId >= 0) {
+    LOG(WARNING) << "MKLDNN_NUMA_NODE=" << selectedNodeId
+                 << " has no available cpu, using all nodes";
+    selectedNodeId = -1;
+    getCurrentCoreSet();
+    return;
+  }
+
+  std::sort(cores.begin(), cores.end());
+  coreOrder.clear();
+  for (size_t i = 0; i < cores.size(); i++) {
+    coreOrder.push_back(cores[i].second);
   }
 }
 
 void OpenMpManager::selectAllCoreCpus(cpu_set_t *set, unsigned physicalCoreId) {
   unsigned numberOfProcessors = collection.getNumberOfProcessors();
-  unsigned totalNumberOfCpuCores = collection.getTotalNumberOfCpuCores();
 
-  unsigned processorId = physicalCoreId % totalNumberOfCpuCores;
-  while (processorId < numberOfProcessors) {
-    if (CPU_ISSET(processorId, &currentCpuSet)) {
-      CPU_SET(processorId, set);
+  for (unsigned processorId = 0; processorId < numberOfProcessors; processorId++) {
+    unsigned cpu = collection.getProcessor(processorId).processor;
+    if (CPU_ISSET(cpu, &currentCpuSet) && isSameCore(cpu, physicalCoreId)) {
+      CPU_SET(cpu, set);
     }
-
-    processorId += totalNumberOfCpuCores;
   }
 }
 
 unsigned OpenMpManager::getPhysicalCoreId(unsigned logicalCoreId) {
-  unsigned numberOfProcessors = collection.getNumberOfProcessors();
-
-  for (unsigned processorId = 0; processorId < numberOfProcessors; processorId++) {
-    if (CPU_ISSET(processorId, &currentCoreSet)) {
-      if (!logicalCoreId--) {
-        return processorId;
-      }
-    }
+  if (logicalCoreId < coreOrder.size()) {
+    return coreOrder[logicalCoreId];
   }
 
   LOG(FATAL) << "This should never happen!";
@@ -446,7 +575,7 @@ bool OpenMpManager::isThreadsBindAllowed() {
 
 // Limit of threads to number of logical cores available
 void OpenMpManager::setOpenMpThreadNumberLimit() {
-  omp_set_num_threads(CPU_COUNT(&currentCoreSet));
+  omp_set_num_threads(coreOrder.size());
 }
 
 void OpenMpManager::bindCurrentThreadToLogicalCoreCpu(unsigned logicalCoreId) {
@@ -491,8 +620,41 @@ void OpenMpManager::printVerboseInformation() {
   LOG(INFO) << "OpenMP thread bind allowed: "
     << (openMpManager.isThreadsBindAllowed() ? "yes" : "no");
 
+  LOG(INFO) << "Total number of NUMA nodes: "
+    << openMpManager.collection.getTotalNumberOfNodes();
+
+  if (openMpManager.selectedNodeId >= 0) {
+    LOG(INFO) << "NUMA node selected: " << openMpManager.selectedNodeId;
+  }
+
   LOG(INFO) << "Number of OpenMP threads: "
     << omp_get_max_threads();
+
+  if (!openMpManager.isThreadsBindAllowed()) {
+    return;
+  }
+
+  // one line per node: the threads it runs and the cpus they are bound to
+  const std::vector<unsigned> &coreOrder = openMpManager.coreOrder;
+  for (size_t first = 0; first < coreOrder.size(); ) {
+    const Processor *processor =
+      openMpManager.collection.findProcessor(coreOrder[first]);
+    unsigned nodeId = processor ? processor->nodeId : 0;
+    size_t last = first;
+    std::ostringstream cpus;
+    cpus << coreOrder[first];
+    while (last + 1 < coreOrder.size()) {
+      const Processor *next =
+        openMpManager.collection.findProcessor(coreOrder[last + 1]);
+      if ((next ? next->nodeId : 0) != nodeId) {
+        break;
+      }
+      cpus << "," << coreOrder[++last];
+    }
+    LOG(INFO) << "NUMA node " << nodeId << ": OpenMP threads " << first
+      << "-" << last << " bound to cpus " << cpus.str();
+    first = last + 1;
+  }
 }
 
 unsigned OpenMpManager::getProcessorSpeedMHz() {
@@ -500,5 +662,10 @@ unsigned OpenMpManager::getProcessorSpeedMHz() {
   return openMpManager.collection.getProcessorSpeedMHz();
 }
 
+unsigned OpenMpManager::getNumberOfNodes() {
+  OpenMpManager &openMpManager = get_instance();
+  return openMpManager.collection.getTotalNumberOfNodes();
+}
+
 
 // vim: et ts=4 sw=4 cindent cino^=l0,\:0,N-s
@@ -80,6 +80,7 @@ struct Processor {
   unsigned coreId;
   unsigned cpuCores;
   unsigned speedMHz;
+  unsigned nodeId;
 
   Processor();
 };
@@ -118,6 +119,7 @@ class CollectionInterface {
   virtual unsigned getTotalNumberOfSockets() = 0;
   virtual unsigned getTotalNumberOfCpuCores() = 0;
   virtual unsigned getNumberOfProcessors() = 0;
+  virtual unsigned getTotalNumberOfNodes() = 0;
   virtual const Processor &getProcessor(unsigned processorId) = 0;
 };
 
@@ -129,12 +131,16 @@ class Collection : public CollectionInterface {
   virtual unsigned getTotalNumberOfSockets();
   virtual unsigned getTotalNumberOfCpuCores();
   virtual unsigned getNumberOfProcessors();
+  virtual unsigned getTotalNumberOfNodes();
   virtual const Processor &getProcessor(unsigned processorId);
+  // Processor with the given OS cpu number, NULL if there is none
+  const Processor *findProcessor(unsigned cpu) const;
 
  private:
   CpuInfoInterface &cpuInfo;
   unsigned totalNumberOfSockets;
   unsigned totalNumberOfCpuCores;
+  unsigned totalNumberOfNodes;
   std::vector<Processor> processors;
   Processor *currentProcessor;
 
@@ -149,9 +155,9 @@ class Collection : public CollectionInterface {
   unsigned parseInteger(const char *text) const;
   unsigned extractSpeedFromModelName(const char *text) const;
 
+  void readSysfsTopology();
+  void readSysfsNodes();
   void collectBasicCpuInformation();
-  void updateCpuInformation(const Processor &processor,
-    unsigned numberOfUniquePhysicalId);
 };
 
 class OpenMpManager {
@@ -166,6 +172,7 @@ class OpenMpManager {
 
   static bool isMajorThread(boost::thread::id currentThread);
   static unsigned getProcessorSpeedMHz();
+  static unsigned getNumberOfNodes();
 
  private:
   boost::thread::id mainThreadId;
@@ -173,8 +180,11 @@ class OpenMpManager {
 
   bool isGpuEnabled;
   bool isAnyOpenMpEnvVarSpecified;
+  int selectedNodeId;
   cpu_set_t currentCpuSet;
   cpu_set_t currentCoreSet;
+  // one cpu per core, node by node, OpenMP thread i is bound to the i-th
+  std::vector<unsigned> coreOrder;
 
   explicit OpenMpManager(Collection *collection);
   OpenMpManager(const OpenMpManager &openMpManager);
@@ -182,6 +192,7 @@ class OpenMpManager {
   static OpenMpManager &get_instance();
 
   void getOpenMpEnvVars();
+  void getSelectedNode();
   void getCurrentCpuSet();
   void getDefaultCpuSet(cpu_set_t *defaultCpuSet);
   void getCurrentCoreSet();
@@ -189,6 +200,7 @@ class OpenMpManager {
   void selectAllCoreCpus(cpu_set_t *set, unsigned physicalCoreId);
   unsigned getPhysicalCoreId(unsigned logicalCoreId);
 
+  bool isSameCore(unsigned cpu, unsigned otherCpu);
   bool isThreadsBindAllowed();
   void setOpenMpThreadNumberLimit();
   void bindCurrentThreadToLogicalCoreCpu(unsigned logicalCoreId);
@@ -0,0 +1,380 @@
+/*
+ *COPYRIGHT
+ *All modification made by Intel Corporation: © 2017 Intel Corporation.
+ *Copyright (c) 2015 Preferred Infrastructure, Inc.
+ *Copyright (c) 2015 Preferred Networks, Inc.
+ *
+ *Permission is hereby granted, free of charge, to any person obtaining a copy
+ *of this software and associated documentation files (the "Software"), to deal
+ *in the Software without restriction, including without limitation the rights
+ *to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ *copies of the Software, and to permit persons to whom the Software is
+ *furnished to do so, subject to the following conditions:
+ *
+ *The above copyright notice and this permission notice shall be included in
+ *all copies or substantial portions of the Software.
+ *
+ *THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ *AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ *OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ *THE SOFTWARE.
+ *
+ *
+ *######################################################################
+ *# The CuPy is designed based on NumPy's API.
+ *# CuPy's source code and documents contain the original NumPy ones.
+ *######################################################################
+ *Copyright (c) 2005-2016, NumPy Developers.
+ *All rights reserved.
+ *
+ *Redistribution and use in source and binary forms, with or without
+ *modification, are permitted provided that the following conditions are
+ *met:
+ *
+ *    * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *
+ *    * Redistributions in binary form must reproduce the above
+ *       copyright notice, this list of conditions and the following
+ *       disclaimer in the documentation and/or other materials provided
+ *       with the distribution.
+ *
+ *    * Neither the name of the NumPy Developers nor the names of any
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ *THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *"AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ *A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ *OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ *SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ *LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ *DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ *THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ *(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ *OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *######################################################################
+ */
+
+
+
+#include <glog/logging.h>
+#include <iostream>
+#include <omp.h>
+#include "common.h"
+#include "mkldnn.hpp"
+#include "conv.h"
+#include "deconv.h"
+#include "utils.h"
+
+using namespace mkldnn;
+
+extern engine cpu_engine;
+
+// Memory in the layout of pd, returns true if it differs from the user
+// memory and a reorder is needed
+static bool layout_memory(const memory::primitive_desc& pd,
+                          const std::shared_ptr<memory>& user_mem,
+                          std::shared_ptr<memory>& mem)
+{
+    if (memory::primitive_desc(pd) == user_mem->get_primitive_desc()) {
+        mem = user_mem;
+        return false;
+    }
+    mem.reset(new_local_memory(pd));
+    return true;
+}
+
+template<typename T>
+Deconvolution2D<T>* Deconvolution2D<T>::get_object(
+        int x_d1, int x_d2, int x_d3, int x_d4,
+        int W_d1, int W_d2, int W_d3, int W_d4, T* W,
+        int b_d1, int y_d3, int y_d4,
+        int stride_y, int stride_x,
+        int pad_l_h, int pad_l_w,
+        int pad_r_h, int pad_r_w)
+{
+    Deconvolution2D<T>* deconv = dynamic_cast<Deconvolution2D<T>*>(
+        LayerFactory<T>::get_instance().get_deconv2d_layer(
+            x_d1, x_d2, x_d3, x_d4, W_d1, W_d2, W_d3, W_d4, b_d1,
+            y_d3, y_d4, stride_y, stride_x,
+            pad_l_h, pad_l_w, pad_r_h, pad_r_w, (long)W));
+
+    if (deconv == NULL) {
+        deconv = new Deconvolution2D<T>();
+        deconv->x_tz_ = {x_d1, x_d2, x_d3, x_d4};
+        deconv->weights_tz_ = {W_d1, W_d2, W_d3, W_d4};
+        deconv->y_tz_ = {x_d1, W_d2, y_d3, y_d4};
+        deconv->strides_ = {stride_y, stride_x};
+        deconv->padding_l_ = {pad_l_h, pad_l_w};
+        deconv->padding_r_ = {pad_r_h, pad_r_w};
+        LayerFactory<T>::get_instance().set_deconv2d_layer(
+            x_d1, x_d2, x_d3, x_d4, W_d1, W_d2, W_d3, W_d4, b_d1,
+            y_d3, y_d4, stride_y, stride_x,
+            pad_l_h, pad_l_w, pad_r_h, pad_r_w, deconv, (long)W);
+    }
+    return deconv;
+}
+
+template<typename T>
+Deconvolution2D<T>::Deconvolution2D()
+{
+    fwd_stream_.reset(new stream(stream::kind::eager));
+    bwd_data_stream_.reset(new stream(stream::kind::eager));
+    bwd_weights_stream_.reset(new stream(stream::kind::eager));
+}
+
+template<typename T>
+Deconvolution2D<T>::~Deconvolution2D()
+{
+}
+
+template<typename T>
+size_t Deconvolution2D<T>::get_memory_size()
+{
+    return this->memory_size(x_mem_, user_x_mem_)
+        + this->memory_size(weights_mem_, user_weights_mem_)
+        + this->memory_size(y_mem_, user_y_mem_)
+        + this->memory_size(bwd_x_mem_, user_bwd_x_mem_)
+        + this->memory_size(bwd_weights_mem_, user_bwd_weights_mem_)
+        + this->memory_size(gy_data_mem_, user_gy_mem_)
+        + this->memory_size(gy_weights_mem_, user_gy_mem_)
+        + this->memory_size(gW_mem_, user_gW_mem_)
+        + this->memory_size(gx_mem_, user_gx_mem_);
+}
+
+/*
+ * Forward convolution from y to x, the hint of both backward primitive
+ * descs. Keyed as Convolution2D without bias keys it, so a convolution
+ * of the same geometry shares the primitive descs.
+ */
+template<typename T>
+void Deconvolution2D<T>::conv_setup()
+{
+    memory::desc y_md({y_tz_}, memory_data_type<T>(), memory::format::any);
+    memory::desc weights_md({weights_tz_}, memory_data_type<T>(),
+                            memory::format::any);
+    memory::desc x_md({x_tz_}, memory_data_type<T>(), memory::format::any);
+
+    convolution_forward::desc fwd_desc(prop_kind::forward, convolution_direct,
+                                       y_md, weights_md, x_md,
+                                       strides_, padding_l_, padding_r_,
+                                       padding_kind::zero);
+    geometry_key_ = conv_geometry_key({y_tz_, weights_tz_, {-1}, x_tz_,
+                                       strides_, padding_l_, padding_r_,
+                                       {0}});
+    conv_fwd_pd_ = PrimitiveDescCache<convolution_forward::primitive_desc>::get_instance().get(
+                geometry_key_, fwd_desc, cpu_engine);
+}
+
+template<typename T>
+void Deconvolution2D<T>::forward_setup()
+{
+    LOG(INFO) << "Deconvolution forward_setup";
+    if (conv_fwd_pd_ == NULL)
+        conv_setup();
+
+    memory::desc y_md({y_tz_}, memory_data_type<T>(), memory::format::any);
+    memory::desc weights_md({weights_tz_}, memory_data_type<T>(),
+                            memory::format::any);
+    memory::desc x_md({x_tz_}, memory_data_type<T>(), memory::format::any);
+    convolution_backward_data::desc bwd_data_desc(convolution_direct,
+                                                  y_md, weights_md, x_md,
+                                                  strides_, padding_l_, padding_r_,
+                                                  padding_kind::zero);
+    LayerKey data_key = geometry_key_;
+    data_key.add(omp_get_max_threads());
+    conv_bwd_data_pd_ = PrimitiveDescCache<convolution_backward_data::primitive_desc>::get_instance().get(
+                data_key, bwd_data_desc, cpu_engine, *conv_fwd_pd_);
+
+    user_x_mem_.reset(new memory({{{x_tz_}, memory_data_type<T>(),
+                                   memory::format::nchw}, cpu_engine}, dummy));
+    user_weights_mem_.reset(new memory({{{weights_tz_}, memory_data_type<T>(),
+                                         memory::format::oihw}, cpu_engine}, dummy));
+    user_y_mem_.reset(new memory({{{y_tz_}, memory_data_type<T>(),
+                                   memory::format::nchw}, cpu_engine}, dummy));
+
+    /* x is the diff_dst and y the diff_src of the convolution */
+    if (layout_memory(conv_bwd_data_pd_->diff_dst_primitive_desc(),
+                      user_x_mem_, x_mem_))
+        fwd_primitives_.push_back(reorder(*user_x_mem_, *x_mem_));
+    if (layout_memory(conv_bwd_data_pd_->weights_primitive_desc(),
+                      user_weights_mem_, weights_mem_)) {
+        /* runs on its own, see prepack_weights */
+        reorder_weights_ = reorder(*user_weights_mem_, *weights_mem_);
+        fwd_reorder_weights_ = true;
+    }
+    bool reorder_y = layout_memory(conv_bwd_data_pd_->diff_src_primitive_desc(),
+                                   user_y_mem_, y_mem_);
+
+    deconv_fwd_.reset(new convolution_backward_data(*conv_bwd_data_pd_,
+                                                    *x_mem_, *weights_mem_, *y_mem_));
+    fwd_primitives_.push_back(*deconv_fwd_);
+    if (reorder_y)
+        fwd_primitives_.push_back(reorder(*y_mem_, *user_y_mem_));
+}
+
+template<typename T>
+void Deconvolution2D<T>::forward(T* x, T* W, T* b, T* y, long W_version)
+{
+    if (deconv_fwd_ == NULL)
+        forward_setup();
+
+    user_x_mem_->set_data_handle(x);
+    user_weights_mem_->set_data_handle(W);
+    user_y_mem_->set_data_handle(y);
+    if (fwd_reorder_weights_)
+        this->prepack_weights(reorder_weights_, W, W_version);
+    if (fwd_first_run_) {
+        fwd_stream_->submit(fwd_primitives_).wait();
+        fwd_first_run_ = false;
+    } else {
+        fwd_stream_->rerun().wait();
+    }
+
+    if (b != NULL)
+        add_bias(y, b);
+}
+
+template<typename T>
+void Deconvolution2D<T>::backward_setup()
+{
+    LOG(INFO) << "Deconvolution backward_setup";
+    if (conv_fwd_pd_ == NULL)
+        conv_setup();
+
+    memory::desc y_md({y_tz_}, memory_data_type<T>(), memory::format::any);
+    memory::desc weights_md({weights_tz_}, memory_data_type<T>(),
+                            memory::format::any);
+    memory::desc x_md({x_tz_}, memory_data_type<T>(), memory::format::any);
+    convolution_backward_weights::desc bwd_weights_desc(convolution_direct,
+                                                        y_md, weights_md, x_md,
+                                                        strides_, padding_l_, padding_r_,
+                                                        padding_kind::zero);
+    LayerKey weights_key = geometry_key_;
+    weights_key.add(omp_get_max_threads());
+    conv_bwd_weights_pd_ = PrimitiveDescCache<convolution_backward_weights::primitive_desc>::get_instance().get(
+                weights_key, bwd_weights_desc, cpu_engine, *conv_fwd_pd_);
+
+    user_bwd_x_mem_.reset(new memory({{{x_tz_}, memory_data_type<T>(),
+                                       memory::format::nchw}, cpu_engine}, dummy));
+    user_bwd_weights_mem_.reset(new memory({{{weights_tz_}, memory_data_type<T>(),
+                                             memory::format::oihw}, cpu_engine}, dummy));
+    user_gy_mem_.reset(new memory({{{y_tz_}, memory_data_type<T>(),
+                                    memory::format::nchw}, cpu_engine}, dummy));
+    user_gW_mem_.reset(new memory({{{weights_tz_}, memory_data_type<T>(),
+                                    memory::format::oihw}, cpu_engine}, dummy));
+    user_gx_mem_.reset(new memory({{{x_tz_}, memory_data_type<T>(),
+                                    memory::format::nchw}, cpu_engine}, dummy));
+
+    /*
+     * gW = conv_backward_weights(gy, x)
+     * src: gy, diff_dst: x, diff_weights: gW
+     */
+    if (layout_memory(conv_bwd_weights_pd_->src_primitive_desc(),
+                      user_gy_mem_, gy_weights_mem_))
+        bwd_weights_primitives_.push_back(reorder(*user_gy_mem_, *gy_weights_mem_));
+    if (layout_memory(conv_bwd_weights_pd_->diff_dst_primitive_desc(),
+                      user_bwd_x_mem_, bwd_x_mem_))
+        bwd_weights_primitives_.push_back(reorder(*user_bwd_x_mem_, *bwd_x_mem_));
+    bool reorder_gW = layout_memory(conv_bwd_weights_pd_->diff_weights_primitive_desc(),
+                                    user_gW_mem_, gW_mem_);
+    deconv_bwd_weights_.reset(new convolution_backward_weights(*conv_bwd_weights_pd_,
+                                    *gy_weights_mem_, *bwd_x_mem_, *gW_mem_));
+    bwd_weights_primitives_.push_back(*deconv_bwd_weights_);
+    if (reorder_gW)
+        bwd_weights_primitives_.push_back(reorder(*gW_mem_, *user_gW_mem_));
+
+    /*
+     * gx = conv_forward(gy, W)
+     * src: gy, weights: W, dst: gx
+     */
+    if (layout_memory(conv_fwd_pd_->src_primitive_desc(),
+                      user_gy_mem_, gy_data_mem_))
+        bwd_data_primitives_.push_back(reorder(*user_gy_mem_, *gy_data_mem_));
+    if (layout_memory(conv_fwd_pd_->weights_primitive_desc(),
+                      user_bwd_weights_mem_, bwd_weights_mem_))
+        bwd_data_primitives_.push_back(reorder(*user_bwd_weights_mem_, *bwd_weights_mem_));
+    bool reorder_gx = layout_memory(conv_fwd_pd_->dst_primitive_desc(),
+                                    user_gx_mem_, gx_mem_);
+    deconv_bwd_data_.reset(new convolution_forward(*conv_fwd_pd_,
+                                    *gy_data_mem_, *bwd_weights_mem_, *gx_mem_));
+    bwd_data_primitives_.push_back(*deconv_bwd_data_);
+    if (reorder_gx)
+        bwd_data_primitives_.push_back(reorder(*gx_mem_, *user_gx_mem_));
+}
+
+template<typename T>
+void Deconvolution2D<T>::backward(T* x, T* W, T* gy, T* gW, T* gx, T* gb,
+                                  bool first_layer)
+{
+    if (deconv_bwd_weights_ == NULL)
+        backward_setup();
+
+    user_bwd_x_mem_->set_data_handle(x);
+    user_bwd_weights_mem_->set_data_handle(W);
+    user_gy_mem_->set_data_handle(gy);
+    user_gW_mem_->set_data_handle(gW);
+    user_gx_mem_->set_data_handle(gx);
+
+    if (bwd_weights_first_run_) {
+        bwd_weights_stream_->submit(bwd_weights_primitives_).wait();
+        bwd_weights_first_run_ = false;
+    } else {
+        bwd_weights_stream_->rerun().wait();
+    }
+    /* first layer will no need to do backward data */
+    if (!first_layer) {
+        if (bwd_data_first_run_) {
+            bwd_data_stream_->submit(bwd_data_primitives_).wait();
+            bwd_data_first_run_ = false;
+        } else {
+            bwd_data_stream_->rerun().wait();
+        }
+    }
+
+    if (gb != NULL)
+        bias_grad(gy, gb);
+}
+
+template<typename T>
+void Deconvolution2D<T>::add_bias(T* y, const T* b)
+{
+    int n = y_tz_[0], c = y_tz_[1];
+    size_t hw = (size_t)y_tz_[2] * y_tz_[3];
+    #pragma omp parallel for collapse(2)
+    for (int i = 0; i < n; i++) {
+        for (int j = 0; j < c; j++) {
+            T* p = y + ((size_t)i * c + j) * hw;
+            T bj = b[j];
+            for (size_t k = 0; k < hw; k++)
+                p[k] += bj;
+        }
+    }
+}
+
+template<typename T>
+void Deconvolution2D<T>::bias_grad(const T* gy, T* gb)
+{
+    int n = y_tz_[0], c = y_tz_[1];
+    size_t hw = (size_t)y_tz_[2] * y_tz_[3];
+    #pragma omp parallel for
+    for (int j = 0; j < c; j++) {
+        T s = 0;
+        for (int i = 0; i < n; i++) {
+            const T* p = gy + ((size_t)i * c + j) * hw;
+            for (size_t k = 0; k < hw; k++)
+                s += p[k];
+        }
+        gb[j] = s;
+    }
+}
+
+template class Deconvolution2D<float>;
+
+
+// vim: et ts=4 sw=4 cindent cino^=l0,\:0,N-s
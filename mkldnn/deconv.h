@@ -0,0 +1,257 @@
+/*
+ *COPYRIGHT
+ *All modification made by Intel Corporation: © 2017 Intel Corporation.
+ *Copyright (c) 2015 Preferred Infrastructure, Inc.
+ *Copyright (c) 2015 Preferred Networks, Inc.
+ *
+ *Permission is hereby granted, free of charge, to any person obtaining a copy
+ *of this software and associated documentation files (the "Software"), to deal
+ *in the Software without restriction, including without limitation the rights
+ *to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ *copies of the Software, and to permit persons to whom the Software is
+ *furnished to do so, subject to the following conditions:
+ *
+ *The above copyright notice and this permission notice shall be included in
+ *all copies or substantial portions of the Software.
+ *
+ *THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ *AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ *OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ *THE SOFTWARE.
+ *
+ *
+ *######################################################################
+ *# The CuPy is designed based on NumPy's API.
+ *# CuPy's source code and documents contain the original NumPy ones.
+ *######################################################################
+ *Copyright (c) 2005-2016, NumPy Developers.
+ *All rights reserved.
+ *
+ *Redistribution and use in source and binary forms, with or without
+ *modification, are permitted provided that the following conditions are
+ *met:
+ *
+ *    * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *
+ *    * Redistributions in binary form must reproduce the above
+ *       copyright notice, this list of conditions and the following
+ *       disclaimer in the documentation and/or other materials provided
+ *       with the distribution.
+ *
+ *    * Neither the name of the NumPy Developers nor the names of any
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ *THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *"AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ *A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ *OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ *SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ *LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ *DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ *THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ *(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ *OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *######################################################################
+ */
+
+
+#ifndef _DECONVOLUTION_H_
+#define _DECONVOLUTION_H_
+
+#include <mkldnn.hpp>
+#include <vector>
+#include <memory>
+#include "layer.h"
+#include "layer_factory.h"
+
+/*
+ * Deconvolution is the data backward of the convolution from y to x:
+ *   y  = conv_backward_data(x, W)
+ *   gx = conv_forward(gy, W)
+ *   gW = conv_backward_weights(gy, x)
+ * The convolution primitive descs are shared with Convolution2D through
+ * the geometry key, bias and its gradient are done in place on y and gy.
+ */
+template <typename T>
+class Deconvolution2D : public Layer<T>
+{
+public:
+    Deconvolution2D();
+    ~Deconvolution2D();
+
+    size_t get_memory_size();
+
+    /*
+     * Deconvolution forward
+     * Params:
+     * x: input, (n, in_c, h, w)
+     * W: weight, (in_c, out_c, kh, kw)
+     * b: bias, (out_c)
+     * y: output, (n, out_c, out_h, out_w)
+     * pad_r_h, pad_r_w: bottom/right padding of the convolution from y
+     *     to x, out_h and out_w may not be reached by stride exactly
+     */
+    static void do_forward(
+        T* x, int x_d1, int x_d2, int x_d3, int x_d4,
+        T* W, int W_d1, int W_d2, int W_d3, int W_d4,
+        T* b, int b_d1,
+        T* y, int y_d1, int y_d2, int y_d3, int y_d4,
+        int stride_y, int stride_x,
+        int pad_l_h, int pad_l_w,
+        int pad_r_h, int pad_r_w,
+        long W_version = -1)
+    {
+        Deconvolution2D<T>* forward_object = get_object(
+            x_d1, x_d2, x_d3, x_d4, W_d1, W_d2, W_d3, W_d4, W, b_d1,
+            y_d3, y_d4, stride_y, stride_x,
+            pad_l_h, pad_l_w, pad_r_h, pad_r_w);
+        forward_object->forward(x, W, b, y, W_version);
+        LayerFactory<T>::get_instance().put_layer(forward_object);
+    }
+
+    static void do_forward(
+        T* x, int x_d1, int x_d2, int x_d3, int x_d4,
+        T* W, int W_d1, int W_d2, int W_d3, int W_d4,
+        T* y, int y_d1, int y_d2, int y_d3, int y_d4,
+        int stride_y, int stride_x,
+        int pad_l_h, int pad_l_w,
+        int pad_r_h, int pad_r_w,
+        long W_version = -1)
+    {
+        do_forward(x, x_d1, x_d2, x_d3, x_d4,
+                   W, W_d1, W_d2, W_d3, W_d4,
+                   NULL, -1,
+                   y, y_d1, y_d2, y_d3, y_d4,
+                   stride_y, stride_x,
+                   pad_l_h, pad_l_w,
+                   pad_r_h, pad_r_w,
+                   W_version);
+    }
+
+    /*
+     * Deconvolution backward, gx is skipped for the first layer
+     */
+    static void do_backward(
+        T* x,  int x_d1,  int x_d2,  int x_d3,  int x_d4,
+        T* W,  int W_d1,  int W_d2,  int W_d3,  int W_d4,
+        T* gy, int gy_d1, int gy_d2, int gy_d3, int gy_d4,
+        T* gW, int gW_d1, int gW_d2, int gW_d3, int gW_d4,
+        T* gx, int gx_d1, int gx_d2, int gx_d3, int gx_d4,
+        T* gb, int gb_d1,
+        int stride_y, int stride_x,
+        int pad_l_h, int pad_l_w,
+        int pad_r_h, int pad_r_w,
+        bool first_layer)
+    {
+        Deconvolution2D<T>* backward_object = get_object(
+            x_d1, x_d2, x_d3, x_d4, W_d1, W_d2, W_d3, W_d4, W, gb_d1,
+            gy_d3, gy_d4, stride_y, stride_x,
+            pad_l_h, pad_l_w, pad_r_h, pad_r_w);
+        backward_object->backward(x, W, gy, gW, gx, gb, first_layer);
+        LayerFactory<T>::get_instance().put_layer(backward_object);
+    }
+
+    static void do_backward(
+        T* x,  int x_d1,  int x_d2,  int x_d3,  int x_d4,
+        T* W,  int W_d1,  int W_d2,  int W_d3,  int W_d4,
+        T* gy, int gy_d1, int gy_d2, int gy_d3, int gy_d4,
+        T* gW, int gW_d1, int gW_d2, int gW_d3, int gW_d4,
+        T* gx, int gx_d1, int gx_d2, int gx_d3, int gx_d4,
+        int stride_y, int stride_x,
+        int pad_l_h, int pad_l_w,
+        int pad_r_h, int pad_r_w,
+        bool first_layer)
+    {
+        do_backward(x, x_d1, x_d2, x_d3, x_d4,
+                    W, W_d1, W_d2, W_d3, W_d4,
+                    gy, gy_d1, gy_d2, gy_d3, gy_d4,
+                    gW, gW_d1, gW_d2, gW_d3, gW_d4,
+                    gx, gx_d1, gx_d2, gx_d3, gx_d4,
+                    NULL, -1,
+                    stride_y, stride_x,
+                    pad_l_h, pad_l_w,
+                    pad_r_h, pad_r_w,
+                    first_layer);
+    }
+
+private:
+    static Deconvolution2D<T>* get_object(
+        int x_d1, int x_d2, int x_d3, int x_d4,
+        int W_d1, int W_d2, int W_d3, int W_d4, T* W,
+        int b_d1, int y_d3, int y_d4,
+        int stride_y, int stride_x,
+        int pad_l_h, int pad_l_w,
+        int pad_r_h, int pad_r_w);
+
+    void conv_setup();
+    void forward_setup();
+    void forward(T* x, T* W, T* b, T* y, long W_version);
+    void backward_setup();
+    void backward(T* x, T* W, T* gy, T* gW, T* gx, T* gb, bool first_layer);
+
+    // y += b and gb = sum(gy) over n, h, w, both in nchw
+    void add_bias(T* y, const T* b);
+    void bias_grad(const T* gy, T* gb);
+
+    bool fwd_first_run_ = true;
+    bool bwd_weights_first_run_ = true;
+    bool bwd_data_first_run_ = true;
+    bool fwd_reorder_weights_ = false;
+
+    // x is the dst and y the src of the convolution
+    mkldnn::memory::dims x_tz_;
+    mkldnn::memory::dims weights_tz_;
+    mkldnn::memory::dims y_tz_;
+    mkldnn::memory::dims strides_;
+    mkldnn::memory::dims padding_l_;
+    mkldnn::memory::dims padding_r_;
+#ifndef SWIG
+    LayerKey geometry_key_;
+#endif
+
+    std::shared_ptr<mkldnn::convolution_forward::primitive_desc> conv_fwd_pd_;
+    std::shared_ptr<mkldnn::convolution_backward_data::primitive_desc> conv_bwd_data_pd_;
+    std::shared_ptr<mkldnn::convolution_backward_weights::primitive_desc> conv_bwd_weights_pd_;
+
+    //forward, y = conv_backward_data(x, W)
+    std::shared_ptr<mkldnn::memory> user_x_mem_;
+    std::shared_ptr<mkldnn::memory> user_weights_mem_;
+    std::shared_ptr<mkldnn::memory> user_y_mem_;
+    std::shared_ptr<mkldnn::memory> x_mem_;
+    std::shared_ptr<mkldnn::memory> weights_mem_;
+    std::shared_ptr<mkldnn::memory> y_mem_;
+    mkldnn::primitive reorder_weights_;
+    std::shared_ptr<mkldnn::primitive> deconv_fwd_;
+    std::shared_ptr<mkldnn::stream> fwd_stream_;
+    std::vector<mkldnn::primitive> fwd_primitives_;
+
+    //backward, gx = conv_forward(gy, W) and gW = conv_backward_weights(gy, x)
+    std::shared_ptr<mkldnn::memory> user_bwd_x_mem_;
+    std::shared_ptr<mkldnn::memory> user_bwd_weights_mem_;
+    std::shared_ptr<mkldnn::memory> user_gy_mem_;
+    std::shared_ptr<mkldnn::memory> user_gW_mem_;
+    std::shared_ptr<mkldnn::memory> user_gx_mem_;
+    std::shared_ptr<mkldnn::memory> bwd_x_mem_;
+    std::shared_ptr<mkldnn::memory> bwd_weights_mem_;
+    std::shared_ptr<mkldnn::memory> gy_data_mem_;
+    std::shared_ptr<mkldnn::memory> gy_weights_mem_;
+    std::shared_ptr<mkldnn::memory> gW_mem_;
+    std::shared_ptr<mkldnn::memory> gx_mem_;
+    std::shared_ptr<mkldnn::primitive> deconv_bwd_data_;
+    std::shared_ptr<mkldnn::primitive> deconv_bwd_weights_;
+    std::shared_ptr<mkldnn::stream> bwd_data_stream_;
+    std::shared_ptr<mkldnn::stream> bwd_weights_stream_;
+    std::vector<mkldnn::primitive> bwd_data_primitives_;
+    std::vector<mkldnn::primitive> bwd_weights_primitives_;
+};
+
+#endif // _DECONVOLUTION_H_
+
+
+// vim: et ts=4 sw=4 cindent cino^=l0,\:0,N-s
@@ -0,0 +1,245 @@
+/*
+ *COPYRIGHT
+ *All modification made by Intel Corporation: © 2017 Intel Corporation.
+ *Copyright (c) 2015 Preferred Infrastructure, Inc.
+ *Copyright (c) 2015 Preferred Networks, Inc.
+ *
+ *Permission is hereby granted, free of charge, to any person obtaining a copy
+ *of this software and associated documentation files (the "Software"), to deal
+ *in the Software without restriction, including without limitation the rights
+ *to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ *copies of the Software, and to permit persons to whom the Software is
+ *furnished to do so, subject to the following conditions:
+ *
+ *The above copyright notice and this permission notice shall be included in
+ *all copies or substantial portions of the Software.
+ *
+ *THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ *AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ *OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ *THE SOFTWARE.
+ *
+ *
+ *######################################################################
+ *# The CuPy is designed based on NumPy's API.
+ *# CuPy's source code and documents contain the original NumPy ones.
+ *######################################################################
+ *Copyright (c) 2005-2016, NumPy Developers.
+ *All rights reserved.
+ *
+ *Redistribution and use in source and binary forms, with or without
+ *modification, are permitted provided that the following conditions are
+ *met:
+ *
+ *    * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *
+ *    * Redistributions in binary form must reproduce the above
+ *       copyright notice, this list of conditions and the following
+ *       disclaimer in the documentation and/or other materials provided
+ *       with the distribution.
+ *
+ *    * Neither the name of the NumPy Developers nor the names of any
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ *THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *"AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ *A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ *OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ *SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ *LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ *DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ *THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ *(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ *OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *######################################################################
+ */
+
+
+#include <omp.h>
+#include <stdint.h>
+#include <string.h>
+#include <algorithm>
+#include <cmath>
+#include "eltwise.h"
+
+// expf/logf are not vectorized without libmvec, these Cephes polynomials
+// are branch free so the simd loops below vectorize them for every ISA
+static inline float eltwise_exp(float x)
+{
+    x = std::min(std::max(x, -87.33f), 88.37f);
+    float n = floorf(x * 1.44269504088896341f + 0.5f);
+    float r = x - n * 0.693359375f + n * 2.12194440e-4f;
+    float p = 1.9875691500e-4f;
+    p = p * r + 1.3981999507e-3f;
+    p = p * r + 8.3334519073e-3f;
+    p = p * r + 4.1665795894e-2f;
+    p = p * r + 1.6666665459e-1f;
+    p = p * r + 5.0000001201e-1f;
+    p = p * r * r + r + 1.0f;
+
+    int32_t bits = ((int32_t)n + 127) << 23;
+    float scale;
+    memcpy(&scale, &bits, sizeof(scale));
+    return p * scale;
+}
+
+// x has to be a positive normal number
+static inline float eltwise_log(float x)
+{
+    int32_t bits;
+    memcpy(&bits, &x, sizeof(bits));
+    int32_t e = ((bits >> 23) & 0xff) - 126;
+    bits = (bits & 0x007fffff) | 0x3f000000;
+    float m;
+    memcpy(&m, &bits, sizeof(m));
+
+    // m in [sqrt(1/2), sqrt(2)) - 1
+    bool small = m < 0.707106781186547524f;
+    e = small ? e - 1 : e;
+    m = small ? m + m - 1.0f : m - 1.0f;
+
+    float z = m * m;
+    float p = 7.0376836292e-2f;
+    p = p * m - 1.1514610310e-1f;
+    p = p * m + 1.1676998740e-1f;
+    p = p * m - 1.2420140846e-1f;
+    p = p * m + 1.4249322787e-1f;
+    p = p * m - 1.6668057665e-1f;
+    p = p * m + 2.0000714765e-1f;
+    p = p * m - 2.4999993993e-1f;
+    p = p * m + 3.3333331174e-1f;
+    p = p * m * z;
+
+    float fe = (float)e;
+    p += -2.12194440e-4f * fe;
+    p += -0.5f * z;
+    return m + p + 0.693359375f * fe;
+}
+
+#define ELTWISE_CLONES \
+    __attribute__((target_clones("avx512f", "avx2,fma", "default")))
+
+ELTWISE_CLONES
+static void eltwise_fwd_kernel(const float* x, float* y, size_t n,
+                               int alg, float alpha)
+{
+    switch (alg) {
+    case ELTWISE_ELU:
+        #pragma omp simd
+        for (size_t i = 0; i < n; i++)
+            y[i] = x[i] >= 0 ? x[i] : alpha * (eltwise_exp(x[i]) - 1);
+        break;
+    case ELTWISE_TANH:
+        #pragma omp simd
+        for (size_t i = 0; i < n; i++)
+            y[i] = 1 - 2 / (eltwise_exp(2 * x[i]) + 1);
+        break;
+    case ELTWISE_SIGMOID:
+        #pragma omp simd
+        for (size_t i = 0; i < n; i++)
+            y[i] = 1 / (1 + eltwise_exp(-x[i]));
+        break;
+    case ELTWISE_CLIPPED_RELU:
+        #pragma omp simd
+        for (size_t i = 0; i < n; i++)
+            y[i] = std::min(std::max(x[i], 0.0f), alpha);
+        break;
+    case ELTWISE_SOFTPLUS: {
+        const float alpha_inv = 1 / alpha;
+        #pragma omp simd
+        for (size_t i = 0; i < n; i++) {
+            float bx = alpha * x[i];
+            y[i] = (std::max(bx, 0.0f) +
+                    eltwise_log(1 + eltwise_exp(-std::abs(bx)))) * alpha_inv;
+        }
+        break;
+    }
+    }
+}
+
+ELTWISE_CLONES
+static void eltwise_bwd_kernel(const float* x, const float* gy, float* gx,
+                               size_t n, int alg, float alpha)
+{
+    switch (alg) {
+    case ELTWISE_ELU:
+        #pragma omp simd
+        for (size_t i = 0; i < n; i++)
+            gx[i] = x[i] >= 0 ? gy[i] : gy[i] * alpha * eltwise_exp(x[i]);
+        break;
+    case ELTWISE_TANH:
+        #pragma omp simd
+        for (size_t i = 0; i < n; i++)
+            gx[i] = gy[i] * (1 - x[i] * x[i]);
+        break;
+    case ELTWISE_SIGMOID:
+        #pragma omp simd
+        for (size_t i = 0; i < n; i++)
+            gx[i] = gy[i] * x[i] * (1 - x[i]);
+        break;
+    case ELTWISE_CLIPPED_RELU:
+        #pragma omp simd
+        for (size_t i = 0; i < n; i++)
+            gx[i] = (x[i] > 0 && x[i] < alpha) ? gy[i] : 0;
+        break;
+    case ELTWISE_SOFTPLUS:
+        #pragma omp simd
+        for (size_t i = 0; i < n; i++)
+            gx[i] = gy[i] * (1 - 1 / (1 + eltwise_exp(alpha * x[i])));
+        break;
+    }
+}
+
+// Chunks below this stay on one thread
+#define ELTWISE_MIN_CHUNK 4096
+
+// OpenMP outlined bodies would not inherit the clone's target, so the
+// array is split here and every thread calls the dispatched kernel
+template<typename F>
+static void eltwise_parallel(size_t n, F f)
+{
+    int nthr = std::max(1, std::min(omp_get_max_threads(),
+                                    (int)(n / ELTWISE_MIN_CHUNK)));
+
+    #pragma omp parallel num_threads(nthr)
+    {
+        int ithr = omp_get_thread_num();
+        size_t chunk = (n + nthr - 1) / nthr;
+        size_t begin = std::min(n, chunk * ithr);
+        size_t end = std::min(n, begin + chunk);
+        if (begin < end)
+            f(begin, end - begin);
+    }
+}
+
+template<typename T>
+void Eltwise<T>::do_forward(T* x, int x_d1,
+                            T* y, int y_d1,
+                            int alg, T alpha)
+{
+    eltwise_parallel(x_d1, [&](size_t off, size_t len) {
+        eltwise_fwd_kernel(x + off, y + off, len, alg, alpha);
+    });
+}
+
+template<typename T>
+void Eltwise<T>::do_backward(T* x, int x_d1,
+                             T* gy, int gy_d1,
+                             T* gx, int gx_d1,
+                             int alg, T alpha)
+{
+    eltwise_parallel(x_d1, [&](size_t off, size_t len) {
+        eltwise_bwd_kernel(x + off, gy + off, gx + off, len, alg, alpha);
+    });
+}
+
+template class Eltwise<float>;
+
+
+// vim: et ts=4 sw=4 cindent cino^=l0,\:0,N-s
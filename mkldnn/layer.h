@@ -65,26 +65,148 @@
 #define _LAYER_H_
 
 #include <mkldnn.hpp>
+#include <assert.h>
+#include <stdint.h>
+#include <string.h>
+#include <memory>
 #include <vector>
 
+#ifndef SWIG
+// Fixed size key of a cached layer. Each parameter is stored as a 64-bit
+// field and folded into the hash while the key is built, so building and
+// comparing keys never touches the heap.
+#define LAYER_KEY_MAX_FIELDS 40
+
+struct LayerKey {
+    enum Kind {
+        KIND_RELU = 1,
+        KIND_RELU4D,
+        KIND_MAX_POOL,
+        KIND_AVG_POOL,
+        KIND_LRN,
+        KIND_SOFTMAX2D,
+        KIND_SOFTMAX4D,
+        KIND_CONV2D,
+        KIND_LINEAR,
+        KIND_SUM,
+        KIND_BATCH_NORM,
+        KIND_DECONV2D,
+    };
+
+    int      kind;
+    int      nfields;
+    uint64_t hash;
+    int64_t  fields[LAYER_KEY_MAX_FIELDS];
+
+    LayerKey() : kind(0), nfields(0), hash(0) {}
+    explicit LayerKey(int k) : kind(k), nfields(0) {
+        hash = mix(0xcbf29ce484222325ULL, (uint64_t)k);
+    }
+
+    LayerKey& add(int64_t value) {
+        assert(nfields < LAYER_KEY_MAX_FIELDS);
+        fields[nfields++] = value;
+        hash = mix(hash, (uint64_t)value);
+        return *this;
+    }
+
+    // doubles are keyed on their bit pattern, not a formatted string
+    LayerKey& add(double value) {
+        int64_t bits;
+        memcpy(&bits, &value, sizeof(bits));
+        return add(bits);
+    }
+
+    LayerKey& add(int value) { return add((int64_t)value); }
+
+    bool operator==(const LayerKey& other) const {
+        return hash == other.hash && kind == other.kind
+            && nfields == other.nfields
+            && memcmp(fields, other.fields, nfields * sizeof(int64_t)) == 0;
+    }
+
+    static uint64_t mix(uint64_t h, uint64_t v) {
+        h ^= v + 0x9e3779b97f4a7c15ULL + (h << 6) + (h >> 2);
+        h ^= h >> 33;
+        h *= 0xff51afd7ed558ccdULL;
+        h ^= h >> 33;
+        return h;
+    }
+};
+
+struct LayerKeyHash {
+    size_t operator()(const LayerKey& key) const { return key.hash; }
+};
+#endif // SWIG
+
+template <typename T> class LayerFactory;
+
 template <typename T>
 class Layer {
 public:
-    virtual ~Layer() {}
+    virtual ~Layer() {
+        delete forward_stream_;
+        delete backward_stream_;
+        delete weights_stream_;
+    }
     virtual int forward(){ return 0; };
     virtual int backward(){ return 0; };
 
     virtual int setup_forward(){ return 0; };
     virtual int setup_backward(){ return 0; };
 
+    // Bytes of memory owned by this layer (reorder buffers, workspace).
+    // Memories bound to user (numpy) buffers are not counted.
+    virtual size_t get_memory_size(){ return 0; };
+
 protected:
-    mkldnn::stream* forward_stream_;
-    mkldnn::stream* backward_stream_;
+#ifndef SWIG
+    static size_t memory_size(const std::shared_ptr<mkldnn::memory>& mem,
+                              const std::shared_ptr<mkldnn::memory>& user_mem) {
+        if (!mem || mem == user_mem)
+            return 0;
+        return mem->get_primitive_desc().get_size();
+    }
+    static size_t memory_size(const std::shared_ptr<mkldnn::memory>& mem) {
+        return memory_size(mem, NULL);
+    }
+
+    // Reorder user weights W into the layout of the primitive. The result
+    // is kept and reused while W and version stay the same, so frozen
+    // weights are reordered once; a negative version always reorders.
+    // Versions are stamps of the Python parameter, unique per process, so
+    // another array at a freed address never matches.
+    void prepack_weights(const mkldnn::primitive& reorder, T* W, long version) {
+        if (version >= 0 && W == prepacked_W_ && version == prepacked_version_)
+            return;
+        if (weights_stream_ == NULL) {
+            weights_stream_ = new mkldnn::stream(mkldnn::stream::kind::eager);
+            weights_stream_->submit({reorder}).wait();
+        } else {
+            weights_stream_->rerun().wait();
+        }
+        prepacked_W_ = W;
+        prepacked_version_ = version;
+    }
+#endif
+
+    mkldnn::stream* forward_stream_ = NULL;
+    mkldnn::stream* backward_stream_ = NULL;
     std::vector<mkldnn::primitive> forward_primitives_;
     std::vector<mkldnn::primitive> backward_primitives_;
     bool forward_first_use_ = true;
     bool backward_first_use_ = true;
     bool backward_first_setup_ = true;
+    mkldnn::stream* weights_stream_ = NULL;
+    T* prepacked_W_ = NULL;
+    long prepacked_version_ = -1;
+
+#ifndef SWIG
+private:
+    // key the layer is cached under, stamped by LayerFactory
+    friend class LayerFactory<T>;
+    LayerKey cache_key_;
+#endif
 };
 
 #endif // _LAYER_H_
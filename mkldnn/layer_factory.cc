@@ -61,103 +61,271 @@
  */
 
 
+#include <chrono>
 #include <glog/logging.h>
 #include <iostream>
+#include <sstream>
+#include <stdexcept>
+#include <stdlib.h>
 #include "mkldnn.hpp"
 #include "layer_factory.h"
 
-// helper functions to convert layer unique data to a string
-#if 0
-static std::string pointer_to_string(void* ptr)
+using namespace mkldnn;
+
+#define LAYER_FACTORY_INIT_CAPACITY 64
+
+static size_t env_to_size(const char* name)
 {
-    std::ostringstream os;
-    os << std::hex << static_cast<void*>(ptr) << "_";
-    return os.str();
+    const char* value = getenv(name);
+    if (value == NULL)
+        return 0;
+    return strtoull(value, NULL, 10);
 }
 
-static std::string float_to_string(float value)
+template<typename T>
+LayerFactory<T>::LayerFactory()
+    : tick_(0), entries_(0), hits_(0), misses_(0), evictions_(0),
+      key_by_owner_(false)
 {
-    std::ostringstream os;
-    os << "F" << value << "_";
-    return os.str();
+    for (auto& shard : shards_) {
+        shard.slots.resize(LAYER_FACTORY_INIT_CAPACITY);
+        shard.size = 0;
+        for (auto& slot : shard.slots)
+            slot.layer = NULL;
+    }
+
+    max_bytes_   = env_to_size("MKLDNN_CACHE_MAX_BYTES");
+    max_entries_ = env_to_size("MKLDNN_CACHE_MAX_ENTRIES");
+    key_by_owner_ = env_to_size("MKLDNN_CACHE_BY_OWNER") != 0;
 }
-#endif
 
-static std::string int_to_string(int value)
+// Check out an idle layer, it stays out of the table until put_layer()
+template<typename T>
+Layer<T>* LayerFactory<T>::get_layer(const LayerKey& key)
 {
-    std::ostringstream os;
-    os << std::hex << "I" << value << "_";
-    return os.str();
+    Shard& shard = shard_of(key);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+
+    size_t mask = shard.slots.size() - 1;
+    for (size_t i = key.hash & mask; ; i = (i + 1) & mask) {
+        Slot& slot = shard.slots[i];
+        if (slot.layer == NULL) {
+            misses_++;
+            return NULL;
+        }
+        if (slot.key == key) {
+            Layer<T>* layer = slot.layer;
+            erase_slot(shard, i);
+            entries_--;
+            hits_++;
+            return layer;
+        }
+    }
 }
 
-static std::string double_to_string(double value)
+// A new layer is checked out from the start, only its key is recorded here
+template<typename T>
+void LayerFactory<T>::set_layer(const LayerKey& key, Layer<T>* layer)
 {
-    std::ostringstream os;
-    os << "D" << value << "_";
-    return os.str();
+    layer->cache_key_ = key;
 }
-// end of helper functions
 
-using namespace mkldnn;
 template<typename T>
-LayerFactory<T>::LayerFactory()
+void LayerFactory<T>::put_layer(Layer<T>* layer)
 {
+    const LayerKey& key = layer->cache_key_;
+    if (key.kind == 0)
+        throw new std::invalid_argument("layer is not owned by LayerFactory");
+
+    Shard& shard = shard_of(key);
+    {
+        std::lock_guard<std::mutex> lock(shard.mutex);
+
+        // keep load factor below 1/2 so that probe sequences stay short
+        if ((shard.size + 1) * 2 > shard.slots.size())
+            grow(shard);
+
+        size_t mask = shard.slots.size() - 1;
+        size_t i = key.hash & mask;
+        while (shard.slots[i].layer != NULL)
+            i = (i + 1) & mask;
+        shard.slots[i].key = key;
+        shard.slots[i].layer = layer;
+        shard.slots[i].last_use = ++tick_;
+        shard.size++;
+    }
+    entries_++;
+
+    evict();
 }
 
 template<typename T>
-Layer<T>* LayerFactory<T>::get_layer(std::string key)
+void LayerFactory<T>::grow(Shard& shard)
 {
-    auto stream_iter = map_.find(key);
-    if (stream_iter == map_.end()) {
-        return NULL;
-    } else {
-        return stream_iter->second;
+    std::vector<Slot> old(shard.slots.size() * 2);
+    old.swap(shard.slots);
+    for (auto& slot : shard.slots)
+        slot.layer = NULL;
+
+    size_t mask = shard.slots.size() - 1;
+    for (auto& slot : old) {
+        if (slot.layer == NULL)
+            continue;
+        size_t i = slot.key.hash & mask;
+        while (shard.slots[i].layer != NULL)
+            i = (i + 1) & mask;
+        shard.slots[i] = slot;
     }
 }
 
+// backward shift deletion, keeps probe sequences intact without tombstones
 template<typename T>
-void LayerFactory<T>::set_layer(std::string key, Layer<T>* layer)
+void LayerFactory<T>::erase_slot(Shard& shard, size_t i)
 {
-    auto stream_iter = map_.find(key);
-    if (stream_iter == map_.end()) {
-        map_[key]=layer;
-    } else {
-        throw new std::invalid_argument("cannot set same key to a new stream");
+    std::vector<Slot>& slots = shard.slots;
+    size_t mask = slots.size() - 1;
+    slots[i].layer = NULL;
+    shard.size--;
+
+    for (size_t j = (i + 1) & mask; slots[j].layer != NULL; j = (j + 1) & mask) {
+        size_t home = slots[j].key.hash & mask;
+        // leave the entry if its home lies cyclically in (i, j]
+        bool stay = (i <= j) ? (i < home && home <= j)
+                             : (i < home || home <= j);
+        if (stay)
+            continue;
+        slots[i] = slots[j];
+        slots[j].layer = NULL;
+        i = j;
     }
 }
 
-#define RELU_PREFIX "relu_"
+// Only idle layers are in the table, so an evicted layer is never in use.
+// One thread evicts at a time; shards are locked one by one, the LRU
+// order is therefore approximate while other threads keep putting layers.
+template<typename T>
+void LayerFactory<T>::evict()
+{
+    size_t max_bytes = max_bytes_, max_entries = max_entries_;
+    if (max_bytes == 0 && max_entries == 0)
+        return;
+
+    std::lock_guard<std::mutex> evict_lock(evict_mutex_);
+    size_t bytes = max_bytes ? get_memory_size() : 0;
+    while (entries_ > 1
+            && ((max_entries && entries_ > max_entries)
+                || (max_bytes && bytes > max_bytes))) {
+        Shard*   lru_shard = NULL;
+        uint64_t lru_use = 0;
+        for (auto& shard : shards_) {
+            std::lock_guard<std::mutex> lock(shard.mutex);
+            for (auto& slot : shard.slots) {
+                if (slot.layer == NULL)
+                    continue;
+                if (lru_shard == NULL || slot.last_use < lru_use) {
+                    lru_shard = &shard;
+                    lru_use = slot.last_use;
+                }
+            }
+        }
+        if (lru_shard == NULL)
+            break;
+
+        Layer<T>* layer = NULL;
+        {
+            std::lock_guard<std::mutex> lock(lru_shard->mutex);
+            for (size_t i = 0; i < lru_shard->slots.size(); i++) {
+                Slot& slot = lru_shard->slots[i];
+                if (slot.layer != NULL && slot.last_use == lru_use) {
+                    layer = slot.layer;
+                    erase_slot(*lru_shard, i);
+                    break;
+                }
+            }
+        }
+        // checked out by another thread in the meantime
+        if (layer == NULL)
+            continue;
+
+        entries_--;
+        size_t layer_bytes = layer->get_memory_size();
+        bytes = bytes > layer_bytes ? bytes - layer_bytes : 0;
+        delete layer;
+        evictions_++;
+    }
+}
+
+template<typename T>
+void LayerFactory<T>::clear()
+{
+    for (auto& shard : shards_) {
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        for (auto& slot : shard.slots) {
+            if (slot.layer != NULL) {
+                delete slot.layer;
+                slot.layer = NULL;
+                entries_--;
+            }
+        }
+        shard.size = 0;
+    }
+}
+
+template<typename T>
+void LayerFactory<T>::set_limit(size_t max_bytes, size_t max_entries)
+{
+    max_bytes_   = max_bytes;
+    max_entries_ = max_entries;
+    evict();
+}
+
+template<typename T>
+size_t LayerFactory<T>::get_memory_size()
+{
+    size_t bytes = 0;
+    for (auto& shard : shards_) {
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        for (auto& slot : shard.slots) {
+            if (slot.layer != NULL)
+                bytes += slot.layer->get_memory_size();
+        }
+    }
+    return bytes;
+}
 
 template<typename T>
-Layer<T>* LayerFactory<T>::get_relu_layer(int size)
+Layer<T>* LayerFactory<T>::get_relu_layer(int size, double negative_slope)
 {
-    std::string key = RELU_PREFIX;
+    LayerKey key(LayerKey::KIND_RELU);
 
-    key += int_to_string(size);
+    key.add(size);
+    key.add(negative_slope);
     return get_layer(key);
 }
 
 template<typename T>
-void LayerFactory<T>::set_relu_layer(int size, Layer<T>*   layer)
+void LayerFactory<T>::set_relu_layer(int size, Layer<T>*   layer,
+                                     double negative_slope)
 {
-    std::string key = RELU_PREFIX;
+    LayerKey key(LayerKey::KIND_RELU);
 
-    key += int_to_string(size);
+    key.add(size);
+    key.add(negative_slope);
     set_layer(key, layer);
 }
 
-#define RELU4D_PREFIX "relu4d_"
-
 template<typename T>
 Layer<T>* LayerFactory<T>::get_relu4d_layer(
-          int x_d1, int x_d2, int x_d3, int x_d4)
+          int x_d1, int x_d2, int x_d3, int x_d4,
+          int x_format)
 {
-    std::string key = RELU4D_PREFIX;
+    LayerKey key(LayerKey::KIND_RELU4D);
 
-    key += int_to_string(x_d1);
-    key += int_to_string(x_d2);
-    key += int_to_string(x_d3);
-    key += int_to_string(x_d4);
+    key.add(x_d1);
+    key.add(x_d2);
+    key.add(x_d3);
+    key.add(x_d4);
+    key.add(x_format);
 
     return get_layer(key);
 }
@@ -165,41 +333,46 @@ Layer<T>* LayerFactory<T>::get_relu4d_layer(
 template<typename T>
 void LayerFactory<T>::set_relu4d_layer(
         int x_d1, int x_d2, int x_d3, int x_d4,
-        Layer<T>* layer)
+        Layer<T>* layer,
+        int x_format)
 {
-    std::string key = RELU4D_PREFIX;
+    LayerKey key(LayerKey::KIND_RELU4D);
 
-    key += int_to_string(x_d1);
-    key += int_to_string(x_d2);
-    key += int_to_string(x_d3);
-    key += int_to_string(x_d4);
+    key.add(x_d1);
+    key.add(x_d2);
+    key.add(x_d3);
+    key.add(x_d4);
+    key.add(x_format);
 
     set_layer(key, layer);
 }
 
-#define MAX_POOLING_PREFIX "maxpool_"
 template<typename T>
 Layer<T>* LayerFactory<T>::get_max_pool_layer(
           int x_d1, int x_d2, int x_d3, int x_d4,
           int stride_y, int stride_x,
           int ksize_h,  int ksize_w,
           int pad_u,    int pad_d,
-          int pad_l,    int pad_r)
-{
-    std::string key = MAX_POOLING_PREFIX;
-
-    key += int_to_string(x_d1);
-    key += int_to_string(x_d2);
-    key += int_to_string(x_d3);
-    key += int_to_string(x_d4);
-    key += int_to_string(stride_y);
-    key += int_to_string(stride_x);
-    key += int_to_string(ksize_h);
-    key += int_to_string(ksize_w);
-    key += int_to_string(pad_u);
-    key += int_to_string(pad_d);
-    key += int_to_string(pad_l);
-    key += int_to_string(pad_r);
+          int pad_l,    int pad_r,
+          int x_format,
+          bool inference)
+{
+    LayerKey key(LayerKey::KIND_MAX_POOL);
+
+    key.add(x_d1);
+    key.add(x_d2);
+    key.add(x_d3);
+    key.add(x_d4);
+    key.add(stride_y);
+    key.add(stride_x);
+    key.add(ksize_h);
+    key.add(ksize_w);
+    key.add(pad_u);
+    key.add(pad_d);
+    key.add(pad_l);
+    key.add(pad_r);
+    key.add(x_format);
+    key.add((int)inference);
 
     return get_layer(key);
 }
@@ -211,49 +384,56 @@ void LayerFactory<T>::set_max_pool_layer(
         int ksize_h,  int ksize_w,
         int pad_u,    int pad_d,
         int pad_l,    int pad_r,
-        Layer<T>* layer)
+        Layer<T>* layer,
+        int x_format,
+        bool inference)
 {
-    std::string key = MAX_POOLING_PREFIX;
-
-    key += int_to_string(x_d1);
-    key += int_to_string(x_d2);
-    key += int_to_string(x_d3);
-    key += int_to_string(x_d4);
-    key += int_to_string(stride_y);
-    key += int_to_string(stride_x);
-    key += int_to_string(ksize_h);
-    key += int_to_string(ksize_w);
-    key += int_to_string(pad_u);
-    key += int_to_string(pad_d);
-    key += int_to_string(pad_l);
-    key += int_to_string(pad_r);
+    LayerKey key(LayerKey::KIND_MAX_POOL);
+
+    key.add(x_d1);
+    key.add(x_d2);
+    key.add(x_d3);
+    key.add(x_d4);
+    key.add(stride_y);
+    key.add(stride_x);
+    key.add(ksize_h);
+    key.add(ksize_w);
+    key.add(pad_u);
+    key.add(pad_d);
+    key.add(pad_l);
+    key.add(pad_r);
+    key.add(x_format);
+    key.add((int)inference);
 
     set_layer(key, layer);
 }
 
-#define AVG_POOLING_PREFIX "avgpool_"
 template<typename T>
 Layer<T>* LayerFactory<T>::get_avg_pool_layer(
           int x_d1, int x_d2, int x_d3, int x_d4,
           int stride_y, int stride_x,
           int ksize_h,  int ksize_w,
           int pad_u,    int pad_d,
-          int pad_l,    int pad_r)
-{
-    std::string key = AVG_POOLING_PREFIX;
-
-    key += int_to_string(x_d1);
-    key += int_to_string(x_d2);
-    key += int_to_string(x_d3);
-    key += int_to_string(x_d4);
-    key += int_to_string(stride_y);
-    key += int_to_string(stride_x);
-    key += int_to_string(ksize_h);
-    key += int_to_string(ksize_w);
-    key += int_to_string(pad_u);
-    key += int_to_string(pad_d);
-    key += int_to_string(pad_l);
-    key += int_to_string(pad_r);
+          int pad_l,    int pad_r,
+          int x_format,
+          bool inference)
+{
+    LayerKey key(LayerKey::KIND_AVG_POOL);
+
+    key.add(x_d1);
+    key.add(x_d2);
+    key.add(x_d3);
+    key.add(x_d4);
+    key.add(stride_y);
+    key.add(stride_x);
+    key.add(ksize_h);
+    key.add(ksize_w);
+    key.add(pad_u);
+    key.add(pad_d);
+    key.add(pad_l);
+    key.add(pad_r);
+    key.add(x_format);
+    key.add((int)inference);
 
     return get_layer(key);
 }
@@ -265,27 +445,30 @@ void LayerFactory<T>::set_avg_pool_layer(
         int ksize_h,  int ksize_w,
         int pad_u,    int pad_d,
         int pad_l,    int pad_r,
-        Layer<T>* layer)
+        Layer<T>* layer,
+        int x_format,
+        bool inference)
 {
-    std::string key = AVG_POOLING_PREFIX;
-
-    key += int_to_string(x_d1);
-    key += int_to_string(x_d2);
-    key += int_to_string(x_d3);
-    key += int_to_string(x_d4);
-    key += int_to_string(stride_y);
-    key += int_to_string(stride_x);
-    key += int_to_string(ksize_h);
-    key += int_to_string(ksize_w);
-    key += int_to_string(pad_u);
-    key += int_to_string(pad_d);
-    key += int_to_string(pad_l);
-    key += int_to_string(pad_r);
+    LayerKey key(LayerKey::KIND_AVG_POOL);
+
+    key.add(x_d1);
+    key.add(x_d2);
+    key.add(x_d3);
+    key.add(x_d4);
+    key.add(stride_y);
+    key.add(stride_x);
+    key.add(ksize_h);
+    key.add(ksize_w);
+    key.add(pad_u);
+    key.add(pad_d);
+    key.add(pad_l);
+    key.add(pad_r);
+    key.add(x_format);
+    key.add((int)inference);
 
     set_layer(key, layer);
 }
 
-#define LRN_PREFIX "lrn_"
 template<typename T>
 Layer<T>* LayerFactory<T>::get_lrn_layer(int             x_d1,
                                          int             x_d2,
@@ -294,18 +477,22 @@ Layer<T>* LayerFactory<T>::get_lrn_layer(int             x_d1,
                                          int             local_size,
                                          double           k,
                                          double           alpha,
-                                         double           beta)
+                                         double           beta,
+                                         int             x_format,
+                                         bool            inference)
 {
-    std::string key = LRN_PREFIX;
-
-    key += int_to_string(x_d1);
-    key += int_to_string(x_d2);
-    key += int_to_string(x_d3);
-    key += int_to_string(x_d4);
-    key += int_to_string(local_size);
-    key += double_to_string(k);
-    key += double_to_string(alpha);
-    key += double_to_string(beta);
+    LayerKey key(LayerKey::KIND_LRN);
+
+    key.add(x_d1);
+    key.add(x_d2);
+    key.add(x_d3);
+    key.add(x_d4);
+    key.add(local_size);
+    key.add(k);
+    key.add(alpha);
+    key.add(beta);
+    key.add(x_format);
+    key.add((int)inference);
 
     return get_layer(key);
 }
@@ -319,33 +506,36 @@ void LayerFactory<T>::set_lrn_layer(int              x_d1,
                                     double            k,
                                     double            alpha,
                                     double            beta,
-                                    Layer<T>*    layer)
+                                    Layer<T>*    layer,
+                                    int              x_format,
+                                    bool             inference)
 {
-    std::string key = LRN_PREFIX;
-
-    key += int_to_string(x_d1);
-    key += int_to_string(x_d2);
-    key += int_to_string(x_d3);
-    key += int_to_string(x_d4);
-    key += int_to_string(local_size);
-    key += double_to_string(k);
-    key += double_to_string(alpha);
-    key += double_to_string(beta);
+    LayerKey key(LayerKey::KIND_LRN);
+
+    key.add(x_d1);
+    key.add(x_d2);
+    key.add(x_d3);
+    key.add(x_d4);
+    key.add(local_size);
+    key.add(k);
+    key.add(alpha);
+    key.add(beta);
+    key.add(x_format);
+    key.add((int)inference);
 
     set_layer(key, layer);
 }
 
-#define SOFTMAX2D_PREFIX "softmax2d_"
 template<typename T>
 Layer<T>* LayerFactory<T>::get_softmax2d_layer(int                d1,
                                                int                d2,
                                                int                axis)
 {
-    std::string key = SOFTMAX2D_PREFIX;
+    LayerKey key(LayerKey::KIND_SOFTMAX2D);
 
-    key += int_to_string(d1);
-    key += int_to_string(d2);
-    key += int_to_string(axis);
+    key.add(d1);
+    key.add(d2);
+    key.add(axis);
 
     return get_layer(key);
 }
@@ -356,16 +546,15 @@ void LayerFactory<T>::set_softmax2d_layer(int                d1,
                                           int                axis,
                                           Layer<T>*      layer)
 {
-    std::string key = SOFTMAX2D_PREFIX;
+    LayerKey key(LayerKey::KIND_SOFTMAX2D);
 
-    key += int_to_string(d1);
-    key += int_to_string(d2);
-    key += int_to_string(axis);
+    key.add(d1);
+    key.add(d2);
+    key.add(axis);
 
     set_layer(key, layer);
 }
 
-#define SOFTMAX4D_PREFIX "softmax4d_"
 template<typename T>
 Layer<T>* LayerFactory<T>::get_softmax4d_layer(int                d1,
                                                int                d2,
@@ -373,13 +562,13 @@ Layer<T>* LayerFactory<T>::get_softmax4d_layer(int                d1,
                                                int                d4,
                                                int                axis)
 {
-    std::string key = SOFTMAX4D_PREFIX;
+    LayerKey key(LayerKey::KIND_SOFTMAX4D);
 
-    key += int_to_string(d1);
-    key += int_to_string(d2);
-    key += int_to_string(d3);
-    key += int_to_string(d4);
-    key += int_to_string(axis);
+    key.add(d1);
+    key.add(d2);
+    key.add(d3);
+    key.add(d4);
+    key.add(axis);
 
     return get_layer(key);
 }
@@ -392,18 +581,17 @@ void LayerFactory<T>::set_softmax4d_layer(int                d1,
                                           int                axis,
                                           Layer<T>*      layer)
 {
-    std::string key = SOFTMAX4D_PREFIX;
+    LayerKey key(LayerKey::KIND_SOFTMAX4D);
 
-    key += int_to_string(d1);
-    key += int_to_string(d2);
-    key += int_to_string(d3);
-    key += int_to_string(d4);
-    key += int_to_string(axis);
+    key.add(d1);
+    key.add(d2);
+    key.add(d3);
+    key.add(d4);
+    key.add(axis);
 
     set_layer(key, layer);
 }
 
-#define CONVOLUTION2D_PREFIX "conv2d_"
 template<typename T>
 Layer<T>* LayerFactory<T>::get_conv2d_layer(
           int x_d1, int x_d2, int x_d3, int x_d4,
@@ -412,27 +600,37 @@ Layer<T>* LayerFactory<T>::get_conv2d_layer(
           int ksize_h, int ksize_w,
           int stride_y, int stride_x,
           int pad_l_h, int pad_l_w,
-          int pad_r_h, int pad_r_w)
-{
-    std::string key = CONVOLUTION2D_PREFIX;
-
-    key += int_to_string(x_d1);
-    key += int_to_string(x_d2);
-    key += int_to_string(x_d3);
-    key += int_to_string(x_d4);
-    key += int_to_string(W_d1);
-    key += int_to_string(W_d2);
-    key += int_to_string(W_d3);
-    key += int_to_string(W_d4);
-    key += int_to_string(b_d1);
-    key += int_to_string(ksize_h);
-    key += int_to_string(ksize_w);
-    key += int_to_string(stride_y);
-    key += int_to_string(stride_x);
-    key += int_to_string(pad_l_h);
-    key += int_to_string(pad_l_w);
-    key += int_to_string(pad_r_h);
-    key += int_to_string(pad_r_w);
+          int pad_r_h, int pad_r_w,
+          int x_format,
+          long owner,
+          bool inference,
+          bool with_relu,
+          int groups)
+{
+    LayerKey key(LayerKey::KIND_CONV2D);
+
+    key.add(x_d1);
+    key.add(x_d2);
+    key.add(x_d3);
+    key.add(x_d4);
+    key.add(W_d1);
+    key.add(W_d2);
+    key.add(W_d3);
+    key.add(W_d4);
+    key.add(b_d1);
+    key.add(ksize_h);
+    key.add(ksize_w);
+    key.add(stride_y);
+    key.add(stride_x);
+    key.add(pad_l_h);
+    key.add(pad_l_w);
+    key.add(pad_r_h);
+    key.add(pad_r_w);
+    key.add(x_format);
+    key.add((int64_t)(key_by_owner_ ? owner : 0));
+    key.add((int)inference);
+    key.add((int)with_relu);
+    key.add(groups);
 
     return get_layer(key);
 }
@@ -446,45 +644,127 @@ void LayerFactory<T>::set_conv2d_layer(
         int stride_y, int stride_x,
         int pad_l_h, int pad_l_w,
         int pad_r_h, int pad_r_w,
-        Layer<T>* layer)
+        Layer<T>* layer,
+        int x_format,
+        long owner,
+        bool inference,
+        bool with_relu,
+        int groups)
+{
+    LayerKey key(LayerKey::KIND_CONV2D);
+
+    key.add(x_d1);
+    key.add(x_d2);
+    key.add(x_d3);
+    key.add(x_d4);
+    key.add(W_d1);
+    key.add(W_d2);
+    key.add(W_d3);
+    key.add(W_d4);
+    key.add(b_d1);
+    key.add(ksize_h);
+    key.add(ksize_w);
+    key.add(stride_y);
+    key.add(stride_x);
+    key.add(pad_l_h);
+    key.add(pad_l_w);
+    key.add(pad_r_h);
+    key.add(pad_r_w);
+    key.add(x_format);
+    key.add((int64_t)(key_by_owner_ ? owner : 0));
+    key.add((int)inference);
+    key.add((int)with_relu);
+    key.add(groups);
+
+    return set_layer(key, layer);
+}
+
+template<typename T>
+Layer<T>* LayerFactory<T>::get_deconv2d_layer(
+          int x_d1, int x_d2, int x_d3, int x_d4,
+          int W_d1, int W_d2, int W_d3, int W_d4,
+          int b_d1,
+          int y_d3, int y_d4,
+          int stride_y, int stride_x,
+          int pad_l_h, int pad_l_w,
+          int pad_r_h, int pad_r_w,
+          long owner)
+{
+    LayerKey key(LayerKey::KIND_DECONV2D);
+
+    key.add(x_d1);
+    key.add(x_d2);
+    key.add(x_d3);
+    key.add(x_d4);
+    key.add(W_d1);
+    key.add(W_d2);
+    key.add(W_d3);
+    key.add(W_d4);
+    key.add(b_d1);
+    key.add(y_d3);
+    key.add(y_d4);
+    key.add(stride_y);
+    key.add(stride_x);
+    key.add(pad_l_h);
+    key.add(pad_l_w);
+    key.add(pad_r_h);
+    key.add(pad_r_w);
+    key.add((int64_t)(key_by_owner_ ? owner : 0));
+
+    return get_layer(key);
+}
+
+template<typename T>
+void LayerFactory<T>::set_deconv2d_layer(
+        int x_d1, int x_d2, int x_d3, int x_d4,
+        int W_d1, int W_d2, int W_d3, int W_d4,
+        int b_d1,
+        int y_d3, int y_d4,
+        int stride_y, int stride_x,
+        int pad_l_h, int pad_l_w,
+        int pad_r_h, int pad_r_w,
+        Layer<T>* layer,
+        long owner)
 {
-    std::string key = CONVOLUTION2D_PREFIX;
-
-    key += int_to_string(x_d1);
-    key += int_to_string(x_d2);
-    key += int_to_string(x_d3);
-    key += int_to_string(x_d4);
-    key += int_to_string(W_d1);
-    key += int_to_string(W_d2);
-    key += int_to_string(W_d3);
-    key += int_to_string(W_d4);
-    key += int_to_string(b_d1);
-    key += int_to_string(ksize_h);
-    key += int_to_string(ksize_w);
-    key += int_to_string(stride_y);
-    key += int_to_string(stride_x);
-    key += int_to_string(pad_l_h);
-    key += int_to_string(pad_l_w);
-    key += int_to_string(pad_r_h);
-    key += int_to_string(pad_r_w);
+    LayerKey key(LayerKey::KIND_DECONV2D);
+
+    key.add(x_d1);
+    key.add(x_d2);
+    key.add(x_d3);
+    key.add(x_d4);
+    key.add(W_d1);
+    key.add(W_d2);
+    key.add(W_d3);
+    key.add(W_d4);
+    key.add(b_d1);
+    key.add(y_d3);
+    key.add(y_d4);
+    key.add(stride_y);
+    key.add(stride_x);
+    key.add(pad_l_h);
+    key.add(pad_l_w);
+    key.add(pad_r_h);
+    key.add(pad_r_w);
+    key.add((int64_t)(key_by_owner_ ? owner : 0));
 
     return set_layer(key, layer);
 }
 
-#define LINEAR_PREFIX "linear_"
 template<typename T>
 Layer<T>* LayerFactory<T>::get_linear_layer(
             int x_d1, int x_d2,
             int W_d1, int W_d2,
-            int b_d1)
+            int b_d1,
+            long owner)
 {
-    std::string key = LINEAR_PREFIX;
-
-    key += int_to_string(x_d1);
-    key += int_to_string(x_d2);
-    key += int_to_string(W_d1);
-    key += int_to_string(W_d2);
-    key += int_to_string(b_d1);
+    LayerKey key(LayerKey::KIND_LINEAR);
+
+    key.add(x_d1);
+    key.add(x_d2);
+    key.add(W_d1);
+    key.add(W_d2);
+    key.add(b_d1);
+    key.add((int64_t)(key_by_owner_ ? owner : 0));
     return get_layer(key);
 }
 
@@ -493,18 +773,179 @@ void LayerFactory<T>::set_linear_layer(
         int x_d1, int x_d2,
         int W_d1, int W_d2,
         int b_d1,
+        Layer<T>* layer,
+        long owner)
+{
+    LayerKey key(LayerKey::KIND_LINEAR);
+    key.add(x_d1);
+    key.add(x_d2);
+    key.add(W_d1);
+    key.add(W_d2);
+    key.add(b_d1);
+    key.add((int64_t)(key_by_owner_ ? owner : 0));
+    return set_layer(key, layer);
+}
+
+template<typename T>
+Layer<T>* LayerFactory<T>::get_sum_layer(
+        int num_sum,
+        int d1, int d2, int d3, int d4)
+{
+    LayerKey key(LayerKey::KIND_SUM);
+    key.add(num_sum);
+    key.add(d1);
+    key.add(d2);
+    key.add(d3);
+    key.add(d4);
+    return get_layer(key);
+}
+
+template<typename T>
+void LayerFactory<T>::set_sum_layer(
+        int num_sum,
+        int d1, int d2, int d3, int d4,
         Layer<T>* layer)
 {
-    std::string key = LINEAR_PREFIX;
-    key += int_to_string(x_d1);
-    key += int_to_string(x_d2);
-    key += int_to_string(W_d1);
-    key += int_to_string(W_d2);
-    key += int_to_string(b_d1);
+    LayerKey key(LayerKey::KIND_SUM);
+    key.add(num_sum);
+    key.add(d1);
+    key.add(d2);
+    key.add(d3);
+    key.add(d4);
+    return set_layer(key, layer);
+}
+
+template<typename T>
+Layer<T>* LayerFactory<T>::get_batch_norm_layer(
+        int x_d1, int x_d2, int x_d3, int x_d4,
+        double eps, bool global_stats,
+        int x_format)
+{
+    LayerKey key(LayerKey::KIND_BATCH_NORM);
+    key.add(x_d1);
+    key.add(x_d2);
+    key.add(x_d3);
+    key.add(x_d4);
+    key.add(eps);
+    key.add((int)global_stats);
+    key.add(x_format);
+    return get_layer(key);
+}
+
+template<typename T>
+void LayerFactory<T>::set_batch_norm_layer(
+        int x_d1, int x_d2, int x_d3, int x_d4,
+        double eps, bool global_stats,
+        Layer<T>* layer,
+        int x_format)
+{
+    LayerKey key(LayerKey::KIND_BATCH_NORM);
+    key.add(x_d1);
+    key.add(x_d2);
+    key.add(x_d3);
+    key.add(x_d4);
+    key.add(eps);
+    key.add((int)global_stats);
+    key.add(x_format);
     return set_layer(key, layer);
 }
 
 template class LayerFactory<float>;
 
+void layer_cache_clear()
+{
+    LayerFactory<float>::get_instance().clear();
+    PrimitiveDescCache<convolution_forward::primitive_desc>::get_instance().clear();
+    PrimitiveDescCache<convolution_backward_weights::primitive_desc>::get_instance().clear();
+    PrimitiveDescCache<convolution_backward_data::primitive_desc>::get_instance().clear();
+    PrimitiveDescCache<inner_product_forward::primitive_desc>::get_instance().clear();
+    PrimitiveDescCache<inner_product_backward_weights::primitive_desc>::get_instance().clear();
+    PrimitiveDescCache<inner_product_backward_data::primitive_desc>::get_instance().clear();
+}
+
+void layer_cache_set_limit(size_t max_bytes, size_t max_entries)
+{
+    LayerFactory<float>::get_instance().set_limit(max_bytes, max_entries);
+}
+
+size_t layer_cache_memory_size()
+{
+    return LayerFactory<float>::get_instance().get_memory_size();
+}
+
+size_t layer_cache_entries()
+{
+    return LayerFactory<float>::get_instance().get_entries();
+}
+
+size_t layer_cache_hits()
+{
+    return LayerFactory<float>::get_instance().get_hits();
+}
+
+size_t layer_cache_misses()
+{
+    return LayerFactory<float>::get_instance().get_misses();
+}
+
+size_t layer_cache_evictions()
+{
+    return LayerFactory<float>::get_instance().get_evictions();
+}
+
+void layer_cache_set_key_by_owner(bool enable)
+{
+    LayerFactory<float>::get_instance().set_key_by_owner(enable);
+}
+
+size_t layer_cache_primitive_descs()
+{
+    return PrimitiveDescCache<convolution_forward::primitive_desc>::get_instance().size()
+        + PrimitiveDescCache<convolution_backward_weights::primitive_desc>::get_instance().size()
+        + PrimitiveDescCache<convolution_backward_data::primitive_desc>::get_instance().size()
+        + PrimitiveDescCache<inner_product_forward::primitive_desc>::get_instance().size()
+        + PrimitiveDescCache<inner_product_backward_weights::primitive_desc>::get_instance().size()
+        + PrimitiveDescCache<inner_product_backward_data::primitive_desc>::get_instance().size();
+}
+
+// key of a relu4d layer as built before LayerKey, one string per field
+static std::string string_relu4d_key(int x_d1, int x_d2, int x_d3, int x_d4)
+{
+    std::string key = "relu4d_";
+    for (int d : {x_d1, x_d2, x_d3, x_d4}) {
+        std::ostringstream os;
+        os << std::hex << "I" << d << "_";
+        key += os.str();
+    }
+    return key;
+}
+
+double layer_cache_lookup_ns(int x_d1, int x_d2, int x_d3, int x_d4,
+                             int niter, bool string_keys)
+{
+    LayerFactory<float>& factory = LayerFactory<float>::get_instance();
+    Layer<float>* layer = factory.get_relu4d_layer(x_d1, x_d2, x_d3, x_d4);
+    if (layer == NULL || niter <= 0)
+        return -1;
+
+    std::unordered_map<std::string, Layer<float>*> map;
+    map[string_relu4d_key(x_d1, x_d2, x_d3, x_d4)] = layer;
+    factory.put_layer(layer);
+
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < niter; i++) {
+        if (string_keys) {
+            auto iter = map.find(string_relu4d_key(x_d1, x_d2, x_d3, x_d4));
+            layer = iter->second;
+        } else {
+            layer = factory.get_relu4d_layer(x_d1, x_d2, x_d3, x_d4);
+            factory.put_layer(layer);
+        }
+    }
+    auto end = std::chrono::steady_clock::now();
+    return std::chrono::duration<double, std::nano>(end - start).count()
+        / niter;
+}
+
 
 // vim: et ts=4 sw=4 cindent cino^=l0,\:0,N-s
@@ -64,15 +64,21 @@
 #ifndef _STREAM_FACTORY_
 #define _STREAM_FACTORY_
 #include <mkldnn.hpp>
-#include <string>
-#include "layer.h"
+#include <atomic>
+#include <memory>
+#include <mutex>
 #include <unordered_map>
+#include <vector>
+#include "layer.h"
 
 // Usage:
-// When stream is created, call:
-// LayerFactory::get_instance().setRELUFwdLayer(<input pointer>, <layer>)
-// then when forward is needed, call
-// layer = LayerFactory::get_instance().getRELUFwdLayer(<input pointer>)
+// Cached layers are checked out while they are in use, so every thread
+// works on its own instance. To get a layer, call:
+// layer = LayerFactory::get_instance().get_relu4d_layer(<dims>)
+// if NULL is returned, create and set up a new one, then call:
+// LayerFactory::get_instance().set_relu4d_layer(<dims>, <layer>)
+// when forward/backward is done, hand the layer back:
+// LayerFactory::get_instance().put_layer(<layer>)
 
 template <typename T>
 class LayerFactory {
@@ -86,25 +92,39 @@ public:
     }
 
 private:
-    Layer<T>* get_layer(std::string      key);
-    void      set_layer(std::string      key,
+#ifndef SWIG
+    Layer<T>* get_layer(const LayerKey&  key);
+    void      set_layer(const LayerKey&  key,
                         Layer<T>*        layer);
+#endif
 
 public:
+    // x_format is the mkldnn::memory::format of an MdArray input,
+    // layers working on numpy arrays use -1
+    // inference selects the forward_inference variant of a layer, it has
+    // no workspace and can not be used for backward
+    // owner identifies the parameter of a layer with weights (the address
+    // of W). It is only part of the key when keying by owner is enabled,
+    // so same-shaped layers get their own instance and weight buffers.
+
     // relu stream
-    Layer<T>* get_relu_layer(int          size);
+    Layer<T>* get_relu_layer(int          size,
+                             double       negative_slope = 0);
     void      set_relu_layer(int          size,
-                             Layer<T>*    layer);
+                             Layer<T>*    layer,
+                             double       negative_slope = 0);
     // relu4d stream
     Layer<T>* get_relu4d_layer(int        x_d1,
                                int        x_d2,
                                int        x_d3,
-                               int        x_d4);
+                               int        x_d4,
+                               int        x_format = -1);
     void      set_relu4d_layer(int        x_d1,
                                int        x_d2,
                                int        x_d3,
                                int        x_d4,
-                               Layer<T>*  layer);
+                               Layer<T>*  layer,
+                               int        x_format = -1);
 
     // maxpool stream
     Layer<T>* get_max_pool_layer(int       x_d1,
@@ -118,7 +138,9 @@ public:
                                  int       pad_l_h,
                                  int       pad_l_w,
                                  int       pad_r_h,
-                                 int       pad_r_w);
+                                 int       pad_r_w,
+                                 int       x_format = -1,
+                                 bool      inference = false);
 
     void      set_max_pool_layer(int       x_d1,
                                  int       x_d2,
@@ -132,7 +154,9 @@ public:
                                  int       pad_l_w,
                                  int       pad_r_h,
                                  int       pad_r_w,
-                                 Layer<T>* layer);
+                                 Layer<T>* layer,
+                                 int       x_format = -1,
+                                 bool      inference = false);
 
     // avgpool stream
     Layer<T>* get_avg_pool_layer(int       x_d1,
@@ -146,7 +170,9 @@ public:
                                  int       pad_l_h,
                                  int       pad_l_w,
                                  int       pad_r_h,
-                                 int       pad_r_w);
+                                 int       pad_r_w,
+                                 int       x_format = -1,
+                                 bool      inference = false);
 
     void      set_avg_pool_layer(int       x_d1,
                                  int       x_d2,
@@ -160,7 +186,9 @@ public:
                                  int       pad_l_w,
                                  int       pad_r_h,
                                  int       pad_r_w,
-                                 Layer<T>* layer);
+                                 Layer<T>* layer,
+                                 int       x_format = -1,
+                                 bool      inference = false);
 
     // Local Response Normalization stream
     // TODO cross channel support
@@ -171,7 +199,9 @@ public:
                             int               local_size,
                             double             k,
                             double             alpha,
-                            double             beta);
+                            double             beta,
+                            int                x_format = -1,
+                            bool               inference = false);
     void          set_lrn_layer(int               x_d1,
                                 int               x_d2,
                                 int               x_d3,
@@ -180,7 +210,9 @@ public:
                                 double             k,
                                 double             alpha,
                                 double             beta,
-                                Layer<T>*     layer);
+                                Layer<T>*     layer,
+                                int           x_format = -1,
+                                bool          inference = false);
 
     // Softmax Cross Entropy stream
     Layer<T>* get_softmax2d_layer(int               d1,
@@ -219,7 +251,12 @@ public:
                                 int           pad_l_h,
                                 int           pad_l_w,
                                 int           pad_r_h,
-                                int           pad_r_w);
+                                int           pad_r_w,
+                                int           x_format = -1,
+                                long          owner = 0,
+                                bool          inference = false,
+                                bool          with_relu = false,
+                                int           groups = 1);
 
     void       set_conv2d_layer(int           x_d1,
                                 int           x_d2,
@@ -238,20 +275,116 @@ public:
                                 int           pad_l_w,
                                 int           pad_r_h,
                                 int           pad_r_w,
-                                Layer<T>*     layer);
+                                Layer<T>*     layer,
+                                int           x_format = -1,
+                                long          owner = 0,
+                                bool          inference = false,
+                                bool          with_relu = false,
+                                int           groups = 1);
+
+    // Deconvolution2d stream
+    Layer<T>* get_deconv2d_layer(int          x_d1,
+                                 int          x_d2,
+                                 int          x_d3,
+                                 int          x_d4,
+                                 int          W_d1,
+                                 int          W_d2,
+                                 int          W_d3,
+                                 int          W_d4,
+                                 int          b_d1,
+                                 int          y_d3,
+                                 int          y_d4,
+                                 int          stride_y,
+                                 int          stride_x,
+                                 int          pad_l_h,
+                                 int          pad_l_w,
+                                 int          pad_r_h,
+                                 int          pad_r_w,
+                                 long         owner = 0);
+
+    void      set_deconv2d_layer(int          x_d1,
+                                 int          x_d2,
+                                 int          x_d3,
+                                 int          x_d4,
+                                 int          W_d1,
+                                 int          W_d2,
+                                 int          W_d3,
+                                 int          W_d4,
+                                 int          b_d1,
+                                 int          y_d3,
+                                 int          y_d4,
+                                 int          stride_y,
+                                 int          stride_x,
+                                 int          pad_l_h,
+                                 int          pad_l_w,
+                                 int          pad_r_h,
+                                 int          pad_r_w,
+                                 Layer<T>*    layer,
+                                 long         owner = 0);
 
     //Linear stream
     Layer<T>* get_linear_layer(int            x_d1,
                                int            x_d2,
                                int            W_d1,
                                int            W_d2,
-                               int            b_d1);
+                               int            b_d1,
+                               long           owner = 0);
     void      set_linear_layer(int            x_d1,
                                int            x_d2,
                                int            W_d1,
                                int            W_d2,
                                int            b_d1,
-                               Layer<T>*      layer);
+                               Layer<T>*      layer,
+                               long           owner = 0);
+
+    // Sum stream, keyed by number of inputs and shape
+    Layer<T>* get_sum_layer(int               num_sum,
+                            int               d1,
+                            int               d2,
+                            int               d3,
+                            int               d4);
+    void      set_sum_layer(int               num_sum,
+                            int               d1,
+                            int               d2,
+                            int               d3,
+                            int               d4,
+                            Layer<T>*         layer);
+
+    // Batch normalization stream
+    Layer<T>* get_batch_norm_layer(int            x_d1,
+                                   int            x_d2,
+                                   int            x_d3,
+                                   int            x_d4,
+                                   double         eps,
+                                   bool           global_stats,
+                                   int            x_format = -1);
+    void      set_batch_norm_layer(int            x_d1,
+                                   int            x_d2,
+                                   int            x_d3,
+                                   int            x_d4,
+                                   double         eps,
+                                   bool           global_stats,
+                                   Layer<T>*      layer,
+                                   int            x_format = -1);
+
+    // Return a checked out layer to the cache
+    void      put_layer(Layer<T>* layer);
+
+    // Cache budget and statistics
+    // A limit of 0 means unlimited. When a layer is put back and the
+    // cache is over budget, least recently used idle layers are deleted.
+    // Layers checked out by a thread are neither counted nor evicted.
+    void      clear();
+    void      set_limit(size_t max_bytes, size_t max_entries);
+    size_t    get_memory_size();
+    size_t    get_entries()   { return entries_; }
+    size_t    get_hits()      { return hits_; }
+    size_t    get_misses()    { return misses_; }
+    size_t    get_evictions() { return evictions_; }
+
+    // Key layers with weights by owner as well as by shape
+    void      set_key_by_owner(bool enable) { key_by_owner_ = enable; }
+    bool      get_key_by_owner() { return key_by_owner_; }
 
     LayerFactory(LayerFactory const&)  = delete;
     void operator=(LayerFactory const&) = delete;
@@ -259,9 +392,116 @@ public:
 private:
     //LayerFactory(LayerFactory const&);
     //void operator=(LayerFactory const&);
-    std::unordered_map<std::string, Layer<T>*> map_;
+#ifndef SWIG
+#define LAYER_FACTORY_SHARDS 16
+    // open addressing table with linear probing, capacity is a power of 2.
+    // The same key may be stored several times, one slot per idle instance.
+    struct Slot {
+        LayerKey  key;
+        Layer<T>* layer;
+        uint64_t  last_use;
+    };
+    // the cache is split in shards with their own lock, so threads working
+    // on different layers do not contend with each other
+    struct Shard {
+        std::mutex        mutex;
+        std::vector<Slot> slots;
+        size_t            size;
+    };
+    Shard& shard_of(const LayerKey& key) {
+        return shards_[(key.hash >> 32) % LAYER_FACTORY_SHARDS];
+    }
+    void grow(Shard& shard);
+    void erase_slot(Shard& shard, size_t i);
+    void evict();
+
+    Shard                 shards_[LAYER_FACTORY_SHARDS];
+    std::mutex            evict_mutex_;
+    std::atomic<uint64_t> tick_;
+    std::atomic<size_t>   entries_;
+
+    std::atomic<size_t>   max_bytes_;
+    std::atomic<size_t>   max_entries_;
+    std::atomic<size_t>   hits_;
+    std::atomic<size_t>   misses_;
+    std::atomic<size_t>   evictions_;
+    std::atomic<bool>     key_by_owner_;
+#endif
 };
 
+#ifndef SWIG
+/*
+ * Read-only primitive descriptors shared by layers of the same geometry.
+ * Layers keyed by owner each have their own primitives and buffers, but
+ * creating the primitive descriptor (the implementation selection) is
+ * only paid once per geometry.
+ */
+template <typename PD>
+class PrimitiveDescCache {
+public:
+    static PrimitiveDescCache& get_instance() {
+        static PrimitiveDescCache instance_;
+        return instance_;
+    }
+
+    // returns the descriptor cached under key, or creates it as PD(args...)
+    template <typename... Args>
+    std::shared_ptr<PD> get(const LayerKey& key, const Args&... args) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto it = pds_.find(key);
+        if (it != pds_.end())
+            return it->second;
+        std::shared_ptr<PD> pd(new PD(args...));
+        pds_[key] = pd;
+        return pd;
+    }
+
+    void clear() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        pds_.clear();
+    }
+
+    size_t size() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return pds_.size();
+    }
+
+private:
+    PrimitiveDescCache() {}
+
+    std::mutex mutex_;
+    std::unordered_map<LayerKey, std::shared_ptr<PD>, LayerKeyHash> pds_;
+};
+#endif // SWIG
+
+/*
+ * Python interface of the float layer cache
+ * Limits are also read from MKLDNN_CACHE_MAX_BYTES and
+ * MKLDNN_CACHE_MAX_ENTRIES at start up.
+ */
+void   layer_cache_clear();
+void   layer_cache_set_limit(size_t max_bytes, size_t max_entries);
+size_t layer_cache_memory_size();
+size_t layer_cache_entries();
+size_t layer_cache_hits();
+size_t layer_cache_misses();
+size_t layer_cache_evictions();
+/*
+ * Key conv and linear layers by the identity of their weights, so
+ * same-shaped layers do not share one instance. Also enabled by
+ * MKLDNN_CACHE_BY_OWNER=1.
+ */
+void   layer_cache_set_key_by_owner(bool enable);
+size_t layer_cache_primitive_descs();
+/*
+ * Mean time in ns of checking out and putting back the idle relu4d layer
+ * of the given shape, which has to be cached already (-1 otherwise).
+ * With string_keys the lookup is done as before LayerKey instead: the key
+ * is formatted into a string and found in an unordered_map, as a baseline.
+ */
+double layer_cache_lookup_ns(int x_d1, int x_d2, int x_d3, int x_d4,
+                             int niter, bool string_keys = false);
+
 #endif // _STREAM_FACTORY_
 
 
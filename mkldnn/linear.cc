@@ -84,7 +84,21 @@ MKLDNNLinear<T>::MKLDNNLinear()
 template<typename T>
 MKLDNNLinear<T>::~MKLDNNLinear()
 {
+    delete this->bwd_data_stream_;
+    delete this->bwd_weights_stream_;
+}
 
+template<typename T>
+size_t MKLDNNLinear<T>::get_memory_size()
+{
+    return this->memory_size(fwd_internal_src_mem_, user_src_mem_)
+        + this->memory_size(fwd_internal_weights_mem_, user_weights_mem_)
+        + this->memory_size(fwd_internal_dst_mem_, user_dst_mem_)
+        + this->memory_size(bwd_internal_src_mem_, user_src_mem_)
+        + this->memory_size(bwd_internal_weights_mem_, user_weights_mem_)
+        + this->memory_size(bwd_internal_dst_diff_mem_, user_dst_diff_mem_)
+        + this->memory_size(bwd_internal_src_diff_mem_, user_src_diff_mem_)
+        + this->memory_size(bwd_internal_weights_diff_mem_, user_weights_diff_mem_);
 }
 
 template <typename T>
@@ -126,7 +140,11 @@ int MKLDNNLinear<T>::setup_forward(T* x, int x_d1, int x_d2, //x_d1 = n, x_d2 =
     }
     //------Determing engine to use ----------
     //Current, treat the engine is MKLDNN:CPU
-    linear_fwd_pd_.reset(new inner_product_forward::primitive_desc(*linear_fwd_desc_, cpu_engine));
+    // primitive descs are shared by layers of the same geometry
+    geometry_key_ = LayerKey(LayerKey::KIND_LINEAR);
+    geometry_key_.add(x_d1).add(x_d2).add(W_d1).add(W_d2).add(b_d1);
+    linear_fwd_pd_ = PrimitiveDescCache<inner_product_forward::primitive_desc>::get_instance().get(
+                        geometry_key_, *linear_fwd_desc_, cpu_engine);
 
     //Create user memory primitive
     user_src_mem_.reset(new memory({{{src_tz}, mpcsn, memory::format::nc}, cpu_engine}, dummy));
@@ -151,7 +169,7 @@ int MKLDNNLinear<T>::setup_forward(T* x, int x_d1, int x_d2, //x_d1 = n, x_d2 =
     /* create reorder primitives between user src and internal src if required */
     if ((*user_src_mem_).get_primitive_desc() != MemPD(linear_fwd_pd_.get()->src_primitive_desc())) {
        LOG(INFO) << "fwd reorder x";
-       fwd_internal_src_mem_.reset(new memory(linear_fwd_pd_.get()->src_primitive_desc()));
+       fwd_internal_src_mem_.reset(new_local_memory(linear_fwd_pd_.get()->src_primitive_desc()));
        fwd_reorder_src_ = reorder(*user_src_mem_, *fwd_internal_src_mem_);
        is_src_reordered = true;
     }
@@ -159,7 +177,7 @@ int MKLDNNLinear<T>::setup_forward(T* x, int x_d1, int x_d2, //x_d1 = n, x_d2 =
     /* create reorder primitives between user weights and internal weights if required */
     if ((*user_weights_mem_).get_primitive_desc() != MemPD(linear_fwd_pd_.get()->weights_primitive_desc())) {
        LOG(INFO) << "fwd reorder W";
-       fwd_internal_weights_mem_.reset(new memory(linear_fwd_pd_.get()->weights_primitive_desc()));
+       fwd_internal_weights_mem_.reset(new_local_memory(linear_fwd_pd_.get()->weights_primitive_desc()));
        fwd_reorder_weights_ = reorder(*user_weights_mem_, *fwd_internal_weights_mem_);
        is_weights_reordered = true;
     }
@@ -167,7 +185,7 @@ int MKLDNNLinear<T>::setup_forward(T* x, int x_d1, int x_d2, //x_d1 = n, x_d2 =
     /* create reorder primitives between user dst and internal dst if required */
     if ((*user_dst_mem_).get_primitive_desc() != MemPD(linear_fwd_pd_.get()->dst_primitive_desc())) {
        LOG(INFO) << "fwd reorder y";
-       fwd_internal_dst_mem_.reset(new memory(linear_fwd_pd_.get()->dst_primitive_desc()));
+       fwd_internal_dst_mem_.reset(new_local_memory(linear_fwd_pd_.get()->dst_primitive_desc()));
        fwd_reorder_dst_ = reorder(*fwd_internal_dst_mem_, *user_dst_mem_);
        is_dst_reordered = true;
     }
@@ -177,8 +195,8 @@ int MKLDNNLinear<T>::setup_forward(T* x, int x_d1, int x_d2, //x_d1 = n, x_d2 =
         linear_fwd_.reset(new inner_product_forward(*linear_fwd_pd_, *fwd_internal_src_mem_, *fwd_internal_weights_mem_, *fwd_internal_dst_mem_));
     if (is_src_reordered)
         this->forward_primitives_.push_back(fwd_reorder_src_);
-    if (is_weights_reordered)
-        this->forward_primitives_.push_back(fwd_reorder_weights_);
+    /* fwd_reorder_weights_ runs on its own, see prepack_weights */
+    fwd_reorder_weights_needed_ = is_weights_reordered;
     this->forward_primitives_.push_back(*linear_fwd_);
     if (is_dst_reordered)
         this->forward_primitives_.push_back(fwd_reorder_dst_);
@@ -224,10 +242,10 @@ int MKLDNNLinear<T>::setup_backward(T* x,  int x_d1, int x_d2,
     }
     //-----Determining engine to use-----------------------
     //Current engine is MKLDNN:CPU
-    linear_bwd_data_pd_.reset(new inner_product_backward_data::primitive_desc(*linear_bwd_data_desc_,
-                cpu_engine, *linear_fwd_pd_));
-    linear_bwd_weights_pd_.reset(new inner_product_backward_weights::primitive_desc(*linear_bwd_weights_desc_,
-                cpu_engine, *linear_fwd_pd_));
+    linear_bwd_data_pd_ = PrimitiveDescCache<inner_product_backward_data::primitive_desc>::get_instance().get(
+                geometry_key_, *linear_bwd_data_desc_, cpu_engine, *linear_fwd_pd_);
+    linear_bwd_weights_pd_ = PrimitiveDescCache<inner_product_backward_weights::primitive_desc>::get_instance().get(
+                geometry_key_, *linear_bwd_weights_desc_, cpu_engine, *linear_fwd_pd_);
     //Create user memory primitive
     user_src_diff_mem_.reset(new memory({{{src_tz}, mpcsn, memory::format::nc}, cpu_engine}, dummy));
     user_weights_diff_mem_.reset(new memory({{{weights_tz}, mpcsn, memory::format::oi}, cpu_engine}, dummy));
@@ -253,7 +271,7 @@ int MKLDNNLinear<T>::setup_backward(T* x,  int x_d1, int x_d2,
     if ((*user_src_mem_).get_primitive_desc()
             != MemPD(linear_bwd_weights_pd_.get()->src_primitive_desc())) {
         LOG(INFO) << "bwd reorder x";
-        bwd_internal_src_mem_.reset(new memory(linear_bwd_weights_pd_.get()->src_primitive_desc()));
+        bwd_internal_src_mem_.reset(new_local_memory(linear_bwd_weights_pd_.get()->src_primitive_desc()));
         bwd_reorder_src_ = reorder(*user_src_mem_, *bwd_internal_src_mem_);
         is_src_reordered = true;
     }
@@ -261,7 +279,7 @@ int MKLDNNLinear<T>::setup_backward(T* x,  int x_d1, int x_d2,
     if ((*user_weights_mem_).get_primitive_desc()
             != MemPD(linear_bwd_data_pd_.get()->weights_primitive_desc())) {
         LOG(INFO) << "bwd reorder w";
-        bwd_internal_weights_mem_.reset(new memory(linear_bwd_data_pd_.get()->weights_primitive_desc()));
+        bwd_internal_weights_mem_.reset(new_local_memory(linear_bwd_data_pd_.get()->weights_primitive_desc()));
         bwd_reorder_weights_ = reorder(*user_weights_mem_, *bwd_internal_weights_mem_);
         is_weights_reordered = true;
     }
@@ -269,7 +287,7 @@ int MKLDNNLinear<T>::setup_backward(T* x,  int x_d1, int x_d2,
     if ((*user_src_diff_mem_).get_primitive_desc()
             != MemPD(linear_bwd_data_pd_.get()->diff_src_primitive_desc())) {
         LOG(INFO) << "bwd reorder gx";
-        bwd_internal_src_diff_mem_.reset(new memory(linear_bwd_data_pd_.get()->diff_src_primitive_desc()));
+        bwd_internal_src_diff_mem_.reset(new_local_memory(linear_bwd_data_pd_.get()->diff_src_primitive_desc()));
         bwd_reorder_src_diff_ = reorder(*bwd_internal_src_diff_mem_, *user_src_diff_mem_);
         is_src_diff_reordered = true;
     }
@@ -277,7 +295,7 @@ int MKLDNNLinear<T>::setup_backward(T* x,  int x_d1, int x_d2,
     if ((*user_weights_diff_mem_).get_primitive_desc()
             != MemPD(linear_bwd_weights_pd_.get()->diff_weights_primitive_desc())) {
         LOG(INFO) << "bwd reorder gw";
-        bwd_internal_weights_diff_mem_.reset(new memory(linear_bwd_weights_pd_.get()->diff_weights_primitive_desc()));
+        bwd_internal_weights_diff_mem_.reset(new_local_memory(linear_bwd_weights_pd_.get()->diff_weights_primitive_desc()));
         bwd_reorder_weights_diff_ = reorder(*bwd_internal_weights_diff_mem_, *user_weights_diff_mem_);
         is_weights_diff_reordered = true;
     }
@@ -285,7 +303,7 @@ int MKLDNNLinear<T>::setup_backward(T* x,  int x_d1, int x_d2,
     if ((*bwd_internal_dst_diff_mem_).get_primitive_desc()
             != MemPD(linear_bwd_weights_pd_.get()->diff_dst_primitive_desc())) {
         LOG(INFO) << "bwd reorder gy";
-        bwd_internal_dst_diff_mem_.reset(new memory(linear_bwd_weights_pd_.get()->diff_dst_primitive_desc()));
+        bwd_internal_dst_diff_mem_.reset(new_local_memory(linear_bwd_weights_pd_.get()->diff_dst_primitive_desc()));
         bwd_reorder_dst_diff_ = reorder(*user_dst_diff_mem_, *bwd_internal_dst_diff_mem_);
         is_dst_diff_reordered = true;
     }
@@ -337,6 +355,13 @@ int MKLDNNLinear<T>::backward(T* x,  int x_d1, int x_d2,
                               T* gb, int gb_d1)
 {
     //LOG(INFO) <<"Linear backward with bias";
+    if (linear_fwd_pd_ == NULL) {
+        // rebuilt after eviction, backward needs forward primitive desc
+        setup_forward(x,  x_d1,  x_d2,
+                      W,  W_d1,  W_d2,
+                      b,  b_d1,
+                      gy, gy_d1, gy_d2);
+    }
     if (linear_bwd_data_pd_ == NULL) {
         setup_backward(x,  x_d1,  x_d2,
                        W,  W_d1,  W_d2,
@@ -374,6 +399,13 @@ int MKLDNNLinear<T>::backward(T* x,  int x_d1, int x_d2,
 {
     //LOG(INFO) <<"Linear backward with bias";
 
+    if (linear_fwd_pd_ == NULL) {
+        // rebuilt after eviction, backward needs forward primitive desc
+        setup_forward(x,  x_d1,  x_d2,
+                      W,  W_d1,  W_d2,
+                      NULL,  -1,
+                      gy, gy_d1, gy_d2);
+    }
     if (linear_bwd_data_pd_ == NULL) {
         setup_backward(x,  x_d1,  x_d2,
                       W,  W_d1,  W_d2,
@@ -407,7 +439,8 @@ template <typename T>
 int MKLDNNLinear<T>::forward(T* x, int x_d1, int x_d2,
                              T* W, int W_d1, int W_d2,
                              T* b, int b_d1,
-                             T* y, int y_d1, int y_d2)
+                             T* y, int y_d1, int y_d2,
+                             long W_version)
 {
     //LOG(INFO) << "Linear forward";
     //LOG(INFO) << "x = (" << x_d1 << "," << x_d2 << ")";
@@ -424,6 +457,8 @@ int MKLDNNLinear<T>::forward(T* x, int x_d1, int x_d2,
     user_weights_mem_->set_data_handle(W);
     user_bias_mem_->set_data_handle(b);
     user_dst_mem_->set_data_handle(y);
+    if (fwd_reorder_weights_needed_)
+        this->prepack_weights(fwd_reorder_weights_, W, W_version);
 
     if (this->forward_first_use_) {
         LOG(INFO) << "linear forward first use";
@@ -438,7 +473,8 @@ int MKLDNNLinear<T>::forward(T* x, int x_d1, int x_d2,
 template <typename T>
 int MKLDNNLinear<T>::forward(T* x, int x_d1, int x_d2,
                              T* W, int W_d1, int W_d2,
-                             T* y, int y_d1, int y_d2)
+                             T* y, int y_d1, int y_d2,
+                             long W_version)
 {
     //LOG(INFO) << "Linear forward";
     //LOG(INFO) << "x = (" << x_d1 << "," << x_d2 << ")";
@@ -454,6 +490,8 @@ int MKLDNNLinear<T>::forward(T* x, int x_d1, int x_d2,
     user_src_mem_->set_data_handle(x);
     user_weights_mem_->set_data_handle(W);
     user_dst_mem_->set_data_handle(y);
+    if (fwd_reorder_weights_needed_)
+        this->prepack_weights(fwd_reorder_weights_, W, W_version);
 
     if (this->forward_first_use_) {
         //LOG(INFO) << "linear forward first use";
@@ -83,14 +83,14 @@ private:
                             LayerFactory<T>::get_instance().get_linear_layer(
                                 x_d1, x_d2,
                                 W_d1, W_d2,
-                                b_d1));
+                                b_d1, (long)W));
         if (linear_forward == NULL) {
             linear_forward = new MKLDNNLinear();
             LayerFactory<T>::get_instance().set_linear_layer(
                                 x_d1, x_d2,
                                 W_d1, W_d2,
                                 b_d1,
-                                linear_forward);
+                                linear_forward, (long)W);
         }
         return linear_forward;
     }
@@ -105,8 +105,14 @@ private:
                             LayerFactory<T>::get_instance().get_linear_layer(
                                 x_d1, x_d2,
                                 W_d1, W_d2,
-                                b_d1));
-        assert(linear_backward != NULL);//We must have already done backward before
+                                b_d1, (long)W));
+        if (linear_backward == NULL) {
+            // no idle forward object in the cache (evicted or in use),
+            // backward will set up forward primitives again
+            linear_backward = get_forward_object(x, x_d1, x_d2,
+                                                 W, W_d1, W_d2,
+                                                 b, b_d1);
+        }
         return linear_backward;
     }
 
@@ -114,7 +120,8 @@ public:
     static void do_forward( T* x, int x_d1, int x_d2,
                             T* W, int W_d1, int W_d2,
                             T* b, int b_d1,
-                            T* y, int y_d1, int y_d2)
+                            T* y, int y_d1, int y_d2,
+                            long W_version = -1)
     {
         MKLDNNLinear<T> *fwd_object = get_forward_object(
                                             x, x_d1, x_d2,
@@ -123,19 +130,24 @@ public:
         fwd_object->forward(x, x_d1, x_d2,
                             W, W_d1, W_d2,
                             b, b_d1,
-                            y, y_d1, y_d2);
+                            y, y_d1, y_d2,
+                            W_version);
+        LayerFactory<T>::get_instance().put_layer(fwd_object);
     }
 
     static void do_forward(T* x, int x_d1, int x_d2,
                            T* W, int W_d1, int W_d2,
-                           T* y, int y_d1, int y_d2)
+                           T* y, int y_d1, int y_d2,
+                           long W_version = -1)
     {
         MKLDNNLinear<T>* fwd_object = get_forward_object(x, x_d1, x_d2,
                                                          W, W_d1, W_d2,
                                                          NULL, -1);
         fwd_object->forward(x, x_d1, x_d2,
                             W, W_d1, W_d2,
-                            y, y_d1, y_d2);
+                            y, y_d1, y_d2,
+                            W_version);
+        LayerFactory<T>::get_instance().put_layer(fwd_object);
     }
 
     static void do_backward(T* x, int x_d1, int x_d2,
@@ -156,6 +168,7 @@ public:
                              gW, gW_d1, gW_d2,
                              gx, gx_d1, gx_d2,
                              gb, gb_d1);
+        LayerFactory<T>::get_instance().put_layer(bwd_object);
     }
 
     static void do_backward(T* x, int x_d1, int x_d2,
@@ -172,6 +185,7 @@ public:
                              gy, gy_d1, gy_d2,
                              gW, gW_d1, gW_d2,
                              gx, gx_d1, gx_d2);
+        LayerFactory<T>::get_instance().put_layer(bwd_object);
     }
 
 
@@ -179,6 +193,8 @@ public:
 
     ~MKLDNNLinear();
 
+    size_t get_memory_size();
+
     int setup_forward(T* x, int x_d1, int x_d2,
                        T* W, int W_d1, int W_d2,
                        T* b, int b_d1,
@@ -187,11 +203,13 @@ public:
     int forward(T* x, int x_d1, int x_d2,
                 T* W, int W_d1, int W_d2,
                 T* b, int b_d1,
-                T* y, int y_d1, int y_d2);
+                T* y, int y_d1, int y_d2,
+                long W_version = -1);
 
     int forward(T* x, int x_d1, int x_d2,
                 T* W, int W_d1, int W_d2,
-                T* y, int y_d1, int y_d2);
+                T* y, int y_d1, int y_d2,
+                long W_version = -1);
 
     int setup_backward(T* x,  int x_d1, int x_d2,
                         T* W,  int W_d1, int W_d2,
@@ -243,6 +261,7 @@ private:
     //forward
     mkldnn::primitive fwd_reorder_src_;
     mkldnn::primitive fwd_reorder_weights_;
+    bool fwd_reorder_weights_needed_ = false;
     mkldnn::primitive fwd_reorder_dst_;
     mkldnn::primitive bwd_reorder_src_;
     mkldnn::primitive bwd_reorder_weights_;
@@ -252,6 +271,9 @@ private:
     //linear forward backward primitive
     std::shared_ptr<mkldnn::inner_product_forward::desc> linear_fwd_desc_;
     std::shared_ptr<mkldnn::inner_product_forward::primitive_desc> linear_fwd_pd_;
+#ifndef SWIG
+    LayerKey geometry_key_;
+#endif
     std::shared_ptr<mkldnn::primitive> linear_fwd_;
     std::shared_ptr<mkldnn::inner_product_backward_data::desc> linear_bwd_data_desc_;
     std::shared_ptr<mkldnn::inner_product_backward_weights::desc> linear_bwd_weights_desc_;
@@ -108,21 +108,29 @@ LocalResponseNormalization<T>::~LocalResponseNormalization()
 }
 
 
+template<typename T>
+size_t LocalResponseNormalization<T>::get_memory_size()
+{
+    // workspace is bound to the python buffer
+    return this->memory_size(x_mem_, user_x_mem_)
+        + this->memory_size(y_mem_, user_y_mem_)
+        + this->memory_size(gx_mem_, lrn_diff_src_mem_)
+        + this->memory_size(gy_mem_, lrn_diff_dst_mem_);
+}
+
 template<typename T>
 int LocalResponseNormalization<T>::forward_setup(
     T* x, int x_d1, int x_d2, int x_d3, int x_d4,
     T* y, int y_d1, int y_d2, int y_d3, int y_d4)
 {
     memory::format format;
-    // we check AVX512 first then AVX2
-    if (cpu_support_avx512_p() && (x_d2%16)==0) {
-        format = memory::format::nChw16c;
-        LOG(INFO) << "forward_setup nChw16c";
-    } else if (cpu_support_avx2_p() && (x_d2%8)==0) {
-        format = memory::format::nChw8c;
-        LOG(INFO) << "forward_setup nChw8c";
+    memory::format user_format = p_.data_format;
+    if (x_format_ >= 0) {
+        // MdArray input, normalize in its format for inference only
+        format = user_format = (memory::format)x_format_;
     } else {
-        format = memory::format::nchw;
+        format = cpu_blocked_format(x_d2);
+        LOG(INFO) << "forward_setup format " << format;
     }
     // LOG(INFO) << "forward_setup";
     // LOG(INFO) << "lrn_src_tz "<< x_d1 << x_d2<< x_d3 << x_d4 ;
@@ -132,7 +140,7 @@ int LocalResponseNormalization<T>::forward_setup(
 
     /* create memory for user data */
     LOG(INFO) << "create memory for user data";
-    user_x_mem_.reset(new memory({{{lrn_src_tz}, memory_data_type<T>(),p_.data_format}, *eng_}, dummy));
+    user_x_mem_.reset(new memory({{{lrn_src_tz}, memory_data_type<T>(),user_format}, *eng_}, dummy));
     x_md_.reset(new memory::desc({lrn_src_tz}, memory_data_type<T>(),format));
 
 
@@ -149,12 +157,12 @@ int LocalResponseNormalization<T>::forward_setup(
 
     x_mem_ = user_x_mem_;
     y_mem_ = user_y_mem_;
-    // y_mem_.reset(new memory(lrn_fwd_pd_.get()->dst_primitive_desc()));
+    // y_mem_.reset(new_local_memory(lrn_fwd_pd_.get()->dst_primitive_desc()));
     bool reorder_x_p = false;
     bool reorder_y_p = false;
 
 
-    if (format != memory::format::nchw) {
+    if (format != user_format) {
         x_mem_.reset(new memory({{{lrn_src_tz}, memory_data_type<T>(),
                         format}, *eng_}));
 
@@ -162,20 +170,29 @@ int LocalResponseNormalization<T>::forward_setup(
         reorder_x_p = true;
     }
 
-    if (memory::primitive_desc(lrn_fwd_pd_.get()->dst_primitive_desc())
+    if (x_format_ >= 0) {
+        // MdArray output, keep the format chosen by lrn
+        user_y_mem_.reset(new memory(lrn_fwd_pd_.get()->dst_primitive_desc(), dummy));
+        y_mem_ = user_y_mem_;
+    } else if (memory::primitive_desc(lrn_fwd_pd_.get()->dst_primitive_desc())
         != user_y_mem_->get_primitive_desc()) {
-        y_mem_.reset(new memory(lrn_fwd_pd_.get()->dst_primitive_desc()));
+        y_mem_.reset(new_local_memory(lrn_fwd_pd_.get()->dst_primitive_desc()));
         reorder_y_ = reorder(*y_mem_, *user_y_mem_);
         reorder_y_p = true;
     }
 
-    // LOG(INFO) << "workspace_primitive_desc";
-    workspace_mem_.reset(new memory(lrn_fwd_pd_->workspace_primitive_desc(),dummy));
-    auto workspace_size = lrn_fwd_pd_->workspace_primitive_desc().get_size();
+    size_t workspace_size = 0;
+    if (p_.aprop_kind == prop_kind::forward_inference) {
+        lrn_fwd_.reset(new lrn_forward(*lrn_fwd_pd_, *x_mem_, *y_mem_));
+    } else {
+        // LOG(INFO) << "workspace_primitive_desc";
+        workspace_mem_.reset(new memory(lrn_fwd_pd_->workspace_primitive_desc(),dummy));
+        workspace_size = lrn_fwd_pd_->workspace_primitive_desc().get_size();
+        LOG(INFO) << "workspace_size_ is " << workspace_size;
+        // LOG(INFO) << "lrn_fwd_";
+        lrn_fwd_.reset(new lrn_forward(*lrn_fwd_pd_, *x_mem_, *workspace_mem_, *y_mem_));
+    }
     workspace_size_ = workspace_size;
-    LOG(INFO) << "workspace_size_ is " << workspace_size;
-    // LOG(INFO) << "lrn_fwd_";
-    lrn_fwd_.reset(new lrn_forward(*lrn_fwd_pd_, *x_mem_, *workspace_mem_, *y_mem_));
 
     LOG(INFO) << "    reorder_src: " << reorder_x_p;
     LOG(INFO) << "    reorder_dst: " << reorder_y_p;
@@ -194,7 +211,8 @@ void LocalResponseNormalization<T>::fwd_reset_mem(T* x,T* y,T* ws)
     // LOG(INFO) << "x " << x << "y " << y << "ws " << ws;
     user_x_mem_->set_data_handle(x);
     user_y_mem_->set_data_handle(y);
-    workspace_mem_->set_data_handle(ws);
+    if (workspace_mem_)
+        workspace_mem_->set_data_handle(ws);
 }
 
 // template<typename T>
@@ -241,17 +259,8 @@ int LocalResponseNormalization<T>::backward_setup(
     T* gy, int gy_d1, int gy_d2, int gy_d3, int gy_d4,
     T* gx, int gx_d1, int gx_d2, int gx_d3, int gx_d4)
 {
-    memory::format format;
-    // we check AVX512 first then AVX2
-    if (cpu_support_avx512_p() && (x_d2%16)==0) {
-        LOG(INFO) << "backward_setup nChw16c";
-        format = memory::format::nChw16c;
-    } else if (cpu_support_avx2_p() && (x_d2%8)==0) {
-        format = memory::format::nChw8c;
-        LOG(INFO) << "backward_setup nChw8c";
-    } else {
-        format = memory::format::nchw;
-    }
+    memory::format format = cpu_blocked_format(x_d2);
+    LOG(INFO) << "backward_setup format " << format;
 
     /* Backward lrn */
     memory::dims lrn_src_tz = {x_d1, x_d2, x_d3, x_d4};
@@ -295,7 +304,7 @@ int LocalResponseNormalization<T>::backward_setup(
 
     if (memory::primitive_desc(lrn_bwd_pd_.get()->diff_src_primitive_desc())
         != lrn_diff_src_mem_->get_primitive_desc()) {
-        gx_mem_.reset(new memory(lrn_bwd_pd_.get()->diff_src_primitive_desc()));
+        gx_mem_.reset(new_local_memory(lrn_bwd_pd_.get()->diff_src_primitive_desc()));
         reorder_gx_ = reorder(*gx_mem_, *lrn_diff_src_mem_);
         reorder_x_p = true;
     }
@@ -333,6 +342,11 @@ int LocalResponseNormalization<T>::backward(
     T* ws, int ws_d)
 {
     // LOG(INFO) << "backward: " << x << " : " << x_size << " : " << gy << " : " << gy_size << " : " << gx << " : " << gx_size;
+    if (!lrn_fwd_pd_) {
+        // rebuilt after eviction, backward needs forward primitive desc
+        forward_setup(x, x_d1, x_d2, x_d3, x_d4,
+                      gy, gy_d1, gy_d2, gy_d3, gy_d4);
+    }
     if (!bwd_stream_) {
         backward_setup(
             x, x_d1, x_d2, x_d3, x_d4,
@@ -357,17 +371,43 @@ int LocalResponseNormalization<T>::forward()
 template<typename T>
 LocalResponseNormalization<T>* LocalResponseNormalization<T>::get_forward_object(
     int x_d1, int x_d2, int x_d3, int x_d4,
-    int n, double k, double alpha, double beta, mkldnn::algorithm alg_kind)
+    int n, double k, double alpha, double beta, mkldnn::algorithm alg_kind,
+    int x_format, bool inference)
 {
     auto lrn_forward = dynamic_cast<LocalResponseNormalization<T>*>(
-        LayerFactory<T>::get_instance().get_lrn_layer(x_d1,x_d2,x_d3,x_d4,n,k,alpha,beta));
+        LayerFactory<T>::get_instance().get_lrn_layer(x_d1,x_d2,x_d3,x_d4,n,k,alpha,beta,x_format,inference));
     if (lrn_forward == NULL) {
         lrn_forward = new LocalResponseNormalization<T>(n,k,alpha,beta,alg_kind);
+        lrn_forward->x_format_ = x_format;
+        if (inference)
+            lrn_forward->p_.aprop_kind = prop_kind::forward_inference;
         // LOG(INFO) << "new lrn obj " << lrn << " dim " << x_d1;
-        LayerFactory<T>::get_instance().set_lrn_layer(x_d1,x_d2,x_d3,x_d4,n,k,alpha,beta,lrn_forward);
+        LayerFactory<T>::get_instance().set_lrn_layer(x_d1,x_d2,x_d3,x_d4,n,k,alpha,beta,lrn_forward,x_format,inference);
     }
     return lrn_forward;
 }
+template<typename T>
+MdArray<T>* LocalResponseNormalization<T>::do_forward_md(
+    MdArray<T>* x,
+    int n, double k, double alpha, double beta,
+    mkldnn::algorithm alg_kind)
+{
+    T* x_data = (T*)x->get_data_handle();
+    int x_d1 = x->dim(0), x_d2 = x->dim(1), x_d3 = x->dim(2), x_d4 = x->dim(3);
+    auto forward_object = get_forward_object(
+        x_d1, x_d2, x_d3, x_d4, n, k, alpha, beta, alg_kind, x->format(), true);
+    if (!forward_object->fwd_stream_) {
+        forward_object->forward_setup(x_data, x_d1, x_d2, x_d3, x_d4,
+                                      NULL, x_d1, x_d2, x_d3, x_d4);
+    }
+    MdArray<T>* y = new MdArray<T>(forward_object->y_mem_->get_primitive_desc());
+    forward_object->forward(x_data, x_d1, x_d2, x_d3, x_d4,
+                            (T*)y->get_data_handle(), x_d1, x_d2, x_d3, x_d4,
+                            NULL, 0);
+    LayerFactory<T>::get_instance().put_layer(forward_object);
+    return y;
+}
+
 template<typename T>
 LocalResponseNormalization<T>* LocalResponseNormalization<T>::get_backward_object(
     int x_d1, int x_d2, int x_d3, int x_d4,
@@ -375,7 +415,12 @@ LocalResponseNormalization<T>* LocalResponseNormalization<T>::get_backward_objec
 {
     auto lrn_backward = dynamic_cast<LocalResponseNormalization<T>*>(
         LayerFactory<T>::get_instance().get_lrn_layer(x_d1,x_d2,x_d3,x_d4,n,k,alpha,beta));
-    assert (lrn_backward != NULL);  // we must have already done forward before
+    if (lrn_backward == NULL) {
+        // no idle forward object in the cache (evicted or in use),
+        // backward will set up forward primitives again
+        lrn_backward = get_forward_object(x_d1, x_d2, x_d3, x_d4,
+                                          n, k, alpha, beta, alg_kind);
+    }
     return lrn_backward;
 }
 
@@ -71,6 +71,7 @@
 #include <memory>
 #include "layer.h"
 #include "layer_factory.h"
+#include "mdarray.h"
 
 template <typename T>
 class LocalResponseNormalization : public Layer<T>
@@ -90,6 +91,8 @@ public:
 public:
     LocalResponseNormalization(int n, double k, double alpha, double beta, mkldnn::algorithm alg_kind);
     ~LocalResponseNormalization();
+
+    size_t get_memory_size();
 public:
     int forward();
     static int get_workspace_size(
@@ -102,13 +105,15 @@ public:
         auto forward_object = get_forward_object(
             x_d1, x_d2, x_d3, x_d4, n, k, alpha, beta, alg_kind);
         // LOG(INFO) << "forward";
+        int workspace_size;
         if (forward_object->workspace_size_ != 0 && !forward_object->forward_first_use_){
-            return forward_object->workspace_size_;
+            workspace_size = forward_object->workspace_size_;
         }else{
-            return forward_object->forward_setup(x, x_d1, x_d2, x_d3, x_d4,
+            workspace_size = forward_object->forward_setup(x, x_d1, x_d2, x_d3, x_d4,
                       y, y_d1, y_d2, y_d3, y_d4);
         }
-
+        LayerFactory<T>::get_instance().put_layer(forward_object);
+        return workspace_size;
     }
     static void do_forward(
         T*   x,  int x_d1,  int x_d2,  int x_d3,  int x_d4,
@@ -124,7 +129,33 @@ public:
         forward_object->forward(x,  x_d1,  x_d2,  x_d3,  x_d4,
                                 y,  y_d1,  y_d2,  y_d3,  y_d4,
                                 ws, ws_d);
+        LayerFactory<T>::get_instance().put_layer(forward_object);
+    }
+    /*
+     * LRN for inference with forward_inference, no workspace is produced
+     * so it can not be followed by do_backward
+     */
+    static void do_forward(
+        T*   x,  int x_d1,  int x_d2,  int x_d3,  int x_d4,
+        T*   y,  int y_d1,  int y_d2,  int y_d3,  int y_d4,
+        int n, double k, double alpha, double beta,
+        mkldnn::algorithm alg_kind = mkldnn::algorithm::lrn_across_channels)
+    {
+        auto forward_object = get_forward_object(
+            x_d1, x_d2, x_d3, x_d4, n, k, alpha, beta, alg_kind, -1, true);
+        forward_object->forward(x,  x_d1,  x_d2,  x_d3,  x_d4,
+                                y,  y_d1,  y_d2,  y_d3,  y_d4,
+                                NULL, 0);
+        LayerFactory<T>::get_instance().put_layer(forward_object);
     }
+    /*
+     * LRN on an MdArray for inference, no workspace is produced so it
+     * can not be followed by do_backward
+     */
+    static MdArray<T>* do_forward_md(
+        MdArray<T>* x,
+        int n, double k, double alpha, double beta,
+        mkldnn::algorithm alg_kind = mkldnn::algorithm::lrn_across_channels);
     static void do_backward(
         T*   x,  int x_d1,  int x_d2,  int x_d3,  int x_d4,
         T*   gy, int gy_d1, int gy_d2, int gy_d3, int gy_d4,
@@ -141,6 +172,7 @@ public:
                                   gy, gy_d1, gy_d2, gy_d3, gy_d4,
                                   gx, gx_d1, gx_d2, gx_d3, gx_d4,
                                   ws, ws_d);
+        LayerFactory<T>::get_instance().put_layer(backward_object);
     }
 private:
     int backward(
@@ -166,7 +198,8 @@ private:
 protected:
     static LocalResponseNormalization<T>* get_forward_object(
         int x_d1, int x_d2, int x_d3, int x_d4,
-        int n, double k, double alpha, double beta, mkldnn::algorithm alg_kind);
+        int n, double k, double alpha, double beta, mkldnn::algorithm alg_kind,
+        int x_format = -1, bool inference = false);
 
     static LocalResponseNormalization<T>* get_backward_object(
         int x_d1, int x_d2, int x_d3, int x_d4,
@@ -175,6 +208,8 @@ private:
     lrn_params p_;
     size_t                                                    workspace_size_;
     bool                                                      forward_first_use_;
+    // format of the MdArray input, -1 for numpy input and output
+    int                                                       x_format_ = -1;
     //forward
     std::shared_ptr<mkldnn::memory>                           user_x_mem_;
     std::shared_ptr<mkldnn::memory>                           user_y_mem_;
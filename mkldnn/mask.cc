@@ -0,0 +1,247 @@
+/*
+ *COPYRIGHT
+ *All modification made by Intel Corporation: © 2017 Intel Corporation.
+ *Copyright (c) 2015 Preferred Infrastructure, Inc.
+ *Copyright (c) 2015 Preferred Networks, Inc.
+ *
+ *Permission is hereby granted, free of charge, to any person obtaining a copy
+ *of this software and associated documentation files (the "Software"), to deal
+ *in the Software without restriction, including without limitation the rights
+ *to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ *copies of the Software, and to permit persons to whom the Software is
+ *furnished to do so, subject to the following conditions:
+ *
+ *The above copyright notice and this permission notice shall be included in
+ *all copies or substantial portions of the Software.
+ *
+ *THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ *AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ *OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ *THE SOFTWARE.
+ *
+ *
+ *######################################################################
+ *# The CuPy is designed based on NumPy's API.
+ *# CuPy's source code and documents contain the original NumPy ones.
+ *######################################################################
+ *Copyright (c) 2005-2016, NumPy Developers.
+ *All rights reserved.
+ *
+ *Redistribution and use in source and binary forms, with or without
+ *modification, are permitted provided that the following conditions are
+ *met:
+ *
+ *    * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *
+ *    * Redistributions in binary form must reproduce the above
+ *       copyright notice, this list of conditions and the following
+ *       disclaimer in the documentation and/or other materials provided
+ *       with the distribution.
+ *
+ *    * Neither the name of the NumPy Developers nor the names of any
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ *THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *"AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ *A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ *OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ *SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ *LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ *DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ *THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ *(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ *OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *######################################################################
+ */
+
+
+#include <omp.h>
+#include <string.h>
+#include <algorithm>
+#include <limits>
+#include <stdexcept>
+#include "mask.h"
+
+// Bytes of mask per thread chunk, 32K elements
+#define MASK_MIN_CHUNK 4096
+
+template<typename T>
+void ReluMask<T>::do_forward(T* x, int x_d1,
+                             T* y, int y_d1,
+                             unsigned char* mask, int mask_d1)
+{
+    if (y_d1 != x_d1 || mask_d1 < (x_d1 + 7) / 8)
+        throw std::invalid_argument("ReluMask: size of y or mask mismatch");
+    const int full = x_d1 / 8;
+
+    #pragma omp parallel for schedule(static) if (full > MASK_MIN_CHUNK)
+    for (int b = 0; b < full; b++) {
+        const T* xb = x + b * 8;
+        T* yb = y + b * 8;
+        unsigned char m = 0;
+        for (int j = 0; j < 8; j++) {
+            T v = xb[j];
+            bool pos = v > 0;
+            yb[j] = pos ? v : 0;
+            m |= (unsigned char)pos << j;
+        }
+        mask[b] = m;
+    }
+
+    if (full * 8 < x_d1) {
+        unsigned char m = 0;
+        for (int i = full * 8; i < x_d1; i++) {
+            T v = x[i];
+            bool pos = v > 0;
+            y[i] = pos ? v : 0;
+            m |= (unsigned char)pos << (i - full * 8);
+        }
+        mask[full] = m;
+    }
+}
+
+template<typename T>
+void ReluMask<T>::do_backward(T* gy, int gy_d1,
+                              unsigned char* mask, int mask_d1,
+                              T* gx, int gx_d1)
+{
+    if (gx_d1 != gy_d1 || mask_d1 < (gy_d1 + 7) / 8)
+        throw std::invalid_argument("ReluMask: size of gx or mask mismatch");
+    const int full = gy_d1 / 8;
+
+    #pragma omp parallel for schedule(static) if (full > MASK_MIN_CHUNK)
+    for (int b = 0; b < full; b++) {
+        const T* gyb = gy + b * 8;
+        T* gxb = gx + b * 8;
+        unsigned char m = mask[b];
+        for (int j = 0; j < 8; j++)
+            gxb[j] = (m >> j) & 1 ? gyb[j] : 0;
+    }
+
+    for (int i = full * 8; i < gy_d1; i++)
+        gx[i] = (mask[full] >> (i - full * 8)) & 1 ? gy[i] : 0;
+}
+
+// Checks that the output of pooling (n, c, h, w) with the given geometry is
+// (out_n, out_c, out_h, out_w), and that the mask has the same shape
+static void check_pooling_sizes(
+                int n, int c, int h, int w,
+                int out_n, int out_c, int out_h, int out_w,
+                int mask_d1, int mask_d2, int mask_d3, int mask_d4,
+                int s_y, int s_x, int p_u, int p_d, int p_l, int p_r,
+                int ker_h, int ker_w)
+{
+    if (ker_h <= 0 || ker_w <= 0 || ker_h * ker_w > MASK_EMPTY_WINDOW)
+        throw std::invalid_argument("MaxPoolingMask: bad kernel size");
+    if (s_y <= 0 || s_x <= 0 ||
+            out_h != (h + p_u + p_d - ker_h) / s_y + 1 ||
+            out_w != (w + p_l + p_r - ker_w) / s_x + 1 ||
+            out_n != n || out_c != c)
+        throw std::invalid_argument("MaxPoolingMask: output size mismatch");
+    if (mask_d1 != out_n || mask_d2 != out_c ||
+            mask_d3 != out_h || mask_d4 != out_w)
+        throw std::invalid_argument("MaxPoolingMask: mask size mismatch");
+}
+
+template<typename T>
+void MaxPoolingMask<T>::do_forward(
+                T* x, int x_d1, int x_d2, int x_d3, int x_d4,
+                T* y, int y_d1, int y_d2, int y_d3, int y_d4,
+                unsigned char* mask,
+                int mask_d1, int mask_d2, int mask_d3, int mask_d4,
+                int s_y, int s_x,
+                int p_u, int p_d, int p_l, int p_r,
+                int ker_h, int ker_w)
+{
+    check_pooling_sizes(x_d1, x_d2, x_d3, x_d4, y_d1, y_d2, y_d3, y_d4,
+                        mask_d1, mask_d2, mask_d3, mask_d4,
+                        s_y, s_x, p_u, p_d, p_l, p_r, ker_h, ker_w);
+    const int h = x_d3, w = x_d4;
+    const int out_h = y_d3, out_w = y_d4;
+    const int planes = x_d1 * x_d2;
+
+    #pragma omp parallel for collapse(2) schedule(static)
+    for (int p = 0; p < planes; p++) {
+        for (int oy = 0; oy < out_h; oy++) {
+            const T* xp = x + (size_t)p * h * w;
+            T* yp = y + ((size_t)p * out_h + oy) * out_w;
+            unsigned char* mp = mask + ((size_t)p * out_h + oy) * out_w;
+            const int y0 = oy * s_y - p_u;
+            const int ky0 = std::max(0, -y0);
+            const int ky1 = std::min(ker_h, h - y0);
+            for (int ox = 0; ox < out_w; ox++) {
+                const int x0 = ox * s_x - p_l;
+                const int kx0 = std::max(0, -x0);
+                const int kx1 = std::min(ker_w, w - x0);
+                if (ky0 >= ky1 || kx0 >= kx1) {
+                    yp[ox] = -std::numeric_limits<T>::infinity();
+                    mp[ox] = MASK_EMPTY_WINDOW;
+                    continue;
+                }
+                // the first maximum wins, as numpy's argmax
+                T best = xp[(y0 + ky0) * w + x0 + kx0];
+                int arg = ky0 * ker_w + kx0;
+                for (int ky = ky0; ky < ky1; ky++) {
+                    const T* row = xp + (y0 + ky) * w + x0;
+                    for (int kx = kx0; kx < kx1; kx++) {
+                        if (row[kx] > best) {
+                            best = row[kx];
+                            arg = ky * ker_w + kx;
+                        }
+                    }
+                }
+                yp[ox] = best;
+                mp[ox] = (unsigned char)arg;
+            }
+        }
+    }
+}
+
+template<typename T>
+void MaxPoolingMask<T>::do_backward(
+                T* gy, int gy_d1, int gy_d2, int gy_d3, int gy_d4,
+                unsigned char* mask,
+                int mask_d1, int mask_d2, int mask_d3, int mask_d4,
+                T* gx, int gx_d1, int gx_d2, int gx_d3, int gx_d4,
+                int s_y, int s_x,
+                int p_u, int p_d, int p_l, int p_r,
+                int ker_h, int ker_w)
+{
+    check_pooling_sizes(gx_d1, gx_d2, gx_d3, gx_d4, gy_d1, gy_d2, gy_d3, gy_d4,
+                        mask_d1, mask_d2, mask_d3, mask_d4,
+                        s_y, s_x, p_u, p_d, p_l, p_r, ker_h, ker_w);
+    const int h = gx_d3, w = gx_d4;
+    const int out_h = gy_d3, out_w = gy_d4;
+    const int planes = gx_d1 * gx_d2;
+
+    // windows overlap within a plane, so a plane belongs to one thread
+    #pragma omp parallel for schedule(static)
+    for (int p = 0; p < planes; p++) {
+        T* gxp = gx + (size_t)p * h * w;
+        const T* gyp = gy + (size_t)p * out_h * out_w;
+        const unsigned char* mp = mask + (size_t)p * out_h * out_w;
+        memset(gxp, 0, sizeof(T) * h * w);
+        for (int oy = 0; oy < out_h; oy++) {
+            for (int ox = 0; ox < out_w; ox++) {
+                const int i = oy * out_w + ox;
+                if (mp[i] == MASK_EMPTY_WINDOW)
+                    continue;
+                const int iy = oy * s_y - p_u + mp[i] / ker_w;
+                const int ix = ox * s_x - p_l + mp[i] % ker_w;
+                gxp[iy * w + ix] += gyp[i];
+            }
+        }
+    }
+}
+
+template class ReluMask<float>;
+template class MaxPoolingMask<float>;
+
+
+// vim: et ts=4 sw=4 cindent cino^=l0,\:0,N-s
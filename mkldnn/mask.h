@@ -0,0 +1,117 @@
+/*
+ *COPYRIGHT
+ *All modification made by Intel Corporation: © 2017 Intel Corporation.
+ *Copyright (c) 2015 Preferred Infrastructure, Inc.
+ *Copyright (c) 2015 Preferred Networks, Inc.
+ *
+ *Permission is hereby granted, free of charge, to any person obtaining a copy
+ *of this software and associated documentation files (the "Software"), to deal
+ *in the Software without restriction, including without limitation the rights
+ *to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ *copies of the Software, and to permit persons to whom the Software is
+ *furnished to do so, subject to the following conditions:
+ *
+ *The above copyright notice and this permission notice shall be included in
+ *all copies or substantial portions of the Software.
+ *
+ *THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ *AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ *OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ *THE SOFTWARE.
+ *
+ *
+ *######################################################################
+ *# The CuPy is designed based on NumPy's API.
+ *# CuPy's source code and documents contain the original NumPy ones.
+ *######################################################################
+ *Copyright (c) 2005-2016, NumPy Developers.
+ *All rights reserved.
+ *
+ *Redistribution and use in source and binary forms, with or without
+ *modification, are permitted provided that the following conditions are
+ *met:
+ *
+ *    * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *
+ *    * Redistributions in binary form must reproduce the above
+ *       copyright notice, this list of conditions and the following
+ *       disclaimer in the documentation and/or other materials provided
+ *       with the distribution.
+ *
+ *    * Neither the name of the NumPy Developers nor the names of any
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ *THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *"AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ *A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ *OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ *SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ *LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ *DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ *THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ *(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ *OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *######################################################################
+ */
+
+
+#ifndef _MASK_H_
+#define _MASK_H_
+
+/*
+ * Compact backward state for ReLU and max pooling. ReLU keeps one bit per
+ * element for the sign of x, max pooling keeps the argmax within each
+ * window as a byte (ky * ker_w + kx), so neither backward reads x.
+ * Array sizes are checked, a mismatch throws std::invalid_argument
+ * (ValueError in Python).
+ */
+
+// Mask byte of a pooling window lying in the padding only
+#define MASK_EMPTY_WINDOW 255
+template <typename T>
+class ReluMask {
+public:
+    // y = max(x, 0), y may be x. mask holds (x_d1 + 7) / 8 bytes, bit
+    // i % 8 of byte i / 8 is set where x[i] > 0
+    static void do_forward(T* x, int x_d1,
+                           T* y, int y_d1,
+                           unsigned char* mask, int mask_d1);
+    // gx may be gy
+    static void do_backward(T* gy, int gy_d1,
+                            unsigned char* mask, int mask_d1,
+                            T* gx, int gx_d1);
+};
+
+// Plain NCHW arrays, ker_h * ker_w has to be 255 or less. A window lying
+// in the padding only gets -inf, as in the numpy path, and no gradient
+template <typename T>
+class MaxPoolingMask {
+public:
+    static void do_forward(
+                T* x, int x_d1, int x_d2, int x_d3, int x_d4,
+                T* y, int y_d1, int y_d2, int y_d3, int y_d4,
+                unsigned char* mask,
+                int mask_d1, int mask_d2, int mask_d3, int mask_d4,
+                int s_y, int s_x,
+                int p_u, int p_d, int p_l, int p_r,
+                int ker_h, int ker_w);
+    static void do_backward(
+                T* gy, int gy_d1, int gy_d2, int gy_d3, int gy_d4,
+                unsigned char* mask,
+                int mask_d1, int mask_d2, int mask_d3, int mask_d4,
+                T* gx, int gx_d1, int gx_d2, int gx_d3, int gx_d4,
+                int s_y, int s_x,
+                int p_u, int p_d, int p_l, int p_r,
+                int ker_h, int ker_w);
+};
+
+#endif // _MASK_H_
+
+
+// vim: et ts=4 sw=4 cindent cino^=l0,\:0,N-s
@@ -0,0 +1,132 @@
+/*
+ *COPYRIGHT
+ *All modification made by Intel Corporation: © 2017 Intel Corporation.
+ *Copyright (c) 2015 Preferred Infrastructure, Inc.
+ *Copyright (c) 2015 Preferred Networks, Inc.
+ *
+ *Permission is hereby granted, free of charge, to any person obtaining a copy
+ *of this software and associated documentation files (the "Software"), to deal
+ *in the Software without restriction, including without limitation the rights
+ *to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ *copies of the Software, and to permit persons to whom the Software is
+ *furnished to do so, subject to the following conditions:
+ *
+ *The above copyright notice and this permission notice shall be included in
+ *all copies or substantial portions of the Software.
+ *
+ *THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ *AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ *OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ *THE SOFTWARE.
+ *
+ *
+ *######################################################################
+ *# The CuPy is designed based on NumPy's API.
+ *# CuPy's source code and documents contain the original NumPy ones.
+ *######################################################################
+ *Copyright (c) 2005-2016, NumPy Developers.
+ *All rights reserved.
+ *
+ *Redistribution and use in source and binary forms, with or without
+ *modification, are permitted provided that the following conditions are
+ *met:
+ *
+ *    * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *
+ *    * Redistributions in binary form must reproduce the above
+ *       copyright notice, this list of conditions and the following
+ *       disclaimer in the documentation and/or other materials provided
+ *       with the distribution.
+ *
+ *    * Neither the name of the NumPy Developers nor the names of any
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ *THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *"AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ *A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ *OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ *SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ *LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ *DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ *THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ *(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ *OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *######################################################################
+ */
+
+
+#include <glog/logging.h>
+#include <string.h>
+#include "common.h"
+#include "mkldnn.hpp"
+#include "mdarray.h"
+#include "utils.h"
+
+using namespace mkldnn;
+
+extern engine cpu_engine;
+
+template<typename T>
+MdArray<T>::MdArray(const memory::primitive_desc& pd)
+{
+    mem_.reset(new_local_memory(pd));
+    memory::desc md = mem_->get_primitive_desc().desc();
+    dims_.assign(md.data.dims, md.data.dims + md.data.ndims);
+}
+
+template<typename T>
+MdArray<T>::MdArray(const memory::primitive_desc& pd, void* handle)
+{
+    mem_.reset(new memory(pd, handle));
+    memory::desc md = mem_->get_primitive_desc().desc();
+    dims_.assign(md.data.dims, md.data.dims + md.data.ndims);
+}
+
+template<typename T>
+int MdArray<T>::format()
+{
+    return mem_->get_primitive_desc().desc().data.format;
+}
+
+template<typename T>
+int MdArray<T>::size()
+{
+    return mem_->get_primitive_desc().get_size();
+}
+
+template<typename T>
+void MdArray<T>::to_nchw(T* y, int y_d1, int y_d2, int y_d3, int y_d4)
+{
+    memory::primitive_desc user_pd({{y_d1, y_d2, y_d3, y_d4},
+                                    memory_data_type<T>(),
+                                    memory::format::nchw}, cpu_engine);
+    if (user_pd == mem_->get_primitive_desc()) {
+        memcpy(y, mem_->get_data_handle(), user_pd.get_size());
+        return;
+    }
+
+    memory user_mem(user_pd, y);
+    std::vector<primitive> primitives;
+    primitives.push_back(reorder(*mem_, user_mem));
+    stream(stream::kind::eager).submit(primitives).wait();
+}
+
+template<typename T>
+MdArray<T>* MdArray<T>::from_nchw(T* x, int x_d1, int x_d2, int x_d3, int x_d4)
+{
+    memory::primitive_desc pd({{x_d1, x_d2, x_d3, x_d4},
+                               memory_data_type<T>(),
+                               memory::format::nchw}, cpu_engine);
+    return new MdArray<T>(pd, x);
+}
+
+template class MdArray<float>;
+
+
+// vim: et ts=4 sw=4 cindent cino^=l0,\:0,N-s
@@ -0,0 +1,115 @@
+/*
+ *COPYRIGHT
+ *All modification made by Intel Corporation: © 2017 Intel Corporation.
+ *Copyright (c) 2015 Preferred Infrastructure, Inc.
+ *Copyright (c) 2015 Preferred Networks, Inc.
+ *
+ *Permission is hereby granted, free of charge, to any person obtaining a copy
+ *of this software and associated documentation files (the "Software"), to deal
+ *in the Software without restriction, including without limitation the rights
+ *to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ *copies of the Software, and to permit persons to whom the Software is
+ *furnished to do so, subject to the following conditions:
+ *
+ *The above copyright notice and this permission notice shall be included in
+ *all copies or substantial portions of the Software.
+ *
+ *THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ *AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ *OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ *THE SOFTWARE.
+ *
+ *
+ *######################################################################
+ *# The CuPy is designed based on NumPy's API.
+ *# CuPy's source code and documents contain the original NumPy ones.
+ *######################################################################
+ *Copyright (c) 2005-2016, NumPy Developers.
+ *All rights reserved.
+ *
+ *Redistribution and use in source and binary forms, with or without
+ *modification, are permitted provided that the following conditions are
+ *met:
+ *
+ *    * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *
+ *    * Redistributions in binary form must reproduce the above
+ *       copyright notice, this list of conditions and the following
+ *       disclaimer in the documentation and/or other materials provided
+ *       with the distribution.
+ *
+ *    * Neither the name of the NumPy Developers nor the names of any
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ *THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *"AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ *A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ *OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ *SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ *LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ *DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ *THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ *(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ *OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *######################################################################
+ */
+
+
+#ifndef _MDARRAY_H_
+#define _MDARRAY_H_
+
+#include <mkldnn.hpp>
+#include <memory>
+
+/*
+ * Opaque 4D array in the memory format chosen by MKL-DNN (nChw8c,
+ * nChw16c, ...). Layers produce and consume it directly so a chain of
+ * MKL-DNN layers does not reorder back to nchw at every boundary; the
+ * reorder to nchw only happens when numpy needs the data (to_nchw).
+ */
+template <typename T>
+class MdArray {
+public:
+    ~MdArray() {}
+
+    int ndims() { return dims_.size(); }
+    int dim(int i) { return dims_[i]; }
+    // mkldnn::memory::format of the data
+    int format();
+    // size of the data in bytes
+    int size();
+
+    // reorder the data into a plain nchw buffer
+    void to_nchw(T* y, int y_d1, int y_d2, int y_d3, int y_d4);
+
+    // wrap a plain nchw buffer without copy, the caller keeps the buffer
+    // alive as long as the returned array
+    static MdArray<T>* from_nchw(T* x, int x_d1, int x_d2, int x_d3, int x_d4);
+
+#ifndef SWIG
+    // allocate a new array with the primitive desc
+    explicit MdArray(const mkldnn::memory::primitive_desc& pd);
+    // wrap a buffer owned by someone else
+    MdArray(const mkldnn::memory::primitive_desc& pd, void* handle);
+
+    mkldnn::memory::primitive_desc get_primitive_desc() {
+        return mem_->get_primitive_desc();
+    }
+    void* get_data_handle() { return mem_->get_data_handle(); }
+
+private:
+    std::shared_ptr<mkldnn::memory> mem_;
+    mkldnn::memory::dims dims_;
+#endif
+};
+
+#endif // _MDARRAY_H_
+
+
+// vim: et ts=4 sw=4 cindent cino^=l0,\:0,N-s
@@ -0,0 +1,87 @@
+import numpy
+from . import mkldnn
+
+
+class mdarray(object):
+
+    """4D float32 array kept in the memory format chosen by MKL-DNN.
+
+    Layers running on MKL-DNN return and accept it directly, so the data is
+    only reordered back to nchw when numpy needs it (``numpy.asarray(x)``,
+    indexing or any attribute of :class:`numpy.ndarray`).
+    """
+
+    __array_priority__ = 100
+
+    def __init__(self, md, base=None):
+        self.md = md
+        # numpy buffer wrapped by md, kept alive as long as md
+        self.base = base
+        self.shape = tuple(md.dim(i) for i in range(md.ndims()))
+        self.dtype = numpy.dtype(numpy.float32)
+        self._array = base
+
+    @staticmethod
+    def from_numpy(x):
+        x = numpy.ascontiguousarray(x, dtype=numpy.float32)
+        return mdarray(mkldnn.MdArray_F32.from_nchw(x), x)
+
+    @property
+    def ndim(self):
+        return len(self.shape)
+
+    @property
+    def size(self):
+        return int(numpy.prod(self.shape))
+
+    @property
+    def nbytes(self):
+        return self.md.size()
+
+    def __array__(self, dtype=None):
+        if self._array is None:
+            a = numpy.empty(self.shape, dtype=self.dtype)
+            self.md.to_nchw(a)
+            self._array = a
+        if dtype is not None and numpy.dtype(dtype) != self.dtype:
+            return self._array.astype(dtype)
+        return self._array
+
+    def __getattr__(self, name):
+        if name.startswith('__') or name in ('md', 'base', '_array'):
+            raise AttributeError(name)
+        return getattr(self.__array__(), name)
+
+    def __len__(self):
+        return self.shape[0]
+
+    def __getitem__(self, key):
+        return self.__array__()[key]
+
+    def __repr__(self):
+        return 'mdarray(%r, format=%d)' % (self.__array__(), self.md.format())
+
+    def __str__(self):
+        return str(self.__array__())
+
+
+def _delegate(name):
+    def f(self, *args):
+        return getattr(self.__array__(), name)(*args)
+    f.__name__ = name
+    return f
+
+
+for _name in ('__add__', '__radd__', '__sub__', '__rsub__',
+              '__mul__', '__rmul__', '__div__', '__rdiv__',
+              '__truediv__', '__rtruediv__', '__pow__', '__rpow__',
+              '__neg__', '__abs__', '__lt__', '__le__', '__gt__', '__ge__',
+              '__eq__', '__ne__'):
+    setattr(mdarray, _name, _delegate(_name))
+
+
+def asarray(x):
+    """Returns x as numpy.ndarray, reordering an mdarray to nchw."""
+    if isinstance(x, mdarray):
+        return x.__array__()
+    return x
@@ -2,9 +2,11 @@
 
 %{
     #define SWIG_FILE_WITH_INIT
+    #include <stdexcept>
     #include "common.h"
     #include "layer_factory.h"
     #include "layer.h"
+    #include "mdarray.h"
     #include "linear.h"
     #include "pooling.h"
     #include "max_pooling.h"
@@ -12,11 +14,15 @@
     #include "conv.h"
     #include "relu4d.h"
     #include "relu.h"
+    #include "eltwise.h"
+    #include "mask.h"
     #include "softmax.h"
     #include "lrn.h"
     #include "softmax_cross_entropy.h"
     #include "concat.h"
     #include "sum.h"
+    #include "batch_normalization.h"
+    #include "deconv.h"
 %}
 
 %include "numpy.i"
@@ -37,7 +43,8 @@
 %apply ( float* IN_ARRAY1, int DIM1 )
     {( float* b, int b_d1 ),
      /* Softmax_2D/4D, Ravel 2D or 4D nparray to 1D to unify interface */
-     ( float* x, int dummy_x )}
+     ( float* x, int dummy_x ),
+     ( float* gy, int dummy_gy )}
 %apply ( float* INPLACE_ARRAY1, int DIM1 )
     {( float* gb, int gb_d1 ),
      ( float* y, int dummy_y ),
@@ -62,6 +69,11 @@
     {( int* ws, int ws_d1, int ws_d2, int ws_d3, int ws_d4 )}
 %apply ( float* IN_ARRAY4, int DIM1, int DIM2, int DIM3, int DIM4 )
     {( float* ws, int ws_d1, int ws_d2, int ws_d3, int ws_d4 )}
+    /* ReLU bit masks and max pooling argmax masks, written by forward */
+%apply ( unsigned char* INPLACE_ARRAY1, int DIM1 )
+    {( unsigned char* mask, int mask_d1 )}
+%apply ( unsigned char* INPLACE_ARRAY4, int DIM1, int DIM2, int DIM3, int DIM4 )
+    {( unsigned char* mask, int mask_d1, int mask_d2, int mask_d3, int mask_d4 )}
     /* linear_2D interface*/
 %apply ( float* IN_ARRAY2, int DIM1, int DIM2 )
     {( float* x, int x_d1, int x_d2 )}
@@ -77,14 +89,65 @@
     {( float* gb, int gb_d1)}
 %apply ( float* INPLACE_ARRAY2, int DIM1, int DIM2 )
     {( float* y, int y_d1, int y_d2 )}
+    /* batch normalization scale/shift and statistics */
+%apply ( float* IN_ARRAY1, int DIM1)
+    {( float* w, int w_d1)}
+%apply ( float* INPLACE_ARRAY1, int DIM1)
+    {( float* mean, int mean_d1),
+     ( float* var, int var_d1),
+     ( float* gw, int gw_d1)}
 %apply ( float* INPLACE_ARRAY2, int DIM1, int DIM2 )
     {( float* gy, int gy_d1, int gy_d2 )}
 %apply ( float* IN_ARRAY1, int DIM1)
     {( float* ws, int ws_d)}
 
+/*
+ * Release the GIL while the native compute runs (built with swig -threads).
+ * Arguments are converted and released with the GIL held, and the caller
+ * keeps references to its arrays, so buffers stay alive during the call.
+ * Everything else keeps the GIL.
+ */
+%nothread;
+%thread do_forward;
+%thread do_backward;
+%thread forward;
+%thread backward;
+%thread sum;
+%thread do_sum;
+%thread sum_nd;
+%thread do_sum_nd;
+%thread do_forward_md;
+%thread do_forward_inplace;
+%thread do_backward_inplace;
+%thread forward_loss;
+%thread backward_x;
+%thread to_nchw;
+
+/* Size checks of the mask kernels are raised as ValueError */
+%include "exception.i"
+%define %mask_size_checked(func)
+%exception func {
+    try {
+        $action
+    } catch (const std::invalid_argument& e) {
+        SWIG_exception(SWIG_ValueError, e.what());
+    }
+}
+%enddef
+%mask_size_checked(ReluMask::do_forward)
+%mask_size_checked(ReluMask::do_backward)
+%mask_size_checked(MaxPoolingMask::do_forward)
+%mask_size_checked(MaxPoolingMask::do_backward)
+
+/* MdArray results are owned by python */
+%newobject do_forward_md;
+%newobject from_nchw;
+%nodefaultctor MdArray;
+
 %include "common.h"
 %include "layer_factory.h"
 %include "layer.h"
+%include "mdarray.h"
 %include "linear.h"
 %include "pooling.h"
 %include "max_pooling.h"
@@ -92,11 +155,15 @@
 %include "conv.h"
 %include "relu4d.h"
 %include "relu.h"
+%include "eltwise.h"
+%include "mask.h"
 %include "softmax.h"
 %include "lrn.h"
 %include "softmax_cross_entropy.h"
 %include "concat.h"
 %include "sum.h"
+%include "batch_normalization.h"
+%include "deconv.h"
 
 /*
 * Support Concat to get a variable size tuple
@@ -105,7 +172,7 @@
 * concat data:
 */
 /* Get the ndarray tuple */
-%typemap(in) (int num_concats, char** data, int* n, int* c, int* h, int *w) {
+%typemap(in) (int num_concats, char** data, int* n, int* c, int* h, int *w) (PyObject* items = NULL) {
     int i;
     bool isTuple = false;
     bool isList = false;
@@ -115,19 +182,22 @@
 
     if (!isTuple && !isList) {
         PyErr_SetString(PyExc_ValueError, "Expecting a Tuple or List");
-        return NULL;
+        SWIG_fail;
     }
     if (isTuple && isList) {
         PyErr_SetString(PyExc_ValueError, "Object can not be both Tuple and List, something wrong");
-        return NULL;
+        SWIG_fail;
     }
 
-    $1 = 0;
-    if (isTuple) {
-        $1 = PyTuple_Size($input);
-    } else if (isList) {
-        $1 = PyList_Size($input);
+    /*
+     * Hold a private tuple of the items, a list can be changed by
+     * another thread while the call runs without the GIL
+     */
+    items = PySequence_Tuple($input);
+    if (items == NULL) {
+        SWIG_fail;
     }
+    $1 = PyTuple_Size(items);
 
     /* malloc the concat data struct */
     $2 = (char**)malloc(($1)*sizeof(char*));
@@ -136,22 +206,17 @@
     $5 = (int*)malloc(($1)*sizeof(int));
     $6 = (int*)malloc(($1)*sizeof(int));
     for (i = 0; i < $1; i++) {
-        PyObject* x=NULL;
-        if (isTuple) {
-            x = PyTuple_GetItem($input, i);
-        } else if (isList) {
-            x = PyList_GetItem($input, i);
-        }
+        PyObject* x = PyTuple_GetItem(items, i);
         if (!PyArray_Check(x)) {
             PyErr_SetString(PyExc_ValueError, "Item must be array");
-            return NULL;
+            SWIG_fail;
         }
         void* data= array_data(x);
         ($2)[i] = (char*)data;
         int ndims = array_numdims(x);
         if (ndims != 4) {
             PyErr_SetString(PyExc_ValueError, "Only support 4 dimensions now");
-            return NULL;
+            SWIG_fail;
         }
         npy_intp *dims = array_dimensions(x);
         ($3)[i] = dims[0];
@@ -162,6 +227,7 @@
 }
 /* free the list*/
 %typemap(freearg) (int num_concats, char** data, int* n, int* c, int* h, int* w) {
+    Py_XDECREF(items$argnum);
     free($2);
     free($3);
     free($4);
@@ -173,12 +239,67 @@
     (int num_sum, char** data, int* n, int* c, int* h, int* w)
 }
 
+/*
+* Support Sum of arrays of any rank
+* in: tuple of C contiguous float32 arrays of the same size
+* size: number of elements of each array
+*/
+%typemap(in) (int num_sum, char** data, int* size) (PyObject* items = NULL) {
+    int i;
+
+    if (!PyTuple_Check($input) && !PyList_Check($input)) {
+        PyErr_SetString(PyExc_ValueError, "Expecting a Tuple or List");
+        SWIG_fail;
+    }
+    items = PySequence_Tuple($input);
+    if (items == NULL) {
+        SWIG_fail;
+    }
+    $1 = PyTuple_Size(items);
+    if ($1 == 0) {
+        PyErr_SetString(PyExc_ValueError, "Expecting at least one array");
+        SWIG_fail;
+    }
+
+    $2 = (char**)malloc(($1)*sizeof(char*));
+    $3 = (int*)malloc(($1)*sizeof(int));
+    for (i = 0; i < $1; i++) {
+        PyObject* x = PyTuple_GetItem(items, i);
+        if (!PyArray_Check(x)) {
+            PyErr_SetString(PyExc_ValueError, "Item must be array");
+            SWIG_fail;
+        }
+        if (!array_is_contiguous(x) || array_type(x) != NPY_FLOAT) {
+            PyErr_SetString(PyExc_ValueError, "Item must be C contiguous float32");
+            SWIG_fail;
+        }
+        ($2)[i] = (char*)array_data(x);
+        ($3)[i] = (int)PyArray_SIZE((PyArrayObject*)x);
+        if (i > 0 && ($3)[i] != ($3)[0]) {
+            PyErr_SetString(PyExc_ValueError, "Items must have the same size");
+            SWIG_fail;
+        }
+    }
+}
+%typemap(freearg) (int num_sum, char** data, int* size) {
+    Py_XDECREF(items$argnum);
+    free($2);
+    free($3);
+}
+%apply ( float* INPLACE_ARRAY_FLAT, int DIM_FLAT )
+    {( float* y_flat, int y_size )}
+
 %template(Layer_F32) Layer<float>;
+%template(MdArray_F32) MdArray<float>;
 %template(Convolution2D_F32) Convolution2D<float>;
+%template(Deconvolution2D_F32) Deconvolution2D<float>;
 %template(Pooling_F32) Pooling<float>;
 %template(MaxPooling_F32) MaxPooling<float>;
 %template(Relu4D_F32) Relu4D<float>;
 %template(Relu_F32) Relu<float>;
+%template(Eltwise_F32) Eltwise<float>;
+%template(ReluMask_F32) ReluMask<float>;
+%template(MaxPoolingMask_F32) MaxPoolingMask<float>;
 %template(AvgPooling_F32) AvgPooling<float>;
 %template(Softmax_F32) Softmax<float>;
 %template(LocalResponseNormalization_F32) LocalResponseNormalization<float>;
@@ -186,3 +307,4 @@
 %template(SoftmaxCrossEntropy_F32) SoftmaxCrossEntropy<float>;
 %template(Concat_F32) Concat<float>;
 %template(Sum_F32) Sum<float>;
+%template(BatchNormalization_F32) BatchNormalization<float>;
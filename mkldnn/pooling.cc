@@ -72,6 +72,17 @@ using namespace mkldnn;
 
 extern engine cpu_engine;
 
+template<typename T>
+size_t Pooling<T>::get_memory_size()
+{
+    // workspace is allocated by forward_setup even if python provides one
+    return this->memory_size(x_mem_, user_x_mem_)
+        + this->memory_size(y_mem_, user_y_mem_)
+        + this->memory_size(gx_mem_, user_gx_mem_)
+        + this->memory_size(gy_mem_, user_gy_mem_)
+        + this->memory_size(workspace_mem_);
+}
+
 template<typename T>
 int Pooling<T>::forward_setup(int x_d1, int x_d2, int x_d3, int x_d4,
                               int s_y, int s_x,
@@ -80,13 +91,12 @@ int Pooling<T>::forward_setup(int x_d1, int x_d2, int x_d3, int x_d4,
                               mkldnn::algorithm alg_kind)
 {
     memory::format format;
-    // we check AVX512 first then AVX2
-    if (cpu_support_avx512_p() && (x_d2%16)==0) {
-        format = memory::format::nChw16c;
-    } else if (cpu_support_avx2_p() && (x_d2%8)==0) {
-        format = memory::format::nChw8c;
+    memory::format user_format = memory::format::nchw;
+    if (x_format_ >= 0) {
+        // MdArray input, pool in its format
+        format = user_format = (memory::format)x_format_;
     } else {
-        format = memory::format::nchw;
+        format = cpu_blocked_format(x_d2);
     }
 
     int y_d1, y_d2, y_d3, y_d4;
@@ -125,7 +135,7 @@ int Pooling<T>::forward_setup(int x_d1, int x_d2, int x_d3, int x_d4,
 
     /* create memory for user data */
     user_x_mem_.reset(new memory({{{x_tz}, memory_data_type<T>(),
-                            memory::format::nchw}, cpu_engine}, dummy));
+                            user_format}, cpu_engine}, dummy));
     // TODO here we let mkldnn allocate a piece of internal memory but its not
     // used and will soon be replaced.  An alt. way is pass data pointer of
     // first run to forward setup and use that data for first run but it makes
@@ -140,7 +150,8 @@ int Pooling<T>::forward_setup(int x_d1, int x_d2, int x_d3, int x_d4,
 
 
     // create a pooling descriptor
-    fwd_desc_.reset(new pooling_forward::desc(prop_kind::forward_training,
+    fwd_desc_.reset(new pooling_forward::desc(inference_ ? prop_kind::forward_inference
+                                                         : prop_kind::forward_training,
                                          alg_kind,
                                          *x_md_, *y_md_,
                                          strides, kernel, padding_l, padding_r,
@@ -157,23 +168,31 @@ int Pooling<T>::forward_setup(int x_d1, int x_d2, int x_d3, int x_d4,
     bool reorder_x_p = false;
     bool reorder_y_p = false;
 
-    if (format != memory::format::nchw) {
+    if (format != user_format) {
         x_mem_.reset(new memory({{{x_tz}, memory_data_type<T>(),
                             format}, cpu_engine}));
         reorder_x_ = reorder(*user_x_mem_, *x_mem_);
         reorder_x_p = true;
     }
 
-    if (memory::primitive_desc(fwd_pd_->dst_primitive_desc())
+    if (x_format_ >= 0) {
+        // MdArray output, keep the format chosen by pooling
+        user_y_mem_.reset(new memory(fwd_pd_->dst_primitive_desc(), dummy));
+        y_mem_ = user_y_mem_;
+    } else if (memory::primitive_desc(fwd_pd_->dst_primitive_desc())
         != user_y_mem_->get_primitive_desc()) {
-        y_mem_.reset(new memory(fwd_pd_.get()->dst_primitive_desc()));
+        y_mem_.reset(new_local_memory(fwd_pd_.get()->dst_primitive_desc()));
         reorder_y_ = reorder(*y_mem_, *user_y_mem_);
         reorder_y_p = true;
     }
 
-    workspace_mem_.reset(new memory(y_mem_->get_primitive_desc()));
-    fwd_.reset(new pooling_forward(
-            *fwd_pd_, *x_mem_, *y_mem_, *workspace_mem_));
+    if (inference_) {
+        fwd_.reset(new pooling_forward(*fwd_pd_, *x_mem_, *y_mem_));
+    } else {
+        workspace_mem_.reset(new_local_memory(y_mem_->get_primitive_desc()));
+        fwd_.reset(new pooling_forward(
+                *fwd_pd_, *x_mem_, *y_mem_, *workspace_mem_));
+    }
 
     LOG(INFO) << "    reorder_src: " << reorder_x_p;
     LOG(INFO) << "    reorder_dst: " << reorder_y_p;
@@ -209,15 +228,7 @@ int Pooling<T>::backward_setup(int x_d1, int x_d2, int x_d3, int x_d4,
                               int ker_h, int ker_w,
                               mkldnn::algorithm alg_kind)
 {
-    memory::format format;
-    // we check AVX512 first then AVX2
-    if (cpu_support_avx512_p() && (x_d2%16)==0) {
-        format = memory::format::nChw16c;
-    } else if (cpu_support_avx2_p() && (x_d2%8)==0) {
-        format = memory::format::nChw8c;
-    } else {
-        format = memory::format::nchw;
-    }
+    memory::format format = cpu_blocked_format(x_d2);
 
     int y_d1, y_d2, y_d3, y_d4;
     // prepare y according to x, s, p, ker
@@ -292,7 +303,7 @@ int Pooling<T>::backward_setup(int x_d1, int x_d2, int x_d3, int x_d4,
 
     if (memory::primitive_desc(bwd_pd_.get()->diff_src_primitive_desc())
         != user_gx_mem_->get_primitive_desc()) {
-        gx_mem_.reset(new memory(
+        gx_mem_.reset(new_local_memory(
                             bwd_pd_.get()->diff_src_primitive_desc()));
         reorder_gx_ = reorder(*gx_mem_, *user_gx_mem_);
         reorder_x_p = true;
@@ -343,7 +354,7 @@ int Pooling<T>::forward(T*   x,  int x_d1,  int x_d2,  int x_d3,  int x_d4,
 
     user_x_mem_->set_data_handle(x);
     user_y_mem_->set_data_handle(y);
-    if (ws != NULL)
+    if (ws != NULL && workspace_mem_)
         workspace_mem_->set_data_handle(ws);
     if (this->forward_first_use_) {
         this->forward_stream_->submit(this->forward_primitives_).wait();
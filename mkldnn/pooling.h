@@ -71,12 +71,15 @@
 #include <vector>
 #include "layer.h"
 #include "layer_factory.h"
+#include "mdarray.h"
 
 template <typename T>
 class Pooling: public Layer<T>{
 public:
     //Pooling();
 
+    size_t get_memory_size();
+
     int forward(T*   x,  int x_d1,  int x_d2,  int x_d3,  int x_d4,
                 T*   y,  int y_d1,  int y_d2,  int y_d3,  int y_d4,
                 int* ws, int ws_d1, int ws_d2, int ws_d3, int ws_d4);
@@ -104,22 +107,28 @@ protected:
                       int s_y, int s_x,
                       int p_u, int p_d, int p_l, int p_r,
                       int ker_h, int ker_w,
-                      mkldnn::algorithm alg_kind) {
+                      mkldnn::algorithm alg_kind,
+                      int x_format = -1,
+                      bool inference = false) {
         Pooling<T>* pooling_forward = NULL;
         assert (alg_kind == pooling_max || alg_kind == pooling_avg);
         if (alg_kind == mkldnn::pooling_max) {
             pooling_forward = dynamic_cast<Pooling<T>*>(
                                 LayerFactory<T>::get_instance().get_max_pool_layer
                                 (x_d1, x_d2, x_d3, x_d4,
-                                 s_y, s_x, ker_h, ker_w, p_u, p_d, p_l, p_r));
+                                 s_y, s_x, ker_h, ker_w, p_u, p_d, p_l, p_r,
+                                 x_format, inference));
         } else {
             pooling_forward = dynamic_cast<Pooling<float>*>(
                                 LayerFactory<T>::get_instance().get_avg_pool_layer
                                 (x_d1, x_d2, x_d3, x_d4,
-                                 s_y, s_x, ker_h, ker_w, p_u, p_d, p_l, p_r));
+                                 s_y, s_x, ker_h, ker_w, p_u, p_d, p_l, p_r,
+                                 x_format, inference));
         }
         if (pooling_forward == NULL) {
             pooling_forward = new Pooling<T>();
+            pooling_forward->x_format_ = x_format;
+            pooling_forward->inference_ = inference;
             pooling_forward->forward_setup(x_d1, x_d2, x_d3, x_d4,
                                        s_y, s_x, p_u, p_d, p_l, p_r,
                                        ker_h, ker_w,
@@ -128,12 +137,12 @@ protected:
                 LayerFactory<T>::get_instance().set_max_pool_layer(
                                     x_d1, x_d2, x_d3, x_d4,
                                     s_y, s_x, ker_h, ker_w, p_u, p_d, p_l, p_r,
-                                    pooling_forward);
+                                    pooling_forward, x_format, inference);
             } else {
                 LayerFactory<T>::get_instance().set_avg_pool_layer(
                                     x_d1, x_d2, x_d3, x_d4,
                                     s_y, s_x, ker_h, ker_w, p_u, p_d, p_l, p_r,
-                                    pooling_forward);
+                                    pooling_forward, x_format, inference);
             }
         }
         return pooling_forward;
@@ -157,8 +166,13 @@ protected:
                                 (x_d1, x_d2, x_d3, x_d4,
                                  s_y, s_x, ker_h, ker_w, p_u, p_d, p_l, p_r));
         }
-        assert (pooling_backward != NULL);  // we must have already done forward
-                                            // before
+        if (pooling_backward == NULL) {
+            // no idle forward object in the cache (evicted or in use), rebuild it
+            pooling_backward = get_forward_object(x, x_d1, x_d2, x_d3, x_d4,
+                                       s_y, s_x, p_u, p_d, p_l, p_r,
+                                       ker_h, ker_w,
+                                       alg_kind);
+        }
         if (pooling_backward->backward_first_setup_ == true) {
             pooling_backward->backward_setup(x_d1, x_d2, x_d3, x_d4,
                                        s_y, s_x, p_u, p_d, p_l, p_r,
@@ -186,20 +200,59 @@ public:
         forward_object->forward(x,  x_d1,  x_d2,  x_d3,  x_d4,
                                 y,  y_d1,  y_d2,  y_d3,  y_d4,
                                 ws, ws_d1, ws_d2, ws_d3, ws_d4);
+        LayerFactory<T>::get_instance().put_layer(forward_object);
     }
 
+    /*
+     * Pooling forward without workspace output. With inference the
+     * forward_inference variant is used, which has no workspace at all
+     * and can not be followed by do_backward.
+     */
     static void do_forward(
                 T* x,  int x_d1,  int x_d2,  int x_d3,  int x_d4,
                 T* y,  int y_d1,  int y_d2,  int y_d3,  int y_d4,
                 int s_y, int s_x,
                 int p_u, int p_d, int p_l, int p_r,
                 int ker_h, int ker_w,
-                mkldnn::algorithm alg_kind) {
-        do_forward(x, x_d1, x_d2, x_d3, x_d4,
-                   y, y_d1, y_d2, y_d3, y_d4,
-                   NULL, 0, 0, 0, 0,
-                   s_y, s_x, p_u, p_d, p_l, p_r, ker_h, ker_w,
-                   alg_kind);
+                mkldnn::algorithm alg_kind,
+                bool inference = false) {
+        Pooling<T> *forward_object = get_forward_object(
+                                        x, x_d1, x_d2, x_d3, x_d4,
+                                        s_y, s_x, p_u, p_d, p_l, p_r,
+                                        ker_h, ker_w,
+                                        alg_kind, -1, inference);
+        forward_object->forward(x,  x_d1,  x_d2,  x_d3,  x_d4,
+                                y,  y_d1,  y_d2,  y_d3,  y_d4,
+                                NULL, 0, 0, 0, 0);
+        LayerFactory<T>::get_instance().put_layer(forward_object);
+    }
+
+    /*
+     * Pooling forward on an MdArray, the output is a new MdArray in the
+     * format chosen by pooling. Workspace is kept inside the layer, so
+     * backward of max pooling can not be computed from this forward.
+     */
+    static MdArray<T>* do_forward_md(
+                MdArray<T>* x,
+                int s_y, int s_x,
+                int p_u, int p_d, int p_l, int p_r,
+                int ker_h, int ker_w,
+                mkldnn::algorithm alg_kind,
+                bool inference = false) {
+        T* x_data = (T*)x->get_data_handle();
+        int x_d1 = x->dim(0), x_d2 = x->dim(1), x_d3 = x->dim(2), x_d4 = x->dim(3);
+        Pooling<T> *forward_object = get_forward_object(
+                                        x_data, x_d1, x_d2, x_d3, x_d4,
+                                        s_y, s_x, p_u, p_d, p_l, p_r,
+                                        ker_h, ker_w,
+                                        alg_kind, x->format(), inference);
+        MdArray<T>* y = new MdArray<T>(forward_object->y_mem_->get_primitive_desc());
+        forward_object->forward(x_data, x_d1, x_d2, x_d3, x_d4,
+                                (T*)y->get_data_handle(),
+                                y->dim(0), y->dim(1), y->dim(2), y->dim(3),
+                                NULL, 0, 0, 0, 0);
+        LayerFactory<T>::get_instance().put_layer(forward_object);
+        return y;
     }
 
     static void do_backward(
@@ -220,6 +273,7 @@ public:
                                   x,  x_d1,  x_d2,  x_d3,  x_d4,
                                   gx, gx_d1, gx_d2, gx_d3, gx_d4,
                                   ws, ws_d1, ws_d2, ws_d3, ws_d4);
+        LayerFactory<T>::get_instance().put_layer(backward_object);
     }
 
     static void do_backward(
@@ -242,6 +296,10 @@ private:
     int y_d1_, y_d2_, y_d3_, y_d4_;
     int s_y_, s_x_, p_u_, p_d_, p_l_, p_r_, ker_h_, ker_w_;
     mkldnn::algorithm alg_kind_;
+    // format of the MdArray input, -1 for numpy input and output
+    int x_format_ = -1;
+    // forward_inference variant, no workspace
+    bool inference_ = false;
 
     std::shared_ptr<mkldnn::memory>                           user_x_mem_;
     std::shared_ptr<mkldnn::memory>                           user_y_mem_;
@@ -71,8 +71,9 @@ using namespace mkldnn;
 extern engine cpu_engine;
 
 template<typename T>
-Relu<T>::Relu()
-: relu_fwd_user_src_mem_(NULL), relu_fwd_dst_mem_(NULL)
+Relu<T>::Relu(T negative_slope)
+: negative_slope_(negative_slope)
+               , relu_fwd_user_src_mem_(NULL), relu_fwd_dst_mem_(NULL)
                , relu_fwd_src_md_(NULL), relu_fwd_desc_(NULL), relu_fwd_pd_(NULL)
                , relu_fwd_(NULL), fwd_stream_(NULL)
                , relu_diff_dst_mem_(NULL), relu_diff_dst_md_(NULL)
@@ -102,7 +103,7 @@ int Relu<T>::forward_setup(T* x, int x_size,
     /* no reorder for relu, since there is no interface src_primitive_desc() of relu pd*/
     auto relu_src_mem = relu_fwd_user_src_mem_;
 
-    const double negative_slope = 0.0;//1.0;
+    const double negative_slope = negative_slope_;
 
     /* create relu primitive and add it to net_ */
     relu_fwd_desc_.reset(new relu_forward::desc(prop_kind::forward,
@@ -134,10 +135,12 @@ int Relu<T>::forward(T* x, int x_size,
     //LOG(INFO) << "Convolution forward";
     if (!fwd_stream_) {
         forward_setup(x, x_size, y, y_size);
-        fwd_reset_mem(x, y);
+    }
+    fwd_reset_mem(x, y);
+    if (this->forward_first_use_) {
         fwd_stream_->submit(fwd_primitives_).wait();
+        this->forward_first_use_ = false;
     } else {
-        fwd_reset_mem(x, y);
         fwd_stream_->rerun().wait();
     }
     return 0;
@@ -148,7 +151,7 @@ int Relu<T>::backward_setup(T* x, int x_size,
                       T* gy, int gy_size,
                       T* gx, int gx_size)
 {
-    const double negative_slope = 0.0;//1.0;
+    const double negative_slope = negative_slope_;
 
     /* Backward relu */
     memory::dims relu_src_tz = {x_size};
@@ -194,6 +197,10 @@ int Relu<T>::backward(T* x, int x_size,
                       T* gx, int gx_size)
 {
     LOG(INFO) << "backward: " << x << " : " << x_size << " : " << gy << " : " << gy_size << " : " << gx << " : " << gx_size;
+    if (!fwd_stream_) {
+        // rebuilt after eviction, backward needs forward primitive desc
+        forward_setup(x, x_size, gx, gx_size);
+    }
     if (!bwd_stream_) {
         backward_setup(x, x_size, gy, gy_size, gx, gx_size);
         bwd_reset_mem(x, gy, gx);
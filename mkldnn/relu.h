@@ -71,7 +71,8 @@
 template <typename T>
 class Relu : public Layer<T>{
 public:
-    Relu();
+    // negative_slope > 0 gives a leaky ReLU
+    Relu(T negative_slope = 0);
     int forward_setup(T* x, int x_size,
                       T* y, int y_size);
     void fwd_reset_mem(T* x,
@@ -89,45 +90,69 @@ public:
                  T* gy, int gy_size,
                  T* gx, int gx_size);
 
-    static Relu<T>* get_forward_object(int x_d1) {
+    static Relu<T>* get_forward_object(int x_d1, T negative_slope = 0) {
         Relu<T>* relu_forward = NULL;
         relu_forward = dynamic_cast<Relu<T>*>(
-                LayerFactory<T>::get_instance().get_relu_layer(x_d1));
+                LayerFactory<T>::get_instance().get_relu_layer(
+                    x_d1, negative_slope));
         if (relu_forward == NULL) {
-            relu_forward = new Relu<T>();
+            relu_forward = new Relu<T>(negative_slope);
             LOG(INFO) << "new relu obj " << relu_forward << " dim " << x_d1;
             LayerFactory<T>::get_instance().set_relu_layer(
-                    x_d1, relu_forward);
+                    x_d1, relu_forward, negative_slope);
         }
         return relu_forward;
     }
 
-    static Relu<T>* get_backward_object(int x_d1) {
+    static Relu<T>* get_backward_object(int x_d1, T negative_slope = 0) {
         Relu<T>* relu_backward = NULL;
             relu_backward = dynamic_cast<Relu<T>*>(
-                                LayerFactory<T>::get_instance().get_relu_layer(x_d1));
-        assert (relu_backward != NULL);  // we must have already done forward
-                                            // before
+                                LayerFactory<T>::get_instance().get_relu_layer(
+                                    x_d1, negative_slope));
+        if (relu_backward == NULL) {
+            // no idle forward object in the cache (evicted or in use),
+            // backward will set up forward primitives again
+            relu_backward = get_forward_object(x_d1, negative_slope);
+        }
         return relu_backward;
     }
 
     static void do_forward(
                 T* x,  int x_d1,
-                T* y,  int y_d1) {
-        Relu<T> *forward_object = get_forward_object(x_d1);
+                T* y,  int y_d1,
+                T negative_slope = 0) {
+        Relu<T> *forward_object = get_forward_object(x_d1, negative_slope);
         forward_object->forward(x,  x_d1,
                                 y,  y_d1);
+        LayerFactory<T>::get_instance().put_layer(forward_object);
     }
 
     static void do_backward(T* x, int x_d1,
                  T* gy, int gy_d1,
-                 T* gx, int gx_d1) {
-        Relu<T> *backward_object = get_backward_object(x_d1);
+                 T* gx, int gx_d1,
+                 T negative_slope = 0) {
+        Relu<T> *backward_object = get_backward_object(x_d1, negative_slope);
         backward_object->backward(x, x_d1,
                        gy, gy_d1,
                        gx, gx_d1);
+        LayerFactory<T>::get_instance().put_layer(backward_object);
+    }
+
+    // In-place relu, y holds x on entry
+    static void do_forward_inplace(T* y, int y_d1, T negative_slope = 0) {
+        do_forward(y, y_d1, y, y_d1, negative_slope);
+    }
+
+    // In-place backward, gx holds gy on entry. x may be the forward output
+    // of an in-place forward, relu keeps the sign of its input.
+    static void do_backward_inplace(T* x, int x_d1,
+                 T* gx, int gx_d1,
+                 T negative_slope = 0) {
+        do_backward(x, x_d1, gx, gx_d1, gx, gx_d1, negative_slope);
     }
 private:
+    T negative_slope_;
+
     //forward
     std::shared_ptr<mkldnn::memory> relu_fwd_user_src_mem_, relu_fwd_dst_mem_;
     std::shared_ptr<mkldnn::memory::desc> relu_fwd_src_md_;
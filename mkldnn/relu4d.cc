@@ -89,15 +89,19 @@ int Relu4D<T>::forward_setup(T* x, int x_d1, int x_d2, int x_d3, int x_d4,
     memory::dims relu_src_tz = {x_d1, x_d2, x_d3, x_d4};
     memory::dims relu_dst_tz = {y_d1, y_d2, y_d3, y_d4};
 
+    /* relu keeps the layout, an MdArray input is computed in its own format */
+    memory::format format = x_format_ < 0 ? memory::format::nchw
+                                          : (memory::format)x_format_;
+
     /* create memory for user data */
     relu_fwd_user_src_mem_.reset(new memory({{{relu_src_tz}, memory::data_type::f32,
-        memory::format::nchw}, cpu_engine}, x));
+        format}, cpu_engine}, x));
     relu_fwd_dst_mem_.reset(new memory({{{relu_src_tz}, memory::data_type::f32,
-        memory::format::nchw}, cpu_engine}, y));
+        format}, cpu_engine}, y));
 
     /* create memory descriptors for relu data w/ no specified format */
     relu_fwd_src_md_.reset(new memory::desc({relu_src_tz}, memory::data_type::f32,
-        memory::format::nchw));
+        format));
 
     /* no reorder for relu, since there is no interface src_primitive_desc() of relu pd*/
     auto relu_src_mem = relu_fwd_user_src_mem_;
@@ -135,10 +139,12 @@ int Relu4D<T>::forward(T* x, int x_d1, int x_d2, int x_d3, int x_d4,
     if (!fwd_stream_) {
         forward_setup(x, x_d1, x_d2, x_d3, x_d4,
                       y, y_d1, y_d2, y_d3, y_d4);
-        fwd_reset_mem(x, y);
+    }
+    fwd_reset_mem(x, y);
+    if (this->forward_first_use_) {
         fwd_stream_->submit(fwd_primitives_).wait();
+        this->forward_first_use_ = false;
     } else {
-        fwd_reset_mem(x, y);
         fwd_stream_->rerun().wait();
     }
     return 0;
@@ -195,6 +201,11 @@ int Relu4D<T>::backward(T* x, int x_d1, int x_d2, int x_d3, int x_d4,
                         T* gx, int gx_d1, int gx_d2, int gx_d3, int gx_d4)
 {
     //LOG(INFO) << "backward: " << x << " : " << x_size << " : " << gy << " : " << gy_size << " : " << gx << " : " << gx_size;
+    if (!fwd_stream_) {
+        // rebuilt after eviction, backward needs forward primitive desc
+        forward_setup(x, x_d1, x_d2, x_d3, x_d4,
+                      gx, gx_d1, gx_d2, gx_d3, gx_d4);
+    }
     if (!bwd_stream_) {
         backward_setup(x, x_d1, x_d2, x_d3, x_d4,
                        gy, gy_d1, gy_d2, gy_d3, gy_d4,
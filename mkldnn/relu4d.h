@@ -67,6 +67,7 @@
 #include <vector>
 #include "layer.h"
 #include "layer_factory.h"
+#include "mdarray.h"
 
 template <typename T>
 class Relu4D : public Layer<T>{
@@ -90,13 +91,14 @@ public:
                  T* gx, int gx_d1, int gx_d2, int gx_d3, int gx_d4);
 
     static Relu4D<T>* get_forward_object(
-            int x_d1, int x_d2, int x_d3, int x_d4) {
+            int x_d1, int x_d2, int x_d3, int x_d4, int x_format = -1) {
         Relu4D<T>* relu4d_forward = NULL;
         relu4d_forward = dynamic_cast<Relu4D<T>*>(
                 LayerFactory<T>::get_instance().get_relu4d_layer
-                (x_d1, x_d2, x_d3, x_d4));
+                (x_d1, x_d2, x_d3, x_d4, x_format));
         if (relu4d_forward == NULL) {
             relu4d_forward = new Relu4D<T>();
+            relu4d_forward->x_format_ = x_format;
             LOG(INFO) << "new relu4d obj " << relu4d_forward << " dmin " << x_d1 << " : "
                 << x_d2 << " : " << x_d3 << " : " << x_d4;
 #if 0
@@ -104,7 +106,7 @@ public:
                     y, x_d1, x_d2, x_d3, x_d4);
 #endif
             LayerFactory<T>::get_instance().set_relu4d_layer(
-                    x_d1, x_d2, x_d3, x_d4, relu4d_forward);
+                    x_d1, x_d2, x_d3, x_d4, relu4d_forward, x_format);
         }
         return relu4d_forward;
     }
@@ -115,8 +117,11 @@ public:
             relu4d_backward = dynamic_cast<Relu4D<T>*>(
                                 LayerFactory<T>::get_instance().get_relu4d_layer
                                 (x_d1, x_d2, x_d3, x_d4));
-        assert (relu4d_backward != NULL);  // we must have already done forward
-                                            // before
+        if (relu4d_backward == NULL) {
+            // no idle forward object in the cache (evicted or in use),
+            // backward will set up forward primitives again
+            relu4d_backward = get_forward_object(x_d1, x_d2, x_d3, x_d4);
+        }
         if (relu4d_backward->backward_first_setup_ == true) {
 #if 0
             relu4d_backward->backward_setup(x, x_d1, x_d2, x_d3, x_d4,
@@ -134,6 +139,19 @@ public:
         Relu4D<T> *forward_object = get_forward_object(x_d1, x_d2, x_d3, x_d4);
         forward_object->forward(x,  x_d1,  x_d2,  x_d3,  x_d4,
                                 y,  y_d1,  y_d2,  y_d3,  y_d4);
+        LayerFactory<T>::get_instance().put_layer(forward_object);
+    }
+
+    // relu on an MdArray, the output has the same format as the input
+    static MdArray<T>* do_forward_md(MdArray<T>* x) {
+        int x_d1 = x->dim(0), x_d2 = x->dim(1), x_d3 = x->dim(2), x_d4 = x->dim(3);
+        Relu4D<T> *forward_object = get_forward_object(x_d1, x_d2, x_d3, x_d4,
+                                                       x->format());
+        MdArray<T>* y = new MdArray<T>(x->get_primitive_desc());
+        forward_object->forward((T*)x->get_data_handle(), x_d1, x_d2, x_d3, x_d4,
+                                (T*)y->get_data_handle(), x_d1, x_d2, x_d3, x_d4);
+        LayerFactory<T>::get_instance().put_layer(forward_object);
+        return y;
     }
 
     static void do_backward(T* x, int x_d1, int x_d2, int x_d3, int x_d4,
@@ -144,6 +162,23 @@ public:
         backward_object->backward(x, x_d1, x_d2, x_d3, x_d4,
                        gy, gy_d1, gy_d2, gy_d3, gy_d4,
                        gx, gx_d1, gx_d2, gx_d3, gx_d4);
+        LayerFactory<T>::get_instance().put_layer(backward_object);
+    }
+
+    // In-place relu, y holds x on entry. The relu primitive reads each
+    // element before writing it, so src and dst can share the buffer.
+    static void do_forward_inplace(T* y, int y_d1, int y_d2, int y_d3, int y_d4) {
+        do_forward(y, y_d1, y_d2, y_d3, y_d4,
+                   y, y_d1, y_d2, y_d3, y_d4);
+    }
+
+    // In-place backward, gx holds gy on entry. x may be the forward output
+    // of an in-place forward, relu keeps the sign of its input.
+    static void do_backward_inplace(T* x, int x_d1, int x_d2, int x_d3, int x_d4,
+                 T* gx, int gx_d1, int gx_d2, int gx_d3, int gx_d4) {
+        do_backward(x, x_d1, x_d2, x_d3, x_d4,
+                    gx, gx_d1, gx_d2, gx_d3, gx_d4,
+                    gx, gx_d1, gx_d2, gx_d3, gx_d4);
     }
 private:
     //forward
@@ -164,6 +199,9 @@ private:
 
     std::shared_ptr<mkldnn::stream> bwd_stream_;
     std::vector<mkldnn::primitive> bwd_primitives_;
+
+    // format of the MdArray input, -1 for numpy input and output
+    int x_format_ = -1;
 };
 
 
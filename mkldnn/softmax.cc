@@ -62,6 +62,8 @@
 
 
 #include <glog/logging.h>
+#include <algorithm>
+#include <cmath>
 #include <iostream>
 #include <vector>
 #include "mkldnn.hpp"
@@ -148,6 +150,183 @@ Softmax<T>::softmax_create_forward(T* x, int dummy_x,
     return inst;
 };
 
+// Pixels handled together when the softmax axis is strided
+#define SOFTMAX_BLOCK 64
+
+// Splits dims around axis into (outer, C, inner), returns false if the
+// axis is out of range
+static bool softmax_geometry(int* dims, int ndim, int& axis,
+                             int& outer, int& C, int& inner)
+{
+    if (axis < 0)
+        axis += ndim;
+    if (axis < 0 || axis >= ndim)
+        return false;
+
+    outer = inner = 1;
+    for (int i = 0; i < axis; i++)
+        outer *= dims[i];
+    C = dims[axis];
+    for (int i = axis + 1; i < ndim; i++)
+        inner *= dims[i];
+    return true;
+}
+
+template<typename T>
+static void softmax_rows(const T* x, T* y, int outer, int C)
+{
+    #pragma omp parallel for
+    for (int n = 0; n < outer; n++) {
+        const T* xn = x + (size_t)n * C;
+        T* yn = y + (size_t)n * C;
+        T m = xn[0], s = 0;
+
+        #pragma omp simd reduction(max:m)
+        for (int c = 1; c < C; c++)
+            m = std::max(m, xn[c]);
+        #pragma omp simd reduction(+:s)
+        for (int c = 0; c < C; c++) {
+            yn[c] = expf(xn[c] - m);
+            s += yn[c];
+        }
+        s = 1 / s;
+        #pragma omp simd
+        for (int c = 0; c < C; c++)
+            yn[c] *= s;
+    }
+}
+
+// Softmax axis strided by inner: each thread takes a block of contiguous
+// positions and walks the axis with SIMD over the block
+template<typename T>
+static void softmax_strided(const T* x, T* y, int outer, int C, int inner)
+{
+    const int nblk = (inner + SOFTMAX_BLOCK - 1) / SOFTMAX_BLOCK;
+
+    #pragma omp parallel for collapse(2)
+    for (int n = 0; n < outer; n++) {
+        for (int b = 0; b < nblk; b++) {
+            const int off = b * SOFTMAX_BLOCK;
+            const int len = std::min(SOFTMAX_BLOCK, inner - off);
+            const T* xn = x + (size_t)n * C * inner + off;
+            T* yn = y + (size_t)n * C * inner + off;
+            T m[SOFTMAX_BLOCK], s[SOFTMAX_BLOCK];
+
+            for (int i = 0; i < len; i++) {
+                m[i] = xn[i];
+                s[i] = 0;
+            }
+            for (int c = 1; c < C; c++) {
+                const T* xc = xn + (size_t)c * inner;
+                #pragma omp simd
+                for (int i = 0; i < len; i++)
+                    m[i] = std::max(m[i], xc[i]);
+            }
+            for (int c = 0; c < C; c++) {
+                const T* xc = xn + (size_t)c * inner;
+                T* yc = yn + (size_t)c * inner;
+                #pragma omp simd
+                for (int i = 0; i < len; i++) {
+                    yc[i] = expf(xc[i] - m[i]);
+                    s[i] += yc[i];
+                }
+            }
+            for (int i = 0; i < len; i++)
+                s[i] = 1 / s[i];
+            for (int c = 0; c < C; c++) {
+                T* yc = yn + (size_t)c * inner;
+                #pragma omp simd
+                for (int i = 0; i < len; i++)
+                    yc[i] *= s[i];
+            }
+        }
+    }
+}
+
+template<typename T>
+int Softmax<T>::do_forward(T* x, int dummy_x,
+                           T* y, int dummy_y,
+                           int* dims, int ndim, int axis)
+{
+    int outer, C, inner;
+    if (!softmax_geometry(dims, ndim, axis, outer, C, inner))
+        return -1;
+
+    if (ndim == 2 && axis == 1) {
+        Softmax<T>* inst = softmax_create_forward(x, dummy_x, y, dummy_y,
+                                                  dims, ndim, axis);
+        inst->forward();
+        LayerFactory<T>::get_instance().put_layer(inst);
+    } else if (inner == 1) {
+        softmax_rows(x, y, outer, C);
+    } else {
+        softmax_strided(x, y, outer, C, inner);
+    }
+
+    return 0;
+}
+
+template<typename T>
+int Softmax<T>::do_backward(T* y, int dummy_y,
+                            T* gy, int dummy_gy,
+                            T* gx, int dummy_gx,
+                            int* dims, int ndim, int axis)
+{
+    int outer, C, inner;
+    if (!softmax_geometry(dims, ndim, axis, outer, C, inner))
+        return -1;
+
+    if (inner == 1) {
+        #pragma omp parallel for
+        for (int n = 0; n < outer; n++) {
+            const T* yn = y + (size_t)n * C;
+            const T* gyn = gy + (size_t)n * C;
+            T* gxn = gx + (size_t)n * C;
+            T dot = 0;
+
+            #pragma omp simd reduction(+:dot)
+            for (int c = 0; c < C; c++)
+                dot += gyn[c] * yn[c];
+            #pragma omp simd
+            for (int c = 0; c < C; c++)
+                gxn[c] = yn[c] * (gyn[c] - dot);
+        }
+        return 0;
+    }
+
+    const int nblk = (inner + SOFTMAX_BLOCK - 1) / SOFTMAX_BLOCK;
+
+    #pragma omp parallel for collapse(2)
+    for (int n = 0; n < outer; n++) {
+        for (int b = 0; b < nblk; b++) {
+            const int off = b * SOFTMAX_BLOCK;
+            const int len = std::min(SOFTMAX_BLOCK, inner - off);
+            const size_t base = (size_t)n * C * inner + off;
+            T dot[SOFTMAX_BLOCK];
+
+            for (int i = 0; i < len; i++)
+                dot[i] = 0;
+            for (int c = 0; c < C; c++) {
+                const T* yc = y + base + (size_t)c * inner;
+                const T* gyc = gy + base + (size_t)c * inner;
+                #pragma omp simd
+                for (int i = 0; i < len; i++)
+                    dot[i] += gyc[i] * yc[i];
+            }
+            for (int c = 0; c < C; c++) {
+                const T* yc = y + base + (size_t)c * inner;
+                const T* gyc = gy + base + (size_t)c * inner;
+                T* gxc = gx + base + (size_t)c * inner;
+                #pragma omp simd
+                for (int i = 0; i < len; i++)
+                    gxc[i] = yc[i] * (gyc[i] - dot[i]);
+            }
+        }
+    }
+
+    return 0;
+}
+
 // Class Softmax_2D<T>
 template<typename T>
 int Softmax_2D<T>::get_res_size()
@@ -155,6 +334,13 @@ int Softmax_2D<T>::get_res_size()
     return sizeof(T) * dims[0] * dims[1];
 }
 
+template<typename T>
+size_t Softmax_2D<T>::get_memory_size()
+{
+    // src/dst are allocated at setup and then rebound to user data
+    return this->memory_size(src_mem) + this->memory_size(dst_mem);
+}
+
 template<typename T>
 int Softmax_2D<T>::setup_forward()
 {
@@ -187,7 +373,7 @@ int Softmax_2D<T>::setup_forward()
     // primitive *src_mem = user_src_mem, *src_reorder = NULL;
     // if (memory::primitive_desc(fwd_pd->src_primitive_desc()) !=
     //     user_src_mem->get_primitive_desc()){
-    //     src_mem = new memory(fwd_pd->src_primitive_desc());
+    //     src_mem = new_local_memory(fwd_pd->src_primitive_desc());
     //     src_reorder = new reorder(*user_src_mem, *src_mem);
     // }
 
@@ -198,7 +384,7 @@ int Softmax_2D<T>::setup_forward()
     // primitive *dst_mem = user_dst_mem, *dst_reorder = NULL;
     // if (memory::primitive_desc(fwd_pd->dst_primitive_desc()) !=
     //     user_dst_mem->get_primitive_desc()) {
-    //     dst_mem = new memory(fwd_pd->dst_primitive_desc());
+    //     dst_mem = new_local_memory(fwd_pd->dst_primitive_desc());
     //     dst_reorder = new reorder(*dst_mem, *user_dst_mem);
     // }
 
@@ -84,10 +84,27 @@ public:
     bool is_first_fwd(void) { return first_fwd; };
     void mark_first_fwd(void) { first_fwd = false; };
 
+    // The returned layer is checked out of LayerFactory, hand it back with
+    // LayerFactory<T>::get_instance().put_layer() after forward()
     static Softmax<T>* softmax_create_forward(T* x, int dummy_x,
                                               T* y, int dummy_y,
                                               int* dims, int ndim, int axis);
 
+    /*
+     * Softmax of a contiguous array of any rank along axis (negative
+     * axes count from the end). 2D arrays along axis 1 run the MKL-DNN
+     * primitive, everything else a vectorized OpenMP kernel over
+     * (outer, dims[axis], inner).
+     */
+    static int do_forward(T* x, int dummy_x,
+                          T* y, int dummy_y,
+                          int* dims, int ndim, int axis);
+    // gx = y * (gy - sum(gy * y)) along axis, y being the forward output
+    static int do_backward(T* y, int dummy_y,
+                           T* gy, int dummy_gy,
+                           T* gx, int dummy_gx,
+                           int* dims, int ndim, int axis);
+
     virtual int get_res_size() { LOG(INFO) << "Softmax donot implement get_res_size"; return -1; /* Implement in instance */ }
     virtual int forward() { LOG(INFO) << "Softmax donot implement forward"; return -1; /* Implement in instance */ }
     virtual int backward() { LOG(INFO) << "Softmax donot implement backward"; return -1; /* Implement in instance */ }
@@ -118,6 +135,7 @@ public:
     int backward();
     int setup_forward();
     int setup_backward();
+    size_t get_memory_size();
 
 private:
     // Instance shape/identity
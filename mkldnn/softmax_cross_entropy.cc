@@ -62,6 +62,8 @@
 
 
 #include <glog/logging.h>
+#include <algorithm>
+#include <cmath>
 #include <vector>
 #include "softmax_cross_entropy.h"
 #include "softmax.h"
@@ -92,43 +94,175 @@ SoftmaxCrossEntropy<T>::softmax_cross_entropy_create_backward(int* dims, int ndi
     return softmax_cross_entropy_create_forward(dims, ndim);
 }
 
+template<typename T>
+int SoftmaxCrossEntropy_2D<T>::backward(T* gx, int dummy_gx,
+                                        int* label, int nlabel,
+                                        int* dims, int ndim, T coeff)
+{
+    const int N = dims[0], C = dims[1];
+
+    #pragma omp parallel for
+    for (int n = 0; n < N; n++) {
+        T* cur = gx + (size_t)n * C;
+        const int t = label[n];
+        const T scale = (t >= 0 && t < C) ? coeff : 0;
+
+        #pragma omp simd
+        for (int c = 0; c < C; c++)
+            cur[c] *= scale;
+        if (t >= 0 && t < C)
+            cur[t] -= coeff;
+    }
+
+    return 0;
+}
+
+// Pixels handled together, kept in registers/L1 while walking channels
+#define SCE_BLOCK 64
+
+// log_softmax over axis 1 of an (N, C, HW) array:
+// y = x - max - log(sum(exp(x - max)))
+// Channels are strided by HW, so each thread takes a block of contiguous
+// pixels and walks the channels with SIMD over the block.
+template<typename T>
+static void log_softmax(const T* x, T* y, int N, int C, int HW)
+{
+    const int nblk = (HW + SCE_BLOCK - 1) / SCE_BLOCK;
+
+    #pragma omp parallel for collapse(2)
+    for (int n = 0; n < N; n++) {
+        for (int b = 0; b < nblk; b++) {
+            const int off = b * SCE_BLOCK;
+            const int len = std::min(SCE_BLOCK, HW - off);
+            const T* xn = x + (size_t)n * C * HW + off;
+            T* yn = y + (size_t)n * C * HW + off;
+            T m[SCE_BLOCK], s[SCE_BLOCK];
+
+            for (int i = 0; i < len; i++)
+                m[i] = xn[i];
+            for (int c = 1; c < C; c++) {
+                const T* xc = xn + (size_t)c * HW;
+                #pragma omp simd
+                for (int i = 0; i < len; i++)
+                    m[i] = std::max(m[i], xc[i]);
+            }
+
+            for (int i = 0; i < len; i++)
+                s[i] = 0;
+            for (int c = 0; c < C; c++) {
+                const T* xc = xn + (size_t)c * HW;
+                #pragma omp simd
+                for (int i = 0; i < len; i++)
+                    s[i] += expf(xc[i] - m[i]);
+            }
+
+            for (int i = 0; i < len; i++)
+                m[i] += logf(s[i]);
+            for (int c = 0; c < C; c++) {
+                const T* xc = xn + (size_t)c * HW;
+                T* yc = yn + (size_t)c * HW;
+                #pragma omp simd
+                for (int i = 0; i < len; i++)
+                    yc[i] = xc[i] - m[i];
+            }
+        }
+    }
+}
+
+// max and log(sum(exp(x - max))) of a contiguous row
+template<typename T>
+static inline T row_logsumexp(const T* x, int C)
+{
+    T m = x[0], s = 0;
+
+    #pragma omp simd reduction(max:m)
+    for (int c = 1; c < C; c++)
+        m = std::max(m, x[c]);
+    #pragma omp simd reduction(+:s)
+    for (int c = 0; c < C; c++)
+        s += expf(x[c] - m);
+    return m + logf(s);
+}
+
 template<typename T>
 int SoftmaxCrossEntropy_2D<T>::forward(T* x, int dummy_x,
                                        T* y, int dummy_y,
                                        int* dims, int ndim)
 {
-    // Softmax mkldnn optimization
-    Softmax<T>* softmax = Softmax<T>::softmax_create_forward(x, dummy_x,
-                                                             y, dummy_y,
-                                                             dims, ndim, 1);
-    softmax->forward();
-
-    // log(F_Softmax)
-    int n, c;
-    float* cur;
-
-    for (n = 0; n < dims[0]; n++) {
-        for (c = 0; c < dims[1]; c++) {
-            cur = y + n * dims[1] + c;
-            *cur = logf(*cur);
-        }
+    // Rows are contiguous, reduce each one with SIMD
+    const int N = dims[0], C = dims[1];
+
+    #pragma omp parallel for
+    for (int n = 0; n < N; n++) {
+        const T* xn = x + (size_t)n * C;
+        T* yn = y + (size_t)n * C;
+        const T lse = row_logsumexp(xn, C);
+
+        #pragma omp simd
+        for (int c = 0; c < C; c++)
+            yn[c] = xn[c] - lse;
     }
 
     return 0;
 }
 
 template<typename T>
-int SoftmaxCrossEntropy_2D<T>::backward(T* gx, int dummy_gx,
-                                        int* label, int nlabel,
-                                        int* dims, int ndim)
+T SoftmaxCrossEntropy_2D<T>::forward_loss(T* x, int dummy_x,
+                                          T* y, int dummy_y,
+                                          int* label, int nlabel,
+                                          int* dims, int ndim)
+{
+    // One parallel pass over the rows: logsumexp, label gather and the
+    // loss reduction, log_softmax itself is never stored. Each row stays
+    // in cache between its reads even for large vocabularies.
+    const int N = dims[0], C = dims[1];
+    const bool keep_y = dummy_y != 0;
+    double sum = 0;
+
+    #pragma omp parallel for reduction(+:sum)
+    for (int n = 0; n < N; n++) {
+        const T* xn = x + (size_t)n * C;
+        const T lse = row_logsumexp(xn, C);
+        const int t = label[n];
+
+        if (t >= 0 && t < C)
+            sum += xn[t] - lse;
+        if (keep_y) {
+            T* yn = y + (size_t)n * C;
+            #pragma omp simd
+            for (int c = 0; c < C; c++)
+                yn[c] = expf(xn[c] - lse);
+        }
+    }
+
+    return (T)sum;
+}
+
+template<typename T>
+int SoftmaxCrossEntropy_2D<T>::backward_x(T* x, int dummy_x,
+                                          T* gx, int dummy_gx,
+                                          int* label, int nlabel,
+                                          int* dims, int ndim, T coeff)
 {
-    int n, c;
+    const int N = dims[0], C = dims[1];
+
+    #pragma omp parallel for
+    for (int n = 0; n < N; n++) {
+        const T* xn = x + (size_t)n * C;
+        T* gn = gx + (size_t)n * C;
+        const int t = label[n];
 
-    for (n = 0; n < dims[0]; n++) {
-        if (label[n] >= 0 && label[n] < dims[1]) {
-            c = label[n];
-            *(gx + n * dims[1] + c) -= 1;
+        if (t < 0 || t >= C) {
+            #pragma omp simd
+            for (int c = 0; c < C; c++)
+                gn[c] = 0;
+            continue;
         }
+        const T lse = row_logsumexp(xn, C);
+        #pragma omp simd
+        for (int c = 0; c < C; c++)
+            gn[c] = coeff * expf(xn[c] - lse);
+        gn[t] -= coeff;
     }
 
     return 0;
@@ -137,19 +271,58 @@ int SoftmaxCrossEntropy_2D<T>::backward(T* gx, int dummy_gx,
 template<typename T>
 int SoftmaxCrossEntropy_4D<T>::forward(T* x, int dummy_x,
                                        T* y, int dummy_y,
-                       int* dims, int ndim)
+                                       int* dims, int ndim)
 {
+    log_softmax(x, y, dims[0], dims[1], dims[2] * dims[3]);
     return 0;
 }
 
 template<typename T>
 int SoftmaxCrossEntropy_4D<T>::backward(T* gx, int dummy_gx,
                                         int* label, int nlabel,
-                    int* dims, int ndim)
+                                        int* dims, int ndim, T coeff)
 {
+    const int N = dims[0], C = dims[1], HW = dims[2] * dims[3];
+
+    #pragma omp parallel for collapse(2)
+    for (int n = 0; n < N; n++) {
+        for (int c = 0; c < C; c++) {
+            const int* t = label + (size_t)n * HW;
+            T* g = gx + ((size_t)n * C + c) * HW;
+            #pragma omp simd
+            for (int i = 0; i < HW; i++) {
+                T v = t[i] == c ? g[i] - 1 : g[i];
+                g[i] = (t[i] >= 0 && t[i] < C) ? v * coeff : 0;
+            }
+        }
+    }
+
     return 0;
 }
 
+template<typename T>
+T SoftmaxCrossEntropy<T>::loss(T* y, int dummy_y,
+                               int* label, int nlabel,
+                               int* dims, int ndim)
+{
+    const int N = dims[0], C = dims[1];
+    int HW = 1;
+    for (int i = 2; i < ndim; i++)
+        HW *= dims[i];
+
+    double sum = 0;
+    #pragma omp parallel for collapse(2) reduction(+:sum)
+    for (int n = 0; n < N; n++) {
+        for (int i = 0; i < HW; i++) {
+            int t = label[(size_t)n * HW + i];
+            if (t >= 0 && t < C)
+                sum += y[((size_t)n * C + t) * HW + i];
+        }
+    }
+
+    return (T)sum;
+}
+
 template class SoftmaxCrossEntropy<float>;
 template class SoftmaxCrossEntropy_2D<float>;
 template class SoftmaxCrossEntropy_4D<float>;
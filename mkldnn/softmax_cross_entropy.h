@@ -83,10 +83,45 @@ public:
                         T* y, int dummy_y,
                         int* dims, int ndim)
     { LOG(INFO) << "Softmax donot implement forward"; return -1; /* Implement in instance */ }
+    /*
+     * gx holds the softmax output on entry. Subtracts 1 at each label,
+     * zeroes samples whose label is out of [0, C) (ignore_label) and
+     * scales the result by coeff.
+     */
     virtual int backward(T* gx, int dummy_gx,
                          int* label, int nlabel,
-                         int* dims, int ndim)
+                         int* dims, int ndim, T coeff = 1)
     { LOG(INFO) << "Softmax donot implement backward"; return -1; /* Implement in instance */ }
+
+    /*
+     * Fused forward: returns the sum of log probabilities picked by label
+     * without materializing log_softmax. The softmax output is written to
+     * y unless y is empty (dummy_y == 0), in which case backward_x
+     * recomputes it.
+     */
+    virtual T forward_loss(T* x, int dummy_x,
+                           T* y, int dummy_y,
+                           int* label, int nlabel,
+                           int* dims, int ndim)
+    { LOG(INFO) << "Softmax donot implement forward_loss"; return 0; /* Implement in instance */ }
+    /*
+     * Fused backward from x when the softmax output was not kept:
+     * gx = coeff * (softmax(x) - onehot(label)), zero for ignored samples.
+     */
+    virtual int backward_x(T* x, int dummy_x,
+                           T* gx, int dummy_gx,
+                           int* label, int nlabel,
+                           int* dims, int ndim, T coeff)
+    { LOG(INFO) << "Softmax donot implement backward_x"; return -1; /* Implement in instance */ }
+
+    /*
+     * Sums the log probabilities y (output of forward) picked by label,
+     * skipping samples whose label is out of [0, C). Trailing dims are
+     * flattened, so it serves both 2D and 4D inputs.
+     */
+    static T loss(T* y, int dummy_y,
+                  int* label, int nlabel,
+                  int* dims, int ndim);
 };
 
 template <typename T>
@@ -99,7 +134,15 @@ public:
                 int* dims, int ndim);
     int backward(T* gx, int dummy_gx,
                  int* label, int nlabel,
-                 int* dims, int ndim);
+                 int* dims, int ndim, T coeff = 1);
+    T forward_loss(T* x, int dummy_x,
+                   T* y, int dummy_y,
+                   int* label, int nlabel,
+                   int* dims, int ndim);
+    int backward_x(T* x, int dummy_x,
+                   T* gx, int dummy_gx,
+                   int* label, int nlabel,
+                   int* dims, int ndim, T coeff);
 };
 
 template <typename T>
@@ -112,7 +155,7 @@ public:
                 int* dims, int ndim);
     int backward(T* gx, int dummy_gx,
                  int* label, int nlabel,
-                 int* dims, int ndim);
+                 int* dims, int ndim, T coeff = 1);
 };
 
 #endif // _SOFTMAX_CROSS_ENTROPY_H_
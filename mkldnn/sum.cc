@@ -84,12 +84,14 @@ Sum<T>::~Sum() {
 
 template<typename T>
 void Sum<T>::sum_setup(int num_sum, Sum<T>::sum_data* sum_input,
-        T* y, int y_d1, int y_d2, int y_d3, int y_d4) {
+        const memory::dims& output_tz) {
     LOG(INFO) << "Enter sum forward_setup";
-    LOG(INFO) << "y_d1=" << y_d1 << "; y_d2=" << y_d2 << "; y_d3="<<y_d3 << "; y_d4=" << y_d4;
-    memory::dims output_tz = {y_d1, y_d2, y_d3, y_d4};
-    memory::format src_mfmt = memory::format::nchw;
+    setup_done_ = true;
+    /* 4d arrays are nchw, anything else is summed as a flat vector */
+    memory::format src_mfmt = output_tz.size() == 4 ? memory::format::nchw
+                                                    : memory::format::x;
 
+    try {
       for (int i = 0; i < num_sum; i++) {
           memory::dims input_tz = sum_input[i].dims;
 
@@ -97,10 +99,10 @@ void Sum<T>::sum_setup(int num_sum, Sum<T>::sum_data* sum_input,
           assert(output_tz == input_tz);
 
           // sum primitive doesn't expose API to get inputs' internal format
-          // so here always set input internal format as nchw
+          // so here always set input internal format as the user format
           shared_ptr<memory::primitive_desc> input_mem_pd;
           input_mem_pd.reset(new memory::primitive_desc(
-                      {input_tz, memory_data_type<T>(), memory::format::nchw}, cpu_engine));
+                      {input_tz, memory_data_type<T>(), src_mfmt}, cpu_engine));
           srcs_mem_pd_.push_back(*input_mem_pd);
           scale_.push_back((double)1.0);
 
@@ -112,11 +114,14 @@ void Sum<T>::sum_setup(int num_sum, Sum<T>::sum_data* sum_input,
 
       //create user dst memory prim/desc
       user_dst_md_.reset(new memory::desc(output_tz, memory_data_type<T>(),memory::format::any));
-      user_dst_mem_.reset(new memory({{{output_tz}, memory_data_type<T>(), memory::format::nchw}, cpu_engine}, dummy));
+      user_dst_mem_.reset(new memory({{{output_tz}, memory_data_type<T>(), src_mfmt}, cpu_engine}, dummy));
 
       sum_pd_.reset(new mkldnn::sum::primitive_desc(*user_dst_md_, scale_,  srcs_mem_pd_));
-
-
+    } catch (mkldnn::error& e) {
+      LOG(INFO) << "sum primitive not available, use OpenMP loop: " << e.message;
+      use_fallback_ = true;
+      return;
+    }
 
       /*
        * Check whether need to reorder for dst mem
@@ -127,7 +132,7 @@ void Sum<T>::sum_setup(int num_sum, Sum<T>::sum_data* sum_input,
               != user_dst_mem_.get()->get_primitive_desc()) {
           LOG(INFO) << "sum reorder dst memory";
           dst_mem_.reset(
-                  new memory(sum_pd_.get()->dst_primitive_desc()));
+                  new_local_memory(sum_pd_.get()->dst_primitive_desc()));
           sum_reorder_dst_ = reorder(*dst_mem_, *user_dst_mem_);
           reorder_sum_dst = true;
       }
@@ -142,18 +147,31 @@ void Sum<T>::sum_setup(int num_sum, Sum<T>::sum_data* sum_input,
 }
 
 template<typename T>
-void Sum<T>::sum(int num_sum, char** data, int* n, int* c, int* h, int* w,
-        T* y, int y_d1, int y_d2, int y_d3, int y_d4) {
+void Sum<T>::sum_fallback(int num_sum, Sum<T>::sum_data* sum_input,
+        T* y, size_t len) {
+    /* all inputs are read before y is written, so y may alias an input */
+    #pragma omp parallel for simd
+    for (size_t i = 0; i < len; i++) {
+        T acc = sum_input[0].data[i];
+        for (int k = 1; k < num_sum; k++)
+            acc += sum_input[k].data[i];
+        y[i] = acc;
+    }
+}
 
-    sum_data sum_input[num_sum];
-    for (int i = 0; i < num_sum; i++) {
-        sum_input[i].data = (T*)data[i];
-        sum_input[i].dims = {n[i], c[i], h[i], w[i]};
+template<typename T>
+void Sum<T>::execute(int num_sum, Sum<T>::sum_data* sum_input,
+        T* y, const memory::dims& output_tz) {
+    if (!setup_done_) {
+        sum_setup(num_sum, sum_input, output_tz);
     }
 
-    if (sum_prim_ == NULL) {
-        sum_setup(num_sum, sum_input,
-                y, y_d1, y_d2, y_d3, y_d4);
+    if (use_fallback_) {
+        size_t len = 1;
+        for (auto d : output_tz)
+            len *= d;
+        sum_fallback(num_sum, sum_input, y, len);
+        return;
     }
 
     /*
@@ -174,5 +192,30 @@ void Sum<T>::sum(int num_sum, char** data, int* n, int* c, int* h, int* w,
     }
 }
 
+template<typename T>
+void Sum<T>::sum(int num_sum, char** data, int* n, int* c, int* h, int* w,
+        T* y, int y_d1, int y_d2, int y_d3, int y_d4) {
+
+    sum_data sum_input[num_sum];
+    for (int i = 0; i < num_sum; i++) {
+        sum_input[i].data = (T*)data[i];
+        sum_input[i].dims = {n[i], c[i], h[i], w[i]};
+    }
+
+    execute(num_sum, sum_input, y, {y_d1, y_d2, y_d3, y_d4});
+}
+
+template<typename T>
+void Sum<T>::sum_nd(int num_sum, char** data, int* size,
+        T* y_flat, int y_size) {
+
+    sum_data sum_input[num_sum];
+    for (int i = 0; i < num_sum; i++) {
+        sum_input[i].data = (T*)data[i];
+        sum_input[i].dims = {size[i]};
+    }
+
+    execute(num_sum, sum_input, y_flat, {y_size});
+}
+
 template class Sum<float>;
-template class Sum<double>;
@@ -61,6 +61,7 @@
  */
 
 
+
 #ifndef _MKLDNN_SUM_H
 #define _MKLDNN_SUM_H
 
@@ -83,13 +84,61 @@ public:
     ~Sum<T>();
 
     void sum_setup(int num_sum, sum_data* sum_input,
-            T* y, int y_d1, int y_d2, int y_d3, int y_d4);
+            const mkldnn::memory::dims& output_tz);
 
     void sum(int num_sum, char** data, int* n, int* c, int* h, int* w,
             T* y, int y_d1, int y_d2, int y_d3, int y_d4);
 
+    /*
+     * Sum of contiguous arrays of any rank, summed as flat vectors
+     * size: number of elements of each input
+     */
+    void sum_nd(int num_sum, char** data, int* size,
+            T* y_flat, int y_size);
+
+    /*
+     * Sum with a cached layer
+     * y may be one of the inputs, the sum is elementwise so it can
+     * accumulate in place.
+     */
+    static void do_sum(int num_sum, char** data, int* n, int* c, int* h, int* w,
+            T* y, int y_d1, int y_d2, int y_d3, int y_d4) {
+        Sum<T>* sum_object = get_sum_object(num_sum, y_d1, y_d2, y_d3, y_d4);
+        sum_object->sum(num_sum, data, n, c, h, w,
+                y, y_d1, y_d2, y_d3, y_d4);
+        LayerFactory<T>::get_instance().put_layer(sum_object);
+    }
+
+    static void do_sum_nd(int num_sum, char** data, int* size,
+            T* y_flat, int y_size) {
+        /* flat layers are keyed apart from 4d ones of the same volume */
+        Sum<T>* sum_object = get_sum_object(num_sum, y_size, -1, -1, -1);
+        sum_object->sum_nd(num_sum, data, size, y_flat, y_size);
+        LayerFactory<T>::get_instance().put_layer(sum_object);
+    }
+
 private:
+    static Sum<T>* get_sum_object(int num_sum, int d1, int d2, int d3, int d4) {
+        Sum<T>* sum_object = dynamic_cast<Sum<T>*>(
+                LayerFactory<T>::get_instance().get_sum_layer(
+                    num_sum, d1, d2, d3, d4));
+        if (sum_object == NULL) {
+            sum_object = new Sum<T>();
+            LayerFactory<T>::get_instance().set_sum_layer(
+                    num_sum, d1, d2, d3, d4, sum_object);
+        }
+        return sum_object;
+    }
+
+    void execute(int num_sum, sum_data* sum_input,
+            T* y, const mkldnn::memory::dims& output_tz);
+
+    // elementwise OpenMP loop for shapes the sum primitive rejects
+    void sum_fallback(int num_sum, sum_data* sum_input, T* y, size_t len);
+
        bool first_run_ = true;
+       bool setup_done_ = false;
+       bool use_fallback_ = false;
 
        std::shared_ptr<mkldnn::stream> sum_stream_;
        std::vector<mkldnn::memory::primitive_desc> srcs_mem_pd_;
@@ -1,22 +1,41 @@
 import numpy
 from . import mkldnn
+from .mdarray import mdarray
 is_from_chain = False
 enable_conv = True
 enable_max_pooling = True
 enable_avg_pooling = True
 enable_lrn = True
 enable_relu = True
-enable_softmax = False
+# F.relu overwrites intermediate inputs (see
+# chainer.utils.array.is_intermediate); only turn it on when nothing reads
+# them after the relu
+enable_relu_inplace = False
+# F.relu and F.max_pooling_2d keep compact masks for backward
+enable_relu_mask = True
+enable_max_pooling_mask = True
+# with a mask, F.relu and F.max_pooling_2d release the data of intermediate
+# inputs (see chainer.Variable.release_data); reading it afterwards raises
+enable_release_inputs = False
+enable_softmax = True
 enable_linear = True
-enable_softmax_cross_entropy = False
+enable_softmax_cross_entropy = True
 enable_concat = True
 enable_acc_grad = True
+enable_batch_normalization = True
+enable_deconv = True
+# leaky_relu, elu, tanh, sigmoid, clipped_relu and softplus
+enable_eltwise = True
+# keep conv/relu/pooling/lrn outputs in MKL-DNN layout (mdarray.mdarray)
+enable_mdarray = False
 supportTypes = (numpy.float32,)
 
 
 def SupportedInput(tul):
     isSupportType = True
     for x in tul:
+        if isinstance(x, mdarray):
+            continue
         if len(x) == 0:
             continue
         if x[0].dtype not in supportTypes:
@@ -47,6 +66,12 @@ def enable_reluF(tul):
         return mkldnn.enabled() and SupportedInput(tul) and enable_relu
 
 
+def enable_eltwiseF(tul):
+        return (mkldnn.enabled() and enable_eltwise and
+                all(x.ndim > 0 and x.flags.c_contiguous for x in tul) and
+                SupportedInput(tul))
+
+
 def enable_softmaxF(tul):
         return mkldnn.enabled() and SupportedInput(tul) and enable_softmax
 
@@ -65,3 +90,11 @@ def enable_concatF(tul):
 
 def enable_acc_gradF(tul):
         return mkldnn.enabled() and SupportedInput(tul) and enable_acc_grad
+
+
+def enable_batch_normalizationF(tul):
+        return mkldnn.enabled() and SupportedInput(tul) and enable_batch_normalization
+
+
+def enable_deconvF(tul):
+        return mkldnn.enabled() and SupportedInput(tul) and enable_deconv
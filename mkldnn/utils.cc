@@ -61,26 +61,18 @@
  */
 
 
-#if defined(__INTEL_COMPILER) && (__INTEL_COMPILER >= 1300)
-#include <immintrin.h>
-int has_intel_knl_features()
-{
-  const unsigned long knl_features =
-      (_FEATURE_AVX512F | _FEATURE_AVX512ER |
-       _FEATURE_AVX512PF | _FEATURE_AVX512CD );
-  return _may_i_use_cpu_feature( knl_features );
-}
-
-int has_intel_avx2_features()
-{
-  const unsigned long avx2_features = _FEATURE_AVX2;
-  return _may_i_use_cpu_feature( avx2_features );
-}
-#else /* non-Intel compiler */
+#include <glog/logging.h>
 #include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
 #if defined(_MSC_VER)
 #include <intrin.h>
 #endif
+#include "mkldnn.hpp"
+#include "common.h"
+#include "cpu_info.h"
+#include "utils.h"
+
 void run_cpuid(uint32_t eax, uint32_t ecx, uint32_t* abcd)
 {
 #if defined(_MSC_VER)
@@ -98,106 +90,172 @@ void run_cpuid(uint32_t eax, uint32_t ecx, uint32_t* abcd)
 #endif
 }
 
-int check_xcr0_zmm() {
-  uint32_t xcr0;
-  uint32_t zmm_ymm_xmm = (7 << 5) | (1 << 2) | (1 << 1);
+static uint32_t read_xcr0()
+{
 #if defined(_MSC_VER)
-  xcr0 = (uint32_t)_xgetbv(0);  /* min VS2010 SP1 compiler is required */
+  return (uint32_t)_xgetbv(0);  /* min VS2010 SP1 compiler is required */
 #else
+  uint32_t xcr0;
   __asm__ ("xgetbv" : "=a" (xcr0) : "c" (0) : "%edx" );
+  return xcr0;
 #endif
-  return ((xcr0 & zmm_ymm_xmm) == zmm_ymm_xmm); /* check if xmm, zmm and zmm state are enabled in XCR0 */
 }
 
-int check_xcr0_ymm()
-{
- uint32_t xcr0;
-  uint32_t ymm_xmm = (1 << 2) | (1 << 1);
-#if defined(_MSC_VER)
- xcr0 = (uint32_t)_xgetbv(0); /* min VS2010 SP1 compiler is required */
-#else
- __asm__ ("xgetbv" : "=a" (xcr0) : "c" (0) : "%edx" );
-#endif
- return ((xcr0 & ymm_xmm) == ymm_xmm); /* checking if xmm and ymm state are enabled in XCR0 */
-}
+// CPUID bits of the features, leaf 1 ecx and leaf 7 ebx/ecx
+#define CPUID1_ECX_FMA          (1u << 12)
+#define CPUID1_ECX_OSXSAVE      (1u << 27)
+#define CPUID1_ECX_AVX          (1u << 28)
+#define CPUID7_EBX_AVX2         (1u << 5)
+#define CPUID7_EBX_AVX512F      (1u << 16)
+#define CPUID7_EBX_AVX512DQ     (1u << 17)
+#define CPUID7_EBX_AVX512PF     (1u << 26)
+#define CPUID7_EBX_AVX512ER     (1u << 27)
+#define CPUID7_EBX_AVX512CD     (1u << 28)
+#define CPUID7_EBX_AVX512BW     (1u << 30)
+#define CPUID7_EBX_AVX512VL     (1u << 31)
+#define CPUID7_ECX_AVX512_VNNI  (1u << 11)
+
+// XCR0 state the OS saves on context switch: xmm, ymm, and opmask/zmm
+#define XCR0_YMM ((1u << 2) | (1u << 1))
+#define XCR0_ZMM ((7u << 5) | XCR0_YMM)
 
-int has_intel_knl_features() {
+static unsigned detect_cpu_features()
+{
     uint32_t abcd[4];
-    uint32_t osxsave_mask   =   (1 << 27); // OSX.
-    uint32_t knl_bmi12_mask =   (1 << 16) | // AVX-512F
-                                (1 << 26) | // AVX-512PF
-                                (1 << 27) | // AVX-512ER
-                                (1 << 28);  // AVX-512CD
-    run_cpuid( 1, 0, abcd );
-    // step 1 - must ensure OS supports extended processor state management
-    if ( (abcd[2] & osxsave_mask) != osxsave_mask )
-        return 0;
-    run_cpuid( 7, 0, abcd );
-    if ( (abcd[1] & knl_bmi12_mask) != knl_bmi12_mask )
+    unsigned features = 0;
+
+    run_cpuid(0, 0, abcd);
+    uint32_t max_leaf = abcd[0];
+    run_cpuid(1, 0, abcd);
+    uint32_t ecx1 = abcd[2];
+    // the OS has to save the vector registers before they can be used
+    if (!(ecx1 & CPUID1_ECX_OSXSAVE) || !(ecx1 & CPUID1_ECX_AVX))
         return 0;
-    // step 2 - must ensure OS supports ZMM registers (and YMM, and XMM)
-    if ( ! check_xcr0_zmm() )
+    uint32_t xcr0 = read_xcr0();
+    if ((xcr0 & XCR0_YMM) != XCR0_YMM)
         return 0;
 
-    return 1;
+    if (ecx1 & CPUID1_ECX_FMA)
+        features |= CPU_FMA;
+    if (max_leaf < 7)
+        return features;
+
+    run_cpuid(7, 0, abcd);
+    uint32_t ebx7 = abcd[1], ecx7 = abcd[2];
+    if (ebx7 & CPUID7_EBX_AVX2)
+        features |= CPU_AVX2;
+    if ((xcr0 & XCR0_ZMM) != XCR0_ZMM)
+        return features;
+
+    static const struct { uint32_t bit; unsigned feature; } avx512_ebx[] = {
+        { CPUID7_EBX_AVX512F,  CPU_AVX512F },
+        { CPUID7_EBX_AVX512CD, CPU_AVX512CD },
+        { CPUID7_EBX_AVX512BW, CPU_AVX512BW },
+        { CPUID7_EBX_AVX512DQ, CPU_AVX512DQ },
+        { CPUID7_EBX_AVX512VL, CPU_AVX512VL },
+        { CPUID7_EBX_AVX512ER, CPU_AVX512ER },
+        { CPUID7_EBX_AVX512PF, CPU_AVX512PF },
+    };
+    for (auto& f : avx512_ebx) {
+        if (ebx7 & f.bit)
+            features |= f.feature;
+    }
+    if (ecx7 & CPUID7_ECX_AVX512_VNNI)
+        features |= CPU_AVX512_VNNI;
+    // the other AVX-512 extensions are meaningless without the foundation
+    if (!(features & CPU_AVX512F))
+        features &= CPU_FMA | CPU_AVX2;
+    return features;
 }
 
-int has_intel_avx2_features() {
-    uint32_t abcd[4];
-    uint32_t fma_movbe_osxsave_mask = ((1 << 12) | (1 << 22) | (1 << 27));
-    uint32_t avx2_bmi12_mask = (1 << 5) | (1 << 3) | (1 << 8);
-    run_cpuid( 1, 0, abcd );
-    if ( (abcd[2] & fma_movbe_osxsave_mask) != fma_movbe_osxsave_mask )
-        return 0;
-    if ( ! check_xcr0_ymm() )
-        return 0;
-    run_cpuid( 7, 0, abcd );
-    if ( (abcd[1] & avx2_bmi12_mask) != avx2_bmi12_mask )
-        return 0;
-    return 1;
+#define ISA_AVX2        (CPU_FMA | CPU_AVX2)
+#define ISA_AVX512_COMMON (ISA_AVX2 | CPU_AVX512F | CPU_AVX512CD)
+#define ISA_AVX512_MIC  (ISA_AVX512_COMMON | CPU_AVX512ER | CPU_AVX512PF)
+#define ISA_AVX512_CORE (ISA_AVX512_COMMON | \
+                         CPU_AVX512BW | CPU_AVX512DQ | CPU_AVX512VL)
+
+// Widest first, named as MKL-DNN names its ISAs
+static const struct {
+    const char* name;
+    unsigned features;
+} isa_table[] = {
+    { "avx512_core_vnni", ISA_AVX512_CORE | CPU_AVX512_VNNI },
+    { "avx512_core",      ISA_AVX512_CORE },
+    { "avx512_mic",       ISA_AVX512_MIC },
+    { "avx512_common",    ISA_AVX512_COMMON },
+    { "avx2",             ISA_AVX2 },
+    { "sse42",            0 },
+};
+
+// MKLDNN_MAX_CPU_ISA=<isa name> limits the features to those of the ISA,
+// "all" or unset keeps what the CPU has
+static unsigned max_isa_features()
+{
+    const char* value = getenv("MKLDNN_MAX_CPU_ISA");
+    if (value == NULL || strcasecmp(value, "all") == 0)
+        return ~0u;
+    for (auto& isa : isa_table) {
+        if (strcasecmp(value, isa.name) == 0)
+            return isa.features;
+    }
+    LOG(WARNING) << "MKLDNN_MAX_CPU_ISA=" << value << " is unknown, ignored";
+    return ~0u;
 }
-#endif /* non-Intel compiler */
-
-static int can_use_intel_knl_features() {
-  static int knl_features_available = -1;
-  /* test is performed once */
-  if (knl_features_available < 0 )
-    knl_features_available = has_intel_knl_features();
-  return knl_features_available;
+
+unsigned cpu_features()
+{
+    /* test is performed once */
+    static const unsigned features = detect_cpu_features() & max_isa_features();
+    return features;
 }
 
-static int can_use_intel_avx2_features() {
-  static int avx2_features_available = -1;
-  /* test is performed once */
-  if (avx2_features_available < 0 )
-    avx2_features_available = has_intel_avx2_features();
-  return avx2_features_available;
+const char* cpu_isa_name()
+{
+    unsigned features = cpu_features();
+    for (auto& isa : isa_table) {
+        if ((features & isa.features) == isa.features)
+            return isa.name;
+    }
+    return "sse42";
 }
 
+// AVX-512F is all the 16 channel blocked kernels need, Knights Landing
+// and Xeon (Skylake-SP and later) alike
 int cpu_support_avx512_p()
 {
-    return can_use_intel_knl_features();
-    // TODO the following code requires gcc 6 or above
-    //__builtin_cpu_init();
-    //return  true && __builtin_cpu_supports("avx512f")
-    //             && __builtin_cpu_supports("avx512cd")
-    //             && __builtin_cpu_supports("avx512er")
-    //             && __builtin_cpu_supports("avx512pf");
-    // TODO icc path not enabled
-    //const unsigned long knl_features =
-    //    (_FEATURE_AVX512F | _FEATURE_AVX512ER |
-    //    _FEATURE_AVX512PF | _FEATURE_AVX512CD );
-    //    return _may_i_use_cpu_feature( knl_features );
+    return (cpu_features() & CPU_AVX512F) != 0;
 }
 
 int cpu_support_avx2_p()
 {
-    return can_use_intel_avx2_features();
-    //__builtin_cpu_init();
-    //return 1 && __builtin_cpu_supports("avx2");
-    // TODO icc path not enabled
-    //const unsigned long avx2_features = _FEATURE_AVX2
-    //    return _may_i_use_cpu_feature( avx2_features );
+    return (cpu_features() & ISA_AVX2) == ISA_AVX2;
+}
+
+mkldnn::memory::format cpu_blocked_format(int channels)
+{
+    if (cpu_support_avx512_p() && (channels % 16) == 0)
+        return mkldnn::memory::format::nChw16c;
+    if (cpu_support_avx2_p() && (channels % 8) == 0)
+        return mkldnn::memory::format::nChw8c;
+    return mkldnn::memory::format::nchw;
+}
+
+
+mkldnn::memory* new_local_memory(const mkldnn::memory::primitive_desc& pd)
+{
+    mkldnn::memory* mem = new mkldnn::memory(pd);
+    // the memory is malloc'ed and not touched yet, one node has nothing to
+    // place
+    if (OpenMpManager::getNumberOfNodes() < 2)
+        return mem;
+
+    char* data = static_cast<char*>(mem->get_data_handle());
+    long pages = (pd.get_size() + PAGE_SIZE - 1) / PAGE_SIZE;
+    #pragma omp parallel for schedule(static)
+    for (long i = 0; i < pages; i++)
+        data[i * PAGE_SIZE] = 0;
+    return mem;
 }
 
 
+// vim: et ts=4 sw=4 cindent cino^=l0,\:0,N-s
@@ -61,6 +61,8 @@
  */
 
 
+#pragma once
+
 #include <glog/logging.h>
 #include "mkldnn.hpp"
 
@@ -79,8 +81,31 @@ static mkldnn::memory::data_type memory_data_type() {
     return mkldnn::memory::data_type::data_undef;
 }
 
+// CPU features from CPUID, set only when the OS saves the registers
+enum cpu_feature {
+    CPU_FMA         = 1 << 0,
+    CPU_AVX2        = 1 << 1,
+    CPU_AVX512F     = 1 << 2,
+    CPU_AVX512CD    = 1 << 3,
+    CPU_AVX512BW    = 1 << 4,
+    CPU_AVX512DQ    = 1 << 5,
+    CPU_AVX512VL    = 1 << 6,
+    CPU_AVX512_VNNI = 1 << 7,
+    CPU_AVX512ER    = 1 << 8,   // Knights Landing only
+    CPU_AVX512PF    = 1 << 9,   // Knights Landing only
+};
+
+// cpu_feature bits of the host, limited by env MKLDNN_MAX_CPU_ISA
+unsigned cpu_features(void);
 int cpu_support_avx512_p(void);
 int cpu_support_avx2_p(void);
+// nChw16c with AVX-512, nChw8c with AVX2 if channels allow, else nchw
+mkldnn::memory::format cpu_blocked_format(int channels);
+
+// New memory for a layer owned buffer. On NUMA machines its pages are first
+// touched by the OpenMP team with a static schedule, the way the primitives
+// split their work, so each page lands on the node that works on it.
+mkldnn::memory* new_local_memory(const mkldnn::memory::primitive_desc& pd);
 
 #define DISALLOW_COPY_AND_ASSIGN(TypeName) \
   TypeName(const TypeName&) = delete;      \
@@ -19,7 +19,11 @@ extensions = [
         "mkldnn._mkldnn",
         sources=[
                 "mkldnn/relu4d.cc",
+                "mkldnn/batch_normalization.cc",
+                "mkldnn/deconv.cc",
                 "mkldnn/relu.cc",
+                "mkldnn/eltwise.cc",
+                "mkldnn/mask.cc",
                 "mkldnn/conv.cc",
                 "mkldnn/concat.cc",
                 "mkldnn/common.cc",
@@ -27,6 +31,7 @@ extensions = [
                 "mkldnn/layer_factory.cc",
                 "mkldnn/linear.cc",
                 "mkldnn/lrn.cc",
+                "mkldnn/mdarray.cc",
                 "mkldnn/pooling.cc",
                 "mkldnn/max_pooling.cc",
                 "mkldnn/avg_pooling.cc",
@@ -36,7 +41,7 @@ extensions = [
                 "mkldnn/utils.cc",
                 "mkldnn/mkldnn.i"
                 ],
-        swig_opts=["-c++"],
+        swig_opts=["-c++", "-threads"],
         extra_compile_args=[
             "-std=c++11", "-fopenmp", "-funsafe-math-optimizations",
             "-ffinite-math-only", "-fno-rounding-math",
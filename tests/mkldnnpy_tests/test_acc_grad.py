@@ -0,0 +1,92 @@
+import numpy as np
+import unittest
+import chainer
+import chainer.functions as F
+import chainer.testing as testing
+from mkldnn import mkldnn as mkl
+from mkldnn import switch
+
+
+class TestAccGrad(unittest.TestCase):
+    def setUp(self):
+        self.x = np.random.uniform(-1, 1, (2, 8, 7, 7)).astype('f')
+        self.W = np.random.uniform(-1, 1, (8, 8, 3, 3)).astype('f')
+
+    def tearDown(self):
+        switch.enable_acc_grad = True
+
+    def grads(self, acc_grad):
+        switch.enable_acc_grad = acc_grad
+        x = chainer.Variable(self.x)
+        W = chainer.Variable(self.W)
+        h = F.convolution_2d(x, W, pad=1, use_cudnn=False)
+        # h fans out three times, two branches share one gradient array
+        a = F.relu(h, use_cudnn=False)
+        y = F.sum(a * a) + F.sum(h + h) + F.sum(h * 3)
+        y.backward()
+        return x.grad.copy(), W.grad.copy()
+
+    def test_acc_grad(self):
+        gx_expect, gW_expect = self.grads(False)
+        for _ in range(2):
+            # second pass runs on the cached sum layer
+            gx, gW = self.grads(True)
+            testing.assert_allclose(gx, gx_expect, atol=1e-4, rtol=1e-4)
+            testing.assert_allclose(gW, gW_expect, atol=1e-3, rtol=1e-4)
+
+    def test_acc_grad_2d(self):
+        W = np.random.uniform(-1, 1, (6, 6)).astype('f')
+
+        def grads(acc_grad):
+            switch.enable_acc_grad = acc_grad
+            x = chainer.Variable(self.x.reshape(2, -1)[:, :6].copy())
+            W_v = chainer.Variable(W)
+            # W is shared by two layers, h fans out twice
+            h = F.linear(x, W_v)
+            y = F.sum(F.linear(h, W_v)) + F.sum(F.tanh(h))
+            y.backward()
+            return x.grad.copy(), W_v.grad.copy()
+
+        gx_expect, gW_expect = grads(False)
+        gx, gW = grads(True)
+        testing.assert_allclose(gx, gx_expect, atol=1e-4, rtol=1e-4)
+        testing.assert_allclose(gW, gW_expect, atol=1e-4, rtol=1e-4)
+
+    def test_caller_grad_unchanged(self):
+        x = chainer.Variable(self.x)
+        W = chainer.Variable(self.W)
+        h = F.convolution_2d(x, W, pad=1, use_cudnn=False)
+        # the identities pass the caller's array on, to the relu output
+        # and to h, which fans out
+        a = F.identity(F.relu(h, use_cudnn=False))
+        y = F.identity(a * 2 + F.tanh(a))
+        gy = np.random.uniform(-1, 1, y.shape).astype('f')
+        gy_expect = gy.copy()
+        y.grad = gy
+        y.backward()
+        self.assertIs(y.grad, gy)
+        np.testing.assert_array_equal(gy, gy_expect)
+
+        y = F.identity(F.relu(F.identity(h), use_cudnn=False))
+        y.grad = gy
+        y.backward()
+        np.testing.assert_array_equal(gy, gy_expect)
+
+    def test_do_sum_nd(self):
+        for shape in ((7,), (3, 5), (2, 3, 4), (2, 3, 4, 5, 6)):
+            a = np.random.uniform(-1, 1, shape).astype('f')
+            b = np.random.uniform(-1, 1, shape).astype('f')
+            c = np.random.uniform(-1, 1, shape).astype('f')
+            y = np.empty(shape, dtype='f')
+            mkl.Sum_F32.do_sum_nd((a, b, c), y)
+            testing.assert_allclose(y, a + b + c, atol=1e-6, rtol=1e-6)
+
+    def test_do_sum_in_place(self):
+        a = np.random.uniform(-1, 1, (2, 3, 4, 5)).astype('f')
+        b = np.random.uniform(-1, 1, (2, 3, 4, 5)).astype('f')
+        expect = a + b
+        mkl.Sum_F32.do_sum((b, a), a)
+        testing.assert_allclose(a, expect)
+
+
+testing.run_module(__name__, __file__)
@@ -0,0 +1,66 @@
+import numpy as np
+import unittest
+import chainer
+import chainer.functions as F
+from chainer.functions.normalization import batch_normalization
+import chainer.testing as testing
+from mkldnn import switch
+
+
+@testing.parameterize(*testing.product({
+    'shape': [(4, 8), (4, 16, 7, 7), (2, 32, 5, 5)],
+}))
+class TestBatchNormalization(unittest.TestCase):
+    def setUp(self):
+        c = self.shape[1]
+        self.x = np.random.uniform(-1, 1, self.shape).astype('f')
+        self.gamma = np.random.uniform(.5, 1, (c,)).astype('f')
+        self.beta = np.random.uniform(-1, 1, (c,)).astype('f')
+        self.gy = np.random.uniform(-1, 1, self.shape).astype('f')
+        self.mean = np.random.uniform(-1, 1, (c,)).astype('f')
+        self.var = np.random.uniform(.5, 1, (c,)).astype('f')
+
+    def tearDown(self):
+        switch.enable_batch_normalization = True
+
+    def run_bn(self, enable):
+        switch.enable_batch_normalization = enable
+        x = chainer.Variable(self.x.copy())
+        gamma = chainer.Variable(self.gamma.copy())
+        beta = chainer.Variable(self.beta.copy())
+        y = F.batch_normalization(x, gamma, beta, use_cudnn=False)
+        y.grad = self.gy
+        y.backward()
+        return y.data, x.grad, gamma.grad, beta.grad
+
+    def test_train(self):
+        expect = self.run_bn(False)
+        actual = self.run_bn(True)
+        for a, e in zip(actual, expect):
+            testing.assert_allclose(a, e, atol=1e-3, rtol=1e-3)
+
+    def test_running_stats(self):
+        c = self.shape[1]
+        stats = []
+        for enable in (False, True):
+            switch.enable_batch_normalization = enable
+            f = batch_normalization.BatchNormalizationFunction(
+                2e-5, np.zeros(c, 'f'), np.ones(c, 'f'), 0.9, False)
+            f(self.x, self.gamma, self.beta)
+            stats.append((f.running_mean, f.running_var))
+        testing.assert_allclose(stats[1][0], stats[0][0], atol=1e-4)
+        testing.assert_allclose(stats[1][1], stats[0][1], atol=1e-4)
+
+    def test_inference(self):
+        ys = []
+        for enable in (False, True):
+            switch.enable_batch_normalization = enable
+            with chainer.using_config('train', False):
+                y = F.fixed_batch_normalization(
+                    self.x, self.gamma, self.beta, self.mean, self.var,
+                    use_cudnn=False)
+            ys.append(y.data)
+        testing.assert_allclose(ys[1], ys[0], atol=1e-4, rtol=1e-4)
+
+
+testing.run_module(__name__, __file__)
@@ -0,0 +1,55 @@
+import numpy as np
+import unittest
+import chainer
+import chainer.functions as F
+import chainer.links as L
+import chainer.testing as testing
+from mkldnn import mkldnn as mkl
+from mkldnn import switch
+
+
+@testing.parameterize(*testing.product({
+    'first_layer': [False, True],
+    'nobias': [False, True],
+}))
+class TestConvBwdConcurrent(unittest.TestCase):
+    def setUp(self):
+        switch.enable_conv = True
+        self.x = np.random.uniform(-1, 1, (8, 16, 7, 7)).astype('f')
+        self.gy = np.random.uniform(-1, 1, (8, 32, 7, 7)).astype('f')
+        # in a chain, a convolution of a leaf input skips backward data
+        self.model = chainer.Chain(conv=L.Convolution2D(
+            16, 32, 3, pad=1, nobias=self.nobias, use_cudnn=False))
+
+    def tearDown(self):
+        mkl.set_conv_bwd_concurrent(False)
+        mkl.layer_cache_clear()
+
+    def run_bwd(self, concurrent):
+        mkl.set_conv_bwd_concurrent(concurrent)
+        mkl.layer_cache_clear()
+        grads = []
+        # the second run reuses the primitives of the first one
+        for i in range(2):
+            self.model.cleargrads()
+            x = chainer.Variable(self.x.copy())
+            h = x if self.first_layer else F.identity(x)
+            y = self.model.conv(h)
+            y.grad = self.gy.copy()
+            y.backward()
+            grads.append([self.model.conv.W.grad.copy()])
+            if not self.nobias:
+                grads[-1].append(self.model.conv.b.grad.copy())
+            if not self.first_layer:
+                grads[-1].append(x.grad.copy())
+        return grads
+
+    def test_concurrent(self):
+        expect = self.run_bwd(False)
+        actual = self.run_bwd(True)
+        for a_run, e_run in zip(actual, expect):
+            for a, e in zip(a_run, e_run):
+                testing.assert_allclose(a, e, atol=1e-3, rtol=1e-3)
+
+
+testing.run_module(__name__, __file__)
@@ -0,0 +1,45 @@
+import chainer.links as L
+import numpy as np
+import time
+
+from chainer import Variable
+from mkldnn import mkldnn as mkl
+
+# small spatial size, where neither half of backward fills all cores
+batch = 32
+niter = 13
+n_dry = 3
+
+data = np.random.uniform(-1, 1, (batch, 256, 14, 14)).astype(np.float32)
+y_grad = np.random.uniform(-1, 1, (batch, 256, 14, 14)).astype(np.float32)
+conv = L.Convolution2D(256, 256, 3, pad=1)
+
+
+def run(concurrent):
+    mkl.set_conv_bwd_concurrent(concurrent)
+    mkl.layer_cache_clear()
+    total = 0
+    count = 0
+    for i in range(niter):
+        conv.cleargrads()
+        x = Variable(data)
+        y = conv(x)
+        y.grad = y_grad
+        start = time.time()
+        y.backward()
+        end = time.time()
+        if i > n_dry - 1:
+            count += 1
+            total += (end-start)*1000
+    return total/count, x.grad.copy(), conv.W.grad.copy()
+
+
+t_serial, gx_serial, gW_serial = run(False)
+t_concurrent, gx_concurrent, gW_concurrent = run(True)
+mkl.set_conv_bwd_concurrent(False)
+mkl.layer_cache_clear()
+
+np.testing.assert_allclose(gx_concurrent, gx_serial, rtol=1e-4, atol=1e-4)
+np.testing.assert_allclose(gW_concurrent, gW_serial, rtol=1e-3, atol=1e-3)
+print("Average Backward serial: ", t_serial, "ms")
+print("Average Backward concurrent: ", t_concurrent, "ms")
@@ -0,0 +1,54 @@
+import numpy as np
+import unittest
+import chainer
+import chainer.functions as F
+import chainer.links as L
+import chainer.testing as testing
+from mkldnn import switch
+
+
+class TestConvolution2DReLU(unittest.TestCase):
+    def setUp(self):
+        switch.enable_conv = True
+        switch.enable_relu = True
+        self.x = np.random.uniform(-1, 1, (2, 16, 14, 14)).astype('f')
+        self.W = np.random.uniform(-1, 1, (32, 16, 3, 3)).astype('f')
+        self.b = np.random.uniform(-1, 1, (32,)).astype('f')
+        self.gy = np.random.uniform(-1, 1, (2, 32, 14, 14)).astype('f')
+
+    def check(self, train):
+        with chainer.using_config('train', train):
+            x = chainer.Variable(self.x)
+            W = chainer.Variable(self.W)
+            b = chainer.Variable(self.b)
+            y = F.convolution_2d_relu(x, W, b, pad=1, use_cudnn=False)
+            y.grad = self.gy
+            y.backward()
+
+            x_e = chainer.Variable(self.x)
+            W_e = chainer.Variable(self.W)
+            b_e = chainer.Variable(self.b)
+            y_e = F.relu(F.convolution_2d(x_e, W_e, b_e, pad=1,
+                                          use_cudnn=False), use_cudnn=False)
+            y_e.grad = self.gy
+            y_e.backward()
+
+        testing.assert_allclose(y.data, y_e.data, atol=1e-4, rtol=1e-3)
+        testing.assert_allclose(x.grad, x_e.grad, atol=1e-4, rtol=1e-3)
+        testing.assert_allclose(W.grad, W_e.grad, atol=1e-3, rtol=1e-3)
+        testing.assert_allclose(b.grad, b_e.grad, atol=1e-3, rtol=1e-3)
+
+    def test_train(self):
+        self.check(True)
+
+    def test_inference(self):
+        self.check(False)
+
+    def test_link(self):
+        conv = L.Convolution2D(16, 32, 3, pad=1, initialW=self.W,
+                               use_cudnn=False, fuse_relu=True)
+        y = conv(self.x).data
+        self.assertTrue((y >= 0).all())
+
+
+testing.run_module(__name__, __file__)
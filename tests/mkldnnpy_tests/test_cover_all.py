@@ -0,0 +1,69 @@
+import numpy as np
+import unittest
+import chainer
+import chainer.functions as F
+import chainer.testing as testing
+from mkldnn import switch
+
+
+@testing.parameterize(*testing.product({
+    'shape': [(2, 8, 7, 7), (2, 8, 8, 6)],
+    'ksize': [2, 3],
+    'stride': [1, 2],
+    'pad': [0, 1],
+    'cover_all': [True, False],
+}))
+class TestCoverAll(unittest.TestCase):
+    def setUp(self):
+        self.x = np.random.uniform(-1, 1, self.shape).astype('f')
+        self.W = np.random.uniform(
+            -1, 1, (4, self.shape[1], self.ksize, self.ksize)).astype('f')
+
+    def tearDown(self):
+        switch.enable_conv = True
+        switch.enable_max_pooling = True
+        switch.enable_avg_pooling = True
+
+    def run_both(self, f):
+        outs = []
+        for enable in (False, True):
+            switch.enable_conv = enable
+            switch.enable_max_pooling = enable
+            switch.enable_avg_pooling = enable
+            x = chainer.Variable(self.x.copy())
+            y = f(x)
+            y.grad = np.ones(y.shape, dtype='f')
+            y.backward()
+            outs.append((y.data, x.grad))
+        for a, e in zip(outs[1], outs[0]):
+            testing.assert_allclose(a, e, atol=1e-4, rtol=1e-3)
+        return outs[1][0]
+
+    def test_convolution(self):
+        self.run_both(lambda x: F.convolution_2d(
+            x, self.W, stride=self.stride, pad=self.pad,
+            use_cudnn=False, cover_all=self.cover_all))
+
+    def test_max_pooling(self):
+        self.run_both(lambda x: F.max_pooling_2d(
+            x, self.ksize, stride=self.stride, pad=self.pad,
+            use_cudnn=False, cover_all=self.cover_all))
+
+    def test_average_pooling(self):
+        y = self.run_both(lambda x: F.average_pooling_2d(
+            x, self.ksize, stride=self.stride, pad=self.pad,
+            use_cudnn=False, cover_all=self.cover_all))
+
+        # windows are averaged over their part inside the padded input
+        k, s, p = self.ksize, self.stride, self.pad
+        h, w = self.shape[2:]
+        xp = np.pad(self.x, ((0, 0), (0, 0), (p, p), (p, p)), 'constant')
+        for i in range(y.shape[2]):
+            for j in range(y.shape[3]):
+                win = xp[:, :, i * s:i * s + k, j * s:j * s + k]
+                testing.assert_allclose(
+                    y[:, :, i, j], win.mean(axis=(2, 3)),
+                    atol=1e-4, rtol=1e-3)
+
+
+testing.run_module(__name__, __file__)
@@ -0,0 +1,54 @@
+import numpy as np
+import unittest
+import chainer
+import chainer.functions as F
+import chainer.testing as testing
+from mkldnn import mkldnn as mkl
+from mkldnn import switch
+
+
+class TestCpuIsa(unittest.TestCase):
+    def test_name(self):
+        self.assertIn(mkl.cpu_isa_name(), (
+            'avx512_core_vnni', 'avx512_core', 'avx512_mic',
+            'avx512_common', 'avx2', 'sse42'))
+
+
+# 16 channels run nChw16c on AVX-512, 24 nChw8c, 12 nchw
+@testing.parameterize(*testing.product({
+    'channels': [12, 16, 24],
+}))
+class TestBlockedFormat(unittest.TestCase):
+    def setUp(self):
+        self.x = np.random.uniform(
+            -1, 1, (2, self.channels, 9, 9)).astype('f')
+
+    def tearDown(self):
+        switch.enable_max_pooling = True
+        switch.enable_max_pooling_mask = True
+        switch.enable_lrn = True
+
+    def run_both(self, f):
+        outs = []
+        for enable in (False, True):
+            switch.enable_max_pooling = enable
+            switch.enable_lrn = enable
+            # pool through MKL-DNN in the blocked format
+            switch.enable_max_pooling_mask = False
+            x = chainer.Variable(self.x.copy())
+            y = f(x)
+            y.grad = np.ones(y.shape, dtype='f')
+            y.backward()
+            outs.append((y.data, x.grad))
+        for a, e in zip(outs[1], outs[0]):
+            testing.assert_allclose(a, e, atol=1e-4, rtol=1e-3)
+
+    def test_max_pooling(self):
+        self.run_both(lambda x: F.max_pooling_2d(x, 3, stride=2,
+                                                 use_cudnn=False))
+
+    def test_lrn(self):
+        self.run_both(lambda x: F.local_response_normalization(x))
+
+
+testing.run_module(__name__, __file__)
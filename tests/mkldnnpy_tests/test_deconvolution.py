@@ -0,0 +1,43 @@
+import numpy as np
+import unittest
+import chainer
+import chainer.functions as F
+import chainer.testing as testing
+from mkldnn import switch
+
+
+@testing.parameterize(*testing.product({
+    'nobias': [True, False],
+    'stride_pad_outsize': [(1, 0, None), (2, 1, None), (2, 1, (14, 14))],
+}))
+class TestDeconvolution2D(unittest.TestCase):
+    def setUp(self):
+        self.stride, self.pad, self.outsize = self.stride_pad_outsize
+        self.x = np.random.uniform(-1, 1, (2, 16, 7, 7)).astype('f')
+        self.W = np.random.uniform(-1, 1, (16, 8, 4, 4)).astype('f')
+        self.b = None if self.nobias else \
+            np.random.uniform(-1, 1, (8,)).astype('f')
+
+    def tearDown(self):
+        switch.enable_deconv = True
+
+    def run_deconv(self, enable):
+        switch.enable_deconv = enable
+        x = chainer.Variable(self.x)
+        W = chainer.Variable(self.W)
+        b = None if self.b is None else chainer.Variable(self.b)
+        y = F.deconvolution_2d(x, W, b, stride=self.stride, pad=self.pad,
+                               outsize=self.outsize, use_cudnn=False)
+        np.random.seed(0)
+        y.grad = np.random.uniform(-1, 1, y.shape).astype('f')
+        y.backward()
+        return [y.data, x.grad, W.grad] + ([] if b is None else [b.grad])
+
+    def test_forward_backward(self):
+        expect = self.run_deconv(False)
+        actual = self.run_deconv(True)
+        for a, e in zip(actual, expect):
+            testing.assert_allclose(a, e, atol=1e-3, rtol=1e-3)
+
+
+testing.run_module(__name__, __file__)
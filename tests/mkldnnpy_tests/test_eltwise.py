@@ -0,0 +1,46 @@
+import numpy as np
+import unittest
+import chainer
+import chainer.functions as F
+import chainer.testing as testing
+from mkldnn import switch
+
+
+_functions = {
+    'leaky_relu': lambda x: F.leaky_relu(x, slope=0.1),
+    'elu': lambda x: F.elu(x, alpha=1.5),
+    'tanh': lambda x: F.tanh(x, use_cudnn=False),
+    'sigmoid': lambda x: F.sigmoid(x, use_cudnn=False),
+    'clipped_relu': lambda x: F.clipped_relu(x, z=2.0),
+    'softplus': lambda x: F.softplus(x, beta=2.0),
+}
+
+
+@testing.parameterize(*testing.product({
+    'func': sorted(_functions),
+    'shape': [(3, 7), (2, 16, 9, 9), (100000,)],
+}))
+class TestEltwise(unittest.TestCase):
+    def setUp(self):
+        self.x = np.random.uniform(-4, 4, self.shape).astype('f')
+        self.gy = np.random.uniform(-1, 1, self.shape).astype('f')
+
+    def tearDown(self):
+        switch.enable_eltwise = True
+
+    def run_func(self, enable):
+        switch.enable_eltwise = enable
+        x = chainer.Variable(self.x.copy())
+        y = _functions[self.func](x)
+        y.grad = self.gy
+        y.backward()
+        return y.data, x.grad
+
+    def test_cpu(self):
+        expect = self.run_func(False)
+        actual = self.run_func(True)
+        for a, e in zip(actual, expect):
+            testing.assert_allclose(a, e, atol=1e-5, rtol=1e-4)
+
+
+testing.run_module(__name__, __file__)
@@ -0,0 +1,85 @@
+import numpy as np
+import unittest
+import chainer
+import chainer.functions as F
+import chainer.links as L
+import chainer.testing as testing
+
+
+class ConvBN(chainer.Chain):
+    def __init__(self):
+        super(ConvBN, self).__init__(
+            conv1=L.Convolution2D(3, 8, 3, pad=1, nobias=True,
+                                  use_cudnn=False),
+            norm1=L.BatchNormalization(8),
+            conv2=L.Convolution2D(8, 8, 3, pad=1, use_cudnn=False),
+            norm2=L.BatchNormalization(8),
+            # conv3 output is also used by the residual sum, not folded
+            conv3=L.Convolution2D(8, 8, 1, use_cudnn=False),
+            norm3=L.BatchNormalization(8),
+        )
+
+    def __call__(self, x):
+        h = F.relu(self.norm1(self.conv1(x)))
+        h = F.relu(self.norm2(self.conv2(h)))
+        h3 = self.conv3(h)
+        return self.norm3(h3) + h3
+
+
+class TestFoldBatchNormalization(unittest.TestCase):
+    def setUp(self):
+        self.x = np.random.uniform(-1, 1, (2, 3, 9, 9)).astype('f')
+        self.model = ConvBN()
+        for bn in (self.model.norm1, self.model.norm2, self.model.norm3):
+            bn.avg_mean[:] = np.random.uniform(-1, 1, bn.avg_mean.shape)
+            bn.avg_var[:] = np.random.uniform(.5, 2, bn.avg_var.shape)
+            bn.gamma.data[:] = np.random.uniform(.5, 2, bn.gamma.shape)
+            bn.beta.data[:] = np.random.uniform(-1, 1, bn.beta.shape)
+
+    def infer(self):
+        with chainer.using_config('train', False):
+            return self.model(self.x).data
+
+    def test_fold(self):
+        y_expect = self.infer()
+        pairs = L.fold_batch_normalization(self.model, self.x)
+        self.assertEqual(
+            set(pairs), {(self.model.conv1, self.model.norm1),
+                         (self.model.conv2, self.model.norm2)})
+        self.assertFalse(self.model.norm3.folded)
+        testing.assert_allclose(self.infer(), y_expect, atol=1e-4, rtol=1e-4)
+
+    def check_refold(self, update):
+        L.fold_batch_normalization(self.model, self.x)
+        self.infer()
+        update()
+        y = self.infer()
+        self.model.norm1.folded = False
+        self.model.norm2.folded = False
+        self.model.conv1._folded_bn = None
+        self.model.conv2._folded_bn = None
+        testing.assert_allclose(y, self.infer(), atol=1e-4, rtol=1e-4)
+
+    def test_refold_after_update(self):
+        def update():
+            self.model.norm1.gamma.data *= 2
+        self.check_refold(update)
+
+    def test_refold_after_train_forward(self):
+        # running statistics change without any parameter update
+        def update():
+            self.model(self.x)
+        self.check_refold(update)
+
+    def test_refold_after_assign_stats(self):
+        def update():
+            self.model.norm1.avg_var = self.model.norm1.avg_var * 2
+        self.check_refold(update)
+
+    def test_train_unaffected(self):
+        y_expect = self.model(self.x).data
+        L.fold_batch_normalization(self.model, self.x)
+        testing.assert_allclose(self.model(self.x).data, y_expect)
+
+
+testing.run_module(__name__, __file__)
@@ -0,0 +1,75 @@
+import numpy as np
+import unittest
+import chainer
+import chainer.functions as F
+import chainer.links as L
+import chainer.testing as testing
+from mkldnn import switch
+
+
+def run(f, x, W, b):
+    x = chainer.Variable(x)
+    W = chainer.Variable(W)
+    b = chainer.Variable(b)
+    y = f(x, W, b)
+    np.random.seed(0)
+    y.grad = np.random.uniform(-1, 1, y.shape).astype('f')
+    y.backward()
+    return y.data, x.grad, W.grad, b.grad
+
+
+def compare(f, x, W, b):
+    switch.enable_conv = False
+    expect = run(f, x, W, b)
+    switch.enable_conv = True
+    actual = run(f, x, W, b)
+    for a, e in zip(actual, expect):
+        testing.assert_allclose(a, e, atol=1e-3, rtol=1e-3)
+
+
+@testing.parameterize(*testing.product({
+    'groups': [2, 4, 16],
+    'stride': [1, 2],
+}))
+class TestGroupedConvolution2D(unittest.TestCase):
+    def setUp(self):
+        self.x = np.random.uniform(-1, 1, (2, 16, 9, 9)).astype('f')
+        self.W = np.random.uniform(
+            -1, 1, (32, 16 // self.groups, 3, 3)).astype('f')
+        self.b = np.random.uniform(-1, 1, (32,)).astype('f')
+
+    def tearDown(self):
+        switch.enable_conv = True
+
+    def test_forward_backward(self):
+        compare(lambda x, W, b: F.convolution_2d(
+            x, W, b, stride=self.stride, pad=1, use_cudnn=False,
+            groups=self.groups), self.x, self.W, self.b)
+
+    def test_link(self):
+        conv = L.Convolution2D(16, 32, 3, pad=1, groups=self.groups,
+                               use_cudnn=False)
+        self.assertEqual(conv.W.shape, (32, 16 // self.groups, 3, 3))
+        self.assertEqual(conv(self.x).shape, (2, 32, 9, 9))
+
+
+@testing.parameterize(*testing.product({
+    'dilate': [2, 3],
+    'pad': [0, 2],
+}))
+class TestDilatedConvolution2D(unittest.TestCase):
+    def setUp(self):
+        self.x = np.random.uniform(-1, 1, (2, 8, 11, 10)).astype('f')
+        self.W = np.random.uniform(-1, 1, (16, 8, 3, 3)).astype('f')
+        self.b = np.random.uniform(-1, 1, (16,)).astype('f')
+
+    def tearDown(self):
+        switch.enable_conv = True
+
+    def test_forward_backward(self):
+        compare(lambda x, W, b: F.dilated_convolution_2d(
+            x, W, b, pad=self.pad, dilate=self.dilate, use_cudnn=False),
+            self.x, self.W, self.b)
+
+
+testing.run_module(__name__, __file__)
@@ -0,0 +1,47 @@
+import numpy as np
+import unittest
+import chainer
+import chainer.functions as F
+import chainer.links as L
+import chainer.testing as testing
+from mkldnn import switch
+
+
+class TestInference(unittest.TestCase):
+    def setUp(self):
+        switch.enable_conv = True
+        switch.enable_max_pooling = True
+        switch.enable_avg_pooling = True
+        switch.enable_lrn = True
+        self.x = np.random.uniform(-1, 1, (2, 16, 14, 14)).astype('f')
+        self.conv = L.Convolution2D(16, 32, 3, pad=1, use_cudnn=False)
+
+    def forward(self, x):
+        h = self.conv(x)
+        h = F.max_pooling_2d(h, 3, stride=2, use_cudnn=False)
+        h = F.local_response_normalization(h)
+        return F.average_pooling_2d(h, 2, use_cudnn=False)
+
+    def test_forward(self):
+        y_expect = self.forward(self.x).data
+        with chainer.using_config('train', False):
+            y = self.forward(self.x).data
+        testing.assert_allclose(y, y_expect, atol=1e-4, rtol=1e-3)
+
+    def test_backward(self):
+        # workspaces dropped by forward_inference are rebuilt on backward
+        x = chainer.Variable(self.x)
+        y_expect = self.forward(x)
+        y_expect.grad = np.ones(y_expect.shape, dtype='f')
+        y_expect.backward()
+        gx_expect = x.grad.copy()
+
+        x.cleargrad()
+        with chainer.using_config('train', False):
+            y = self.forward(x)
+        y.grad = np.ones(y.shape, dtype='f')
+        y.backward()
+        testing.assert_allclose(x.grad, gx_expect, atol=1e-4, rtol=1e-3)
+
+
+testing.run_module(__name__, __file__)
@@ -0,0 +1,129 @@
+import numpy as np
+import threading
+import unittest
+import chainer.testing as testing
+from chainer import functions as F
+from mkldnn import mkldnn as mkl
+from mkldnn import switch
+
+
+class TestLayerCache(unittest.TestCase):
+    def setUp(self):
+        switch.enable_relu = True
+        switch.enable_max_pooling = True
+        mkl.layer_cache_clear()
+        mkl.layer_cache_set_limit(0, 2)
+
+    def tearDown(self):
+        mkl.layer_cache_set_limit(0, 0)
+        mkl.layer_cache_clear()
+
+    def relu(self, shape):
+        x = np.random.rand(*shape).astype('f') - 0.5
+        gy = np.random.rand(*shape).astype('f')
+        f_relu = F.ReLU(False)
+        y = f_relu.forward_cpu((x,))
+        return f_relu, x, gy, y
+
+    def test_evict_entries(self):
+        for n in range(1, 6):
+            self.relu((n, 8, 4, 4))
+        self.assertLessEqual(mkl.layer_cache_entries(), 2)
+        self.assertEqual(mkl.layer_cache_evictions(), 3)
+
+    def test_clear(self):
+        self.relu((1, 8, 4, 4))
+        self.assertEqual(mkl.layer_cache_entries(), 1)
+        mkl.layer_cache_clear()
+        self.assertEqual(mkl.layer_cache_entries(), 0)
+        self.assertEqual(mkl.layer_cache_memory_size(), 0)
+
+    def test_relu_backward_after_evict(self):
+        f_relu, x, gy, y = self.relu((2, 8, 4, 4))
+        # push the forward object out of the cache
+        self.relu((3, 8, 4, 4))
+        self.relu((4, 8, 4, 4))
+        gx = f_relu.backward_cpu((x,), (gy,))
+        testing.assert_allclose(y[0], np.maximum(x, 0))
+        testing.assert_allclose(gx[0], gy * (x > 0))
+
+    def test_max_pooling_backward_after_evict(self):
+        x = np.random.rand(2, 16, 8, 8).astype('f')
+        gy = np.random.rand(2, 16, 4, 4).astype('f')
+        f_pool = F.MaxPooling2D(2, 2, 0, False)
+        y = f_pool.forward_cpu((x,))
+        self.relu((3, 8, 4, 4))
+        self.relu((4, 8, 4, 4))
+        gx = f_pool.backward_cpu((x,), (gy,))
+
+        switch.enable_max_pooling = False
+        f_pool_expect = F.MaxPooling2D(2, 2, 0, False)
+        y_expect = f_pool_expect.forward_cpu((x,))
+        gx_expect = f_pool_expect.backward_cpu((x,), (gy,))
+        testing.assert_allclose(y[0], y_expect[0])
+        testing.assert_allclose(gx[0], gx_expect[0])
+
+    def test_memory_limit(self):
+        mkl.layer_cache_set_limit(0, 0)
+        x = np.random.rand(3, 16, 8, 8).astype('f')
+        for n in range(1, 4):
+            f_pool = F.MaxPooling2D(2, 2, 0, False)
+            f_pool.forward_cpu((np.ascontiguousarray(x[:n]),))
+        self.assertEqual(mkl.layer_cache_entries(), 3)
+        if mkl.layer_cache_memory_size() == 0:
+            return
+        mkl.layer_cache_set_limit(1, 0)
+        # the most recently used layer is always kept
+        self.assertEqual(mkl.layer_cache_entries(), 1)
+
+    def test_threads(self):
+        mkl.layer_cache_set_limit(0, 0)
+        shapes = [(2, 8, 4, 4), (3, 8, 4, 4)]
+        errors = []
+
+        def run(shape):
+            try:
+                for _ in range(20):
+                    f_relu, x, gy, y = self.relu(shape)
+                    gx = f_relu.backward_cpu((x,), (gy,))
+                    testing.assert_allclose(y[0], np.maximum(x, 0))
+                    testing.assert_allclose(gx[0], gy * (x > 0))
+            except Exception as e:
+                errors.append(e)
+
+        threads = [threading.Thread(target=run, args=(shapes[i % 2],))
+                   for i in range(8)]
+        for t in threads:
+            t.start()
+        for t in threads:
+            t.join()
+        self.assertEqual(errors, [])
+        # every layer has been handed back
+        self.assertLessEqual(mkl.layer_cache_entries(), len(threads))
+        self.assertGreaterEqual(mkl.layer_cache_entries(), len(shapes))
+
+    def test_key_by_owner(self):
+        mkl.layer_cache_set_limit(0, 0)
+        switch.enable_conv = True
+        x = np.random.rand(2, 8, 6, 6).astype('f')
+        Ws = [np.random.rand(8, 8, 3, 3).astype('f') for _ in range(2)]
+
+        def forward():
+            for W in Ws:
+                F.convolution_2d(x, W, pad=1, use_cudnn=False)
+
+        forward()
+        self.assertEqual(mkl.layer_cache_entries(), 1)
+
+        mkl.layer_cache_set_key_by_owner(True)
+        try:
+            mkl.layer_cache_clear()
+            forward()
+            forward()
+            # one instance per W, one forward primitive desc for both
+            self.assertEqual(mkl.layer_cache_entries(), 2)
+            self.assertEqual(mkl.layer_cache_primitive_descs(), 1)
+        finally:
+            mkl.layer_cache_set_key_by_owner(False)
+
+testing.run_module(__name__, __file__)
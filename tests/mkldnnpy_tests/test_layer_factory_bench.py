@@ -0,0 +1,23 @@
+import chainer.functions as F
+import numpy as np
+from mkldnn import mkldnn as mkl
+from mkldnn import switch
+
+# Times LayerFactory lookups alone, with the layer already cached: a
+# get_relu4d_layer/put_layer round trip on LayerKey, against the formatted
+# string key and unordered_map lookup used before.
+
+niter = 1000000
+shape = (1, 8, 4, 4)
+
+switch.enable_relu = True
+x = np.ones(shape, dtype=np.float32)
+# warm up, the forward call leaves an idle relu4d layer in the cache
+F.ReLU(False).forward_cpu((x,))
+
+for name, string_keys in (("string key", True), ("LayerKey", False)):
+    # the first run warms up the lookup path itself
+    mkl.layer_cache_lookup_ns(*(shape + (niter // 10, string_keys)))
+    ns = mkl.layer_cache_lookup_ns(*(shape + (niter, string_keys)))
+    assert ns >= 0, "relu4d layer is not cached"
+    print(name, "lookup Average: ", ns, "ns")
@@ -0,0 +1,143 @@
+import numpy as np
+import six
+import unittest
+import chainer
+from chainer import function_hooks
+import chainer.functions as F
+import chainer.links as L
+import chainer.testing as testing
+from mkldnn import switch
+
+
+@testing.parameterize(*testing.product({
+    'ksize': [2, 3],
+    'cover_all': [True, False],
+    'inplace': [True, False],
+}))
+class TestMask(unittest.TestCase):
+    def setUp(self):
+        self.x = np.random.uniform(-1, 1, (2, 8, 11, 11)).astype('f')
+        self.conv = L.Convolution2D(8, 8, 3, pad=1, use_cudnn=False)
+
+    def tearDown(self):
+        switch.enable_relu_inplace = False
+        switch.enable_relu_mask = True
+        switch.enable_max_pooling_mask = True
+        switch.enable_release_inputs = False
+
+    def forward(self, x):
+        h = F.relu(self.conv(x))
+        return F.max_pooling_2d(F.relu(self.conv(h)), self.ksize,
+                                pad=1, cover_all=self.cover_all,
+                                use_cudnn=False)
+
+    def run_net(self, mask):
+        switch.enable_relu_inplace = self.inplace
+        switch.enable_relu_mask = mask
+        switch.enable_max_pooling_mask = mask
+        self.conv.cleargrads()
+        x = chainer.Variable(self.x.copy())
+        y = self.forward(x)
+        y.grad = np.random.RandomState(0).uniform(
+            -1, 1, y.shape).astype('f')
+        y.backward()
+        return y, (y.data, x.grad, self.conv.W.grad)
+
+    def test_backward(self):
+        _, expect = self.run_net(False)
+        y, actual = self.run_net(True)
+        self.assertIsNotNone(y.creator.mask)
+        self.assertIsNotNone(y.creator.inputs[0].creator.mask)
+        for a, e in zip(actual, expect):
+            testing.assert_allclose(a, e, atol=1e-5, rtol=1e-4)
+
+    def test_release(self):
+        switch.enable_relu_inplace = self.inplace
+        switch.enable_release_inputs = True
+        x = chainer.Variable(self.x.copy())
+        y = self.forward(x)
+        # the conv and relu outputs under the pooling are released
+        h = y.creator.inputs[0]
+        for v in (h, h.creator.inputs[0]):
+            with self.assertRaises(RuntimeError):
+                v.data
+            self.assertEqual(v.shape, (2, 8, 11, 11))
+            self.assertEqual(v.dtype, np.float32)
+
+    def test_release_hooks(self):
+        switch.enable_relu_inplace = self.inplace
+        switch.enable_release_inputs = True
+        x = chainer.Variable(self.x.copy())
+        y = self.forward(x)
+        y.grad = np.ones(y.shape, dtype='f')
+        out = six.StringIO()
+        with function_hooks.PrintHook(file=out):
+            y.backward()
+        # hooks are told, instead of reading made up data
+        self.assertIn('(released)', out.getvalue())
+        self.assertEqual(x.grad.shape, x.shape)
+
+
+class TestMaskReferenced(unittest.TestCase):
+    def test_no_release_by_default(self):
+        x = chainer.Variable(
+            np.random.uniform(-1, 1, (2, 4, 6, 6)).astype('f'))
+        y = F.max_pooling_2d(F.relu(F.identity(x)), 2, use_cudnn=False)
+        self.assertIsNotNone(y.creator.mask)
+        h = y.creator.inputs[0]
+        testing.assert_allclose(h.data, np.maximum(x.data, 0))
+
+    def test_referenced_input(self):
+        # h is referenced by the caller and keeps its data
+        x = chainer.Variable(
+            np.random.uniform(-1, 1, (2, 4, 6, 6)).astype('f'))
+        h = F.relu(F.identity(x))
+        h_data = h.data.copy()
+        y = F.max_pooling_2d(h, 2, use_cudnn=False)
+        self.assertIsNotNone(y.creator.mask)
+        testing.assert_allclose(h.data, h_data)
+
+    def test_inference(self):
+        x = chainer.Variable(
+            np.random.uniform(-1, 1, (2, 4, 6, 6)).astype('f'))
+        with chainer.using_config('train', False):
+            y = F.max_pooling_2d(F.relu(F.identity(x)), 2, use_cudnn=False)
+        self.assertIsNone(y.creator.mask)
+        self.assertIsNone(y.creator.inputs[0].creator.mask)
+
+
+@testing.parameterize(*[
+    {'in_size': 4, 'ksize': 1, 'stride': 2, 'pad': 0},
+    {'in_size': 5, 'ksize': 2, 'stride': 4, 'pad': 1},
+])
+class TestMaskEmptyWindow(unittest.TestCase):
+    """Windows in the padding only, stride larger than ksize and cover_all.
+    """
+
+    def setUp(self):
+        shape = (2, 3, self.in_size, self.in_size)
+        self.x = np.random.uniform(-1, 1, shape).astype('f')
+
+    def tearDown(self):
+        switch.enable_max_pooling = True
+
+    def run_pool(self, mkldnn):
+        switch.enable_max_pooling = mkldnn
+        x = chainer.Variable(self.x.copy())
+        y = F.max_pooling_2d(x, self.ksize, self.stride, self.pad,
+                             cover_all=True, use_cudnn=False)
+        y.grad = np.random.RandomState(0).uniform(
+            -1, 1, y.shape).astype('f')
+        y.backward()
+        return y, x.grad
+
+    def test_empty_window(self):
+        y_expect, gx_expect = self.run_pool(False)
+        y, gx = self.run_pool(True)
+        self.assertIsNotNone(y.creator.mask)
+        self.assertTrue(np.isneginf(y_expect.data).any())
+        testing.assert_allclose(y.data, y_expect.data)
+        testing.assert_allclose(gx, gx_expect)
+
+
+testing.run_module(__name__, __file__)
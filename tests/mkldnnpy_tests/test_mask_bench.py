@@ -0,0 +1,54 @@
+import chainer
+import chainer.functions as F
+import chainer.links as L
+import numpy as np
+import time
+import tracemalloc
+
+from mkldnn import switch
+
+
+# Peak memory of conv-relu-pool blocks with and without ReLU and max
+# pooling masks. numpy reports its allocations to tracemalloc, MKL-DNN
+# internal buffers are not counted.
+class ConvReLUPool(chainer.Chain):
+    def __init__(self, n_blocks=3, channels=64):
+        super(ConvReLUPool, self).__init__()
+        for i in range(n_blocks):
+            self.add_link('conv%d' % i, L.Convolution2D(
+                channels, channels, 3, pad=1, use_cudnn=False))
+        self.n_blocks = n_blocks
+
+    def __call__(self, x):
+        h = x
+        for i in range(self.n_blocks):
+            h = F.max_pooling_2d(
+                F.relu(getattr(self, 'conv%d' % i)(h)), 2, use_cudnn=False)
+        return h
+
+
+model = ConvReLUPool()
+data = np.random.uniform(-1, 1, (64, 64, 112, 112)).astype(np.float32)
+
+for mask in (False, True):
+    switch.enable_relu_mask = mask
+    switch.enable_max_pooling_mask = mask
+    switch.enable_release_inputs = mask
+    # warm up primitives and layer caches
+    loss = F.sum(model(chainer.Variable(data)))
+    loss.backward()
+    model.cleargrads()
+    del loss
+
+    tracemalloc.start()
+    start = time.time()
+    loss = F.sum(model(chainer.Variable(data)))
+    loss.backward()
+    end = time.time()
+    _, peak = tracemalloc.get_traced_memory()
+    tracemalloc.stop()
+    model.cleargrads()
+    del loss
+
+    print("relu/pooling masks: %s, peak: %.1f MB, time: %.1f ms"
+          % (mask, peak / 1e6, (end - start) * 1000))
@@ -0,0 +1,58 @@
+import numpy as np
+import unittest
+import chainer
+import chainer.functions as F
+import chainer.links as L
+import chainer.testing as testing
+from mkldnn import switch
+from mkldnn.mdarray import mdarray
+
+
+class TestMdArray(unittest.TestCase):
+    def setUp(self):
+        switch.enable_conv = True
+        switch.enable_relu = True
+        switch.enable_max_pooling = True
+        switch.enable_avg_pooling = True
+        switch.enable_lrn = True
+        self.x = np.random.uniform(-1, 1, (2, 16, 14, 14)).astype('f')
+        self.W = np.random.uniform(-1, 1, (32, 16, 3, 3)).astype('f')
+        self.conv = L.Convolution2D(16, 32, 3, stride=1, pad=1,
+                                    initialW=self.W, use_cudnn=False)
+
+    def tearDown(self):
+        switch.enable_mdarray = False
+
+    def forward(self, x):
+        h = F.relu(self.conv(x), use_cudnn=False)
+        h = F.max_pooling_2d(h, 3, stride=2, use_cudnn=False)
+        h = F.local_response_normalization(h)
+        return F.average_pooling_2d(h, 2, use_cudnn=False)
+
+    def test_roundtrip(self):
+        x = mdarray.from_numpy(self.x)
+        self.assertEqual(x.shape, self.x.shape)
+        self.assertEqual(x.dtype, np.float32)
+        testing.assert_allclose(np.asarray(x), self.x)
+
+    def test_chain(self):
+        with chainer.using_config('train', False):
+            y_expect = self.forward(self.x).data
+            switch.enable_mdarray = True
+            y = self.forward(self.x).data
+        self.assertIsInstance(y, mdarray)
+        self.assertEqual(y.shape, y_expect.shape)
+        testing.assert_allclose(np.asarray(y), y_expect, atol=1e-4, rtol=1e-3)
+
+    def test_backward(self):
+        # outputs of the layout-keeping path still feed numpy backward
+        switch.enable_mdarray = True
+        x = chainer.Variable(self.x)
+        y = F.relu(self.conv(x), use_cudnn=False)
+        self.assertIsInstance(y.data, mdarray)
+        y.grad = np.ones(y.shape, dtype='f')
+        y.backward()
+        self.assertEqual(x.grad.shape, self.x.shape)
+
+
+testing.run_module(__name__, __file__)
@@ -0,0 +1,79 @@
+import numpy as np
+import unittest
+import chainer
+import chainer.functions as F
+import chainer.links as L
+import chainer.testing as testing
+from mkldnn import switch
+
+
+@testing.parameterize(*testing.product({
+    'shape': [(2, 8, 9, 9), (4, 30)],
+}))
+class TestReLUInplace(unittest.TestCase):
+    def setUp(self):
+        self.x = np.random.uniform(-1, 1, self.shape).astype('f')
+        if len(self.shape) == 4:
+            self.layer = L.Convolution2D(8, 8, 3, pad=1, use_cudnn=False)
+        else:
+            self.layer = L.Linear(30, 30)
+
+    def tearDown(self):
+        switch.enable_relu_inplace = False
+
+    def forward(self, x):
+        h = F.relu(self.layer(x))
+        return F.relu(self.layer(h)), h
+
+    def run_net(self, inplace):
+        switch.enable_relu_inplace = inplace
+        self.layer.cleargrads()
+        x = chainer.Variable(self.x.copy())
+        y, h = self.forward(x)
+        loss = F.sum(y * y)
+        loss.backward()
+        # the gradient of y is allocated by backward, so relu may reuse it
+        self.assertTrue(y.creator.inplace_grad)
+        return y.creator.inplace, (y.data, x.grad, self.layer.W.grad)
+
+    def test_inplace(self):
+        inplace, expect = self.run_net(False)
+        self.assertFalse(inplace)
+        inplace, actual = self.run_net(True)
+        self.assertTrue(inplace)
+        for a, e in zip(actual, expect):
+            testing.assert_allclose(a, e, atol=1e-5, rtol=1e-4)
+
+    def test_off_by_default(self):
+        # h is referenced by the caller, relu must not overwrite it unless
+        # the user opts in
+        x = chainer.Variable(self.x.copy())
+        h = self.layer(x)
+        h_data = h.data.copy()
+        y = F.relu(h)
+        self.assertFalse(y.creator.inplace)
+        testing.assert_allclose(h.data, h_data)
+
+    def test_retained_grad(self):
+        x = chainer.Variable(self.x.copy())
+        y = F.relu(self.layer(x))
+        loss = F.sum(y * y)
+        loss.backward(retain_grad=True)
+        self.assertFalse(y.creator.inplace_grad)
+        testing.assert_allclose(y.grad, 2 * y.data, atol=1e-5, rtol=1e-4)
+
+    def test_leaf_input(self):
+        switch.enable_relu_inplace = True
+        x = self.x.copy()
+        F.relu(chainer.Variable(x))
+        testing.assert_allclose(x, self.x)
+
+    def test_identity_input(self):
+        # F.identity outputs the array of its input
+        switch.enable_relu_inplace = True
+        x = self.x.copy()
+        F.relu(F.identity(chainer.Variable(x)))
+        testing.assert_allclose(x, self.x)
+
+
+testing.run_module(__name__, __file__)
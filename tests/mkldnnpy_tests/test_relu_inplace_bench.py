@@ -0,0 +1,51 @@
+import chainer
+import chainer.functions as F
+import chainer.links as L
+import numpy as np
+import time
+import tracemalloc
+
+from mkldnn import switch
+
+
+# Peak memory of a conv-relu stack with and without in-place ReLU.
+# numpy reports its allocations to tracemalloc, MKL-DNN internal buffers
+# are not counted.
+class ConvReLUStack(chainer.Chain):
+    def __init__(self, n_layers=8, channels=64):
+        super(ConvReLUStack, self).__init__()
+        for i in range(n_layers):
+            self.add_link('conv%d' % i, L.Convolution2D(
+                channels, channels, 3, pad=1, use_cudnn=False))
+        self.n_layers = n_layers
+
+    def __call__(self, x):
+        h = x
+        for i in range(self.n_layers):
+            h = F.relu(getattr(self, 'conv%d' % i)(h))
+        return h
+
+
+model = ConvReLUStack()
+data = np.random.uniform(-1, 1, (16, 64, 56, 56)).astype(np.float32)
+
+for inplace in (False, True):
+    switch.enable_relu_inplace = inplace
+    # warm up primitives and layer caches
+    loss = F.sum(model(chainer.Variable(data)))
+    loss.backward()
+    model.cleargrads()
+    del loss
+
+    tracemalloc.start()
+    start = time.time()
+    loss = F.sum(model(chainer.Variable(data)))
+    loss.backward()
+    end = time.time()
+    _, peak = tracemalloc.get_traced_memory()
+    tracemalloc.stop()
+    model.cleargrads()
+    del loss
+
+    print("inplace relu: %s, peak: %.1f MB, time: %.1f ms"
+          % (inplace, peak / 1e6, (end - start) * 1000))
@@ -1,5 +1,6 @@
 import numpy as np
 import unittest
+import chainer
 import chainer.testing as testing
 import chainer.testing.condition as condition
 from chainer import functions as F
@@ -12,6 +13,7 @@ class TestSoftmax(unittest.TestCase):
 
     def tearDown(self):
         self.dims = None
+        switch.enable_softmax = True
 
     def check_softmax(self):
         for dim1, dim2 in self.dims:
@@ -27,4 +29,35 @@ class TestSoftmax(unittest.TestCase):
         self.check_softmax()
 
 
+@testing.parameterize(
+    {'shape': (4, 7), 'axis': 1},
+    {'shape': (4, 7), 'axis': 0},
+    {'shape': (2, 5, 3, 4), 'axis': 1},
+    {'shape': (2, 5, 3, 4), 'axis': -1},
+    {'shape': (3, 6, 70), 'axis': 1},
+    {'shape': (2, 3, 4, 5, 6), 'axis': 2},
+)
+class TestSoftmaxAxis(unittest.TestCase):
+    def setUp(self):
+        self.x = np.random.uniform(-3, 3, self.shape).astype('f')
+        self.gy = np.random.uniform(-1, 1, self.shape).astype('f')
+
+    def tearDown(self):
+        switch.enable_softmax = True
+
+    def run_softmax(self, enable):
+        switch.enable_softmax = enable
+        x = chainer.Variable(self.x.copy())
+        y = F.softmax(x, use_cudnn=False, axis=self.axis)
+        y.grad = self.gy
+        y.backward()
+        return y.data, x.grad
+
+    def test_cpu(self):
+        expect = self.run_softmax(False)
+        actual = self.run_softmax(True)
+        for a, e in zip(actual, expect):
+            testing.assert_allclose(a, e, atol=1e-5, rtol=1e-4)
+
+
 testing.run_module(__name__, __file__)
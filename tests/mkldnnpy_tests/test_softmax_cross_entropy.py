@@ -1,11 +1,23 @@
+import mock
 import numpy as np
 import unittest
+import chainer
 import chainer.testing as testing
 import chainer.testing.condition as condition
 from chainer import functions as F
+from mkldnn import mkldnn
 from mkldnn import switch
 
 
+def _spy(obj, name):
+    """Patches obj.name with a mock that still calls the original."""
+    orig = getattr(obj, name)
+    if isinstance(obj, type):
+        # methods of the SWIG proxy class get the instance as first argument
+        return mock.patch.object(obj, name, autospec=True, side_effect=orig)
+    return mock.patch.object(obj, name, side_effect=orig)
+
+
 class TestSoftmaxCrossEntropy(unittest.TestCase):
     def setUp(self):
         self.x_2d = np.random.rand(2, 3).astype('f')
@@ -27,4 +39,84 @@ class TestSoftmaxCrossEntropy(unittest.TestCase):
         self.check_softmax_cross_entropy()
 
 
+@testing.parameterize(*testing.product({
+    'shape': [(4, 5), (2, 5, 7, 3)],
+    'normalize': [True, False],
+    'cache_score': [True, False],
+}))
+class TestSoftmaxCrossEntropyND(unittest.TestCase):
+    def setUp(self):
+        self.x = np.random.uniform(-5, 5, self.shape).astype('f')
+        t_shape = (self.shape[0],) + self.shape[2:]
+        self.t = np.random.randint(0, self.shape[1], t_shape).astype('i')
+        self.t.ravel()[::3] = -1
+
+    def tearDown(self):
+        switch.enable_softmax_cross_entropy = True
+
+    def run_sce(self, enable):
+        switch.enable_softmax_cross_entropy = enable
+        x = chainer.Variable(self.x.copy())
+        with _spy(mkldnn, 'SoftmaxCrossEntropy_F32_'
+                  'softmax_cross_entropy_create_forward') as create:
+            loss = F.softmax_cross_entropy(
+                x, self.t, use_cudnn=False, normalize=self.normalize,
+                cache_score=self.cache_score)
+        # the native path runs exactly when it is enabled
+        self.assertEqual(create.called, enable)
+        loss.grad = np.full((), 2, dtype='f')
+        loss.backward()
+        return loss.data, x.grad
+
+    def test_cpu(self):
+        expect = self.run_sce(False)
+        actual = self.run_sce(True)
+        for a, e in zip(actual, expect):
+            testing.assert_allclose(a, e, atol=1e-5, rtol=1e-4)
+
+
+@testing.parameterize(*testing.product({
+    'normalize': [True, False],
+    'cache_score': [True, False],
+}))
+class TestSoftmaxCrossEntropyFused2D(unittest.TestCase):
+    def setUp(self):
+        self.x = np.random.uniform(-5, 5, (6, 11)).astype('f')
+        self.t = np.random.randint(0, 11, (6,)).astype('i')
+        self.t[[1, 4]] = -1
+        self.gloss = np.full((), 2, dtype='f')
+
+    def tearDown(self):
+        switch.enable_softmax_cross_entropy = True
+
+    def run_sce(self):
+        x = chainer.Variable(self.x.copy())
+        loss = F.softmax_cross_entropy(
+            x, self.t, use_cudnn=False, normalize=self.normalize,
+            cache_score=self.cache_score)
+        loss.grad = self.gloss
+        loss.backward()
+        return loss.data, x.grad
+
+    def test_fused(self):
+        switch.enable_softmax_cross_entropy = False
+        expect = self.run_sce()
+
+        switch.enable_softmax_cross_entropy = True
+        cls = mkldnn.SoftmaxCrossEntropy_F32
+        with _spy(cls, 'forward_loss') as forward_loss, \
+                _spy(cls, 'backward_x') as backward_x, \
+                _spy(cls, 'backward') as backward:
+            actual = self.run_sce()
+        self.assertEqual(forward_loss.call_count, 1)
+        # without the cached softmax backward recomputes it from x
+        self.assertEqual(backward_x.called, not self.cache_score)
+        self.assertEqual(backward.called, self.cache_score)
+
+        for a, e in zip(actual, expect):
+            testing.assert_allclose(a, e, atol=1e-5, rtol=1e-4)
+        # ignored labels get no gradient
+        self.assertTrue((actual[1][[1, 4]] == 0).all())
+
+
 testing.run_module(__name__, __file__)
@@ -0,0 +1,76 @@
+import numpy as np
+import threading
+import unittest
+import chainer.functions as F
+import chainer.links as L
+import chainer.testing as testing
+from mkldnn import switch
+
+
+def run_threads(target, nthreads):
+    errors = []
+
+    def run():
+        try:
+            target()
+        except Exception as e:
+            errors.append(e)
+
+    threads = [threading.Thread(target=run) for _ in range(nthreads)]
+    for t in threads:
+        t.start()
+    for t in threads:
+        t.join()
+    return errors
+
+
+class TestThreads(unittest.TestCase):
+    def setUp(self):
+        switch.enable_conv = True
+        switch.enable_concat = True
+        self.x = np.random.rand(2, 16, 16, 16).astype('f')
+        self.W = np.random.rand(32, 16, 3, 3).astype('f')
+        self.conv = L.Convolution2D(16, 32, 3, stride=1, pad=1,
+                                    initialW=self.W, use_cudnn=False)
+
+    def test_convolution(self):
+        y_expect = self.conv(self.x).data
+
+        def forward():
+            for _ in range(10):
+                testing.assert_allclose(self.conv(self.x).data, y_expect)
+
+        self.assertEqual(run_threads(forward, 4), [])
+
+    def test_concat_list(self):
+        xs = [np.random.rand(2, c, 8, 8).astype('f') for c in (2, 4, 8)]
+        y_expect = np.concatenate(xs, axis=1)
+
+        def forward():
+            for _ in range(10):
+                y = F.Concat(axis=1).forward(list(xs))
+                testing.assert_allclose(y[0], y_expect)
+
+        self.assertEqual(run_threads(forward, 4), [])
+
+    def test_python_thread_progress(self):
+        # a pure python thread keeps running while convolutions are computed
+        stop = threading.Event()
+        count = [0]
+
+        def spin():
+            while not stop.is_set():
+                count[0] += 1
+
+        spinner = threading.Thread(target=spin)
+        spinner.start()
+        try:
+            for _ in range(5):
+                self.conv(self.x)
+        finally:
+            stop.set()
+            spinner.join()
+        self.assertGreater(count[0], 0)
+
+
+testing.run_module(__name__, __file__)
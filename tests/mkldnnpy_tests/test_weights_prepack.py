@@ -0,0 +1,135 @@
+import numpy as np
+import unittest
+import chainer
+import chainer.functions as F
+import chainer.links as L
+import chainer.testing as testing
+from chainer import optimizers
+from mkldnn import switch
+
+
+class TestWeightsPrepack(unittest.TestCase):
+    def setUp(self):
+        switch.enable_conv = True
+        switch.enable_linear = True
+        self.x = np.random.uniform(-1, 1, (2, 16, 8, 8)).astype('f')
+        self.conv = L.Convolution2D(16, 32, 3, pad=1, use_cudnn=False)
+        self.linear = L.Linear(16 * 8 * 8, 10)
+
+    def forward(self, link):
+        with chainer.using_config('train', False):
+            return link(self.x).data.copy()
+
+    def check_update(self, link):
+        y0 = self.forward(link)
+        testing.assert_allclose(self.forward(link), y0)
+
+        # modified in place, the prepacked W must not be reused
+        link.W.data *= 2
+        testing.assert_allclose(self.forward(link), y0 * 2,
+                                atol=1e-4, rtol=1e-4)
+        link.W.data[...] *= 2
+        link.W.mark_updated()
+        testing.assert_allclose(self.forward(link), y0 * 4,
+                                atol=1e-4, rtol=1e-4)
+
+    def test_conv(self):
+        self.conv.b.data[...] = 0
+        self.check_update(self.conv)
+
+    def test_linear(self):
+        self.linear.b.data[...] = 0
+        self.check_update(self.linear)
+
+    def test_optimizer(self):
+        opt = optimizers.SGD(lr=0.1)
+        opt.setup(self.conv)
+        version = self.conv.W.version
+        y0 = self.forward(self.conv)
+        self.conv.cleargrads()
+        loss = chainer.functions.sum(self.conv(self.x))
+        loss.backward()
+        opt.update()
+        self.assertGreater(self.conv.W.version, version)
+        y1 = self.forward(self.conv)
+        self.assertFalse(np.allclose(y0, y1))
+
+    def test_copyparams(self):
+        other = L.Convolution2D(16, 32, 3, pad=1, use_cudnn=False)
+        self.forward(self.conv)
+        self.conv.copyparams(other)
+        testing.assert_allclose(self.forward(self.conv), self.forward(other),
+                                atol=1e-5, rtol=1e-5)
+
+    def test_versions(self):
+        other = L.Convolution2D(16, 32, 3, pad=1, use_cudnn=False)
+        self.assertNotEqual(self.conv.W.version, other.W.version)
+        version = self.conv.W.version
+        self.forward(self.conv)
+        self.conv.W.data
+        self.assertEqual(self.conv.W.version, version)
+        # a copy shares the array, writes through either are seen by both
+        copied = self.conv.copy()
+        copied.W.data = np.zeros_like(copied.W.data)
+        self.assertEqual(self.conv.W.version, copied.W.version)
+        self.assertGreater(self.conv.W.version, version)
+        self.assertIsNone(chainer.Variable(self.x).version)
+
+    def test_serialize(self):
+        other = L.Convolution2D(16, 32, 3, pad=1, use_cudnn=False)
+        self.forward(self.conv)
+        version = self.conv.W.version
+        target = {}
+        other.serialize(chainer.serializers.DictionarySerializer(target))
+        self.conv.serialize(chainer.serializers.NpzDeserializer(target))
+        self.assertGreater(self.conv.W.version, version)
+        testing.assert_allclose(self.forward(self.conv), self.forward(other),
+                                atol=1e-5, rtol=1e-5)
+
+
+class TestWeightsPrepackFunctional(unittest.TestCase):
+    """Functional calls with arrays of the user never reuse a reorder.
+
+    Both calls see the same buffer, the worst case of a new W array put at
+    the address of a freed one.
+    """
+
+    def setUp(self):
+        switch.enable_conv = True
+        switch.enable_linear = True
+        switch.enable_deconv = True
+        self.x = np.random.uniform(-1, 1, (2, 16, 8, 8)).astype('f')
+
+    def tearDown(self):
+        switch.enable_conv = True
+        switch.enable_linear = True
+        switch.enable_deconv = True
+
+    def check(self, f, W, W_shape):
+        W1 = np.random.uniform(-1, 1, W_shape).astype('f')
+        W2 = np.random.uniform(-1, 1, W_shape).astype('f')
+        ys = []
+        with chainer.using_config('train', False):
+            for w in (W1, W2):
+                W[...] = w
+                ys.append(f(self.x, W).data.copy())
+            switch.enable_conv = switch.enable_linear = False
+            switch.enable_deconv = False
+            for y, w in zip(ys, (W1, W2)):
+                testing.assert_allclose(y, f(self.x, w).data,
+                                        atol=1e-4, rtol=1e-4)
+
+    def check_arrays(self, f, W_shape):
+        self.check(f, np.empty(W_shape, dtype='f'), W_shape)
+
+    def test_conv(self):
+        self.check_arrays(F.convolution_2d, (32, 16, 3, 3))
+
+    def test_linear(self):
+        self.check_arrays(F.linear, (10, 16 * 8 * 8))
+
+    def test_deconv(self):
+        self.check_arrays(F.deconvolution_2d, (16, 8, 3, 3))
+
+
+testing.run_module(__name__, __file__)